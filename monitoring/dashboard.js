@@ -10,6 +10,9 @@ class CamelRouterDashboard {
     this.refreshInterval = 5000; // 5 seconds
     this.websocket = null;
     this.charts = {};
+    // Last snapshot pushed over /ws, kept current by applying deltas.
+    this.state = null;
+    this.seq = 0;
 
     this.init();
   }
@@ -39,6 +42,12 @@ class CamelRouterDashboard {
     if (refreshButton) {
       refreshButton.addEventListener("click", () => this.refreshAll());
     }
+
+    // History range
+    const historyRange = document.getElementById("history-range");
+    if (historyRange) {
+      historyRange.addEventListener("change", () => this.loadHistory());
+    }
   }
 
   connectWebSocket() {
@@ -48,6 +57,8 @@ class CamelRouterDashboard {
       this.websocket.onopen = () => {
         console.log("WebSocket connected");
         this.updateConnectionStatus("connected");
+        // The server pushes every change; polling would only duplicate it.
+        this.stopPeriodicRefresh();
       };
 
       this.websocket.onmessage = (event) => {
@@ -58,6 +69,11 @@ class CamelRouterDashboard {
       this.websocket.onclose = () => {
         console.log("WebSocket disconnected");
         this.updateConnectionStatus("disconnected");
+        this.state = null;
+        const autoRefreshToggle = document.getElementById("auto-refresh");
+        if (!autoRefreshToggle || autoRefreshToggle.checked) {
+          this.startPeriodicRefresh();
+        }
         // Attempt to reconnect after 5 seconds
         setTimeout(() => this.connectWebSocket(), 5000);
       };
@@ -104,6 +120,7 @@ class CamelRouterDashboard {
         this.loadMetrics(),
         this.loadRecentAlerts(),
         this.loadSystemHealth(),
+        this.loadHistory(),
       ]);
     } catch (error) {
       console.error("Error loading initial data:", error);
@@ -154,6 +171,52 @@ class CamelRouterDashboard {
     }
   }
 
+  // Message rate and latency history from cpp_monitor's embedded store.
+  async loadHistory() {
+    const rangeSelect = document.getElementById("history-range");
+    const range = rangeSelect ? Number(rangeSelect.value) : 3600;
+    const series = ["metrics.messages_per_minute", "metrics.avg_processing_time"];
+    this.historyLoadedAt = Date.now();
+    try {
+      const response = await fetch(
+        `${this.baseUrl}/api/metrics/history?series=${series.join(",")}&from=-${range}`,
+      );
+      const data = await response.json();
+      this.renderHistory(data.series || {}, series);
+    } catch (error) {
+      console.error("Error loading metrics history:", error);
+    }
+  }
+
+  renderHistory(data, series) {
+    const canvas = document.getElementById("messageChart");
+    if (!canvas || typeof Chart === "undefined") {
+      return;
+    }
+    const times = (data[series[0]] || []).map(([t]) =>
+      new Date(t * 1000).toLocaleTimeString(),
+    );
+    const datasets = [
+      { label: "Messages/min", data: (data[series[0]] || []).map(([, v]) => v), yAxisID: "rate" },
+      { label: "Avg ms", data: (data[series[1]] || []).map(([, v]) => v), yAxisID: "latency" },
+    ];
+    if (this.charts.history) {
+      this.charts.history.data.labels = times;
+      this.charts.history.data.datasets.forEach((d, i) => (d.data = datasets[i].data));
+      this.charts.history.update("none");
+      return;
+    }
+    this.charts.history = new Chart(canvas, {
+      type: "line",
+      data: { labels: times, datasets },
+      options: {
+        animation: false,
+        elements: { point: { radius: 0 } },
+        scales: { rate: { position: "left" }, latency: { position: "right" } },
+      },
+    });
+  }
+
   renderRoutesStatus(data) {
     const container = document.getElementById("routes-status");
 
@@ -176,7 +239,7 @@ class CamelRouterDashboard {
                 ${(data.routes || [])
                   .map(
                     (route) => `
-                    <div class="route-item ${route.status}">
+                    <div class="route-item ${route.status}" data-route="${route.name}">
                         <div class="route-name">${route.name}</div>
                         <div class="route-status">${route.status}</div>
                         <div class="route-metrics">
@@ -288,6 +351,21 @@ class CamelRouterDashboard {
 
   handleRealtimeData(data) {
     switch (data.type) {
+      case "snapshot":
+        this.state = data.payload;
+        this.seq = data.seq;
+        this.renderState();
+        break;
+      case "delta":
+        // A delta only applies on top of the previous sequence number; the
+        // server sends a snapshot instead whenever one was skipped.
+        if (!this.state || data.seq !== this.seq + 1) {
+          break;
+        }
+        this.applyDelta(data.payload);
+        this.seq = data.seq;
+        this.renderState();
+        break;
       case "route_status":
         this.updateRouteStatus(data.payload);
         break;
@@ -303,6 +381,76 @@ class CamelRouterDashboard {
     }
   }
 
+  // Removes first, then sets: a subtree that gains its first child is sent
+  // as a removal of the empty object plus the new leaves.
+  applyDelta(delta) {
+    for (const pointer of delta.remove || []) {
+      this.removePointer(pointer);
+    }
+    for (const [pointer, value] of Object.entries(delta.set || {})) {
+      const { parent, key } = this.resolvePointer(pointer, true);
+      parent[key] = value;
+    }
+  }
+
+  // Deletes a leaf and every object it leaves empty, so a route that went
+  // away disappears instead of lingering as {}.
+  removePointer(pointer) {
+    while (pointer) {
+      const { parent, key } = this.resolvePointer(pointer, false);
+      if (!parent) {
+        return;
+      }
+      delete parent[key];
+      if (Object.keys(parent).length > 0 || parent === this.state) {
+        return;
+      }
+      pointer = pointer.slice(0, pointer.lastIndexOf("/"));
+    }
+  }
+
+  resolvePointer(pointer, create) {
+    const keys = pointer
+      .split("/")
+      .slice(1)
+      .map((k) => k.replace(/~1/g, "/").replace(/~0/g, "~"));
+    let parent = this.state;
+    for (const key of keys.slice(0, -1)) {
+      if (typeof parent[key] !== "object" || parent[key] === null) {
+        if (!create) {
+          return { parent: null, key: null };
+        }
+        parent[key] = {};
+      }
+      parent = parent[key];
+    }
+    return { parent, key: keys[keys.length - 1] };
+  }
+
+  renderState() {
+    const routes = Object.values(this.state.routes || {});
+    this.renderRoutesStatus({
+      total: routes.length,
+      running: routes.filter((r) => r.status === "running").length,
+      failed: routes.filter((r) => r.status !== "running").length,
+      routes,
+    });
+    this.updateMetrics(this.state.metrics || {});
+    this.updateSystemHealth(this.state.health || {});
+    // Polling is paused while pushed; the chart only needs the odd refresh.
+    if (Date.now() - (this.historyLoadedAt || 0) > 30000) {
+      this.loadHistory();
+    }
+  }
+
+  updateMetrics(metricsData) {
+    this.renderMetrics(metricsData);
+  }
+
+  updateSystemHealth(healthData) {
+    this.renderSystemHealth(healthData);
+  }
+
   updateRouteStatus(routeData) {
     // Update specific route in the UI
     const routeElement = document.querySelector(
@@ -317,30 +465,33 @@ class CamelRouterDashboard {
 
   addNewAlert(alertData) {
     const alertsList = document.querySelector(".alerts-list");
-    if (alertsList) {
-      const alertHtml = `
-                <div class="alert-item ${alertData.severity} new">
-                    <div class="alert-time">${this.formatTime(alertData.timestamp)}</div>
-                    <div class="alert-message">${alertData.message}</div>
-                    <div class="alert-source">${alertData.source || "Unknown"}</div>
-                </div>
-            `;
-      alertsList.insertAdjacentHTML("afterbegin", alertHtml);
-
-      // Remove old alerts if too many
-      const alerts = alertsList.querySelectorAll(".alert-item");
-      if (alerts.length > 20) {
-        alerts[alerts.length - 1].remove();
-      }
+    if (!alertsList) {
+      // First alert since the page loaded: build the list around it.
+      this.renderRecentAlerts({ alerts: [alertData] });
+      return;
+    }
+    const alertHtml = `
+            <div class="alert-item ${alertData.severity} new">
+                <div class="alert-time">${this.formatTime(alertData.timestamp)}</div>
+                <div class="alert-message">${alertData.message}</div>
+                <div class="alert-source">${alertData.source || "Unknown"}</div>
+            </div>
+        `;
+    alertsList.insertAdjacentHTML("afterbegin", alertHtml);
 
-      // Remove 'new' class after animation
-      setTimeout(() => {
-        const newAlert = alertsList.querySelector(".alert-item.new");
-        if (newAlert) {
-          newAlert.classList.remove("new");
-        }
-      }, 1000);
+    // Remove old alerts if too many
+    const alerts = alertsList.querySelectorAll(".alert-item");
+    if (alerts.length > 20) {
+      alerts[alerts.length - 1].remove();
     }
+
+    // Remove 'new' class after animation
+    setTimeout(() => {
+      const newAlert = alertsList.querySelector(".alert-item.new");
+      if (newAlert) {
+        newAlert.classList.remove("new");
+      }
+    }, 1000);
   }
 
   startPeriodicRefresh() {
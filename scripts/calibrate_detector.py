@@ -0,0 +1,324 @@
+#!/usr/bin/env python3
+"""
+INT8 calibration and accuracy check for the native detector (bin/cpp_detector).
+
+Samples frames from recorded streams, statically quantizes an exported
+YOLOv8 ONNX model with ONNX Runtime (QDQ format, per-channel weights) and
+compares the INT8 model against the FP32 model on held-out frames:
+
+- mAP@0.5 and mAP@0.5:0.95 of INT8 detections, using FP32 detections as the
+  reference, i.e. the accuracy drift introduced by quantization
+- single-thread latency of both models, i.e. throughput per core
+
+Usage:
+    python scripts/calibrate_detector.py --model yolov8n.onnx \\
+        --video test_video.mp4 --output yolov8n.int8.onnx
+
+Requires: onnx, onnxruntime, opencv-python, numpy
+"""
+import argparse
+import json
+import os
+import sys
+import time
+
+import cv2
+import numpy as np
+
+
+def sample_frames(videos, count):
+    """Return frames spread evenly over each video, split per video into a
+    leading calibration part and a trailing held-out part."""
+    per_video = max(1, count // len(videos))
+    sampled = []
+    for path in videos:
+        cap = cv2.VideoCapture(path)
+        if not cap.isOpened():
+            raise RuntimeError(f"cannot open {path}")
+        total = int(cap.get(cv2.CAP_PROP_FRAME_COUNT)) or per_video
+        indices = np.linspace(0, total - 1, num=min(per_video, total)).astype(int)
+        frames = []
+        for index in indices:
+            cap.set(cv2.CAP_PROP_POS_FRAMES, int(index))
+            ok, frame = cap.read()
+            if ok:
+                frames.append(frame)
+        cap.release()
+        if not frames:
+            raise RuntimeError(f"no frames decoded from {path}")
+        sampled.append(frames)
+    return sampled
+
+
+def split_frames(sampled, holdout):
+    """Contiguous split per video: neighbouring frames are near-duplicates,
+    so interleaving would leak calibration frames into the held-out set."""
+    calibration, held_out = [], []
+    for frames in sampled:
+        cut = max(1, int(round(len(frames) * (1.0 - holdout))))
+        calibration.extend(frames[:cut])
+        held_out.extend(frames[cut:] or frames[-1:])
+    return calibration, held_out
+
+
+def letterbox(frame, size, pad_value=114):
+    """Same geometry and normalization as the C++ Letterboxer."""
+    height, width = frame.shape[:2]
+    scale = min(size / width, size / height)
+    new_w = max(1, min(size, int(round(width * scale))))
+    new_h = max(1, min(size, int(round(height * scale))))
+    pad_x, pad_y = (size - new_w) // 2, (size - new_h) // 2
+    resized = cv2.resize(frame, (new_w, new_h), interpolation=cv2.INTER_LINEAR)
+    canvas = np.full((size, size, 3), pad_value, dtype=np.uint8)
+    canvas[pad_y : pad_y + new_h, pad_x : pad_x + new_w] = resized
+    rgb = canvas[:, :, ::-1].astype(np.float32) / 255.0
+    return np.ascontiguousarray(rgb.transpose(2, 0, 1))[None]
+
+
+def decode(head, conf_threshold, iou_threshold=0.45, max_det=300):
+    """YOLOv8 head [4 + classes, anchors] -> (boxes xyxy, scores, classes)."""
+    boxes, scores = head[:4].T, head[4:].T
+    classes = scores.argmax(axis=1)
+    best = scores[np.arange(len(scores)), classes]
+    keep = best >= conf_threshold
+    boxes, best, classes = boxes[keep], best[keep], classes[keep]
+    xyxy = np.stack(
+        [
+            boxes[:, 0] - boxes[:, 2] / 2,
+            boxes[:, 1] - boxes[:, 3] / 2,
+            boxes[:, 0] + boxes[:, 2] / 2,
+            boxes[:, 1] + boxes[:, 3] / 2,
+        ],
+        axis=1,
+    )
+    kept = []
+    for cls in np.unique(classes):
+        idx = np.where(classes == cls)[0]
+        idx = idx[np.argsort(-best[idx])]
+        while len(idx):
+            kept.append(idx[0])
+            if len(idx) == 1:
+                break
+            ious = box_iou(xyxy[idx[0]][None], xyxy[idx[1:]])[0]
+            idx = idx[1:][ious <= iou_threshold]
+    kept = sorted(kept, key=lambda i: -best[i])[:max_det]
+    return xyxy[kept], best[kept], classes[kept]
+
+
+def box_iou(a, b):
+    lt = np.maximum(a[:, None, :2], b[None, :, :2])
+    rb = np.minimum(a[:, None, 2:], b[None, :, 2:])
+    inter = np.clip(rb - lt, 0, None).prod(axis=2)
+    area_a = (a[:, 2] - a[:, 0]) * (a[:, 3] - a[:, 1])
+    area_b = (b[:, 2] - b[:, 0]) * (b[:, 3] - b[:, 1])
+    return inter / np.maximum(area_a[:, None] + area_b[None, :] - inter, 1e-9)
+
+
+def average_precision(predictions, references, iou_threshold):
+    """COCO-style 101-point AP per class, averaged over reference classes."""
+    classes = set()
+    for _, _, ref_cls in references:
+        classes.update(ref_cls.tolist())
+    if not classes:
+        return float("nan")
+    aps = []
+    for cls in sorted(classes):
+        records, total = [], 0
+        for (p_boxes, p_scores, p_cls), (r_boxes, _, r_cls) in zip(predictions, references):
+            refs = r_boxes[r_cls == cls]
+            total += len(refs)
+            preds = np.where(p_cls == cls)[0]
+            preds = preds[np.argsort(-p_scores[preds])]
+            matched = np.zeros(len(refs), dtype=bool)
+            ious = box_iou(p_boxes[preds], refs) if len(preds) and len(refs) else None
+            for row, i in enumerate(preds):
+                hit = False
+                if ious is not None:
+                    candidates = np.where(~matched & (ious[row] >= iou_threshold))[0]
+                    if len(candidates):
+                        matched[candidates[ious[row][candidates].argmax()]] = True
+                        hit = True
+                records.append((p_scores[i], hit))
+        records.sort(key=lambda r: -r[0])
+        hits = np.array([r[1] for r in records], dtype=float)
+        tp = np.cumsum(hits)
+        recall = tp / max(total, 1)
+        precision = tp / np.arange(1, len(hits) + 1) if len(hits) else np.array([])
+        envelope = np.maximum.accumulate(precision[::-1])[::-1] if len(precision) else precision
+        ap = 0.0
+        for r in np.linspace(0, 1, 101):
+            above = np.where(recall >= r)[0]
+            ap += envelope[above[0]] if len(above) else 0.0
+        aps.append(ap / 101)
+    return float(np.mean(aps))
+
+
+def head_nodes_to_exclude(model_path, head_prefix):
+    """Keep the post-processing tail of the YOLO head (DFL, sigmoid, box
+    arithmetic) in float; its outputs are coordinates, not activations."""
+    import onnx
+
+    model = onnx.load(model_path)
+    return [n.name for n in model.graph.node if n.name.startswith(head_prefix) and n.op_type != "Conv"]
+
+
+class FrameReader:
+    """onnxruntime.quantization CalibrationDataReader over letterboxed frames."""
+
+    def __init__(self, frames, input_name, size):
+        self.frames = iter(frames)
+        self.input_name = input_name
+        self.size = size
+
+    def get_next(self):
+        frame = next(self.frames, None)
+        if frame is None:
+            return None
+        return {self.input_name: letterbox(frame, self.size)}
+
+
+def check_calibration_frames(frames):
+    """Reject calibration input that cannot give activation ranges: no
+    frames, or frames without any variation (a blank or frozen stream), for
+    which the calibrator derives NaN or zero scales."""
+    if not frames:
+        raise RuntimeError("no calibration frames; lower --holdout or add --video")
+    # Checked on the frames themselves: letterbox padding would add
+    # variation of its own.
+    lo, hi = np.inf, -np.inf
+    for frame in frames:
+        if frame.size == 0:
+            raise RuntimeError("calibration frames include an empty frame")
+        lo, hi = min(lo, float(frame.min())), max(hi, float(frame.max()))
+    if not (np.isfinite(lo) and np.isfinite(hi)) or hi <= lo:
+        raise RuntimeError("calibration frames are constant; record footage with real scene content")
+
+
+def check_quantization_params(model_path):
+    """Every scale must be finite and positive and every zero point finite;
+    anything else came from a degenerate calibration range."""
+    import onnx
+    from onnx import numpy_helper
+
+    model = onnx.load(model_path)
+    initializers = {t.name: t for t in model.graph.initializer}
+    for node in model.graph.node:
+        if node.op_type not in ("QuantizeLinear", "DequantizeLinear"):
+            continue
+        for role, name in zip(("scale", "zero point"), node.input[1:3]):
+            if name not in initializers:
+                continue
+            values = numpy_helper.to_array(initializers[name]).astype(np.float64)
+            if not np.all(np.isfinite(values)) or (role == "scale" and np.any(values <= 0)):
+                raise RuntimeError(f"{model_path}: {node.name or node.op_type} has an invalid {role} ({name}); "
+                                   f"the calibration data gave a degenerate range")
+
+
+def quantize(args, calibration, input_name, size):
+    from onnxruntime.quantization import CalibrationMethod, QuantFormat, QuantType, quantize_static
+    from onnxruntime.quantization.shape_inference import quant_pre_process
+
+    prepared = args.output + ".prep.onnx"
+    quant_pre_process(args.model, prepared)
+    exclude = head_nodes_to_exclude(prepared, args.head_prefix) if args.keep_head_float else []
+    quantize_static(
+        prepared,
+        args.output,
+        FrameReader(calibration, input_name, size),
+        quant_format=QuantFormat.QDQ,
+        activation_type=QuantType.QUInt8,
+        weight_type=QuantType.QInt8,
+        per_channel=True,
+        calibrate_method=getattr(CalibrationMethod, args.method),
+        nodes_to_exclude=exclude,
+    )
+    os.remove(prepared)
+
+
+def evaluate(model_path, frames, input_name, size, conf_threshold):
+    """Run single-threaded, as the per-core throughput figure is what sizes
+    cameras per node."""
+    import onnxruntime as ort
+
+    options = ort.SessionOptions()
+    options.intra_op_num_threads = 1
+    options.inter_op_num_threads = 1
+    options.graph_optimization_level = ort.GraphOptimizationLevel.ORT_ENABLE_ALL
+    session = ort.InferenceSession(model_path, options, providers=["CPUExecutionProvider"])
+    tensors = [letterbox(f, size) for f in frames]
+    session.run(None, {input_name: tensors[0]})  # warm-up
+    detections, elapsed = [], 0.0
+    for tensor in tensors:
+        start = time.perf_counter()
+        head = session.run(None, {input_name: tensor})[0][0]
+        elapsed += time.perf_counter() - start
+        detections.append(decode(head, conf_threshold))
+    return detections, 1000.0 * elapsed / len(tensors)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--model", required=True, help="FP32 ONNX export (yolo export format=onnx)")
+    parser.add_argument("--video", action="append", required=True, help="recorded stream; repeatable")
+    parser.add_argument("--output", help="INT8 model path (default: <model>.int8.onnx)")
+    parser.add_argument("--frames", type=int, default=300, help="frames to sample across all videos")
+    parser.add_argument("--holdout", type=float, default=0.3, help="fraction of frames kept for evaluation")
+    parser.add_argument("--method", default="MinMax", choices=["MinMax", "Entropy", "Percentile"])
+    parser.add_argument("--confidence-threshold", type=float, default=0.25)
+    parser.add_argument("--head-prefix", default="/model.22/", help="node name prefix of the detection head")
+    parser.add_argument("--no-keep-head-float", dest="keep_head_float", action="store_false")
+    parser.add_argument("--skip-quantize", action="store_true", help="only evaluate an existing --output")
+    parser.add_argument("--report", default="results/detector_int8_report.json")
+    args = parser.parse_args()
+    args.output = args.output or os.path.splitext(args.model)[0] + ".int8.onnx"
+
+    import onnxruntime as ort
+
+    session = ort.InferenceSession(args.model, providers=["CPUExecutionProvider"])
+    model_input = session.get_inputs()[0]
+    size = model_input.shape[2] if isinstance(model_input.shape[2], int) else 640
+    del session
+
+    calibration, held_out = split_frames(sample_frames(args.video, args.frames), args.holdout)
+    print(f"📼 {len(calibration)} calibration frames, {len(held_out)} held-out frames")
+
+    if not args.skip_quantize:
+        print(f"⚙️  Calibrating ({args.method}) and writing {args.output}")
+        check_calibration_frames(calibration)
+        quantize(args, calibration, model_input.name, size)
+    check_quantization_params(args.output)
+
+    reference, fp32_ms = evaluate(args.model, held_out, model_input.name, size, args.confidence_threshold)
+    quantized, int8_ms = evaluate(args.output, held_out, model_input.name, size, args.confidence_threshold)
+    map50 = average_precision(quantized, reference, 0.5)
+    map50_95 = float(np.nanmean([average_precision(quantized, reference, t) for t in np.arange(0.5, 0.96, 0.05)]))
+    if not np.isfinite(map50) or not np.isfinite(map50_95):
+        raise RuntimeError("the FP32 model detected nothing on the held-out frames, so there is no reference "
+                           "to measure drift against; use footage with objects or lower --confidence-threshold")
+
+    report = {
+        "model": args.model,
+        "int8_model": args.output,
+        "calibration_method": args.method,
+        "calibration_frames": len(calibration),
+        "held_out_frames": len(held_out),
+        "fp32_ms_per_frame": round(fp32_ms, 2),
+        "int8_ms_per_frame": round(int8_ms, 2),
+        "speedup_per_core": round(fp32_ms / int8_ms, 2) if int8_ms else None,
+        "map50_vs_fp32": round(map50, 4),
+        "map50_95_vs_fp32": round(map50_95, 4),
+        "map50_drift": round(1.0 - map50, 4),
+        "map50_95_drift": round(1.0 - map50_95, 4),
+    }
+    os.makedirs(os.path.dirname(args.report) or ".", exist_ok=True)
+    with open(args.report, "w") as f:
+        json.dump(report, f, indent=2, allow_nan=False)
+
+    print(f"⏱️  FP32 {fp32_ms:.1f} ms/frame, INT8 {int8_ms:.1f} ms/frame (x{report['speedup_per_core']} per core)")
+    print(f"🎯 INT8 vs FP32: mAP@0.5 {map50:.3f}, mAP@0.5:0.95 {map50_95:.3f}")
+    print(f"✅ Report written to {args.report}")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,103 @@
+#!/usr/bin/env python3
+"""
+Compare a Google Benchmark JSON result (bin/cpp_bench) against a baseline.
+
+Benchmarks are matched by name and compared on CPU time (real time for
+benchmarks registered with UseRealTime). With --benchmark_repetitions the
+median is used. A benchmark slower than the baseline by more than the
+threshold is a regression, and the script exits with status 1.
+
+Timings only compare on the machine the baseline was recorded on. When
+the host, CPU count, clock or benchmark library build differ, regressions
+are still listed but only warned about, and the script exits with 0.
+
+Usage:
+    python scripts/compare_benchmarks.py results/benchmark_baseline.json \\
+        results/benchmark.json --threshold 10
+
+Requires: Python 3 standard library only
+"""
+import argparse
+import json
+import sys
+
+UNIT_NS = {"ns": 1.0, "us": 1e3, "ms": 1e6, "s": 1e9}
+
+
+def load(path):
+    """Return ({name: time in ns}, context) of a benchmark JSON file."""
+    with open(path) as f:
+        data = json.load(f)
+    times = {}
+    has_median = {b.get("run_name") for b in data.get("benchmarks", []) if b.get("aggregate_name") == "median"}
+    for b in data.get("benchmarks", []):
+        name = b.get("run_name", b["name"])
+        if b.get("run_type") == "aggregate":
+            if b.get("aggregate_name") != "median":
+                continue
+        elif name in has_median or b.get("error_occurred"):
+            continue
+        field = "real_time" if "/real_time" in name else "cpu_time"
+        times[name] = b[field] * UNIT_NS[b.get("time_unit", "ns")]
+    return times, data.get("context", {})
+
+
+def fmt_ns(ns):
+    for unit, scale in (("s", 1e9), ("ms", 1e6), ("us", 1e3)):
+        if ns >= scale:
+            return f"{ns / scale:.3g} {unit}"
+    return f"{ns:.3g} ns"
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    parser.add_argument("baseline")
+    parser.add_argument("current")
+    parser.add_argument("--threshold", type=float, default=10.0,
+                        help="allowed slowdown in percent (default 10)")
+    args = parser.parse_args()
+
+    try:
+        base, base_ctx = load(args.baseline)
+    except FileNotFoundError:
+        print(f"No baseline at {args.baseline}; record one with `make benchmark-baseline`.")
+        return 0
+    current, ctx = load(args.current)
+
+    comparable = True
+    for key in ("host_name", "num_cpus", "mhz_per_cpu", "library_build_type"):
+        if key in base_ctx and base_ctx.get(key) != ctx.get(key):
+            print(f"warning: baseline {key} {base_ctx[key]} differs from {ctx.get(key)}; "
+                  f"timings may not be comparable")
+            comparable = False
+
+    width = max((len(n) for n in current), default=10)
+    print(f"{'benchmark':<{width}}  {'baseline':>10}  {'current':>10}  {'change':>8}")
+    regressions = []
+    for name, ns in current.items():
+        if name not in base:
+            print(f"{name:<{width}}  {'-':>10}  {fmt_ns(ns):>10}  {'new':>8}")
+            continue
+        change = (ns - base[name]) / base[name] * 100.0
+        mark = ""
+        if change > args.threshold:
+            mark = "  REGRESSION"
+            regressions.append(name)
+        print(f"{name:<{width}}  {fmt_ns(base[name]):>10}  {fmt_ns(ns):>10}  {change:>+7.1f}%{mark}")
+    for name in base:
+        if name not in current:
+            print(f"{name:<{width}}  {fmt_ns(base[name]):>10}  {'-':>10}  {'missing':>8}")
+
+    if regressions:
+        print(f"\n{len(regressions)} benchmark(s) slower than baseline by more than {args.threshold:g}%")
+        if not comparable:
+            print("Not failing: the baseline was recorded on a different machine; "
+                  "re-record it with `make benchmark-baseline`.")
+            return 0
+        return 1
+    print(f"\nNo regressions beyond {args.threshold:g}%")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,192 @@
+// H.264 / H.265 Annex-B elementary stream parsing.
+//
+// Splits a byte stream (as produced by `ffmpeg -c:v copy -f h264`) into
+// access units, i.e. one compressed picture with its parameter sets and SEI,
+// and flags the ones that start a decodable GOP. Only NAL headers and the
+// first slice-header bit are inspected; nothing is decoded.
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace camel {
+
+enum class VideoCodec { H264, H265 };
+
+inline VideoCodec parse_video_codec(const std::string& s) {
+    if (s == "h264" || s == "avc") return VideoCodec::H264;
+    if (s == "h265" || s == "hevc") return VideoCodec::H265;
+    throw std::runtime_error("unknown codec '" + s + "'");
+}
+
+// ffmpeg raw elementary stream format name.
+inline const char* annexb_format(VideoCodec c) { return c == VideoCodec::H264 ? "h264" : "hevc"; }
+
+// ffmpeg command that copies a camera's video to Annex-B on stdout without
+// decoding. RTSP goes over TCP; local files are paced in real time.
+inline std::vector<std::string> ffmpeg_copy_args(const std::string& ffmpeg, const std::string& source, VideoCodec codec) {
+    std::vector<std::string> argv = {ffmpeg, "-hide_banner", "-loglevel", "error"};
+    if (source.rfind("rtsp://", 0) == 0) argv.insert(argv.end(), {"-rtsp_transport", "tcp"});
+    else if (source.find("://") == std::string::npos) argv.push_back("-re");
+    argv.insert(argv.end(), {"-i", source, "-an", "-c:v", "copy", "-f", annexb_format(codec), "pipe:1"});
+    return argv;
+}
+
+struct NalInfo {
+    int type = 0;
+    bool vcl = false;            // coded slice
+    bool first_slice = false;    // first slice of a picture
+    bool keyframe = false;       // IDR (H.264) or IRAP (H.265)
+    bool parameter_set = false;  // SPS/PPS (and VPS)
+    bool starts_unit = false;    // may only appear before the first slice of an access unit
+};
+
+// `nal` points at the NAL header (after the start code).
+inline NalInfo inspect_nal(VideoCodec codec, const uint8_t* nal, size_t size) {
+    NalInfo n;
+    if (size == 0) return n;
+    if (codec == VideoCodec::H264) {
+        n.type = nal[0] & 0x1f;
+        n.vcl = n.type >= 1 && n.type <= 5;
+        n.first_slice = n.vcl && size > 1 && (nal[1] & 0x80);  // first_mb_in_slice == 0
+        n.keyframe = n.type == 5;
+        n.parameter_set = n.type == 7 || n.type == 8;
+        n.starts_unit = n.type == 6 || n.type == 7 || n.type == 8 || n.type == 9 || (n.type >= 14 && n.type <= 18);
+    } else {
+        n.type = (nal[0] >> 1) & 0x3f;
+        n.vcl = n.type < 32;
+        n.first_slice = n.vcl && size > 2 && (nal[2] & 0x80);  // first_slice_segment_in_pic_flag
+        n.keyframe = n.type >= 16 && n.type <= 21;
+        n.parameter_set = n.type >= 32 && n.type <= 34;
+        n.starts_unit = (n.type >= 32 && n.type <= 35) || n.type == 39 || (n.type >= 41 && n.type <= 44) ||
+                        (n.type >= 48 && n.type <= 55);
+    }
+    return n;
+}
+
+struct AccessUnit {
+    std::vector<uint8_t> data;  // Annex-B, 4-byte start codes
+    bool keyframe = false;
+    bool has_parameter_sets = false;
+    double time = 0.0;          // arrival time, seconds
+    uint64_t sequence = 0;
+};
+
+// Units are immutable once parsed and shared between buffers and writers.
+using UnitPtr = std::shared_ptr<const AccessUnit>;
+
+// Incremental parser: feed() arbitrary chunks, receive complete access units.
+// Access unit delimiter. A raw Annex-B demuxer only knows a picture is
+// complete when the next one starts; ending each unit fed to a decoder with
+// a delimiter gets the frame out now instead of one picture later.
+inline std::vector<uint8_t> access_unit_delimiter(VideoCodec codec) {
+    if (codec == VideoCodec::H264) return {0, 0, 0, 1, 0x09, 0xf0};  // primary_pic_type 7
+    return {0, 0, 0, 1, 0x46, 0x01, 0x50};                           // AUD_NUT, pic_type 2
+}
+
+// Size of the delimiter NAL `unit` starts with, 0 if none; such a unit is
+// fed without it when the previous one was already terminated.
+inline size_t leading_delimiter_bytes(VideoCodec codec, const AccessUnit& unit) {
+    const std::vector<uint8_t>& d = unit.data;
+    if (d.size() < 5 || inspect_nal(codec, d.data() + 4, d.size() - 4).type != (codec == VideoCodec::H264 ? 9 : 35))
+        return 0;
+    for (size_t i = 5; i + 3 <= d.size(); ++i)
+        if (d[i] == 0 && d[i + 1] == 0 && (d[i + 2] == 1 || (d[i + 2] == 0 && i + 3 < d.size() && d[i + 3] == 1))) return i;
+    return d.size();
+}
+
+class AccessUnitParser {
+public:
+    explicit AccessUnitParser(VideoCodec codec) : codec_(codec) {}
+
+    // Latest parameter sets seen, to prepend to clips that start on a
+    // keyframe without in-band headers.
+    const std::vector<uint8_t>& parameter_sets() const { return headers_; }
+
+    template <typename OnUnit>
+    void feed(const uint8_t* data, size_t n, OnUnit&& on_unit) {
+        buf_.insert(buf_.end(), data, data + n);
+        for (size_t next; (next = find_start(scan_)) != npos;) {
+            if (nal_start_ != npos) nal(buf_.data() + nal_start_, next - nal_start_, on_unit);
+            nal_start_ = scan_ = next + 3;
+        }
+        // Keep the NAL in progress, or the tail bytes a start code may begin in.
+        size_t tail = buf_.size() >= 2 ? buf_.size() - 2 : 0;
+        size_t keep = nal_start_ != npos ? nal_start_ : tail;
+        buf_.erase(buf_.begin(), buf_.begin() + static_cast<std::ptrdiff_t>(keep));
+        if (nal_start_ != npos) nal_start_ = 0;
+        scan_ = buf_.size() >= 2 ? buf_.size() - 2 : 0;
+    }
+
+    // End of stream: emits the NAL and access unit still pending.
+    template <typename OnUnit>
+    void flush(OnUnit&& on_unit) {
+        if (nal_start_ != npos && nal_start_ < buf_.size())
+            nal(buf_.data() + nal_start_, buf_.size() - nal_start_, on_unit);
+        buf_.clear();
+        nal_start_ = npos;
+        scan_ = 0;
+        if (has_vcl_) emit(on_unit);
+    }
+
+private:
+    static constexpr size_t npos = static_cast<size_t>(-1);
+
+    size_t find_start(size_t from) const {
+        for (size_t i = from; i + 3 <= buf_.size(); ++i) {
+            if (buf_[i + 2] > 1) {
+                i += 2;
+                continue;
+            }
+            if (buf_[i] == 0 && buf_[i + 1] == 0 && buf_[i + 2] == 1) return i;
+        }
+        return npos;
+    }
+
+    template <typename OnUnit>
+    void nal(const uint8_t* p, size_t size, OnUnit& on_unit) {
+        while (size > 0 && p[size - 1] == 0) --size;  // trailing zeros / 4-byte start code prefix
+        if (size == 0) return;
+        NalInfo info = inspect_nal(codec_, p, size);
+        if (has_vcl_ && (info.starts_unit || (info.vcl && info.first_slice))) emit(on_unit);
+        if (info.parameter_set) {
+            if (!in_headers_) headers_.clear();
+            append(headers_, p, size);
+            in_headers_ = true;
+        } else {
+            in_headers_ = false;
+        }
+        append(unit_.data, p, size);
+        unit_.keyframe = unit_.keyframe || info.keyframe;
+        unit_.has_parameter_sets = unit_.has_parameter_sets || info.parameter_set;
+        has_vcl_ = has_vcl_ || info.vcl;
+    }
+
+    template <typename OnUnit>
+    void emit(OnUnit& on_unit) {
+        on_unit(std::move(unit_));
+        unit_ = AccessUnit{};
+        has_vcl_ = false;
+    }
+
+    static void append(std::vector<uint8_t>& out, const uint8_t* p, size_t size) {
+        static const uint8_t start[4] = {0, 0, 0, 1};
+        out.insert(out.end(), start, start + 4);
+        out.insert(out.end(), p, p + size);
+    }
+
+    VideoCodec codec_;
+    std::vector<uint8_t> buf_;
+    size_t nal_start_ = npos;
+    size_t scan_ = 0;
+    AccessUnit unit_;
+    bool has_vcl_ = false;
+    std::vector<uint8_t> headers_;
+    bool in_headers_ = false;
+};
+
+}  // namespace camel
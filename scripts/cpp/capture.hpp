@@ -0,0 +1,302 @@
+// Capture files: timestamped recordings of route input for replay.
+//
+// Layout (little-endian):
+//   "CRCP" | u32 version | u64 created_unix_ns
+//   record*:  u64 time_ns | u32 type | u32 frame_bytes | envelope (envelope.hpp)
+//   index:    (u64 time_ns, u64 record_offset)*
+//   trailer:  u64 index_offset | u64 index_entries | "CRIX" | u32 0
+//
+// `time_ns` counts from the start of the capture on a monotonic clock. A
+// message record's envelope holds the message and its envelope payload,
+// followed by `frame_bytes` of packed pixels when the frame was captured;
+// an access unit record holds {"camera", "codec", "keyframe"} and the
+// Annex-B picture. The index has one entry per second of capture and is
+// written on close; a file cut short by a crash has no trailer, and the
+// reader then replays every complete record and seeks by scanning.
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "envelope.hpp"
+#include "json.hpp"
+
+namespace camel {
+
+constexpr char kCaptureMagic[4] = {'C', 'R', 'C', 'P'};
+constexpr char kCaptureIndexMagic[4] = {'C', 'R', 'I', 'X'};
+constexpr uint32_t kCaptureVersion = 1;
+
+enum class RecordType : uint32_t { Message = 1, AccessUnit = 2 };
+
+class CaptureWriter {
+public:
+    static constexpr uint64_t kIndexStepNs = 1000000000ull;
+
+    explicit CaptureWriter(const std::string& path) : path_(path), start_(std::chrono::steady_clock::now()) {
+        file_ = std::fopen(path.c_str(), "wb");
+        if (!file_) throw std::runtime_error("cannot create capture " + path);
+        std::setvbuf(file_, nullptr, _IOFBF, 1 << 20);
+        const auto created = static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count());
+        char head[16];
+        std::memcpy(head, kCaptureMagic, 4);
+        std::memcpy(head + 4, &kCaptureVersion, 4);
+        std::memcpy(head + 8, &created, 8);
+        put(head, sizeof(head));
+    }
+
+    CaptureWriter(const CaptureWriter&) = delete;
+    CaptureWriter& operator=(const CaptureWriter&) = delete;
+    ~CaptureWriter() {
+        try {
+            close();
+        } catch (...) {
+        }
+    }
+
+    // Appends a record stamped with the time since the capture started.
+    // `frame` (may be empty) is stored after `payload` inside the envelope.
+    void write(RecordType type, const std::string& header_json, const std::string& payload, const uint8_t* frame = nullptr,
+               size_t frame_bytes = 0) {
+        if (!file_) throw std::runtime_error("capture " + path_ + " is closed");
+        const uint64_t t = elapsed_ns();
+        if (index_.empty() || t >= index_.back().time_ns + kIndexStepNs) index_.push_back({t, offset_});
+        char prefix[16 + 16];
+        const auto type_code = static_cast<uint32_t>(type);
+        const auto fb = static_cast<uint32_t>(frame_bytes);
+        const auto header_bytes = static_cast<uint32_t>(header_json.size());
+        const uint64_t payload_bytes = payload.size() + frame_bytes;
+        std::memcpy(prefix, &t, 8);
+        std::memcpy(prefix + 8, &type_code, 4);
+        std::memcpy(prefix + 12, &fb, 4);
+        std::memcpy(prefix + 16, kEnvelopeMagic, 4);
+        std::memcpy(prefix + 20, &header_bytes, 4);
+        std::memcpy(prefix + 24, &payload_bytes, 8);
+        put(prefix, sizeof(prefix));
+        put(header_json.data(), header_json.size());
+        put(payload.data(), payload.size());
+        if (frame_bytes) put(frame, frame_bytes);
+        ++records_;
+        // Bounded loss on a crash without flushing on every record.
+        if (t >= flushed_ns_ + kIndexStepNs) {
+            std::fflush(file_);
+            flushed_ns_ = t;
+        }
+    }
+
+    // Writes the index and trailer; the file is complete afterwards.
+    void close() {
+        if (!file_) return;
+        const uint64_t index_offset = offset_, entries = index_.size();
+        for (const auto& e : index_) {
+            put(&e.time_ns, 8);
+            put(&e.offset, 8);
+        }
+        char trailer[24] = {};
+        std::memcpy(trailer, &index_offset, 8);
+        std::memcpy(trailer + 8, &entries, 8);
+        std::memcpy(trailer + 16, kCaptureIndexMagic, 4);
+        put(trailer, sizeof(trailer));
+        const bool ok = std::fclose(file_) == 0;
+        file_ = nullptr;
+        if (!ok) throw std::runtime_error("error closing capture " + path_);
+    }
+
+    uint64_t bytes() const { return offset_; }
+    uint64_t records() const { return records_; }
+    const std::string& path() const { return path_; }
+
+private:
+    struct Entry {
+        uint64_t time_ns;
+        uint64_t offset;
+    };
+
+    uint64_t elapsed_ns() const {
+        return static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start_).count());
+    }
+
+    void put(const void* p, size_t n) {
+        if (n && std::fwrite(p, 1, n, file_) != n) throw std::runtime_error("cannot write capture " + path_);
+        offset_ += n;
+    }
+
+    std::string path_;
+    std::FILE* file_ = nullptr;
+    std::chrono::steady_clock::time_point start_;
+    uint64_t offset_ = 0;
+    uint64_t records_ = 0;
+    uint64_t flushed_ns_ = 0;
+    std::vector<Entry> index_;
+};
+
+struct CaptureRecord {
+    uint64_t time_ns = 0;
+    RecordType type = RecordType::Message;
+    json::Value header;
+    std::string payload;     // envelope payload followed by the frame pixels
+    uint32_t frame_bytes = 0;
+
+    size_t frame_offset() const { return payload.size() - frame_bytes; }
+};
+
+class CaptureReader {
+public:
+    explicit CaptureReader(const std::string& path) : path_(path), in_(path, std::ios::binary) {
+        if (!in_) throw std::runtime_error("cannot open capture " + path);
+        char head[16];
+        in_.read(head, sizeof(head));
+        uint32_t version = 0;
+        std::memcpy(&version, head + 4, 4);
+        if (!in_ || std::memcmp(head, kCaptureMagic, 4) != 0) throw std::runtime_error(path + " is not a capture file");
+        if (version != kCaptureVersion) throw std::runtime_error(path + ": unsupported capture version " + std::to_string(version));
+        std::memcpy(&created_unix_ns_, head + 8, 8);
+
+        in_.seekg(0, std::ios::end);
+        const uint64_t size = static_cast<uint64_t>(in_.tellg());
+        end_ = size;
+        char trailer[24];
+        if (size >= sizeof(head) + sizeof(trailer)) {
+            in_.seekg(static_cast<std::streamoff>(size - sizeof(trailer)));
+            in_.read(trailer, sizeof(trailer));
+            uint64_t index_offset = 0, entries = 0;
+            std::memcpy(&index_offset, trailer, 8);
+            std::memcpy(&entries, trailer + 8, 8);
+            if (in_ && std::memcmp(trailer + 16, kCaptureIndexMagic, 4) == 0 &&
+                index_offset + entries * 16 + sizeof(trailer) == size) {
+                in_.seekg(static_cast<std::streamoff>(index_offset));
+                index_.resize(entries);
+                for (auto& e : index_) {
+                    in_.read(reinterpret_cast<char*>(&e.time_ns), 8);
+                    in_.read(reinterpret_cast<char*>(&e.offset), 8);
+                }
+                if (!in_) throw std::runtime_error("truncated index in " + path);
+                end_ = index_offset;
+                indexed_ = true;
+            }
+        }
+        in_.clear();
+        rewind();
+    }
+
+    // False when the file has no index (the recorder did not shut down).
+    bool indexed() const { return indexed_; }
+    uint64_t created_unix_ns() const { return created_unix_ns_; }
+    // Set when the last record was cut short; everything before it was read.
+    bool truncated() const { return truncated_; }
+
+    void rewind() { seek_offset(kHeaderBytes); }
+
+    // Positions the reader at or shortly before the first record at or
+    // after `time_ns`; callers skip the few earlier records themselves.
+    void seek(uint64_t time_ns) {
+        uint64_t offset = kHeaderBytes;
+        for (const auto& e : index_) {
+            if (e.time_ns > time_ns) break;
+            offset = e.offset;
+        }
+        seek_offset(offset);
+    }
+
+    bool next(CaptureRecord& rec) {
+        if (pos_ >= end_) return false;
+        char prefix[16];
+        in_.read(prefix, sizeof(prefix));
+        if (in_.gcount() != static_cast<std::streamsize>(sizeof(prefix))) return stop_truncated();
+        uint32_t type = 0;
+        std::memcpy(&rec.time_ns, prefix, 8);
+        std::memcpy(&type, prefix + 8, 4);
+        std::memcpy(&rec.frame_bytes, prefix + 12, 4);
+        rec.type = static_cast<RecordType>(type);
+        try {
+            if (!read_envelope(in_, rec.header, rec.payload)) return stop_truncated();
+        } catch (const json::ParseError&) {
+            throw std::runtime_error("corrupt record in " + path_);
+        } catch (const std::exception&) {
+            return stop_truncated();
+        }
+        if (rec.frame_bytes > rec.payload.size()) throw std::runtime_error("corrupt record in " + path_);
+        pos_ = static_cast<uint64_t>(in_.tellg());
+        return true;
+    }
+
+private:
+    static constexpr uint64_t kHeaderBytes = 16;
+
+    struct Entry {
+        uint64_t time_ns;
+        uint64_t offset;
+    };
+
+    void seek_offset(uint64_t offset) {
+        in_.clear();
+        in_.seekg(static_cast<std::streamoff>(offset));
+        pos_ = offset;
+    }
+
+    bool stop_truncated() {
+        truncated_ = true;
+        pos_ = end_;
+        return false;
+    }
+
+    std::string path_;
+    std::ifstream in_;
+    uint64_t created_unix_ns_ = 0;
+    uint64_t end_ = 0;  // first byte after the records
+    uint64_t pos_ = 0;
+    bool indexed_ = false;
+    bool truncated_ = false;
+    std::vector<Entry> index_;
+};
+
+// Replay speed: "1x" (real time), "10x", "0.5x" or "max" (as fast as the
+// consumer reads; 0 here).
+inline double parse_replay_speed(const std::string& s) {
+    if (s == "max") return 0.0;
+    std::string num = !s.empty() && (s.back() == 'x' || s.back() == 'X') ? s.substr(0, s.size() - 1) : s;
+    size_t used = 0;
+    double v = 0.0;
+    try {
+        v = std::stod(num, &used);
+    } catch (const std::exception&) {
+        used = 0;
+    }
+    if (used != num.size() || !(v > 0.0)) throw std::runtime_error("invalid replay speed '" + s + "'");
+    return v;
+}
+
+// Maps capture time onto wall time at a fixed speed. Sleeping to an
+// absolute schedule keeps a slow consumer from stretching later gaps.
+class ReplayClock {
+public:
+    explicit ReplayClock(double speed) : speed_(speed) {}
+
+    // Restarts the schedule so `time_ns` is due now.
+    void reset(uint64_t time_ns) {
+        origin_ = std::chrono::steady_clock::now();
+        base_ns_ = time_ns;
+    }
+
+    void wait_until(uint64_t time_ns) const {
+        if (speed_ <= 0.0 || time_ns <= base_ns_) return;
+        const auto offset = std::chrono::nanoseconds(static_cast<int64_t>(static_cast<double>(time_ns - base_ns_) / speed_));
+        std::this_thread::sleep_until(origin_ + offset);
+    }
+
+private:
+    double speed_;
+    uint64_t base_ns_ = 0;
+    std::chrono::steady_clock::time_point origin_ = std::chrono::steady_clock::now();
+};
+
+}  // namespace camel
@@ -0,0 +1,215 @@
+// cgroup v2 pools for processor resource accounting.
+//
+// Every replica of a route stage, in whatever language, runs in one pool:
+// `<root>/<route>/<stage>`. cpp_launch moves itself there and execs the
+// processor, so children (ffmpeg, interpreter workers) are charged to the
+// same pool; cpp_monitor reads the pools' accounting files. The root is a
+// directory delegated to the user that runs the routes, e.g. with systemd
+// `Delegate=yes`, and defaults to CAMEL_CGROUP.
+//
+// Controllers that are not enabled leave their fields at zero, so CPU time
+// is reported even where only the unified hierarchy's core files exist.
+#pragma once
+
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace camel {
+
+struct CgroupLimits {
+    double cpus = 0.0;          // cores; 0 = unlimited
+    uint64_t memory_bytes = 0;  // 0 = unlimited
+};
+
+struct CgroupUsage {
+    uint64_t cpu_usec = 0;
+    uint64_t user_usec = 0;
+    uint64_t system_usec = 0;
+    uint64_t throttled_usec = 0;
+    uint64_t memory_bytes = 0;  // memory.current: RSS, page cache and kernel memory
+    uint64_t anon_bytes = 0;    // anonymous memory, the pool's RSS proper
+    uint64_t page_faults = 0;
+    uint64_t major_faults = 0;
+    uint64_t io_read_bytes = 0;
+    uint64_t io_write_bytes = 0;
+    uint64_t oom_kills = 0;
+    uint64_t processes = 0;
+    CgroupLimits limits;
+};
+
+struct CgroupPool {
+    std::string route;
+    std::string stage;
+    std::string path;
+};
+
+inline std::string default_cgroup_root() {
+    const char* root = std::getenv("CAMEL_CGROUP");
+    return root ? root : "";
+}
+
+// "512M", "2G", "1048576" or "max".
+inline uint64_t parse_bytes(const std::string& text) {
+    if (text.empty() || text == "max") return 0;
+    char* end = nullptr;
+    const double v = std::strtod(text.c_str(), &end);
+    if (end == text.c_str() || v < 0) throw std::runtime_error("invalid size '" + text + "'");
+    const std::string unit = end;
+    double scale = 1;
+    if (unit == "K" || unit == "k") scale = 1024.0;
+    else if (unit == "M") scale = 1024.0 * 1024;
+    else if (unit == "G") scale = 1024.0 * 1024 * 1024;
+    else if (!unit.empty()) throw std::runtime_error("invalid size '" + text + "'");
+    return static_cast<uint64_t>(v * scale);
+}
+
+namespace detail {
+
+inline bool write_cgroup_file(const std::string& path, const std::string& value) {
+    std::ofstream out(path);
+    out << value;
+    out.flush();
+    return static_cast<bool>(out);
+}
+
+inline std::string read_cgroup_file(const std::string& path) {
+    std::ifstream in(path);
+    std::stringstream ss;
+    ss << in.rdbuf();
+    return ss.str();
+}
+
+// Value of `key` in a flat-keyed file such as cpu.stat or memory.stat.
+inline uint64_t keyed_value(const std::string& text, const char* key) {
+    std::istringstream in(text);
+    std::string k;
+    uint64_t v = 0;
+    while (in >> k >> v)
+        if (k == key) return v;
+    return 0;
+}
+
+inline std::vector<std::string> subdirectories(const std::string& path) {
+    std::vector<std::string> out;
+    DIR* d = ::opendir(path.c_str());
+    if (!d) return out;
+    while (dirent* e = ::readdir(d)) {
+        const std::string name = e->d_name;
+        if (name.empty() || name[0] == '.') continue;
+        struct stat st {};
+        if (::stat((path + "/" + name).c_str(), &st) == 0 && S_ISDIR(st.st_mode)) out.push_back(name);
+    }
+    ::closedir(d);
+    return out;
+}
+
+// Best effort: a parent may not have the controller available at all.
+inline void enable_controllers(const std::string& path) {
+    const std::string available = read_cgroup_file(path + "/cgroup.controllers");
+    std::istringstream in(available);
+    std::string c;
+    while (in >> c)
+        if (c == "cpu" || c == "memory" || c == "io") write_cgroup_file(path + "/cgroup.subtree_control", "+" + c);
+}
+
+inline void make_dir(const std::string& path) {
+    if (::mkdir(path.c_str(), 0755) != 0 && errno != EEXIST)
+        throw std::runtime_error("cannot create cgroup " + path + ": " + std::strerror(errno));
+}
+
+// One path component below the root: "." or ".." would escape it.
+inline bool valid_pool_name(const std::string& name) {
+    return !name.empty() && name != "." && name != ".." && name.find('/') == std::string::npos;
+}
+
+}  // namespace detail
+
+inline std::string cgroup_pool_path(const std::string& root, const std::string& route, const std::string& stage) {
+    return root + "/" + route + "/" + stage;
+}
+
+// Creates the pool if needed, applies the limits and moves the calling
+// process into it. Throws when the pool cannot be joined or a requested
+// limit cannot be set.
+inline std::string join_cgroup_pool(const std::string& root, const std::string& route, const std::string& stage,
+                                    const CgroupLimits& limits) {
+    if (!detail::valid_pool_name(route) || !detail::valid_pool_name(stage))
+        throw std::runtime_error("invalid cgroup pool '" + route + "/" + stage + "'");
+    const std::string route_dir = root + "/" + route;
+    const std::string pool = cgroup_pool_path(root, route, stage);
+    detail::enable_controllers(root);
+    detail::make_dir(route_dir);
+    detail::enable_controllers(route_dir);
+    detail::make_dir(pool);
+    if (limits.cpus > 0) {
+        const long period = 100000;
+        const long quota = std::max(1000L, std::lround(limits.cpus * period));
+        if (!detail::write_cgroup_file(pool + "/cpu.max", std::to_string(quota) + " " + std::to_string(period)))
+            throw std::runtime_error("cannot set cpu.max in " + pool + " (cpu controller not delegated?)");
+    }
+    if (limits.memory_bytes > 0 && !detail::write_cgroup_file(pool + "/memory.max", std::to_string(limits.memory_bytes)))
+        throw std::runtime_error("cannot set memory.max in " + pool + " (memory controller not delegated?)");
+    if (!detail::write_cgroup_file(pool + "/cgroup.procs", "0"))
+        throw std::runtime_error("cannot join cgroup " + pool + ": " + std::strerror(errno));
+    return pool;
+}
+
+inline std::vector<CgroupPool> list_cgroup_pools(const std::string& root) {
+    std::vector<CgroupPool> out;
+    if (root.empty()) return out;
+    for (const auto& route : detail::subdirectories(root))
+        for (const auto& stage : detail::subdirectories(root + "/" + route))
+            out.push_back({route, stage, cgroup_pool_path(root, route, stage)});
+    return out;
+}
+
+inline CgroupUsage read_cgroup_usage(const std::string& pool) {
+    CgroupUsage u;
+    const std::string cpu = detail::read_cgroup_file(pool + "/cpu.stat");
+    u.cpu_usec = detail::keyed_value(cpu, "usage_usec");
+    u.user_usec = detail::keyed_value(cpu, "user_usec");
+    u.system_usec = detail::keyed_value(cpu, "system_usec");
+    u.throttled_usec = detail::keyed_value(cpu, "throttled_usec");
+
+    std::istringstream(detail::read_cgroup_file(pool + "/memory.current")) >> u.memory_bytes;
+    const std::string mem = detail::read_cgroup_file(pool + "/memory.stat");
+    u.anon_bytes = detail::keyed_value(mem, "anon");
+    u.page_faults = detail::keyed_value(mem, "pgfault");
+    u.major_faults = detail::keyed_value(mem, "pgmajfault");
+    u.oom_kills = detail::keyed_value(detail::read_cgroup_file(pool + "/memory.events"), "oom_kill");
+
+    // io.stat: "<major>:<minor> rbytes=N wbytes=N rios=N ..." per device.
+    std::istringstream io(detail::read_cgroup_file(pool + "/io.stat"));
+    std::string field;
+    while (io >> field) {
+        if (field.compare(0, 7, "rbytes=") == 0) u.io_read_bytes += std::strtoull(field.c_str() + 7, nullptr, 10);
+        else if (field.compare(0, 7, "wbytes=") == 0) u.io_write_bytes += std::strtoull(field.c_str() + 7, nullptr, 10);
+    }
+
+    std::istringstream procs(detail::read_cgroup_file(pool + "/cgroup.procs"));
+    for (std::string pid; procs >> pid;) ++u.processes;
+
+    std::istringstream cpu_max(detail::read_cgroup_file(pool + "/cpu.max"));
+    std::string quota;
+    double period = 0;
+    if (cpu_max >> quota >> period && quota != "max" && period > 0) u.limits.cpus = std::strtod(quota.c_str(), nullptr) / period;
+    std::string memory_max;
+    std::istringstream(detail::read_cgroup_file(pool + "/memory.max")) >> memory_max;
+    if (!memory_max.empty() && memory_max != "max") u.limits.memory_bytes = std::strtoull(memory_max.c_str(), nullptr, 10);
+    return u;
+}
+
+}  // namespace camel
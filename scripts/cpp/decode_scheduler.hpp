@@ -0,0 +1,202 @@
+// Node-level scheduling of video decode across cameras.
+//
+// Compressed pictures of every camera are queued here, and the scheduler
+// decides which one goes to a decoder next. The number of pictures being
+// decoded at once (in flight, node-wide) is capped at the decoder pool size,
+// so adding cameras never oversubscribes cores: past that point each camera
+// gets a smaller share instead of every decoder slowing down. Rules:
+//
+//  - fairness: start-time fair queuing; the backlogged camera with the
+//    least weighted service so far goes next, and a camera returning from
+//    idle does not bank credit;
+//  - staleness: a queue holding more than `max_queue_seconds` drops whole
+//    GOPs from its head, so decoding resumes on a keyframe and never lags;
+//  - frame-rate caps: when a camera's cap is at or below its keyframe
+//    rate, only keyframes are decoded; otherwise decoded frames are thinned
+//    to the cap at publish time.
+//
+// Pure bookkeeping, no I/O: the hub feeds it pictures and decode results.
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include "annexb.hpp"
+#include "probes.hpp"
+
+namespace camel {
+
+struct SchedulerOptions {
+    int workers = 4;                 // pictures decoded concurrently, node-wide
+    int depth = 2;                   // pictures in flight per decoder, to keep it busy
+    double max_queue_seconds = 1.0;  // older queued pictures are dropped a GOP at a time
+    double stall_seconds = 2.0;      // no output for this long: in-flight pictures are written off
+};
+
+struct CameraPolicy {
+    double max_fps = 0.0;  // 0 = every frame
+    double weight = 1.0;
+};
+
+struct CameraStats {
+    uint64_t received = 0;
+    uint64_t fed = 0;
+    uint64_t decoded = 0;
+    uint64_t published = 0;
+    uint64_t dropped = 0;  // never decoded: stale GOPs, keyframe-only mode, waiting for a keyframe
+    bool keyframes_only = false;
+};
+
+class DecodeScheduler {
+public:
+    explicit DecodeScheduler(SchedulerOptions opt) : opt_(opt) {}
+
+    const SchedulerOptions& options() const { return opt_; }
+    size_t size() const { return cams_.size(); }
+    const CameraStats& stats(size_t cam) const { return cams_[cam].stats; }
+    int in_flight() const { return in_flight_; }
+
+    size_t add_camera(const CameraPolicy& policy) {
+        Camera c;
+        c.policy = policy;
+        c.policy.weight = std::max(policy.weight, 1e-3);
+        cams_.push_back(std::move(c));
+        return cams_.size() - 1;
+    }
+
+    // A compressed picture arrived from the camera.
+    void push(size_t cam, UnitPtr unit) {
+        Camera& c = cams_[cam];
+        ++c.stats.received;
+        if (unit->keyframe) {
+            if (c.last_key > 0 && unit->time > c.last_key) {
+                double gop = unit->time - c.last_key;
+                c.gop_seconds = c.gop_seconds > 0 ? 0.8 * c.gop_seconds + 0.2 * gop : gop;
+            }
+            c.last_key = unit->time;
+            c.need_key = false;
+        }
+        c.stats.keyframes_only = c.policy.max_fps > 0 && c.gop_seconds > 0 && c.policy.max_fps * c.gop_seconds <= 1.0;
+        if (c.need_key || (c.stats.keyframes_only && !unit->keyframe)) {
+            drop(c, *unit, c.need_key ? "await_keyframe" : "keyframes_only");
+            return;
+        }
+        if (c.queue.empty()) c.vtime = std::max(c.vtime, vclock_);
+        c.queue.push_back(std::move(unit));
+        trim(c);
+    }
+
+    // Next picture to feed to a decoder; false when the pool is saturated or
+    // nothing is eligible.
+    bool next(size_t& cam, UnitPtr& unit, double now) {
+        if (in_flight_ >= opt_.workers) return false;
+        size_t best = cams_.size();
+        for (size_t i = 0; i < cams_.size(); ++i) {
+            const Camera& c = cams_[i];
+            if (c.queue.empty() || c.in_flight >= opt_.depth) continue;
+            if (best == cams_.size() || c.vtime < cams_[best].vtime) best = i;
+        }
+        if (best == cams_.size()) return false;
+        Camera& c = cams_[best];
+        cam = best;
+        unit = std::move(c.queue.front());
+        c.queue.pop_front();
+        vclock_ = c.vtime;
+        c.vtime += 1.0 / c.policy.weight;
+        if (c.in_flight == 0) c.last_output = now;  // stall clock starts when the decoder gets work
+        ++c.in_flight;
+        ++in_flight_;
+        ++c.stats.fed;
+        return true;
+    }
+
+    // A decoded frame is starting to come out; true if it should be
+    // published under the camera's frame-rate cap.
+    bool admit(size_t cam, double now) {
+        Camera& c = cams_[cam];
+        if (c.policy.max_fps <= 0 || c.stats.keyframes_only) return true;
+        const double interval = 1.0 / c.policy.max_fps;
+        if (now < c.next_publish) return false;
+        // Keep the long-run rate at the cap without bunching after gaps.
+        c.next_publish = std::max(c.next_publish + interval, now + 0.5 * interval);
+        return true;
+    }
+
+    // A decoded frame came out (published or not).
+    void decoded(size_t cam, bool published, double now) {
+        Camera& c = cams_[cam];
+        ++c.stats.decoded;
+        if (published) ++c.stats.published;
+        c.last_output = now;
+        release(c, 1);
+    }
+
+    // The camera's decoder was (re)started: nothing is in flight and
+    // decoding must resume on a keyframe.
+    void reset(size_t cam) {
+        Camera& c = cams_[cam];
+        release(c, c.in_flight);
+        for (const auto& u : c.queue) drop(c, *u, "decoder_restart");
+        c.queue.clear();
+        c.need_key = true;
+    }
+
+    // Writes off pictures a decoder swallowed without output (corrupt data),
+    // so they do not hold pool slots forever.
+    void tick(double now) {
+        for (auto& c : cams_) {
+            if (c.in_flight > 0 && now - c.last_output > opt_.stall_seconds) {
+                release(c, c.in_flight);
+                c.last_output = now;
+            }
+        }
+    }
+
+private:
+    struct Camera {
+        CameraPolicy policy;
+        std::deque<UnitPtr> queue;
+        CameraStats stats;
+        double vtime = 0.0;
+        int in_flight = 0;
+        bool need_key = true;
+        double last_key = 0.0;
+        double gop_seconds = 0.0;
+        double next_publish = 0.0;
+        double last_output = 0.0;
+    };
+
+    void release(Camera& c, int n) {
+        n = std::min(n, c.in_flight);
+        c.in_flight -= n;
+        in_flight_ -= n;
+    }
+
+    // Drops whole GOPs from the head while the queue spans too much time;
+    // if no later keyframe is queued, everything goes and the camera waits
+    // for the next one.
+    void trim(Camera& c) {
+        while (!c.queue.empty() && c.queue.back()->time - c.queue.front()->time > opt_.max_queue_seconds) {
+            auto next_key = std::find_if(c.queue.begin() + 1, c.queue.end(), [](const UnitPtr& u) { return u->keyframe; });
+            for (auto it = c.queue.begin(); it != next_key; ++it) drop(c, **it, "stale_gop");
+            c.queue.erase(c.queue.begin(), next_key);
+            if (c.queue.empty()) c.need_key = true;
+        }
+    }
+
+    static void drop(Camera& c, const AccessUnit& unit, const char* reason) {
+        ++c.stats.dropped;
+        CAMEL_PROBE4(drop, probes::route(), probes::stage(), unit.sequence, reason);
+    }
+
+    SchedulerOptions opt_;
+    std::vector<Camera> cams_;
+    int in_flight_ = 0;
+    double vclock_ = 0.0;  // start tag of the last picture served
+};
+
+}  // namespace camel
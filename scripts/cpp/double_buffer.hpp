@@ -0,0 +1,71 @@
+// Single-writer double buffer with wait-free readers.
+//
+// The writer fills the back slot and publishes it with one atomic store;
+// readers pin the front slot with a per-slot reader count and never block.
+// A publish that would overwrite a slot a reader still pins is skipped and
+// reported, so a stuck reader delays updates instead of seeing torn data.
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace camel {
+
+template <typename T>
+class DoubleBuffer {
+public:
+    class Ref {
+    public:
+        Ref(const Ref&) = delete;
+        Ref& operator=(const Ref&) = delete;
+        Ref(Ref&& o) noexcept : slot_(o.slot_), version_(o.version_) { o.slot_ = nullptr; }
+        ~Ref() {
+            if (slot_) slot_->readers.fetch_sub(1);
+        }
+
+        const T& operator*() const { return slot_->value; }
+        const T* operator->() const { return &slot_->value; }
+        uint64_t version() const { return version_; }
+
+    private:
+        friend class DoubleBuffer;
+        Ref(typename DoubleBuffer::Slot* slot, uint64_t version) : slot_(slot), version_(version) {}
+        typename DoubleBuffer::Slot* slot_;
+        uint64_t version_;
+    };
+
+    // Writer only. `fill(T&)` updates the back slot, which still holds the
+    // value from two publishes ago. Returns false if a reader pinned it.
+    template <typename Fill>
+    bool publish(Fill&& fill) {
+        const uint64_t next = version_.load() + 1;
+        Slot& s = slots_[next & 1];
+        if (s.readers.load() != 0) return false;
+        fill(s.value);
+        version_.store(next);
+        return true;
+    }
+
+    Ref read() const {
+        for (;;) {
+            const uint64_t v = version_.load();
+            Slot& s = slots_[v & 1];
+            s.readers.fetch_add(1);
+            if (version_.load() == v) return Ref(&s, v);
+            s.readers.fetch_sub(1);  // a publish raced us: the slot may be refilled
+        }
+    }
+
+    uint64_t version() const { return version_.load(); }
+
+private:
+    struct Slot {
+        std::atomic<int> readers{0};
+        T value{};
+    };
+
+    mutable Slot slots_[2];
+    std::atomic<uint64_t> version_{0};
+};
+
+}  // namespace camel
@@ -0,0 +1,64 @@
+// Binary message envelope for processors configured with
+// `input_format: "binary"`.
+//
+// Layout (little-endian):
+//   "CREN" | u32 header_bytes | u64 payload_bytes | header JSON | payload
+//
+// The header is the regular JSON message; the payload carries bulk data
+// (e.g. a raw output tensor) that would be wasteful to base64 into JSON.
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <istream>
+#include <stdexcept>
+#include <string>
+
+#include "json.hpp"
+
+namespace camel {
+
+constexpr char kEnvelopeMagic[4] = {'C', 'R', 'E', 'N'};
+constexpr uint32_t kMaxEnvelopeHeader = 16u << 20;
+constexpr uint64_t kMaxEnvelopePayload = 1ull << 32;
+
+// Returns false on clean end of stream; throws on a malformed envelope.
+// `header_text`, if given, receives the header JSON as read.
+inline bool read_envelope(std::istream& in, json::Value& header, std::string& payload,
+                          std::string* header_text = nullptr) {
+    char prefix[16];
+    in.read(prefix, sizeof(prefix));
+    if (in.gcount() == 0 && in.eof()) return false;
+    if (in.gcount() != static_cast<std::streamsize>(sizeof(prefix))) throw std::runtime_error("truncated envelope");
+    if (std::memcmp(prefix, kEnvelopeMagic, 4) != 0) throw std::runtime_error("bad envelope magic");
+    uint32_t header_bytes;
+    uint64_t payload_bytes;
+    std::memcpy(&header_bytes, prefix + 4, 4);
+    std::memcpy(&payload_bytes, prefix + 8, 8);
+    if (header_bytes > kMaxEnvelopeHeader || payload_bytes > kMaxEnvelopePayload)
+        throw std::runtime_error("envelope too large");
+
+    std::string text(header_bytes, '\0');
+    in.read(text.data(), header_bytes);
+    payload.resize(payload_bytes);
+    in.read(payload.data(), static_cast<std::streamsize>(payload_bytes));
+    if (!in) throw std::runtime_error("truncated envelope");
+    header = json::Value::parse(text);
+    if (header_text) header_text->swap(text);
+    return true;
+}
+
+inline void write_envelope(FILE* out, const std::string& header_json, const std::string& payload) {
+    char prefix[16];
+    std::memcpy(prefix, kEnvelopeMagic, 4);
+    auto header_bytes = static_cast<uint32_t>(header_json.size());
+    auto payload_bytes = static_cast<uint64_t>(payload.size());
+    std::memcpy(prefix + 4, &header_bytes, 4);
+    std::memcpy(prefix + 8, &payload_bytes, 8);
+    std::fwrite(prefix, 1, sizeof(prefix), out);
+    std::fwrite(header_json.data(), 1, header_json.size(), out);
+    std::fwrite(payload.data(), 1, payload.size(), out);
+}
+
+}  // namespace camel
@@ -0,0 +1,120 @@
+// Renders folded stacks ("root;child;leaf count" per line) as a flame graph
+// SVG in the style of Brendan Gregg's flamegraph.pl: one box per frame, as
+// wide as its share of the samples, callers below callees. Hovering a box
+// shows the frame and its sample count.
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace camel {
+
+namespace detail {
+
+struct FlameNode {
+    uint64_t value = 0;
+    std::map<std::string, std::unique_ptr<FlameNode>> children;
+};
+
+inline void xml_escape(std::string& out, std::string_view s) {
+    for (char c : s) {
+        switch (c) {
+            case '&': out += "&amp;"; break;
+            case '<': out += "&lt;"; break;
+            case '>': out += "&gt;"; break;
+            case '"': out += "&quot;"; break;
+            default: out += c;
+        }
+    }
+}
+
+inline int flame_depth(const FlameNode& n) {
+    int d = 0;
+    for (const auto& [name, child] : n.children) d = std::max(d, flame_depth(*child) + 1);
+    return d;
+}
+
+}  // namespace detail
+
+inline std::string render_flamegraph(std::string_view folded, const std::string& title) {
+    constexpr double kWidth = 1200.0, kPad = 10.0, kFrame = 16.0, kTop = 40.0, kCharWidth = 7.0;
+    detail::FlameNode root;
+    while (!folded.empty()) {
+        const size_t nl = folded.find('\n');
+        std::string_view line = folded.substr(0, nl);
+        folded = nl == std::string_view::npos ? std::string_view() : folded.substr(nl + 1);
+        const size_t sp = line.rfind(' ');
+        if (sp == std::string_view::npos) continue;
+        const uint64_t count = std::strtoull(std::string(line.substr(sp + 1)).c_str(), nullptr, 10);
+        if (count == 0) continue;
+        root.value += count;
+        detail::FlameNode* node = &root;
+        std::string_view stack = line.substr(0, sp);
+        while (!stack.empty()) {
+            const size_t semi = stack.find(';');
+            auto& child = node->children[std::string(stack.substr(0, semi))];
+            if (!child) child = std::make_unique<detail::FlameNode>();
+            child->value += count;
+            node = child.get();
+            stack = semi == std::string_view::npos ? std::string_view() : stack.substr(semi + 1);
+        }
+    }
+    const int depth = detail::flame_depth(root);
+    const double height = kTop + (depth + 1) * kFrame + kPad;
+    const double scale = root.value ? (kWidth - 2 * kPad) / static_cast<double>(root.value) : 0.0;
+    char buf[256];
+    std::string svg;
+    std::snprintf(buf, sizeof(buf),
+                  "<?xml version=\"1.0\" standalone=\"no\"?>\n"
+                  "<svg version=\"1.1\" width=\"%.0f\" height=\"%.0f\" xmlns=\"http://www.w3.org/2000/svg\" "
+                  "font-family=\"Verdana\" font-size=\"12\">\n",
+                  kWidth, height);
+    svg += buf;
+    std::snprintf(buf, sizeof(buf), "<rect width=\"100%%\" height=\"100%%\" fill=\"#f8f8f8\"/>\n<text x=\"%.0f\" y=\"24\" text-anchor=\"middle\" font-size=\"17\">",
+                  kWidth / 2);
+    svg += buf;
+    detail::xml_escape(svg, title + " (" + std::to_string(root.value) + " samples)");
+    svg += "</text>\n";
+
+    auto draw = [&](auto& self, const std::string& name, const detail::FlameNode& node, double x, int level) -> void {
+        const double w = static_cast<double>(node.value) * scale;
+        if (w < 0.1) return;
+        if (level >= 0) {
+            const double y = height - kPad - (level + 1) * kFrame;
+            uint32_t h = 2166136261u;
+            for (char c : name) h = (h ^ static_cast<uint8_t>(c)) * 16777619u;
+            svg += "<g><title>";
+            detail::xml_escape(svg, name);
+            std::snprintf(buf, sizeof(buf), " (%llu samples, %.2f%%)</title>", static_cast<unsigned long long>(node.value),
+                          100.0 * static_cast<double>(node.value) / static_cast<double>(root.value));
+            svg += buf;
+            std::snprintf(buf, sizeof(buf),
+                          "<rect x=\"%.1f\" y=\"%.1f\" width=\"%.1f\" height=\"%.0f\" fill=\"rgb(%u,%u,%u)\" rx=\"2\"/>",
+                          x, y, w, kFrame - 1, 205 + h % 50, (h >> 8) % 230, (h >> 16) % 55);
+            svg += buf;
+            const auto fit = static_cast<size_t>((w - 6) / kCharWidth);
+            if (fit >= 3) {
+                std::snprintf(buf, sizeof(buf), "<text x=\"%.1f\" y=\"%.1f\">", x + 3, y + kFrame - 4);
+                svg += buf;
+                detail::xml_escape(svg, name.size() <= fit ? name : name.substr(0, fit - 2) + "..");
+                svg += "</text>";
+            }
+            svg += "</g>\n";
+        }
+        for (const auto& [child_name, child] : node.children) {
+            self(self, child_name, *child, x, level + 1);
+            x += static_cast<double>(child->value) * scale;
+        }
+    };
+    draw(draw, "all", root, kPad, -1);
+    svg += "</svg>\n";
+    return svg;
+}
+
+}  // namespace camel
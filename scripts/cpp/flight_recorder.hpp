@@ -0,0 +1,380 @@
+// Flight recorder: the last messages a processor handled, kept in shared
+// memory so they survive the process.
+//
+// Every processor keeps a `/camel_flight_<pid>` ring of its most recent
+// inputs: the JSON header (frames travel by shm reference, so this is the
+// whole message for camera traffic), the first bytes of any envelope
+// payload, the handler time and the outcome. A record is published before
+// the handler runs and completed after it, so the input that crashed a
+// process is the newest record in the ring. Slots are guarded by a seqlock:
+// the single writer never waits and readers retry or skip a slot that is
+// being rewritten.
+//
+// The ring is dumped as NDJSON under CAMEL_FLIGHT_DIR by the processor when
+// a handler fails or takes longer than CAMEL_FLIGHT_SLOW_MS, and by
+// cpp_monitor when a processor dies or on request.
+//
+// Environment:
+//   CAMEL_FLIGHT               "off" disables the recorder
+//   CAMEL_FLIGHT_SLOTS         records kept, default 64
+//   CAMEL_FLIGHT_SLOT_BYTES    bytes per record (header + payload), default 4096
+//   CAMEL_FLIGHT_PAYLOAD_BYTES payload prefix kept, default 256
+//   CAMEL_FLIGHT_SLOW_MS       dump when a handler exceeds this, default off
+//   CAMEL_FLIGHT_DIR           dump directory, default "logs"
+#pragma once
+
+#include <dirent.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "base64.hpp"
+#include "json.hpp"
+#include "shm.hpp"
+#include "stage_metrics.hpp"
+
+namespace camel {
+
+enum class FlightOutcome : uint32_t { InFlight = 0, Forwarded = 1, Dropped = 2, Error = 3 };
+
+inline const char* flight_outcome_name(FlightOutcome o) {
+    switch (o) {
+        case FlightOutcome::InFlight: return "in_flight";
+        case FlightOutcome::Forwarded: return "forwarded";
+        case FlightOutcome::Dropped: return "dropped";
+        case FlightOutcome::Error: return "error";
+    }
+    return "unknown";
+}
+
+struct FlightBlock {
+    static constexpr uint32_t kMagic = 0x43524c46;  // "FLRC"
+    static constexpr uint32_t kVersion = 1;
+
+    uint32_t magic;
+    uint32_t version;
+    int32_t pid;
+    uint32_t slots;
+    uint32_t slot_bytes;
+    uint32_t reserved0;
+    uint64_t started_unix_ms;
+    char route[64];
+    char stage[64];
+    std::atomic<uint64_t> next;  // records written so far
+};
+
+struct FlightSlot {
+    static constexpr uint32_t kErrorBytes = 256;
+
+    std::atomic<uint64_t> seq;  // odd while being written
+    uint64_t index;
+    uint64_t unix_us;
+    uint64_t busy_ns;
+    uint64_t payload_bytes;   // full payload size
+    uint32_t outcome;
+    uint32_t header_bytes;    // full header size
+    uint32_t stored_header;   // header bytes kept
+    uint32_t stored_payload;  // payload bytes kept
+    uint32_t error_len;
+    uint32_t reserved0;
+    char error[kErrorBytes];
+    // followed by slot_bytes of header text, then payload prefix
+};
+
+struct FlightRecord {
+    uint64_t index = 0;
+    uint64_t unix_us = 0;
+    uint64_t busy_ns = 0;
+    FlightOutcome outcome = FlightOutcome::InFlight;
+    uint32_t header_bytes = 0;
+    uint64_t payload_bytes = 0;
+    std::string header;   // possibly truncated
+    std::string payload;  // prefix
+    std::string error;
+};
+
+struct FlightSnapshot {
+    std::string shm;
+    std::string route;
+    std::string stage;
+    int pid = 0;
+    bool alive = false;
+    std::vector<FlightRecord> records;  // oldest first
+};
+
+namespace detail {
+
+inline size_t flight_slot_stride(uint32_t slot_bytes) {
+    return (sizeof(FlightSlot) + slot_bytes + 63) & ~size_t{63};
+}
+
+inline uint64_t env_u64(const char* name, uint64_t def) {
+    const char* v = std::getenv(name);
+    return v && *v ? std::strtoull(v, nullptr, 10) : def;
+}
+
+inline uint64_t unix_us_now() {
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count());
+}
+
+}  // namespace detail
+
+// Copies the completed records out of a mapped block.
+inline FlightSnapshot read_flight(const std::string& shm) {
+    FlightSnapshot out;
+    out.shm = shm;
+    SharedRegion r = SharedRegion::open(shm);
+    if (r.size() < sizeof(FlightBlock)) return out;
+    const auto* b = reinterpret_cast<const FlightBlock*>(r.data());
+    if (b->magic != FlightBlock::kMagic || b->version != FlightBlock::kVersion) return out;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    const size_t stride = detail::flight_slot_stride(b->slot_bytes);
+    if (r.size() < sizeof(FlightBlock) + stride * b->slots) return out;
+    out.route.assign(b->route, strnlen(b->route, sizeof(b->route)));
+    out.stage.assign(b->stage, strnlen(b->stage, sizeof(b->stage)));
+    out.pid = b->pid;
+    out.alive = ::kill(b->pid, 0) == 0 || errno == EPERM;
+    const uint8_t* base = r.data() + sizeof(FlightBlock);
+    for (uint32_t i = 0; i < b->slots; ++i) {
+        const auto* s = reinterpret_cast<const FlightSlot*>(base + stride * i);
+        const char* data = reinterpret_cast<const char*>(s + 1);
+        for (int attempt = 0; attempt < 3; ++attempt) {
+            const uint64_t before = s->seq.load(std::memory_order_acquire);
+            if (before == 0) break;  // never written
+            if (before & 1) continue;
+            FlightRecord rec;
+            rec.index = s->index;
+            rec.unix_us = s->unix_us;
+            rec.busy_ns = s->busy_ns;
+            rec.outcome = static_cast<FlightOutcome>(s->outcome);
+            rec.header_bytes = s->header_bytes;
+            rec.payload_bytes = s->payload_bytes;
+            const uint32_t hb = std::min(s->stored_header, b->slot_bytes);
+            const uint32_t pb = std::min(s->stored_payload, b->slot_bytes - hb);
+            rec.header.assign(data, hb);
+            rec.payload.assign(data + hb, pb);
+            rec.error.assign(s->error, std::min(s->error_len, FlightSlot::kErrorBytes));
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (s->seq.load(std::memory_order_relaxed) != before) continue;
+            out.records.push_back(std::move(rec));
+            break;
+        }
+    }
+    std::sort(out.records.begin(), out.records.end(),
+              [](const FlightRecord& a, const FlightRecord& b) { return a.index < b.index; });
+    return out;
+}
+
+// Names of all flight blocks on the node, e.g. "/camel_flight_1234".
+inline std::vector<std::string> list_flight_blocks() {
+    std::vector<std::string> out;
+    DIR* dir = opendir("/dev/shm");
+    if (!dir) return out;
+    while (dirent* e = readdir(dir))
+        if (std::strncmp(e->d_name, "camel_flight_", 13) == 0) out.push_back(std::string("/") + e->d_name);
+    closedir(dir);
+    return out;
+}
+
+// Appends one record as a JSON object. A complete header is embedded as
+// the `message` object; a truncated one as the `message_truncated` string.
+inline void append_flight_record(std::string& out, const FlightRecord& r) {
+    out += "{\"index\":" + std::to_string(r.index) + ",\"unix_us\":" + std::to_string(r.unix_us) + ",\"busy_ms\":";
+    json::detail::dump_number(out, static_cast<double>(r.busy_ns) / 1e6);
+    out += ",\"outcome\":\"";
+    out += flight_outcome_name(r.outcome);
+    out += '"';
+    if (!r.error.empty()) {
+        out += ",\"error\":";
+        json::detail::dump_string(out, r.error);
+    }
+    if (r.header.size() == r.header_bytes) {
+        out += ",\"message\":";
+        out += r.header;  // stored verbatim, already JSON
+    } else {
+        out += ",\"message_truncated\":";
+        json::detail::dump_string(out, r.header);
+        out += ",\"message_bytes\":" + std::to_string(r.header_bytes);
+    }
+    if (r.payload_bytes > 0) {
+        out += ",\"payload_bytes\":" + std::to_string(r.payload_bytes) + ",\"payload_prefix\":\"";
+        out += base64_encode(r.payload);
+        out += '"';
+    }
+    out += '}';
+}
+
+// Writes a snapshot as NDJSON: one line describing the dump, then one line
+// per record, oldest first. Returns the file path, or "" if it could not be
+// written.
+inline std::string write_flight_dump(const FlightSnapshot& snap, const std::string& reason, const std::string& dir) {
+    ::mkdir(dir.c_str(), 0775);
+    const uint64_t now_ms = unix_ms_now();
+    std::string file = "flight_" + snap.route + "_" + snap.stage + "_" + std::to_string(snap.pid) + "_" +
+                       std::to_string(now_ms) + ".ndjson";
+    for (char& c : file)
+        if (c == '/' || c == ' ') c = '_';
+    const std::string path = dir + "/" + file;
+    FILE* f = std::fopen(path.c_str(), "w");
+    if (!f) return "";
+    json::Value head = json::Value::object();
+    head["route"] = snap.route;
+    head["stage"] = snap.stage;
+    head["pid"] = snap.pid;
+    head["reason"] = reason;
+    head["dumped_unix_ms"] = now_ms;
+    head["records"] = snap.records.size();
+    std::string line = head.dump();
+    line += '\n';
+    std::fwrite(line.data(), 1, line.size(), f);
+    for (const FlightRecord& r : snap.records) {
+        line.clear();
+        append_flight_record(line, r);
+        line += '\n';
+        std::fwrite(line.data(), 1, line.size(), f);
+    }
+    return std::fclose(f) == 0 ? path : "";
+}
+
+// Writer side, one per process.
+class FlightRecorder {
+public:
+    static FlightRecorder& instance() {
+        static FlightRecorder recorder;
+        return recorder;
+    }
+
+    ~FlightRecorder() {
+        if (block_) shm_unlink(name_.c_str());
+    }
+
+    void open(const std::string& stage) {
+        if (block_ || disabled_) return;
+        const char* off = std::getenv("CAMEL_FLIGHT");
+        if (off && std::strcmp(off, "off") == 0) {
+            disabled_ = true;
+            return;
+        }
+        const auto slots = static_cast<uint32_t>(std::max<uint64_t>(detail::env_u64("CAMEL_FLIGHT_SLOTS", 64), 1));
+        const auto slot_bytes = static_cast<uint32_t>(std::max<uint64_t>(detail::env_u64("CAMEL_FLIGHT_SLOT_BYTES", 4096), 256));
+        payload_cap_ = static_cast<uint32_t>(std::min<uint64_t>(detail::env_u64("CAMEL_FLIGHT_PAYLOAD_BYTES", 256), slot_bytes));
+        slow_ns_ = detail::env_u64("CAMEL_FLIGHT_SLOW_MS", 0) * 1000000ull;
+        const char* dir = std::getenv("CAMEL_FLIGHT_DIR");
+        dir_ = dir && *dir ? dir : "logs";
+        stride_ = detail::flight_slot_stride(slot_bytes);
+        name_ = "/camel_flight_" + std::to_string(::getpid());
+        try {
+            region_ = SharedRegion::create(name_, sizeof(FlightBlock) + stride_ * slots);
+        } catch (const std::exception&) {
+            disabled_ = true;
+            return;
+        }
+        auto* b = reinterpret_cast<FlightBlock*>(region_.data());
+        std::memset(static_cast<void*>(region_.data()), 0, region_.size());
+        b->version = FlightBlock::kVersion;
+        b->pid = static_cast<int32_t>(::getpid());
+        b->slots = slots;
+        b->slot_bytes = slot_bytes;
+        b->started_unix_ms = unix_ms_now();
+        const char* route = std::getenv("CAMEL_ROUTE");
+        std::strncpy(b->route, route && *route ? route : "default", sizeof(b->route) - 1);
+        std::strncpy(b->stage, stage.c_str(), sizeof(b->stage) - 1);
+        std::atomic_thread_fence(std::memory_order_release);
+        b->magic = FlightBlock::kMagic;
+        block_ = b;
+    }
+
+    bool enabled() const { return block_ != nullptr; }
+
+    // Records an input before the handler sees it.
+    void begin(std::string_view header, std::string_view payload) {
+        if (!block_) return;
+        const uint64_t n = count_++;
+        current_ = slot(n);
+        const uint64_t seq = current_->seq.load(std::memory_order_relaxed);
+        current_->seq.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        auto* data = reinterpret_cast<char*>(current_ + 1);
+        const uint32_t hb = static_cast<uint32_t>(std::min<size_t>(header.size(), block_->slot_bytes));
+        const uint32_t pb = static_cast<uint32_t>(std::min<size_t>({payload.size(), payload_cap_, block_->slot_bytes - hb}));
+        std::memcpy(data, header.data(), hb);
+        std::memcpy(data + hb, payload.data(), pb);
+        current_->index = n;
+        current_->unix_us = detail::unix_us_now();
+        current_->busy_ns = 0;
+        current_->payload_bytes = payload.size();
+        current_->outcome = static_cast<uint32_t>(FlightOutcome::InFlight);
+        current_->header_bytes = static_cast<uint32_t>(header.size());
+        current_->stored_header = hb;
+        current_->stored_payload = pb;
+        current_->error_len = 0;
+        current_->seq.store(seq + 2, std::memory_order_release);
+        block_->next.store(count_, std::memory_order_release);
+    }
+
+    // Completes the record from begin(). Dumps the ring when the handler
+    // failed or was slower than CAMEL_FLIGHT_SLOW_MS.
+    void end(FlightOutcome outcome, uint64_t busy_ns, std::string_view error = {}) {
+        if (!block_ || !current_) return;
+        const uint64_t seq = current_->seq.load(std::memory_order_relaxed);
+        current_->seq.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        current_->outcome = static_cast<uint32_t>(outcome);
+        current_->busy_ns = busy_ns;
+        current_->error_len = static_cast<uint32_t>(std::min<size_t>(error.size(), FlightSlot::kErrorBytes));
+        std::memcpy(current_->error, error.data(), current_->error_len);
+        current_->seq.store(seq + 2, std::memory_order_release);
+        current_ = nullptr;
+        if (outcome == FlightOutcome::Error) dump("error");
+        else if (slow_ns_ && busy_ns > slow_ns_) dump("slow");
+    }
+
+    // Writes the ring to CAMEL_FLIGHT_DIR, at most once a minute so a
+    // failing stream does not fill the disk. Returns the path or "".
+    std::string dump(const std::string& reason) {
+        if (!block_) return "";
+        const uint64_t now_ms = unix_ms_now();
+        if (last_dump_ms_ && now_ms - last_dump_ms_ < 60000) return "";
+        last_dump_ms_ = now_ms;
+        try {
+            return write_flight_dump(read_flight(name_), reason, dir_);
+        } catch (const std::exception&) {
+            return "";
+        }
+    }
+
+private:
+    FlightRecorder() = default;
+
+    FlightSlot* slot(uint64_t n) {
+        return reinterpret_cast<FlightSlot*>(region_.data() + sizeof(FlightBlock) + stride_ * (n % block_->slots));
+    }
+
+    std::string name_;
+    std::string dir_;
+    SharedRegion region_;
+    FlightBlock* block_ = nullptr;
+    FlightSlot* current_ = nullptr;
+    size_t stride_ = 0;
+    uint32_t payload_cap_ = 256;
+    uint64_t slow_ns_ = 0;
+    uint64_t count_ = 0;
+    uint64_t last_dump_ms_ = 0;
+    bool disabled_ = false;
+};
+
+}  // namespace camel
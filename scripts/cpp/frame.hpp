@@ -0,0 +1,154 @@
+// Decoded frame views and resolution of the "frame" reference carried in
+// route messages.
+//
+// A frame reference looks like
+//   {"shm": "/camel_frames_front", "slot": 3, "sequence": 88,
+//    "format": "i420", "width": 1920, "height": 1080}
+// or, for offline runs, {"path": "frame.yuv", "format": ..., ...}.
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <stdexcept>
+#include <string>
+
+#include "json.hpp"
+#include "shm.hpp"
+
+namespace camel {
+
+enum class PixelFormat { BGR, I420, NV12 };
+
+inline PixelFormat parse_pixel_format(const std::string& s) {
+    if (s == "bgr" || s == "bgr24") return PixelFormat::BGR;
+    if (s == "i420" || s == "yuv420p") return PixelFormat::I420;
+    if (s == "nv12") return PixelFormat::NV12;
+    throw std::runtime_error("unsupported pixel format '" + s + "'");
+}
+
+inline const char* pixel_format_name(PixelFormat f) {
+    switch (f) {
+        case PixelFormat::BGR: return "bgr";
+        case PixelFormat::I420: return "i420";
+        case PixelFormat::NV12: return "nv12";
+    }
+    return "unknown";
+}
+
+inline size_t frame_bytes(PixelFormat f, int width, int height) {
+    size_t luma = static_cast<size_t>(width) * height;
+    if (f == PixelFormat::BGR) return luma * 3;
+    size_t chroma = static_cast<size_t>((width + 1) / 2) * ((height + 1) / 2);
+    return luma + 2 * chroma;
+}
+
+// Non-owning view over a decoded frame. For BGR only plane 0 is used; for
+// NV12 plane 1 holds interleaved UV and plane 2 is unused.
+struct FrameView {
+    PixelFormat format = PixelFormat::BGR;
+    int width = 0;
+    int height = 0;
+    uint8_t* planes[3] = {nullptr, nullptr, nullptr};
+    int strides[3] = {0, 0, 0};
+
+    static FrameView packed(PixelFormat f, int width, int height, uint8_t* data) {
+        FrameView v;
+        v.format = f;
+        v.width = width;
+        v.height = height;
+        int cw = (width + 1) / 2;
+        int ch = (height + 1) / 2;
+        switch (f) {
+            case PixelFormat::BGR:
+                v.planes[0] = data;
+                v.strides[0] = width * 3;
+                break;
+            case PixelFormat::I420:
+                v.planes[0] = data;
+                v.strides[0] = width;
+                v.planes[1] = data + static_cast<size_t>(width) * height;
+                v.strides[1] = cw;
+                v.planes[2] = v.planes[1] + static_cast<size_t>(cw) * ch;
+                v.strides[2] = cw;
+                break;
+            case PixelFormat::NV12:
+                v.planes[0] = data;
+                v.strides[0] = width;
+                v.planes[1] = data + static_cast<size_t>(width) * height;
+                v.strides[1] = cw * 2;
+                break;
+        }
+        return v;
+    }
+
+    bool is_yuv() const { return format != PixelFormat::BGR; }
+};
+
+// Resolves frame references against shared memory rings, caching mappings
+// so a long-running processor maps each camera's ring once.
+class FrameStore {
+public:
+    explicit FrameStore(bool writable = false) : writable_(writable) {}
+
+    FrameView resolve(const json::Value& ref) {
+        if (!ref.is_object()) throw std::runtime_error("message has no frame reference");
+        PixelFormat format = parse_pixel_format(ref.string_or("format", "bgr"));
+        int width = static_cast<int>(ref.number_or("width", 0));
+        int height = static_cast<int>(ref.number_or("height", 0));
+        if (width <= 0 || height <= 0) throw std::runtime_error("frame reference without width/height");
+        size_t need = frame_bytes(format, width, height);
+
+        uint8_t* data = nullptr;
+        size_t have = 0;
+        if (ref.contains("shm")) {
+            SlotRing& ring = ring_for(ref["shm"].as_string());
+            auto slot = static_cast<uint32_t>(ref.number_or("slot", 0));
+            auto seq = static_cast<uint64_t>(ref.number_or("sequence", 0));
+            const uint8_t* p = ring.read(slot, seq, &have);
+            data = const_cast<uint8_t*>(p);
+        } else if (ref.contains("path")) {
+            file_ = SharedRegion::open_file(ref["path"].as_string(), writable_);
+            data = file_.data();
+            have = file_.size();
+        } else {
+            throw std::runtime_error("frame reference needs 'shm' or 'path'");
+        }
+        if (have < need) throw std::runtime_error("frame buffer smaller than declared geometry");
+        return FrameView::packed(format, width, height, data);
+    }
+
+    // True if the slot behind a shm reference was not overwritten while the
+    // caller was reading it.
+    bool still_valid(const json::Value& ref) {
+        if (!ref.contains("shm")) return true;
+        SlotRing& ring = ring_for(ref["shm"].as_string());
+        return ring.still_valid(static_cast<uint32_t>(ref.number_or("slot", 0)),
+                                static_cast<uint64_t>(ref.number_or("sequence", 0)));
+    }
+
+private:
+    SlotRing& ring_for(const std::string& name) {
+        auto it = rings_.find(name);
+        if (it == rings_.end()) it = rings_.emplace(name, SlotRing::open(name, writable_)).first;
+        else if (it->second.stale()) it->second = SlotRing::open(name, writable_);
+        return it->second;
+    }
+
+    bool writable_;
+    std::map<std::string, SlotRing> rings_;
+    SharedRegion file_;
+};
+
+inline json::Value frame_reference(const SlotRing& ring, const SlotRing::WriteSlot& slot, PixelFormat f, int width,
+                                   int height) {
+    json::Value ref = json::Value::object();
+    ref["shm"] = ring.name();
+    ref["slot"] = slot.index;
+    ref["sequence"] = slot.sequence;
+    ref["format"] = pixel_format_name(f);
+    ref["width"] = width;
+    ref["height"] = height;
+    return ref;
+}
+
+}  // namespace camel
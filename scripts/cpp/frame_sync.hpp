@@ -0,0 +1,134 @@
+// Alignment of frames from a group of cameras into capture-time tuples.
+//
+// Cameras stream independently, so frames of the same instant arrive at
+// different times and rates. Each camera keeps a short queue; the oldest
+// queued frame anchors a tuple and every other camera contributes its
+// frame closest in time, within `tolerance_ms`. A camera that has not
+// delivered anything usable by the time the anchor has waited
+// `max_latency_ms` is left out, so tuples go out with bounded latency even
+// when a camera stalls. Like ApproximateTime sync, a frame is only paired
+// with the anchor if the anchor camera has no closer frame for it.
+//
+// Pure bookkeeping: the caller stamps arrival times and emits the tuples.
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <deque>
+#include <vector>
+
+#include "json.hpp"
+#include "probes.hpp"
+
+namespace camel {
+
+struct SyncOptions {
+    double tolerance_ms = 50.0;     // max capture-time distance from the anchor
+    double max_latency_ms = 200.0;  // longest an anchor waits for the other cameras
+    size_t min_cameras = 1;         // smaller tuples are dropped
+    size_t max_pending = 16;        // per camera; older frames are dropped
+};
+
+struct SyncedFrame {
+    size_t camera = 0;
+    double time_ms = 0.0;     // capture time, for alignment
+    double arrival_ms = 0.0;  // local clock, for the latency bound
+    json::Value message;
+};
+
+// Members in camera order.
+struct FrameTuple {
+    std::vector<SyncedFrame> members;
+    bool complete = false;
+};
+
+class FrameSynchronizer {
+public:
+    FrameSynchronizer(size_t cameras, SyncOptions opt) : opt_(opt), queues_(cameras) {}
+
+    size_t dropped() const { return dropped_; }
+
+    void push(SyncedFrame frame) {
+        auto& q = queues_[frame.camera];
+        // Out-of-order or repeated timestamps would stall the anchor search.
+        if (!q.empty() && frame.time_ms <= q.back().time_ms) {
+            drop(frame, "out_of_order");
+            return;
+        }
+        q.push_back(std::move(frame));
+        if (q.size() > opt_.max_pending) {
+            drop(q.front(), "overflow");
+            q.pop_front();
+        }
+    }
+
+    // Emits every tuple that is complete or has timed out. With `flush`,
+    // pending frames go out without waiting (end of input).
+    template <typename Emit>
+    void poll(double now_ms, Emit&& emit, bool flush = false) {
+        for (;;) {
+            size_t anchor = queues_.size();
+            for (size_t c = 0; c < queues_.size(); ++c) {
+                if (queues_[c].empty()) continue;
+                if (anchor == queues_.size() || queues_[c].front().time_ms < queues_[anchor].front().time_ms) anchor = c;
+            }
+            if (anchor == queues_.size()) return;
+            const SyncedFrame& a = queues_[anchor].front();
+            const bool expired = flush || now_ms - a.arrival_ms >= opt_.max_latency_ms;
+
+            std::vector<size_t> matched = {anchor};
+            bool waiting = false;
+            for (size_t c = 0; c < queues_.size(); ++c) {
+                if (c == anchor) continue;
+                if (queues_[c].empty()) {
+                    waiting = true;  // may still deliver a frame close to the anchor
+                    continue;
+                }
+                const SyncedFrame& f = queues_[c].front();  // not older than the anchor
+                if (f.time_ms - a.time_ms > opt_.tolerance_ms) continue;
+                if (queues_[anchor].size() > 1 &&
+                    std::fabs(queues_[anchor][1].time_ms - f.time_ms) < f.time_ms - a.time_ms)
+                    continue;  // belongs with the anchor camera's next frame
+                matched.push_back(c);
+            }
+            if (waiting && !expired) return;
+
+            FrameTuple tuple;
+            tuple.complete = matched.size() == queues_.size();
+            std::sort(matched.begin(), matched.end());
+            for (size_t c : matched) {
+                tuple.members.push_back(std::move(queues_[c].front()));
+                queues_[c].pop_front();
+            }
+            if (tuple.members.size() >= opt_.min_cameras)
+                emit(std::move(tuple));
+            else
+                for (const auto& m : tuple.members) drop(m, "incomplete");
+        }
+    }
+
+    // Local time at which the oldest anchor times out; < 0 when idle.
+    double next_deadline() const {
+        double deadline = -1.0;
+        for (const auto& q : queues_)
+            if (!q.empty() && (deadline < 0 || q.front().arrival_ms + opt_.max_latency_ms < deadline))
+                deadline = q.front().arrival_ms + opt_.max_latency_ms;
+        return deadline;
+    }
+
+private:
+    void drop(const SyncedFrame& f, const char* reason) {
+        ++dropped_;
+        if (CAMEL_PROBE_ENABLED(drop)) {
+            const auto sequence = static_cast<uint64_t>(f.message.get("frame").number_or("sequence", 0));
+            CAMEL_PROBE4(drop, probes::route(), probes::stage(), sequence, reason);
+        }
+    }
+
+    SyncOptions opt_;
+    std::vector<std::deque<SyncedFrame>> queues_;
+    size_t dropped_ = 0;
+};
+
+}  // namespace camel
@@ -0,0 +1,235 @@
+// Minimal HTTP/1.1 and WebSocket (RFC 6455) pieces for cpp_monitor.
+//
+// Only what a dashboard on the local network needs: GET requests without
+// bodies, one response per connection, and server-to-client text frames.
+// Client frames are parsed far enough to answer pings and closes.
+#pragma once
+
+#include <cctype>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <string_view>
+
+#include "base64.hpp"
+
+namespace camel::http {
+
+struct Request {
+    std::string method;
+    std::string path;
+    std::map<std::string, std::string> query;
+    std::map<std::string, std::string> headers;  // lower-case names
+
+    std::string header(const std::string& name) const {
+        auto it = headers.find(name);
+        return it == headers.end() ? "" : it->second;
+    }
+    std::string param(const std::string& name, const std::string& def = "") const {
+        auto it = query.find(name);
+        return it == query.end() ? def : it->second;
+    }
+};
+
+inline std::string url_decode(std::string_view s) {
+    std::string out;
+    for (size_t i = 0; i < s.size(); ++i) {
+        if (s[i] == '%' && i + 2 < s.size()) {
+            out += static_cast<char>(std::strtol(std::string(s.substr(i + 1, 2)).c_str(), nullptr, 16));
+            i += 2;
+        } else {
+            out += s[i] == '+' ? ' ' : s[i];
+        }
+    }
+    return out;
+}
+
+// "a=1&b=x%20y" into decoded key/value pairs.
+inline void parse_query(std::string_view qs, std::map<std::string, std::string>& out) {
+    while (!qs.empty()) {
+        const size_t amp = qs.find('&');
+        std::string_view kv = qs.substr(0, amp);
+        const size_t eq = kv.find('=');
+        if (!kv.empty()) out[url_decode(kv.substr(0, eq))] = eq == std::string_view::npos ? "" : url_decode(kv.substr(eq + 1));
+        qs = amp == std::string_view::npos ? std::string_view() : qs.substr(amp + 1);
+    }
+}
+
+// Parses a request head once "\r\n\r\n" has arrived. Returns the number of
+// bytes consumed, 0 if incomplete, or -1 if malformed.
+inline long parse_request(std::string_view buf, Request& req) {
+    const size_t end = buf.find("\r\n\r\n");
+    if (end == std::string_view::npos) return buf.size() > 16384 ? -1 : 0;
+    std::string_view head = buf.substr(0, end);
+    size_t line_end = head.find("\r\n");
+    std::string_view line = head.substr(0, line_end);
+    const size_t sp1 = line.find(' '), sp2 = line.rfind(' ');
+    if (sp1 == std::string_view::npos || sp2 <= sp1) return -1;
+    req.method = std::string(line.substr(0, sp1));
+    std::string_view target = line.substr(sp1 + 1, sp2 - sp1 - 1);
+    const size_t q = target.find('?');
+    req.path = url_decode(target.substr(0, q));
+    if (q != std::string_view::npos) parse_query(target.substr(q + 1), req.query);
+    while (line_end != std::string_view::npos) {
+        const size_t start = line_end + 2;
+        line_end = head.find("\r\n", start);
+        line = head.substr(start, line_end == std::string_view::npos ? std::string_view::npos : line_end - start);
+        const size_t colon = line.find(':');
+        if (colon == std::string_view::npos) continue;
+        std::string name(line.substr(0, colon));
+        for (char& c : name) c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+        std::string_view value = line.substr(colon + 1);
+        while (!value.empty() && (value.front() == ' ' || value.front() == '\t')) value.remove_prefix(1);
+        req.headers[name] = std::string(value);
+    }
+    return static_cast<long>(end + 4);
+}
+
+inline const char* status_text(int status) {
+    switch (status) {
+        case 200: return "OK";
+        case 400: return "Bad Request";
+        case 404: return "Not Found";
+        case 405: return "Method Not Allowed";
+        case 409: return "Conflict";
+        case 500: return "Internal Server Error";
+        case 503: return "Service Unavailable";
+    }
+    return "Error";
+}
+
+inline std::string response(int status, const std::string& content_type, const std::string& body) {
+    std::string out = "HTTP/1.1 " + std::to_string(status) + " " + status_text(status) + "\r\n";
+    out += "Content-Type: " + content_type + "\r\n";
+    out += "Content-Length: " + std::to_string(body.size()) + "\r\n";
+    out += "Cache-Control: no-store\r\nConnection: close\r\n\r\n";
+    out += body;
+    return out;
+}
+
+inline const char* content_type_for(const std::string& path) {
+    auto ends = [&](const char* ext) {
+        const size_t n = std::strlen(ext);
+        return path.size() >= n && path.compare(path.size() - n, n, ext) == 0;
+    };
+    if (ends(".html")) return "text/html; charset=utf-8";
+    if (ends(".js")) return "application/javascript";
+    if (ends(".css")) return "text/css";
+    if (ends(".json")) return "application/json";
+    if (ends(".svg")) return "image/svg+xml";
+    if (ends(".png")) return "image/png";
+    return "application/octet-stream";
+}
+
+namespace detail {
+
+inline uint32_t rol(uint32_t v, int n) { return (v << n) | (v >> (32 - n)); }
+
+inline std::string sha1(const std::string& msg) {
+    uint32_t h[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+    std::string data = msg;
+    const uint64_t bits = static_cast<uint64_t>(msg.size()) * 8;
+    data += static_cast<char>(0x80);
+    while (data.size() % 64 != 56) data += '\0';
+    for (int i = 7; i >= 0; --i) data += static_cast<char>((bits >> (i * 8)) & 0xff);
+    for (size_t off = 0; off < data.size(); off += 64) {
+        uint32_t w[80];
+        for (int i = 0; i < 16; ++i)
+            w[i] = (static_cast<uint32_t>(static_cast<uint8_t>(data[off + 4 * i])) << 24) |
+                   (static_cast<uint32_t>(static_cast<uint8_t>(data[off + 4 * i + 1])) << 16) |
+                   (static_cast<uint32_t>(static_cast<uint8_t>(data[off + 4 * i + 2])) << 8) |
+                   static_cast<uint32_t>(static_cast<uint8_t>(data[off + 4 * i + 3]));
+        for (int i = 16; i < 80; ++i) w[i] = rol(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+        uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+        for (int i = 0; i < 80; ++i) {
+            uint32_t f, k;
+            if (i < 20) f = (b & c) | (~b & d), k = 0x5A827999;
+            else if (i < 40) f = b ^ c ^ d, k = 0x6ED9EBA1;
+            else if (i < 60) f = (b & c) | (b & d) | (c & d), k = 0x8F1BBCDC;
+            else f = b ^ c ^ d, k = 0xCA62C1D6;
+            const uint32_t t = rol(a, 5) + f + e + k + w[i];
+            e = d;
+            d = c;
+            c = rol(b, 30);
+            b = a;
+            a = t;
+        }
+        h[0] += a;
+        h[1] += b;
+        h[2] += c;
+        h[3] += d;
+        h[4] += e;
+    }
+    std::string out;
+    for (uint32_t v : h)
+        for (int i = 3; i >= 0; --i) out += static_cast<char>((v >> (i * 8)) & 0xff);
+    return out;
+}
+
+}  // namespace detail
+
+inline bool is_websocket_upgrade(const Request& req) {
+    std::string upgrade = req.header("upgrade");
+    for (char& c : upgrade) c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    return upgrade == "websocket" && !req.header("sec-websocket-key").empty();
+}
+
+inline std::string websocket_accept(const Request& req) {
+    const std::string accept =
+        base64_encode(detail::sha1(req.header("sec-websocket-key") + "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"));
+    return "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+           "Sec-WebSocket-Accept: " + accept + "\r\n\r\n";
+}
+
+enum class Opcode : uint8_t { Continuation = 0, Text = 1, Binary = 2, Close = 8, Ping = 9, Pong = 10 };
+
+// Unmasked server frame.
+inline void append_frame(std::string& out, Opcode op, std::string_view payload) {
+    out += static_cast<char>(0x80 | static_cast<uint8_t>(op));
+    const uint64_t n = payload.size();
+    if (n < 126) {
+        out += static_cast<char>(n);
+    } else if (n < 65536) {
+        out += static_cast<char>(126);
+        out += static_cast<char>(n >> 8);
+        out += static_cast<char>(n & 0xff);
+    } else {
+        out += static_cast<char>(127);
+        for (int i = 7; i >= 0; --i) out += static_cast<char>((n >> (i * 8)) & 0xff);
+    }
+    out.append(payload.data(), payload.size());
+}
+
+struct Frame {
+    Opcode op = Opcode::Text;
+    std::string payload;
+};
+
+// Parses one client frame from the front of `buf`. Returns bytes consumed,
+// 0 if incomplete, -1 on a protocol error (unmasked or oversized frame).
+inline long parse_frame(std::string_view buf, Frame& f, size_t max_payload = 1 << 16) {
+    if (buf.size() < 2) return 0;
+    const auto b0 = static_cast<uint8_t>(buf[0]), b1 = static_cast<uint8_t>(buf[1]);
+    if (!(b1 & 0x80)) return -1;
+    uint64_t n = b1 & 0x7f;
+    size_t pos = 2;
+    if (n == 126 || n == 127) {
+        const size_t bytes = n == 126 ? 2 : 8;
+        if (buf.size() < pos + bytes) return 0;
+        n = 0;
+        for (size_t i = 0; i < bytes; ++i) n = (n << 8) | static_cast<uint8_t>(buf[pos + i]);
+        pos += bytes;
+    }
+    if (n > max_payload) return -1;
+    if (buf.size() < pos + 4 + n) return 0;
+    const char* mask = buf.data() + pos;
+    pos += 4;
+    f.op = static_cast<Opcode>(b0 & 0x0f);
+    f.payload.resize(n);
+    for (size_t i = 0; i < n; ++i) f.payload[i] = static_cast<char>(buf[pos + i] ^ mask[i & 3]);
+    return static_cast<long>(pos + n);
+}
+
+}  // namespace camel::http
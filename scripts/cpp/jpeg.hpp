@@ -0,0 +1,142 @@
+// JPEG encoding of 4:2:0 images with libjpeg(-turbo).
+//
+// Planes go straight into the DCT through the raw-data interface, so no
+// RGB conversion or chroma resampling happens on the way. The compressor
+// object is set up once and reused for every image; keep one encoder per
+// thread (thread_jpeg_encoder()).
+#pragma once
+
+#include <csetjmp>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <jpeglib.h>
+
+#include "yuv.hpp"
+
+namespace camel {
+
+class JpegEncoder {
+public:
+    JpegEncoder() {
+        cinfo_.err = jpeg_std_error(&err_.mgr);
+        err_.mgr.error_exit = &JpegEncoder::on_error;
+        jpeg_create_compress(&cinfo_);
+        dest_.mgr.init_destination = &JpegEncoder::init_destination;
+        dest_.mgr.empty_output_buffer = &JpegEncoder::empty_output_buffer;
+        dest_.mgr.term_destination = &JpegEncoder::term_destination;
+        cinfo_.dest = &dest_.mgr;
+    }
+    JpegEncoder(const JpegEncoder&) = delete;
+    JpegEncoder& operator=(const JpegEncoder&) = delete;
+    ~JpegEncoder() { jpeg_destroy_compress(&cinfo_); }
+
+    // Encodes a full-range I420 image (JFIF YCbCr). Pads the right edge of
+    // each row to the MCU width in place.
+    void encode(YuvImage& img, int quality, std::vector<uint8_t>& out) {
+        pad_columns(img);
+        out.clear();
+        dest_.out = &out;
+        if (setjmp(err_.jump)) {
+            jpeg_abort_compress(&cinfo_);
+            throw std::runtime_error(std::string("jpeg encode failed: ") + err_.message);
+        }
+        cinfo_.image_width = static_cast<JDIMENSION>(img.width);
+        cinfo_.image_height = static_cast<JDIMENSION>(img.height);
+        cinfo_.input_components = 3;
+        cinfo_.in_color_space = JCS_YCbCr;
+        jpeg_set_defaults(&cinfo_);
+        jpeg_set_quality(&cinfo_, quality, TRUE);
+        cinfo_.raw_data_in = TRUE;
+        cinfo_.dct_method = JDCT_ISLOW;
+        cinfo_.comp_info[0].h_samp_factor = cinfo_.comp_info[0].v_samp_factor = 2;
+        for (int c = 1; c < 3; ++c) cinfo_.comp_info[c].h_samp_factor = cinfo_.comp_info[c].v_samp_factor = 1;
+        jpeg_start_compress(&cinfo_, TRUE);
+
+        // One MCU row per call: 16 luma and 8 chroma rows, the last rows
+        // repeated below the image.
+        JSAMPROW y_rows[16], u_rows[8], v_rows[8];
+        JSAMPARRAY planes[3] = {y_rows, u_rows, v_rows};
+        const int ch = img.height / 2;
+        for (int row = 0; row < img.height; row += 16) {
+            for (int i = 0; i < 16; ++i) y_rows[i] = img.row(0, std::min(row + i, img.height - 1));
+            for (int i = 0; i < 8; ++i) {
+                int r = std::min(row / 2 + i, ch - 1);
+                u_rows[i] = img.row(1, r);
+                v_rows[i] = img.row(2, r);
+            }
+            jpeg_write_raw_data(&cinfo_, planes, 16);
+        }
+        jpeg_finish_compress(&cinfo_);
+    }
+
+private:
+    struct ErrorManager {
+        jpeg_error_mgr mgr;
+        std::jmp_buf jump;
+        char message[JMSG_LENGTH_MAX];
+    };
+
+    struct Destination {
+        jpeg_destination_mgr mgr;
+        std::vector<uint8_t>* out = nullptr;
+    };
+
+    static constexpr size_t kChunk = 64 * 1024;
+
+    // libjpeg must not unwind through C frames, so errors longjmp back into
+    // encode() and are rethrown there.
+    static void on_error(j_common_ptr cinfo) {
+        auto* err = reinterpret_cast<ErrorManager*>(cinfo->err);
+        (*cinfo->err->format_message)(cinfo, err->message);
+        std::longjmp(err->jump, 1);
+    }
+
+    static void init_destination(j_compress_ptr cinfo) {
+        auto* d = reinterpret_cast<Destination*>(cinfo->dest);
+        d->out->resize(kChunk);
+        d->mgr.next_output_byte = d->out->data();
+        d->mgr.free_in_buffer = d->out->size();
+    }
+
+    static boolean empty_output_buffer(j_compress_ptr cinfo) {
+        auto* d = reinterpret_cast<Destination*>(cinfo->dest);
+        size_t used = d->out->size();
+        d->out->resize(used * 2);
+        d->mgr.next_output_byte = d->out->data() + used;
+        d->mgr.free_in_buffer = d->out->size() - used;
+        return TRUE;
+    }
+
+    static void term_destination(j_compress_ptr cinfo) {
+        auto* d = reinterpret_cast<Destination*>(cinfo->dest);
+        d->out->resize(d->out->size() - d->mgr.free_in_buffer);
+    }
+
+    // The DCT reads whole 8x8 blocks: replicate the last column into the
+    // row padding up to the next multiple of 16 (luma) / 8 (chroma).
+    static void pad_columns(YuvImage& img) {
+        for (int p = 0; p < 3; ++p) {
+            const int w = img.plane_width(p), padded = (w + (p == 0 ? 15 : 7)) & ~(p == 0 ? 15 : 7);
+            if (padded == w) continue;
+            for (int y = 0; y < img.plane_height(p); ++y) {
+                uint8_t* r = img.row(p, y);
+                std::memset(r + w, r[w - 1], padded - w);
+            }
+        }
+    }
+
+    jpeg_compress_struct cinfo_{};
+    ErrorManager err_{};
+    Destination dest_{};
+};
+
+inline JpegEncoder& thread_jpeg_encoder() {
+    thread_local JpegEncoder encoder;
+    return encoder;
+}
+
+}  // namespace camel
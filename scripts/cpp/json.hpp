@@ -0,0 +1,417 @@
+// Minimal JSON value, parser and serializer for the C++ external processors.
+//
+// Messages exchanged with the router are small (metadata plus references to
+// frames in shared memory), so objects keep insertion order in a flat vector
+// and lookups are linear.
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <variant>
+#include <vector>
+
+namespace camel::json {
+
+class Value;
+using Array = std::vector<Value>;
+using Object = std::vector<std::pair<std::string, Value>>;
+
+class ParseError : public std::runtime_error {
+public:
+    using std::runtime_error::runtime_error;
+};
+
+class Value {
+public:
+    enum class Type { Null, Bool, Number, String, Array, Object };
+
+    Value() = default;
+    Value(std::nullptr_t) {}
+    Value(bool b) : data_(b) {}
+    Value(int n) : data_(static_cast<double>(n)) {}
+    Value(unsigned n) : data_(static_cast<double>(n)) {}
+    Value(long n) : data_(static_cast<double>(n)) {}
+    Value(unsigned long n) : data_(static_cast<double>(n)) {}
+    Value(long long n) : data_(static_cast<double>(n)) {}
+    Value(unsigned long long n) : data_(static_cast<double>(n)) {}
+    Value(double n) : data_(n) {}
+    Value(float n) : data_(static_cast<double>(n)) {}
+    Value(const char* s) : data_(std::string(s)) {}
+    Value(std::string s) : data_(std::move(s)) {}
+    Value(std::string_view s) : data_(std::string(s)) {}
+    Value(json::Array a) : data_(std::move(a)) {}
+    Value(json::Object o) : data_(std::move(o)) {}
+
+    static Value array() { return Value(json::Array{}); }
+    static Value object() { return Value(json::Object{}); }
+
+    Type type() const { return static_cast<Type>(data_.index()); }
+    bool is_null() const { return type() == Type::Null; }
+    bool is_bool() const { return type() == Type::Bool; }
+    bool is_number() const { return type() == Type::Number; }
+    bool is_string() const { return type() == Type::String; }
+    bool is_array() const { return type() == Type::Array; }
+    bool is_object() const { return type() == Type::Object; }
+
+    bool as_bool() const { return expect<bool>("bool"); }
+    double as_number() const { return expect<double>("number"); }
+    const std::string& as_string() const { return expect<std::string>("string"); }
+    const json::Array& as_array() const { return expect<json::Array>("array"); }
+    json::Array& as_array() { return expect<json::Array>("array"); }
+    const json::Object& as_object() const { return expect<json::Object>("object"); }
+    json::Object& as_object() { return expect<json::Object>("object"); }
+
+    // Object lookup; returns a shared null value for missing keys so that
+    // chained lookups on optional config sections stay terse.
+    const Value& operator[](std::string_view key) const {
+        if (const Value* v = find(key)) return *v;
+        return null_value();
+    }
+
+    // Object insert-or-lookup; converts a null value into an empty object.
+    Value& operator[](std::string_view key) {
+        if (is_null()) data_ = json::Object{};
+        auto& obj = as_object();
+        for (auto& kv : obj)
+            if (kv.first == key) return kv.second;
+        obj.emplace_back(std::string(key), Value());
+        return obj.back().second;
+    }
+
+    // Read-only lookup that never inserts, for use on mutable messages.
+    const Value& get(std::string_view key) const { return (*this)[key]; }
+
+    const Value& operator[](size_t index) const { return as_array().at(index); }
+    Value& operator[](size_t index) { return as_array().at(index); }
+
+    const Value* find(std::string_view key) const {
+        if (!is_object()) return nullptr;
+        for (const auto& kv : as_object())
+            if (kv.first == key) return &kv.second;
+        return nullptr;
+    }
+
+    bool contains(std::string_view key) const { return find(key) != nullptr; }
+
+    bool erase(std::string_view key) {
+        if (!is_object()) return false;
+        auto& obj = as_object();
+        for (auto it = obj.begin(); it != obj.end(); ++it) {
+            if (it->first == key) {
+                obj.erase(it);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void push_back(Value v) {
+        if (is_null()) data_ = json::Array{};
+        as_array().push_back(std::move(v));
+    }
+
+    size_t size() const {
+        if (is_array()) return as_array().size();
+        if (is_object()) return as_object().size();
+        return 0;
+    }
+
+    // Typed getters with defaults, used for processor config sections.
+    double number_or(std::string_view key, double def) const {
+        const Value* v = find(key);
+        return v && v->is_number() ? v->as_number() : def;
+    }
+    bool bool_or(std::string_view key, bool def) const {
+        const Value* v = find(key);
+        return v && v->is_bool() ? v->as_bool() : def;
+    }
+    std::string string_or(std::string_view key, std::string def) const {
+        const Value* v = find(key);
+        return v && v->is_string() ? v->as_string() : def;
+    }
+
+    static Value parse(std::string_view text);
+    std::string dump() const {
+        std::string out;
+        dump_to(out);
+        return out;
+    }
+    void dump_to(std::string& out) const;
+
+private:
+    template <typename T>
+    const T& expect(const char* what) const {
+        if (const T* p = std::get_if<T>(&data_)) return *p;
+        throw std::runtime_error(std::string("json: value is not a ") + what);
+    }
+    template <typename T>
+    T& expect(const char* what) {
+        if (T* p = std::get_if<T>(&data_)) return *p;
+        throw std::runtime_error(std::string("json: value is not a ") + what);
+    }
+
+    static const Value& null_value() {
+        static const Value null;
+        return null;
+    }
+
+    std::variant<std::nullptr_t, bool, double, std::string, json::Array, json::Object> data_{nullptr};
+};
+
+namespace detail {
+
+class Parser {
+public:
+    explicit Parser(std::string_view text) : s_(text) {}
+
+    Value parse_document() {
+        Value v = parse_value(0);
+        skip_ws();
+        if (pos_ != s_.size()) fail("trailing characters");
+        return v;
+    }
+
+private:
+    static constexpr int kMaxDepth = 128;
+
+    [[noreturn]] void fail(const char* what) const {
+        throw ParseError("json: " + std::string(what) + " at offset " + std::to_string(pos_));
+    }
+
+    void skip_ws() {
+        while (pos_ < s_.size() && (s_[pos_] == ' ' || s_[pos_] == '\t' || s_[pos_] == '\n' || s_[pos_] == '\r'))
+            ++pos_;
+    }
+
+    bool consume(char c) {
+        skip_ws();
+        if (pos_ < s_.size() && s_[pos_] == c) {
+            ++pos_;
+            return true;
+        }
+        return false;
+    }
+
+    bool consume_literal(std::string_view lit) {
+        if (s_.substr(pos_, lit.size()) == lit) {
+            pos_ += lit.size();
+            return true;
+        }
+        return false;
+    }
+
+    Value parse_value(int depth) {
+        if (depth > kMaxDepth) fail("nesting too deep");
+        skip_ws();
+        if (pos_ >= s_.size()) fail("unexpected end of input");
+        char c = s_[pos_];
+        if (c == '{') return parse_object(depth);
+        if (c == '[') return parse_array(depth);
+        if (c == '"') return Value(parse_string());
+        if (consume_literal("true")) return Value(true);
+        if (consume_literal("false")) return Value(false);
+        if (consume_literal("null")) return Value();
+        if (c == '-' || (c >= '0' && c <= '9')) return Value(parse_number());
+        fail("unexpected character");
+    }
+
+    Value parse_object(int depth) {
+        ++pos_;
+        json::Object obj;
+        if (consume('}')) return Value(std::move(obj));
+        do {
+            skip_ws();
+            if (pos_ >= s_.size() || s_[pos_] != '"') fail("expected object key");
+            std::string key = parse_string();
+            if (!consume(':')) fail("expected ':'");
+            obj.emplace_back(std::move(key), parse_value(depth + 1));
+        } while (consume(','));
+        if (!consume('}')) fail("expected '}'");
+        return Value(std::move(obj));
+    }
+
+    Value parse_array(int depth) {
+        ++pos_;
+        json::Array arr;
+        if (consume(']')) return Value(std::move(arr));
+        do {
+            arr.push_back(parse_value(depth + 1));
+        } while (consume(','));
+        if (!consume(']')) fail("expected ']'");
+        return Value(std::move(arr));
+    }
+
+    double parse_number() {
+        size_t start = pos_;
+        if (s_[pos_] == '-') ++pos_;
+        while (pos_ < s_.size()) {
+            char c = s_[pos_];
+            if ((c >= '0' && c <= '9') || c == '.' || c == 'e' || c == 'E' || c == '+' || c == '-')
+                ++pos_;
+            else
+                break;
+        }
+        std::string token(s_.substr(start, pos_ - start));
+        char* end = nullptr;
+        double v = std::strtod(token.c_str(), &end);
+        if (end != token.c_str() + token.size()) fail("invalid number");
+        return v;
+    }
+
+    unsigned parse_hex4() {
+        if (pos_ + 4 > s_.size()) fail("truncated unicode escape");
+        unsigned v = 0;
+        for (int i = 0; i < 4; ++i) {
+            char c = s_[pos_++];
+            v <<= 4;
+            if (c >= '0' && c <= '9') v |= c - '0';
+            else if (c >= 'a' && c <= 'f') v |= c - 'a' + 10;
+            else if (c >= 'A' && c <= 'F') v |= c - 'A' + 10;
+            else fail("invalid unicode escape");
+        }
+        return v;
+    }
+
+    static void append_utf8(std::string& out, unsigned cp) {
+        if (cp < 0x80) {
+            out += static_cast<char>(cp);
+        } else if (cp < 0x800) {
+            out += static_cast<char>(0xC0 | (cp >> 6));
+            out += static_cast<char>(0x80 | (cp & 0x3F));
+        } else if (cp < 0x10000) {
+            out += static_cast<char>(0xE0 | (cp >> 12));
+            out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (cp & 0x3F));
+        } else {
+            out += static_cast<char>(0xF0 | (cp >> 18));
+            out += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+            out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (cp & 0x3F));
+        }
+    }
+
+    std::string parse_string() {
+        ++pos_;
+        std::string out;
+        while (true) {
+            if (pos_ >= s_.size()) fail("unterminated string");
+            char c = s_[pos_++];
+            if (c == '"') break;
+            if (c != '\\') {
+                out += c;
+                continue;
+            }
+            if (pos_ >= s_.size()) fail("unterminated escape");
+            char e = s_[pos_++];
+            switch (e) {
+                case '"': out += '"'; break;
+                case '\\': out += '\\'; break;
+                case '/': out += '/'; break;
+                case 'b': out += '\b'; break;
+                case 'f': out += '\f'; break;
+                case 'n': out += '\n'; break;
+                case 'r': out += '\r'; break;
+                case 't': out += '\t'; break;
+                case 'u': {
+                    unsigned cp = parse_hex4();
+                    if (cp >= 0xD800 && cp <= 0xDBFF && consume_literal("\\u")) {
+                        unsigned lo = parse_hex4();
+                        cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+                    }
+                    append_utf8(out, cp);
+                    break;
+                }
+                default: fail("invalid escape");
+            }
+        }
+        return out;
+    }
+
+    std::string_view s_;
+    size_t pos_ = 0;
+};
+
+inline void dump_string(std::string& out, const std::string& s) {
+    out += '"';
+    for (unsigned char c : s) {
+        switch (c) {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if (c < 0x20) {
+                    char buf[8];
+                    std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+                    out += buf;
+                } else {
+                    out += static_cast<char>(c);
+                }
+        }
+    }
+    out += '"';
+}
+
+inline void dump_number(std::string& out, double v) {
+    if (!std::isfinite(v)) {
+        out += "null";
+        return;
+    }
+    char buf[32];
+    if (v == std::floor(v) && std::fabs(v) < 9007199254740992.0) {  // 2^53: integers stay exact
+        std::snprintf(buf, sizeof(buf), "%.0f", v);
+    } else {
+        // Every stage re-serializes the message, so the text must read back
+        // as the same double: 15 digits when that suffices, else 17.
+        std::snprintf(buf, sizeof(buf), "%.15g", v);
+        if (std::strtod(buf, nullptr) != v) std::snprintf(buf, sizeof(buf), "%.17g", v);
+    }
+    out += buf;
+}
+
+}  // namespace detail
+
+inline Value Value::parse(std::string_view text) { return detail::Parser(text).parse_document(); }
+
+inline void Value::dump_to(std::string& out) const {
+    switch (type()) {
+        case Type::Null: out += "null"; break;
+        case Type::Bool: out += as_bool() ? "true" : "false"; break;
+        case Type::Number: detail::dump_number(out, as_number()); break;
+        case Type::String: detail::dump_string(out, as_string()); break;
+        case Type::Array: {
+            out += '[';
+            bool first = true;
+            for (const auto& v : as_array()) {
+                if (!first) out += ',';
+                first = false;
+                v.dump_to(out);
+            }
+            out += ']';
+            break;
+        }
+        case Type::Object: {
+            out += '{';
+            bool first = true;
+            for (const auto& kv : as_object()) {
+                if (!first) out += ',';
+                first = false;
+                detail::dump_string(out, kv.first);
+                out += ':';
+                kv.second.dump_to(out);
+            }
+            out += '}';
+            break;
+        }
+    }
+}
+
+}  // namespace camel::json
@@ -0,0 +1,245 @@
+// Frame quality analytics on the luma plane alone.
+//
+// Exposure, blur and motion checks need only Y, so they run on the
+// decoder's native YUV420 output before any color conversion or inference:
+//  - exposure: mean and standard deviation of luma catch dark, blown-out
+//    and flat frames (covered lens, fog, IR cut-filter switching);
+//  - sharpness: the variance of the 4-neighbour Laplacian collapses when
+//    the picture is out of focus, smeared or smudged;
+//  - motion: the mean of every 8x8 block is compared with the previous
+//    frame after removing the global brightness shift, so exposure steps
+//    are not motion, while most blocks changing at once is a scene change
+//    (camera moved, IR switching).
+// One pass gathers the sums and the block grid, a second the Laplacian.
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define CAMEL_LUMA_AVX2 1
+#endif
+
+#include "frame.hpp"
+#include "json.hpp"
+#include "preprocess.hpp"
+
+namespace camel {
+
+struct LumaStats {
+    double mean = 0.0;
+    double contrast = 0.0;   // standard deviation
+    double sharpness = 0.0;  // Laplacian variance
+};
+
+namespace detail {
+
+constexpr int kLumaBlock = 8;
+
+// Adds a row to the running sums, and its 8-pixel sums to `blocks` (one
+// per complete block column).
+inline void luma_row(const uint8_t* p, int n, uint64_t& sum, uint64_t& sumsq, uint16_t* blocks) {
+    int x = 0;
+#if CAMEL_LUMA_AVX2
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i s = zero, sq = zero;
+    alignas(32) uint64_t part[4];
+    for (; x + 32 <= n; x += 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + x));
+        __m256i sad = _mm256_sad_epu8(v, zero);  // four 8-pixel sums
+        s = _mm256_add_epi64(s, sad);
+        _mm256_store_si256(reinterpret_cast<__m256i*>(part), sad);
+        uint16_t* b = blocks + x / kLumaBlock;
+        for (int k = 0; k < 4; ++k) b[k] = static_cast<uint16_t>(b[k] + part[k]);
+        __m256i lo = _mm256_unpacklo_epi8(v, zero), hi = _mm256_unpackhi_epi8(v, zero);
+        sq = _mm256_add_epi32(sq, _mm256_add_epi32(_mm256_madd_epi16(lo, lo), _mm256_madd_epi16(hi, hi)));
+    }
+    _mm256_store_si256(reinterpret_cast<__m256i*>(part), s);
+    sum += part[0] + part[1] + part[2] + part[3];
+    alignas(32) uint32_t q[8];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(q), sq);
+    for (uint32_t v : q) sumsq += v;
+#endif
+    const int block_end = n / kLumaBlock * kLumaBlock;
+    for (; x < n; ++x) {
+        const uint32_t v = p[x];
+        sum += v;
+        sumsq += v * v;
+        if (x < block_end) blocks[x / kLumaBlock] = static_cast<uint16_t>(blocks[x / kLumaBlock] + v);
+    }
+}
+
+// Sum and sum of squares of 4c - l - r - u - d over the interior of a row.
+inline void laplacian_row(const uint8_t* up, const uint8_t* p, const uint8_t* down, int n, int64_t& sum, uint64_t& sumsq) {
+    int x = 1;
+#if CAMEL_LUMA_AVX2
+    const __m256i ones = _mm256_set1_epi16(1);
+    __m256i s = _mm256_setzero_si256(), sq = _mm256_setzero_si256();
+    auto load = [](const uint8_t* q) {
+        return _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(q)));
+    };
+    for (; x + 17 <= n; x += 16) {
+        __m256i c = load(p + x);
+        __m256i around = _mm256_add_epi16(_mm256_add_epi16(load(p + x - 1), load(p + x + 1)),
+                                          _mm256_add_epi16(load(up + x), load(down + x)));
+        __m256i lap = _mm256_sub_epi16(_mm256_slli_epi16(c, 2), around);  // |lap| <= 1020
+        s = _mm256_add_epi32(s, _mm256_madd_epi16(lap, ones));
+        sq = _mm256_add_epi32(sq, _mm256_madd_epi16(lap, lap));  // < 2^31 for rows up to 16k
+    }
+    alignas(32) int32_t a[8], b[8];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(a), s);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(b), sq);
+    for (int k = 0; k < 8; ++k) {
+        sum += a[k];
+        sumsq += static_cast<uint32_t>(b[k]);
+    }
+#endif
+    for (; x + 1 < n; ++x) {
+        const int lap = 4 * p[x] - p[x - 1] - p[x + 1] - up[x] - down[x];
+        sum += lap;
+        sumsq += static_cast<uint64_t>(lap * lap);
+    }
+}
+
+}  // namespace detail
+
+// Exposure and sharpness of `area` in a luma plane; `blocks` receives the
+// sums of its complete 8x8 blocks, row-major, (w / 8) x (h / 8).
+inline LumaStats luma_stats(const uint8_t* plane, int stride, const Rect& area, std::vector<uint16_t>& blocks) {
+    using detail::kLumaBlock;
+    const int bw = area.w / kLumaBlock, bh = area.h / kLumaBlock;
+    // One extra block row absorbs the rows below the last complete block.
+    blocks.assign(static_cast<size_t>(bw) * (bh + 1), 0);
+    uint64_t sum = 0, sumsq = 0;
+    int64_t lsum = 0;
+    uint64_t lsumsq = 0;
+    for (int y = 0; y < area.h; ++y) {
+        const uint8_t* row = plane + static_cast<size_t>(area.y + y) * stride + area.x;
+        detail::luma_row(row, area.w, sum, sumsq, blocks.data() + static_cast<size_t>(std::min(y / kLumaBlock, bh)) * bw);
+        if (y > 0 && y + 1 < area.h) detail::laplacian_row(row - stride, row, row + stride, area.w, lsum, lsumsq);
+    }
+    blocks.resize(static_cast<size_t>(bw) * bh);
+    LumaStats st;
+    const double n = static_cast<double>(area.w) * area.h;
+    if (n <= 0) return st;
+    st.mean = sum / n;
+    st.contrast = std::sqrt(std::max(0.0, sumsq / n - st.mean * st.mean));
+    const double ln = static_cast<double>(std::max(0, area.w - 2)) * std::max(0, area.h - 2);
+    if (ln > 0) {
+        const double lmean = lsum / ln;
+        st.sharpness = std::max(0.0, lsumsq / ln - lmean * lmean);
+    }
+    return st;
+}
+
+// Fraction of blocks whose mean moved by more than `threshold` luma levels
+// beyond the global brightness shift.
+inline double block_motion(const std::vector<uint16_t>& cur, const std::vector<uint16_t>& prev, double threshold) {
+    if (cur.empty() || cur.size() != prev.size()) return 0.0;
+    int64_t shift = 0;
+    for (size_t i = 0; i < cur.size(); ++i) shift += static_cast<int64_t>(cur[i]) - prev[i];
+    shift /= static_cast<int64_t>(cur.size());
+    const int64_t limit = std::llround(threshold * detail::kLumaBlock * detail::kLumaBlock);
+    size_t moving = 0;
+    for (size_t i = 0; i < cur.size(); ++i) moving += std::llabs(static_cast<int64_t>(cur[i]) - prev[i] - shift) > limit;
+    return static_cast<double>(moving) / cur.size();
+}
+
+// "quality": {"min_sharpness": 40, "min_motion": 0.01, "drop": ["flat", "static"]}
+struct QualityOptions {
+    double dark_mean = 25.0;  // video range: black is 16
+    double bright_mean = 230.0;
+    double min_contrast = 6.0;
+    double min_sharpness = 0.0;  // 0 = off; depends on the scene and resolution
+    double motion_threshold = 6.0;
+    double min_motion = 0.0;     // fraction of moving blocks; 0 = off
+    double scene_change = 0.6;   // fraction of moving blocks
+    std::vector<std::string> drop;
+
+    static QualityOptions from_json(const json::Value& v) {
+        QualityOptions o;
+        o.dark_mean = v.number_or("dark_mean", o.dark_mean);
+        o.bright_mean = v.number_or("bright_mean", o.bright_mean);
+        o.min_contrast = v.number_or("min_contrast", o.min_contrast);
+        o.min_sharpness = v.number_or("min_sharpness", o.min_sharpness);
+        o.motion_threshold = v.number_or("motion_threshold", o.motion_threshold);
+        o.min_motion = v.number_or("min_motion", o.min_motion);
+        o.scene_change = v.number_or("scene_change", o.scene_change);
+        const json::Value& drop = v.get("drop");
+        if (drop.is_array()) {
+            static const char* known[] = {"dark", "bright", "flat", "blurred", "scene_change", "static"};
+            for (const auto& d : drop.as_array()) {
+                const std::string& issue = d.as_string();
+                if (std::find_if(std::begin(known), std::end(known), [&](const char* k) { return issue == k; }) ==
+                    std::end(known))
+                    throw std::runtime_error("unknown quality issue '" + issue + "'");
+                o.drop.push_back(issue);
+            }
+        }
+        return o;
+    }
+};
+
+struct FrameQuality {
+    LumaStats stats;
+    double motion = -1.0;  // no previous frame yet
+    std::vector<const char*> issues;
+
+    json::Value to_json() const {
+        auto round = [](double v, double scale) { return std::round(v * scale) / scale; };
+        json::Value q = json::Value::object();
+        q["mean"] = round(stats.mean, 10);
+        q["contrast"] = round(stats.contrast, 10);
+        q["sharpness"] = round(stats.sharpness, 10);
+        if (motion >= 0) q["motion"] = round(motion, 1000);
+        json::Value issues_json = json::Value::array();
+        for (const char* i : issues) issues_json.push_back(i);
+        q["issues"] = std::move(issues_json);
+        return q;
+    }
+};
+
+// Per-camera analyzer; keeps the previous frame's block grid for motion.
+class LumaAnalyzer {
+public:
+    explicit LumaAnalyzer(QualityOptions opt) : opt_(std::move(opt)) {}
+
+    FrameQuality analyze(const FrameView& frame, const Rect& area) {
+        if (frame.format == PixelFormat::BGR) throw std::runtime_error("quality checks need an i420 or nv12 frame");
+        FrameQuality q;
+        q.stats = luma_stats(frame.planes[0], frame.strides[0], area, blocks_);
+        const LumaStats& s = q.stats;
+        if (s.mean < opt_.dark_mean) q.issues.push_back("dark");
+        if (s.mean > opt_.bright_mean) q.issues.push_back("bright");
+        if (s.contrast < opt_.min_contrast) q.issues.push_back("flat");
+        if (opt_.min_sharpness > 0 && s.sharpness < opt_.min_sharpness) q.issues.push_back("blurred");
+        if (area.w == prev_w_ && area.h == prev_h_) {
+            q.motion = block_motion(blocks_, prev_, opt_.motion_threshold);
+            if (q.motion >= opt_.scene_change) q.issues.push_back("scene_change");
+            else if (q.motion < opt_.min_motion) q.issues.push_back("static");
+        }
+        prev_.swap(blocks_);
+        prev_w_ = area.w;
+        prev_h_ = area.h;
+        return q;
+    }
+
+    bool should_drop(const FrameQuality& q) const {
+        for (const char* issue : q.issues)
+            if (std::find(opt_.drop.begin(), opt_.drop.end(), issue) != opt_.drop.end()) return true;
+        return false;
+    }
+
+private:
+    QualityOptions opt_;
+    std::vector<uint16_t> blocks_, prev_;
+    int prev_w_ = 0, prev_h_ = 0;
+};
+
+}  // namespace camel
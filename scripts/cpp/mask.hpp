@@ -0,0 +1,273 @@
+// Irreversible masking of frame regions (privacy): box blur or pixelation,
+// in place on the YUV planes (or the channels of a BGR frame).
+//
+// The blur is a separable running-sum box filter applied `passes` times
+// (two passes give a tent, three are close to a Gaussian). Horizontally it
+// works on a SIMD prefix sum of the edge-replicated row; vertically it keeps
+// one running sum per column and streams rows, so both passes are a few
+// 16-bit vector ops per pixel independent of the radius.
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "frame.hpp"
+#include "preprocess.hpp"
+#include "yuv.hpp"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define CAMEL_MASK_AVX2 1
+#endif
+
+namespace camel {
+
+enum class MaskMode { Blur, Pixelate };
+
+inline MaskMode parse_mask_mode(const std::string& s) {
+    if (s == "blur") return MaskMode::Blur;
+    if (s == "pixelate") return MaskMode::Pixelate;
+    throw std::runtime_error("unknown mask mode '" + s + "' (blur, pixelate)");
+}
+
+struct MaskOptions {
+    MaskMode mode = MaskMode::Blur;
+    int radius = 0;          // blur radius in luma pixels; 0 = from the box size
+    int block = 0;           // pixelation block in luma pixels; 0 = from the box size
+    float strength = 0.15f;  // automatic radius / block as a fraction of the shorter box side
+    int passes = 2;
+
+    static constexpr int kMaxRadius = 63;  // keeps window sums in 16 bits
+    static constexpr int kMaxBlock = 128;
+
+    int radius_for(const Rect& r) const {
+        int v = radius > 0 ? radius : static_cast<int>(std::min(r.w, r.h) * strength);
+        return std::clamp(v, 2, kMaxRadius);
+    }
+    int block_for(const Rect& r) const {
+        int v = block > 0 ? block : static_cast<int>(std::min(r.w, r.h) * strength);
+        return std::clamp(v, 4, kMaxBlock);
+    }
+};
+
+namespace detail {
+
+// Window of k samples: round(sum / k) as ((sum + k/2) * m) >> 16.
+struct BoxDivisor {
+    uint16_t half;
+    uint16_t mul;
+    explicit BoxDivisor(int k) : half(static_cast<uint16_t>(k / 2)), mul(static_cast<uint16_t>((65536 + k - 1) / k)) {}
+    uint8_t apply(uint32_t sum) const { return static_cast<uint8_t>(((sum + half) * mul) >> 16); }
+};
+
+// Horizontal box filter of one row. prefix[i] holds the sum of
+// the first i padded samples modulo 2^16; window differences are exact
+// because a window sum never exceeds 16 bits.
+inline void box_blur_row(const uint8_t* row, uint8_t* out, int n, int r, const BoxDivisor& div,
+                         std::vector<uint8_t>& pad, std::vector<uint16_t>& prefix) {
+    const int padded = n + 2 * r;
+    pad.resize(padded + 32);
+    prefix.resize(padded + 33);
+    std::memset(pad.data(), row[0], r);
+    std::memcpy(pad.data() + r, row, n);
+    std::memset(pad.data() + r + n, row[n - 1], r);
+    prefix[0] = 0;
+    int i = 0;
+#ifdef CAMEL_MASK_AVX2
+    const __m256i last = _mm256_set1_epi16(0x0f0e);
+    __m256i carry = _mm256_setzero_si256();
+    for (; i + 16 <= padded; i += 16) {
+        __m256i v = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pad.data() + i)));
+        v = _mm256_add_epi16(v, _mm256_slli_si256(v, 2));
+        v = _mm256_add_epi16(v, _mm256_slli_si256(v, 4));
+        v = _mm256_add_epi16(v, _mm256_slli_si256(v, 8));
+        // Inclusive scan per 128-bit lane; add the low lane's total to the high lane.
+        v = _mm256_add_epi16(v, _mm256_shuffle_epi8(_mm256_permute2x128_si256(v, v, 0x08), last));
+        v = _mm256_add_epi16(v, carry);
+        carry = _mm256_permute4x64_epi64(_mm256_shuffle_epi8(v, last), 0xff);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(prefix.data() + i + 1), v);
+    }
+#endif
+    for (; i < padded; ++i) prefix[i + 1] = static_cast<uint16_t>(prefix[i] + pad[i]);
+
+    const int k = 2 * r + 1;
+    int x = 0;
+#ifdef CAMEL_MASK_AVX2
+    const __m256i half = _mm256_set1_epi16(static_cast<int16_t>(div.half));
+    const __m256i mul = _mm256_set1_epi16(static_cast<int16_t>(div.mul));
+    for (; x + 16 <= n; x += 16) {
+        __m256i hi = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(prefix.data() + x + k));
+        __m256i lo = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(prefix.data() + x));
+        __m256i v = _mm256_mulhi_epu16(_mm256_add_epi16(_mm256_sub_epi16(hi, lo), half), mul);
+        v = _mm256_permute4x64_epi64(_mm256_packus_epi16(v, v), 0xd8);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + x), _mm256_castsi256_si128(v));
+    }
+#endif
+    for (; x < n; ++x) out[x] = div.apply(static_cast<uint16_t>(prefix[x + k] - prefix[x]));
+}
+
+// Vertical box filter from `src` (w x h, stride `sstride`) into the plane.
+// One running 16-bit sum per column, updated as rows stream by.
+inline void box_blur_columns(const uint8_t* in, int sstride, uint8_t* plane, int stride, int w, int h, int r,
+                             const BoxDivisor& div, std::vector<uint16_t>& sums) {
+    auto src = [&](int y) { return in + static_cast<size_t>(std::clamp(y, 0, h - 1)) * sstride; };
+
+    sums.assign(w + 16, 0);
+    for (int j = -r; j <= r; ++j) {
+        const uint8_t* s = src(j);
+        int x = 0;
+#ifdef CAMEL_MASK_AVX2
+        for (; x + 16 <= w; x += 16) {
+            __m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(sums.data() + x));
+            __m256i v = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(s + x)));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(sums.data() + x), _mm256_add_epi16(c, v));
+        }
+#endif
+        for (; x < w; ++x) sums[x] = static_cast<uint16_t>(sums[x] + s[x]);
+    }
+    for (int y = 0; y < h; ++y) {
+        uint8_t* out = plane + static_cast<size_t>(y) * stride;
+        const uint8_t* add = src(y + r + 1);
+        const uint8_t* sub = src(y - r);
+        int x = 0;
+#ifdef CAMEL_MASK_AVX2
+        const __m256i half = _mm256_set1_epi16(static_cast<int16_t>(div.half));
+        const __m256i mul = _mm256_set1_epi16(static_cast<int16_t>(div.mul));
+        for (; x + 16 <= w; x += 16) {
+            __m256i s = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(sums.data() + x));
+            __m256i v = _mm256_mulhi_epu16(_mm256_add_epi16(s, half), mul);
+            v = _mm256_permute4x64_epi64(_mm256_packus_epi16(v, v), 0xd8);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + x), _mm256_castsi256_si128(v));
+            __m256i a = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(add + x)));
+            __m256i b = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(sub + x)));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(sums.data() + x), _mm256_sub_epi16(_mm256_add_epi16(s, a), b));
+        }
+#endif
+        for (; x < w; ++x) {
+            out[x] = div.apply(sums[x]);
+            sums[x] = static_cast<uint16_t>(sums[x] + add[x] - sub[x]);
+        }
+    }
+}
+
+inline void blur_plane(uint8_t* plane, int stride, int w, int h, int r, int passes) {
+    thread_local std::vector<uint8_t> pad, rows;
+    thread_local std::vector<uint16_t> prefix, sums;
+    r = std::min({r, w - 1, h - 1});
+    if (r < 1) return;
+    const BoxDivisor div(2 * r + 1);
+    const int rstride = (w + 31) & ~31;
+    rows.resize(static_cast<size_t>(rstride) * h);
+    // Horizontal pass into a scratch region, vertical pass back into the frame.
+    for (int p = 0; p < passes; ++p) {
+        for (int y = 0; y < h; ++y)
+            box_blur_row(plane + static_cast<size_t>(y) * stride, rows.data() + static_cast<size_t>(y) * rstride, w, r,
+                         div, pad, prefix);
+        box_blur_columns(rows.data(), rstride, plane, stride, w, h, r, div, sums);
+    }
+}
+
+// Replaces each block x block cell with its mean. Column sums of a block
+// row are accumulated with 16-bit vector adds.
+inline void pixelate_plane(uint8_t* plane, int stride, int w, int h, int block) {
+    thread_local std::vector<uint16_t> cols;
+    cols.resize(w + 16);
+    for (int y0 = 0; y0 < h; y0 += block) {
+        const int bh = std::min(block, h - y0);
+        std::fill(cols.begin(), cols.end(), 0);
+        for (int y = y0; y < y0 + bh; ++y) {
+            const uint8_t* row = plane + static_cast<size_t>(y) * stride;
+            int x = 0;
+#ifdef CAMEL_MASK_AVX2
+            for (; x + 16 <= w; x += 16) {
+                __m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(cols.data() + x));
+                __m256i v = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(row + x)));
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(cols.data() + x), _mm256_add_epi16(c, v));
+            }
+#endif
+            for (; x < w; ++x) cols[x] = static_cast<uint16_t>(cols[x] + row[x]);
+        }
+        for (int x0 = 0; x0 < w; x0 += block) {
+            const int bw = std::min(block, w - x0);
+            uint32_t sum = 0;
+            for (int x = x0; x < x0 + bw; ++x) sum += cols[x];
+            const uint32_t n = static_cast<uint32_t>(bw * bh);
+            const uint8_t mean = static_cast<uint8_t>((sum + n / 2) / n);
+            for (int y = y0; y < y0 + bh; ++y) std::memset(plane + static_cast<size_t>(y) * stride + x0, mean, bw);
+        }
+    }
+}
+
+inline void mask_plane(uint8_t* plane, int stride, int w, int h, const MaskOptions& o, int radius, int block) {
+    if (w <= 0 || h <= 0) return;
+    if (o.mode == MaskMode::Blur) blur_plane(plane, stride, w, h, radius, o.passes);
+    else pixelate_plane(plane, stride, w, h, block);
+}
+
+}  // namespace detail
+
+// Masks `r` of a packed BGR frame: each channel is masked in a planar copy
+// and written back.
+inline void mask_region_bgr(FrameView& f, Rect r, const MaskOptions& o) {
+    const int x0 = std::max(0, r.x), y0 = std::max(0, r.y);
+    const int x1 = std::min(f.width, r.x + r.w), y1 = std::min(f.height, r.y + r.h);
+    if (x1 - x0 < 2 || y1 - y0 < 2) return;
+    r = {x0, y0, x1 - x0, y1 - y0};
+    const int radius = o.radius_for(r), block = o.block_for(r);
+    thread_local std::vector<uint8_t> plane;
+    const int s = (r.w + 31) & ~31;
+    plane.resize(static_cast<size_t>(s) * r.h + 32);
+    for (int c = 0; c < 3; ++c) {
+        for (int y = 0; y < r.h; ++y) {
+            const uint8_t* src = f.planes[0] + static_cast<size_t>(r.y + y) * f.strides[0] + 3 * r.x + c;
+            uint8_t* dst = plane.data() + static_cast<size_t>(y) * s;
+            for (int x = 0; x < r.w; ++x) dst[x] = src[3 * x];
+        }
+        detail::mask_plane(plane.data(), s, r.w, r.h, o, radius, block);
+        for (int y = 0; y < r.h; ++y) {
+            const uint8_t* src = plane.data() + static_cast<size_t>(y) * s;
+            uint8_t* dst = f.planes[0] + static_cast<size_t>(r.y + y) * f.strides[0] + 3 * r.x + c;
+            for (int x = 0; x < r.w; ++x) dst[3 * x] = src[x];
+        }
+    }
+}
+
+// Masks `r` (pixels, grown to even bounds) of a frame in place. For YUV
+// 4:2:0, chroma is masked with half the radius / block so both planes
+// cover the same area.
+inline void mask_region(FrameView& f, Rect r, const MaskOptions& o) {
+    if (f.format == PixelFormat::BGR) return mask_region_bgr(f, r, o);
+    int x0 = std::max(0, r.x) & ~1, y0 = std::max(0, r.y) & ~1;
+    int x1 = std::min(f.width & ~1, (r.x + r.w + 1) & ~1), y1 = std::min(f.height & ~1, (r.y + r.h + 1) & ~1);
+    if (x1 - x0 < 2 || y1 - y0 < 2) return;
+    r = {x0, y0, x1 - x0, y1 - y0};
+    const int radius = o.radius_for(r), block = o.block_for(r);
+    detail::mask_plane(f.planes[0] + static_cast<size_t>(r.y) * f.strides[0] + r.x, f.strides[0], r.w, r.h, o, radius, block);
+
+    const int cx = r.x / 2, cy = r.y / 2, cw = r.w / 2, ch = r.h / 2;
+    const int cradius = std::max(1, radius / 2), cblock = std::max(2, block / 2);
+    if (f.format == PixelFormat::I420) {
+        for (int p = 1; p <= 2; ++p)
+            detail::mask_plane(f.planes[p] + static_cast<size_t>(cy) * f.strides[p] + cx, f.strides[p], cw, ch, o, cradius, cblock);
+        return;
+    }
+    // NV12: mask deinterleaved copies of U and V, then write them back.
+    thread_local std::vector<uint8_t> u, v;
+    const int s = (cw + 31) & ~31;
+    u.resize(static_cast<size_t>(s) * ch + 32);
+    v.resize(u.size());
+    for (int y = 0; y < ch; ++y)
+        detail::deinterleave_row(f.planes[1] + static_cast<size_t>(cy + y) * f.strides[1] + 2 * cx,
+                                 u.data() + static_cast<size_t>(y) * s, v.data() + static_cast<size_t>(y) * s, cw);
+    detail::mask_plane(u.data(), s, cw, ch, o, cradius, cblock);
+    detail::mask_plane(v.data(), s, cw, ch, o, cradius, cblock);
+    for (int y = 0; y < ch; ++y)
+        detail::interleave_row(u.data() + static_cast<size_t>(y) * s, v.data() + static_cast<size_t>(y) * s,
+                               f.planes[1] + static_cast<size_t>(cy + y) * f.strides[1] + 2 * cx, cw);
+}
+
+}  // namespace camel
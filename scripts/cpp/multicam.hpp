@@ -0,0 +1,151 @@
+// Cross-camera association of detections in synchronized frames.
+//
+// Cameras with overlapping views see the same person at the same instant.
+// Every camera of a group is calibrated with the same four ground-plane
+// points (the corners of a doormat, a parking bay), given as fractions of
+// its frame. The homography between two cameras' point sets maps where an
+// object stands in one view (the bottom center of its box) to where it
+// stands in the other. Detections of the same class whose ground points
+// land within `match_distance` box heights of each other are one object.
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <map>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "json.hpp"
+
+namespace camel {
+
+struct Point2 {
+    double x = 0.0;
+    double y = 0.0;
+};
+
+class Homography {
+public:
+    // Maps src[i] onto dst[i] for four point pairs, no three collinear.
+    static Homography from_points(const std::array<Point2, 4>& src, const std::array<Point2, 4>& dst) {
+        // h33 = 1; two equations per pair in the other eight unknowns.
+        double a[8][9];
+        for (int i = 0; i < 4; ++i) {
+            const double x = src[i].x, y = src[i].y, u = dst[i].x, v = dst[i].y;
+            const double r0[9] = {x, y, 1, 0, 0, 0, -x * u, -y * u, u};
+            const double r1[9] = {0, 0, 0, x, y, 1, -x * v, -y * v, v};
+            std::copy(r0, r0 + 9, a[2 * i]);
+            std::copy(r1, r1 + 9, a[2 * i + 1]);
+        }
+        for (int col = 0; col < 8; ++col) {
+            int pivot = col;
+            for (int r = col + 1; r < 8; ++r)
+                if (std::fabs(a[r][col]) > std::fabs(a[pivot][col])) pivot = r;
+            if (std::fabs(a[pivot][col]) < 1e-12) throw std::runtime_error("ground points are degenerate");
+            std::swap(a[col], a[pivot]);
+            for (int r = 0; r < 8; ++r) {
+                if (r == col) continue;
+                const double f = a[r][col] / a[col][col];
+                for (int k = col; k < 9; ++k) a[r][k] -= f * a[col][k];
+            }
+        }
+        Homography h;
+        for (int i = 0; i < 8; ++i) h.m_[i] = a[i][8] / a[i][i];
+        h.m_[8] = 1.0;
+        return h;
+    }
+
+    Point2 apply(const Point2& p) const {
+        const double w = m_[6] * p.x + m_[7] * p.y + m_[8];
+        return {(m_[0] * p.x + m_[1] * p.y + m_[2]) / w, (m_[3] * p.x + m_[4] * p.y + m_[5]) / w};
+    }
+
+private:
+    double m_[9] = {1, 0, 0, 0, 1, 0, 0, 0, 1};
+};
+
+// "ground_points": {"front_door": [[0.41, 0.83], [0.58, 0.83], [0.62, 0.97], [0.37, 0.97]],
+//                   "driveway":   [[0.12, 0.40], [0.21, 0.38], [0.25, 0.47], [0.14, 0.49]]}
+class GroundCalibration {
+public:
+    static GroundCalibration from_json(const json::Value& v) {
+        GroundCalibration c;
+        if (!v.is_object()) return c;
+        for (const auto& [camera, pts] : v.as_object()) {
+            if (!pts.is_array() || pts.size() != 4)
+                throw std::runtime_error("ground_points." + camera + " needs four [x, y] points");
+            std::array<Point2, 4> p;
+            for (size_t i = 0; i < 4; ++i) p[i] = {pts[i][0].as_number(), pts[i][1].as_number()};
+            c.points_[camera] = p;
+        }
+        // Validate every pair up front rather than on the first shared sighting.
+        for (const auto& a : c.points_)
+            for (const auto& b : c.points_)
+                if (a.first != b.first) c.mapping(a.first, b.first);
+        return c;
+    }
+
+    // Maps frame fractions of camera `from` to those of `to`; null when
+    // either camera is not calibrated.
+    const Homography* mapping(const std::string& from, const std::string& to) const {
+        auto key = std::make_pair(from, to);
+        auto cached = cache_.find(key);
+        if (cached != cache_.end()) return &cached->second;
+        auto a = points_.find(from), b = points_.find(to);
+        if (a == points_.end() || b == points_.end()) return nullptr;
+        return &cache_.emplace(key, Homography::from_points(a->second, b->second)).first->second;
+    }
+
+private:
+    std::map<std::string, std::array<Point2, 4>> points_;
+    mutable std::map<std::pair<std::string, std::string>, Homography> cache_;
+};
+
+struct ViewDetection {
+    size_t camera = 0;  // index into the tuple
+    std::string label;
+    float score = 0.0f;
+    Point2 foot;              // bottom center of the box, frame fractions
+    double frame_w = 0.0, frame_h = 0.0;
+    double height = 0.0;      // box height, pixels
+};
+
+// For every detection, the index of the detection kept for its object
+// (itself if it is kept). Highest scores claim first, and an object takes
+// at most one detection per camera. `maps[a][b]` maps camera a to camera b
+// (null: the pair is never matched).
+inline std::vector<size_t> associate_views(const std::vector<ViewDetection>& dets,
+                                           const std::vector<std::vector<const Homography*>>& maps,
+                                           double match_distance) {
+    std::vector<size_t> order(dets.size()), owner(dets.size(), dets.size());
+    std::iota(order.begin(), order.end(), size_t{0});
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return dets[a].score > dets[b].score; });
+    for (size_t i : order) {
+        if (owner[i] != dets.size()) continue;
+        owner[i] = i;
+        const ViewDetection& d = dets[i];
+        std::vector<size_t> best(maps.size(), dets.size());
+        std::vector<double> best_dist(maps.size(), match_distance);
+        for (size_t j = 0; j < dets.size(); ++j) {
+            const ViewDetection& e = dets[j];
+            if (owner[j] != dets.size() || e.camera == d.camera || e.label != d.label) continue;
+            const Homography* h = maps[d.camera][e.camera];
+            if (!h) continue;
+            const Point2 q = h->apply(d.foot);
+            const double dist = std::hypot((q.x - e.foot.x) * e.frame_w, (q.y - e.foot.y) * e.frame_h) /
+                                std::max(e.height, 1.0);
+            if (dist < best_dist[e.camera]) {
+                best_dist[e.camera] = dist;
+                best[e.camera] = j;
+            }
+        }
+        for (size_t j : best)
+            if (j != dets.size()) owner[j] = i;
+    }
+    return owner;
+}
+
+}  // namespace camel
@@ -0,0 +1,83 @@
+// Detection boxes and greedy non-maximum suppression.
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <numeric>
+#include <vector>
+
+namespace camel {
+
+struct Box {
+    float x1 = 0.0f;
+    float y1 = 0.0f;
+    float x2 = 0.0f;
+    float y2 = 0.0f;
+
+    float width() const { return x2 - x1; }
+    float height() const { return y2 - y1; }
+    float area() const { return std::max(0.0f, x2 - x1) * std::max(0.0f, y2 - y1); }
+    float center_x() const { return 0.5f * (x1 + x2); }
+    float center_y() const { return 0.5f * (y1 + y2); }
+};
+
+struct Detection {
+    Box box;
+    float score = 0.0f;
+    int class_id = 0;
+};
+
+inline float intersection_area(const Box& a, const Box& b) {
+    float w = std::min(a.x2, b.x2) - std::max(a.x1, b.x1);
+    float h = std::min(a.y2, b.y2) - std::max(a.y1, b.y1);
+    return w > 0.0f && h > 0.0f ? w * h : 0.0f;
+}
+
+inline float iou(const Box& a, const Box& b) {
+    float inter = intersection_area(a, b);
+    float uni = a.area() + b.area() - inter;
+    return uni > 0.0f ? inter / uni : 0.0f;
+}
+
+struct NmsOptions {
+    float iou_threshold = 0.45f;
+    bool class_aware = true;
+    size_t max_detections = 300;
+};
+
+// Greedy NMS: keeps the highest-scoring box and suppresses overlapping boxes
+// (of the same class when class_aware). Returns survivor indices by
+// descending score.
+inline std::vector<uint32_t> nms_indices(const std::vector<Detection>& dets, const NmsOptions& opt = {}) {
+    std::vector<uint32_t> order(dets.size());
+    std::iota(order.begin(), order.end(), 0u);
+    std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return dets[a].score > dets[b].score; });
+
+    std::vector<uint32_t> kept;
+    std::vector<uint8_t> suppressed(dets.size(), 0);
+    for (size_t i = 0; i < order.size() && kept.size() < opt.max_detections; ++i) {
+        uint32_t a = order[i];
+        if (suppressed[a]) continue;
+        kept.push_back(a);
+        const Box& ba = dets[a].box;
+        float area_a = ba.area();
+        for (size_t j = i + 1; j < order.size(); ++j) {
+            uint32_t b = order[j];
+            if (suppressed[b]) continue;
+            if (opt.class_aware && dets[b].class_id != dets[a].class_id) continue;
+            float inter = intersection_area(ba, dets[b].box);
+            if (inter <= 0.0f) continue;
+            float uni = area_a + dets[b].box.area() - inter;
+            if (uni > 0.0f && inter > opt.iou_threshold * uni) suppressed[b] = 1;
+        }
+    }
+    return kept;
+}
+
+inline std::vector<Detection> nms(const std::vector<Detection>& dets, const NmsOptions& opt = {}) {
+    std::vector<Detection> kept;
+    for (uint32_t i : nms_indices(dets, opt)) kept.push_back(dets[i]);
+    return kept;
+}
+
+}  // namespace camel
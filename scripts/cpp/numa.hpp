@@ -0,0 +1,74 @@
+// NUMA topology and placement from sysfs and raw syscalls, so nodes
+// without libnuma build and run the same code (as a single node).
+#pragma once
+
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace camel {
+
+// "0-3,8-11" -> {0, 1, 2, 3, 8, 9, 10, 11}
+inline std::vector<int> parse_cpu_list(const std::string& s) {
+    std::vector<int> cpus;
+    std::stringstream ss(s);
+    for (std::string part; std::getline(ss, part, ',');) {
+        if (part.empty() || part == "\n") continue;
+        size_t dash = part.find('-');
+        int lo = std::stoi(part.substr(0, dash));
+        int hi = dash == std::string::npos ? lo : std::stoi(part.substr(dash + 1));
+        for (int c = lo; c <= hi; ++c) cpus.push_back(c);
+    }
+    return cpus;
+}
+
+inline int numa_node_count() {
+    int n = 0;
+    while (std::ifstream("/sys/devices/system/node/node" + std::to_string(n) + "/cpulist")) ++n;
+    return n > 0 ? n : 1;
+}
+
+// CPUs of `node`; all online CPUs when the topology is unavailable.
+inline std::vector<int> numa_node_cpus(int node) {
+    std::ifstream in("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+    std::string line;
+    if (in && std::getline(in, line)) {
+        std::vector<int> cpus = parse_cpu_list(line);
+        if (!cpus.empty()) return cpus;
+    }
+    std::vector<int> all;
+    for (long c = 0, n = sysconf(_SC_NPROCESSORS_ONLN); c < n; ++c) all.push_back(static_cast<int>(c));
+    return all;
+}
+
+inline int numa_current_node() {
+    unsigned cpu = 0, node = 0;
+    if (syscall(SYS_getcpu, &cpu, &node, nullptr) != 0) return 0;
+    return static_cast<int>(node);
+}
+
+// Binds a page-aligned mapping to `node` and migrates pages already
+// touched (MPOL_BIND, MPOL_MF_MOVE). False if the kernel refused, e.g. on
+// a non-NUMA build; callers treat placement as best effort.
+inline bool numa_bind_memory(void* addr, size_t bytes, int node) {
+#ifdef SYS_mbind
+    constexpr int kMpolBind = 2;
+    constexpr unsigned kMpolMfMove = 1u << 1;
+    if (node < 0 || node >= 64) return false;
+    unsigned long mask = 1ul << node;
+    return syscall(SYS_mbind, addr, bytes, kMpolBind, &mask, 64 + 1, kMpolMfMove) == 0;
+#else
+    (void)addr;
+    (void)bytes;
+    (void)node;
+    return false;
+#endif
+}
+
+}  // namespace camel
@@ -0,0 +1,437 @@
+// Fused detector-input preprocessing: crop, letterbox resize, color
+// conversion (BGR or YUV420 to RGB), normalization and NCHW layout in a
+// single pass over the source frame.
+//
+// Each output row is produced from two vertically blended source rows kept
+// in a small float row cache; the horizontal bilinear step gathers from that
+// cache with precomputed indices and writes straight into the three output
+// planes. There are no intermediate full-size images.
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#if defined(__AVX2__) && defined(__FMA__)
+#include <immintrin.h>
+#define CAMEL_PREPROCESS_AVX2 1
+#endif
+
+#include "frame.hpp"
+
+namespace camel {
+
+enum class TensorType { Float32, Int8, UInt8 };
+
+inline TensorType parse_tensor_type(const std::string& s) {
+    if (s == "float32" || s == "fp32") return TensorType::Float32;
+    if (s == "int8") return TensorType::Int8;
+    if (s == "uint8") return TensorType::UInt8;
+    throw std::runtime_error("unsupported tensor type '" + s + "'");
+}
+
+inline const char* tensor_type_name(TensorType t) {
+    switch (t) {
+        case TensorType::Float32: return "float32";
+        case TensorType::Int8: return "int8";
+        case TensorType::UInt8: return "uint8";
+    }
+    return "unknown";
+}
+
+inline size_t tensor_element_size(TensorType t) { return t == TensorType::Float32 ? 4 : 1; }
+
+struct Rect {
+    int x = 0;
+    int y = 0;
+    int w = 0;
+    int h = 0;
+};
+
+// Affine quantization of the normalized [0, 1] input: q = round(v / scale) + zero_point.
+struct TensorQuant {
+    float scale = 1.0f / 255.0f;
+    int zero_point = 0;
+
+    bool operator==(const TensorQuant& o) const {
+        return zero_point == o.zero_point && std::fabs(scale - o.scale) <= 1e-6f * o.scale;
+    }
+    bool operator!=(const TensorQuant& o) const { return !(*this == o); }
+};
+
+// Quantization that maps [0, 1] onto the full range of the type: uint8
+// 0..255, int8 -128..127.
+inline TensorQuant default_quant(TensorType t) {
+    TensorQuant q;
+    if (t == TensorType::Int8) q.zero_point = -128;
+    return q;
+}
+
+struct LetterboxOptions {
+    int width = 640;
+    int height = 640;
+    uint8_t pad_value = 114;
+    TensorType type = TensorType::Float32;
+    TensorQuant quant;
+};
+
+// Maps tensor coordinates back to the full source frame:
+//   frame_x = (tensor_x - pad_x) / scale + offset_x
+struct LetterboxTransform {
+    float scale = 1.0f;
+    float pad_x = 0.0f;
+    float pad_y = 0.0f;
+    int offset_x = 0;
+    int offset_y = 0;
+
+    json::Value to_json() const {
+        json::Value v = json::Value::object();
+        v["scale"] = scale;
+        v["pad_x"] = pad_x;
+        v["pad_y"] = pad_y;
+        v["offset_x"] = offset_x;
+        v["offset_y"] = offset_y;
+        return v;
+    }
+
+    static LetterboxTransform from_json(const json::Value& v) {
+        LetterboxTransform t;
+        t.scale = static_cast<float>(v.number_or("scale", 1.0));
+        t.pad_x = static_cast<float>(v.number_or("pad_x", 0.0));
+        t.pad_y = static_cast<float>(v.number_or("pad_y", 0.0));
+        t.offset_x = static_cast<int>(v.number_or("offset_x", 0));
+        t.offset_y = static_cast<int>(v.number_or("offset_y", 0));
+        return t;
+    }
+};
+
+// Reusable letterbox kernel. Index tables and row caches are rebuilt only
+// when the source geometry changes, so one instance per thread amortizes
+// all allocation across frames of the same camera.
+class Letterboxer {
+public:
+    LetterboxTransform run(const FrameView& src, Rect crop, const LetterboxOptions& opt, void* out) {
+        crop = clamp_crop(src, crop);
+        prepare(src, crop, opt);
+        setup_output(opt);
+
+        const size_t plane = static_cast<size_t>(opt.width) * opt.height;
+        const size_t esize = tensor_element_size(opt.type);
+        uint8_t* base = static_cast<uint8_t*>(out);
+        uint8_t* planes[3] = {base, base + plane * esize, base + 2 * plane * esize};
+
+        for (int y = 0; y < opt.height; ++y) {
+            size_t row_off = static_cast<size_t>(y) * opt.width;
+            if (y < pad_y_ || y >= pad_y_ + new_h_) {
+                for (auto* p : planes) fill(p + row_off * esize, opt.width, opt.type);
+                continue;
+            }
+            for (auto* p : planes) {
+                fill(p + row_off * esize, pad_x_, opt.type);
+                fill(p + (row_off + pad_x_ + new_w_) * esize, opt.width - pad_x_ - new_w_, opt.type);
+            }
+            uint8_t* dst[3];
+            for (int c = 0; c < 3; ++c) dst[c] = planes[c] + (row_off + pad_x_) * esize;
+            int oy = y - pad_y_;
+            if (src.format == PixelFormat::BGR)
+                row_bgr(src, crop, oy, dst, opt.type);
+            else
+                row_yuv(src, crop, oy, dst, opt.type);
+        }
+
+        LetterboxTransform t;
+        t.scale = scale_;
+        t.pad_x = static_cast<float>(pad_x_);
+        t.pad_y = static_cast<float>(pad_y_);
+        t.offset_x = crop.x;
+        t.offset_y = crop.y;
+        return t;
+    }
+
+private:
+    static Rect clamp_crop(const FrameView& src, Rect c) {
+        if (c.w <= 0 || c.h <= 0) return {0, 0, src.width, src.height};
+        int x0 = std::clamp(c.x, 0, src.width - 1);
+        int y0 = std::clamp(c.y, 0, src.height - 1);
+        int x1 = std::clamp(c.x + c.w, x0 + 1, src.width);
+        int y1 = std::clamp(c.y + c.h, y0 + 1, src.height);
+        // Keep the crop origin on even coordinates so chroma stays aligned.
+        if (src.is_yuv()) {
+            x0 &= ~1;
+            y0 &= ~1;
+        }
+        return {x0, y0, x1 - x0, y1 - y0};
+    }
+
+    // Source sample position for output index i (half-pixel centers, as in
+    // cv::resize INTER_LINEAR), clamped to [0, n - 1].
+    static float source_coord(int i, float inv_scale, int n) {
+        float f = (static_cast<float>(i) + 0.5f) * inv_scale - 0.5f;
+        return std::clamp(f, 0.0f, static_cast<float>(n - 1));
+    }
+
+    static float chroma_coord(float luma, int n) {
+        float f = (luma + 0.5f) * 0.5f - 0.5f;
+        return std::clamp(f, 0.0f, static_cast<float>(n - 1));
+    }
+
+    void prepare(const FrameView& src, const Rect& crop, const LetterboxOptions& opt) {
+        scale_ = std::min(static_cast<float>(opt.width) / crop.w, static_cast<float>(opt.height) / crop.h);
+        new_w_ = std::clamp(static_cast<int>(std::lround(crop.w * scale_)), 1, opt.width);
+        new_h_ = std::clamp(static_cast<int>(std::lround(crop.h * scale_)), 1, opt.height);
+        pad_x_ = (opt.width - new_w_) / 2;
+        pad_y_ = (opt.height - new_h_) / 2;
+        inv_scale_ = 1.0f / scale_;
+
+        bool same = src.format == cached_format_ && src.width == cached_w_ && src.height == cached_h_ &&
+                    crop.x == cached_crop_.x && crop.y == cached_crop_.y && crop.w == cached_crop_.w &&
+                    crop.h == cached_crop_.h && new_w_ == cached_new_w_;
+        if (same) return;
+        cached_format_ = src.format;
+        cached_w_ = src.width;
+        cached_h_ = src.height;
+        cached_crop_ = crop;
+        cached_new_w_ = new_w_;
+
+        int n = new_w_;
+        x0_.assign(n, 0);
+        x1_.assign(n, 0);
+        wx_.assign(n, 0.0f);
+        int elem = src.format == PixelFormat::BGR ? 3 : 1;
+        for (int x = 0; x < n; ++x) {
+            float f = source_coord(x, inv_scale_, crop.w);
+            int i0 = static_cast<int>(f);
+            int i1 = std::min(i0 + 1, crop.w - 1);
+            x0_[x] = i0 * elem;
+            x1_[x] = i1 * elem;
+            wx_[x] = f - static_cast<float>(i0);
+        }
+        row_.assign(static_cast<size_t>(crop.w) * elem + 8, 0.0f);
+
+        if (src.is_yuv()) {
+            int cw = (src.width + 1) / 2;
+            chroma_begin_ = crop.x / 2;
+            int chroma_end = std::min(cw, (crop.x + crop.w + 1) / 2 + 1);
+            int span = chroma_end - chroma_begin_;
+            int cstride = src.format == PixelFormat::NV12 ? 2 : 1;
+            cx0_.assign(n, 0);
+            cx1_.assign(n, 0);
+            cwx_.assign(n, 0.0f);
+            for (int x = 0; x < n; ++x) {
+                float lx = source_coord(x, inv_scale_, crop.w) + crop.x;
+                float f = chroma_coord(lx, cw) - chroma_begin_;
+                f = std::clamp(f, 0.0f, static_cast<float>(span - 1));
+                int i0 = static_cast<int>(f);
+                int i1 = std::min(i0 + 1, span - 1);
+                cx0_[x] = i0 * cstride;
+                cx1_[x] = i1 * cstride;
+                cwx_[x] = f - static_cast<float>(i0);
+            }
+            chroma_span_ = span;
+            crow_u_.assign(static_cast<size_t>(span) * cstride + 8, 0.0f);
+            crow_v_.assign(src.format == PixelFormat::I420 ? span + 8 : 8, 0.0f);
+        }
+    }
+
+    void setup_output(const LetterboxOptions& opt) {
+        if (opt.type == TensorType::Float32) {
+            out_mul_ = 1.0f / 255.0f;
+            out_add_ = 0.0f;
+        } else {
+            out_mul_ = 1.0f / (255.0f * opt.quant.scale);
+            out_add_ = static_cast<float>(opt.quant.zero_point);
+        }
+        if (opt.type == TensorType::Int8) {
+            out_min_ = -128.0f;
+            out_max_ = 127.0f;
+        } else {
+            out_min_ = 0.0f;
+            out_max_ = 255.0f;
+        }
+        float v = static_cast<float>(opt.pad_value) * out_mul_ + out_add_;
+        pad_f32_ = v;
+        pad_q_ = static_cast<int>(std::clamp(std::nearbyint(v), out_min_, out_max_));
+    }
+
+    void fill(uint8_t* dst, int count, TensorType type) const {
+        if (count <= 0) return;
+        if (type == TensorType::Float32)
+            std::fill_n(reinterpret_cast<float*>(dst), count, pad_f32_);
+        else
+            std::memset(dst, pad_q_, static_cast<size_t>(count));
+    }
+
+    // out[i] = r0[i] + wy * (r1[i] - r0[i])
+    static void vblend(const uint8_t* r0, const uint8_t* r1, float wy, float* out, int n) {
+        int i = 0;
+#ifdef CAMEL_PREPROCESS_AVX2
+        __m256 w = _mm256_set1_ps(wy);
+        for (; i + 8 <= n; i += 8) {
+            __m256 a = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(r0 + i))));
+            __m256 b = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(r1 + i))));
+            _mm256_storeu_ps(out + i, _mm256_fmadd_ps(w, _mm256_sub_ps(b, a), a));
+        }
+#endif
+        for (; i < n; ++i) {
+            float a = r0[i];
+            out[i] = a + wy * (static_cast<float>(r1[i]) - a);
+        }
+    }
+
+    // Vertical blend of one interleaved NV12 chroma row or one I420 plane row.
+    void vertical_rows(const FrameView& src, int plane, int begin, int count, float fy, float* out) const {
+        int y0 = static_cast<int>(fy);
+        int rows = plane == 0 ? src.height : (src.height + 1) / 2;
+        int y1 = std::min(y0 + 1, rows - 1);
+        const uint8_t* r0 = src.planes[plane] + static_cast<size_t>(y0) * src.strides[plane] + begin;
+        const uint8_t* r1 = src.planes[plane] + static_cast<size_t>(y1) * src.strides[plane] + begin;
+        vblend(r0, r1, fy - static_cast<float>(y0), out, count);
+    }
+
+    float source_row(const Rect& crop, int oy) const {
+        return source_coord(oy, inv_scale_, crop.h) + static_cast<float>(crop.y);
+    }
+
+    void row_bgr(const FrameView& src, const Rect& crop, int oy, uint8_t* dst[3], TensorType type) {
+        vertical_rows(src, 0, crop.x * 3, crop.w * 3, source_row(crop, oy), row_.data());
+        const float* rb = row_.data();
+        int x = 0;
+#ifdef CAMEL_PREPROCESS_AVX2
+        for (; x + 8 <= new_w_; x += 8) {
+            __m256i i0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&x0_[x]));
+            __m256i i1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&x1_[x]));
+            __m256 w = _mm256_loadu_ps(&wx_[x]);
+            __m256 ch[3];
+            for (int c = 0; c < 3; ++c) {
+                __m256 a = _mm256_i32gather_ps(rb + c, i0, 4);
+                __m256 b = _mm256_i32gather_ps(rb + c, i1, 4);
+                ch[c] = _mm256_fmadd_ps(w, _mm256_sub_ps(b, a), a);
+            }
+            // BGR source, RGB planes.
+            store8(ch[2], dst[0], x, type);
+            store8(ch[1], dst[1], x, type);
+            store8(ch[0], dst[2], x, type);
+        }
+#endif
+        for (; x < new_w_; ++x) {
+            float w = wx_[x];
+            float v[3];
+            for (int c = 0; c < 3; ++c) {
+                float a = rb[x0_[x] + c];
+                v[c] = a + w * (rb[x1_[x] + c] - a);
+            }
+            store1(v[2], dst[0], x, type);
+            store1(v[1], dst[1], x, type);
+            store1(v[0], dst[2], x, type);
+        }
+    }
+
+    void row_yuv(const FrameView& src, const Rect& crop, int oy, uint8_t* dst[3], TensorType type) {
+        float fy = source_row(crop, oy);
+        vertical_rows(src, 0, crop.x, crop.w, fy, row_.data());
+        int chroma_rows = (src.height + 1) / 2;
+        float fcy = chroma_coord(fy, chroma_rows);
+        const float* ub;
+        const float* vb;
+        if (src.format == PixelFormat::NV12) {
+            vertical_rows(src, 1, chroma_begin_ * 2, chroma_span_ * 2, fcy, crow_u_.data());
+            ub = crow_u_.data();
+            vb = crow_u_.data() + 1;
+        } else {
+            vertical_rows(src, 1, chroma_begin_, chroma_span_, fcy, crow_u_.data());
+            vertical_rows(src, 2, chroma_begin_, chroma_span_, fcy, crow_v_.data());
+            ub = crow_u_.data();
+            vb = crow_v_.data();
+        }
+        const float* yb = row_.data();
+        int x = 0;
+#ifdef CAMEL_PREPROCESS_AVX2
+        const __m256 k16 = _mm256_set1_ps(16.0f), k128 = _mm256_set1_ps(128.0f);
+        const __m256 ky = _mm256_set1_ps(1.164f), krv = _mm256_set1_ps(1.596f);
+        const __m256 kgu = _mm256_set1_ps(-0.392f), kgv = _mm256_set1_ps(-0.813f), kbu = _mm256_set1_ps(2.017f);
+        for (; x + 8 <= new_w_; x += 8) {
+            __m256i i0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&x0_[x]));
+            __m256i i1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&x1_[x]));
+            __m256i c0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&cx0_[x]));
+            __m256i c1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&cx1_[x]));
+            __m256 w = _mm256_loadu_ps(&wx_[x]);
+            __m256 cw = _mm256_loadu_ps(&cwx_[x]);
+            __m256 ya = _mm256_i32gather_ps(yb, i0, 4), yb1 = _mm256_i32gather_ps(yb, i1, 4);
+            __m256 ua = _mm256_i32gather_ps(ub, c0, 4), ub1 = _mm256_i32gather_ps(ub, c1, 4);
+            __m256 va = _mm256_i32gather_ps(vb, c0, 4), vb1 = _mm256_i32gather_ps(vb, c1, 4);
+            __m256 Y = _mm256_mul_ps(ky, _mm256_sub_ps(_mm256_fmadd_ps(w, _mm256_sub_ps(yb1, ya), ya), k16));
+            __m256 U = _mm256_sub_ps(_mm256_fmadd_ps(cw, _mm256_sub_ps(ub1, ua), ua), k128);
+            __m256 V = _mm256_sub_ps(_mm256_fmadd_ps(cw, _mm256_sub_ps(vb1, va), va), k128);
+            __m256 r = _mm256_fmadd_ps(krv, V, Y);
+            __m256 g = _mm256_fmadd_ps(kgv, V, _mm256_fmadd_ps(kgu, U, Y));
+            __m256 b = _mm256_fmadd_ps(kbu, U, Y);
+            store8(clamp255(r), dst[0], x, type);
+            store8(clamp255(g), dst[1], x, type);
+            store8(clamp255(b), dst[2], x, type);
+        }
+#endif
+        for (; x < new_w_; ++x) {
+            float w = wx_[x], cw = cwx_[x];
+            float ya = yb[x0_[x]], ua = ub[cx0_[x]], va = vb[cx0_[x]];
+            float Y = 1.164f * (ya + w * (yb[x1_[x]] - ya) - 16.0f);
+            float U = ua + cw * (ub[cx1_[x]] - ua) - 128.0f;
+            float V = va + cw * (vb[cx1_[x]] - va) - 128.0f;
+            store1(std::clamp(Y + 1.596f * V, 0.0f, 255.0f), dst[0], x, type);
+            store1(std::clamp(Y - 0.392f * U - 0.813f * V, 0.0f, 255.0f), dst[1], x, type);
+            store1(std::clamp(Y + 2.017f * U, 0.0f, 255.0f), dst[2], x, type);
+        }
+    }
+
+#ifdef CAMEL_PREPROCESS_AVX2
+    static __m256 clamp255(__m256 v) {
+        return _mm256_min_ps(_mm256_max_ps(v, _mm256_setzero_ps()), _mm256_set1_ps(255.0f));
+    }
+
+    void store8(__m256 v, uint8_t* dst, int x, TensorType type) const {
+        __m256 s = _mm256_fmadd_ps(v, _mm256_set1_ps(out_mul_), _mm256_set1_ps(out_add_));
+        if (type == TensorType::Float32) {
+            _mm256_storeu_ps(reinterpret_cast<float*>(dst) + x, s);
+            return;
+        }
+        s = _mm256_min_ps(_mm256_max_ps(s, _mm256_set1_ps(out_min_)), _mm256_set1_ps(out_max_));
+        __m256i q = _mm256_cvtps_epi32(s);
+        __m128i w16 = _mm_packs_epi32(_mm256_castsi256_si128(q), _mm256_extracti128_si256(q, 1));
+        __m128i w8 = type == TensorType::Int8 ? _mm_packs_epi16(w16, w16) : _mm_packus_epi16(w16, w16);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(dst + x), w8);
+    }
+#endif
+
+    void store1(float v, uint8_t* dst, int x, TensorType type) const {
+        float s = v * out_mul_ + out_add_;
+        if (type == TensorType::Float32) {
+            reinterpret_cast<float*>(dst)[x] = s;
+            return;
+        }
+        int q = static_cast<int>(std::nearbyint(std::clamp(s, out_min_, out_max_)));
+        if (type == TensorType::Int8)
+            reinterpret_cast<int8_t*>(dst)[x] = static_cast<int8_t>(q);
+        else
+            dst[x] = static_cast<uint8_t>(q);
+    }
+
+    float scale_ = 1.0f, inv_scale_ = 1.0f;
+    int new_w_ = 0, new_h_ = 0, pad_x_ = 0, pad_y_ = 0;
+    float out_mul_ = 1.0f, out_add_ = 0.0f, out_min_ = 0.0f, out_max_ = 255.0f;
+    float pad_f32_ = 0.0f;
+    int pad_q_ = 0;
+
+    PixelFormat cached_format_ = PixelFormat::BGR;
+    int cached_w_ = -1, cached_h_ = -1, cached_new_w_ = -1;
+    Rect cached_crop_{-1, -1, -1, -1};
+
+    std::vector<int32_t> x0_, x1_, cx0_, cx1_;
+    std::vector<float> wx_, cwx_;
+    std::vector<float> row_, crow_u_, crow_v_;
+    int chroma_begin_ = 0, chroma_span_ = 0;
+};
+
+}  // namespace camel
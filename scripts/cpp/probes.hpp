@@ -0,0 +1,159 @@
+// USDT (user-level statically defined tracing) probes on the hot paths.
+//
+// Each probe is a single `nop` plus an ELF note in `.note.stapsdt` that
+// tells bpftrace, perf or SystemTap where the nop is and how to read its
+// arguments, so a detached probe costs one instruction. The note layout is
+// the one <sys/sdt.h> emits; it is written out here so the stages build
+// without systemtap headers. Every probe also has a semaphore in `.probes`
+// that tracers increment while attached: arguments that are not free to
+// compute (message IDs) are only built when CAMEL_PROBE_ENABLED says so.
+//
+// Provider `camel`, probes (string arguments are `const char*`):
+//   receive(route, stage, seq, bytes)          message read from stdin
+//   stage_start(route, stage, seq, id)         handler about to run
+//   stage_end(route, stage, seq, id, ns, outcome)  0 forwarded, 1 dropped, 2 error
+//   send(route, stage, seq, bytes)             message written to stdout
+//   drop(route, stage, seq, reason)            message or frame discarded
+//   enqueue(ring, slot, sequence, bytes)       frame published to a slot ring
+//   dequeue(ring, slot, sequence)              frame read from a slot ring
+//   deliver(route, stage, target, bytes)       sink wrote its output
+//
+// `seq` counts messages within the process; `id` is the message's "id"
+// field or "". Build with -DCAMEL_NO_PROBES to compile the probes out.
+#pragma once
+
+#include <errno.h>
+
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <type_traits>
+
+#include "json.hpp"
+
+#if !defined(CAMEL_NO_PROBES) && (defined(__x86_64__) || defined(__aarch64__)) && defined(__ELF__)
+#define CAMEL_HAVE_PROBES 1
+#else
+#define CAMEL_HAVE_PROBES 0
+#endif
+
+namespace camel::probes {
+
+namespace detail {
+
+// Argument descriptor size as <sys/sdt.h> encodes it: the `%n` operand
+// modifier negates, so unsigned types pass -size to print "8@...".
+template <typename T>
+constexpr int arg_size() {
+    using U = std::decay_t<T>;
+    return (std::is_signed<U>::value ? 1 : -1) * static_cast<int>(sizeof(U));
+}
+
+template <typename... Args>
+inline void ignore(const Args&...) {}
+
+}  // namespace detail
+
+inline const char* route() {
+    static const std::string name = [] {
+        const char* r = std::getenv("CAMEL_ROUTE");
+        return std::string(r && *r ? r : "default");
+    }();
+    return name.c_str();
+}
+
+inline std::string& stage_name() {
+    static std::string name = program_invocation_short_name;
+    return name;
+}
+
+inline const char* stage() { return stage_name().c_str(); }
+
+// Processors name themselves once options are parsed.
+inline void set_stage(const std::string& name) { stage_name() = name; }
+
+inline std::string message_id(const json::Value& message) {
+    if (!message.is_object()) return "";
+    const json::Value& id = message.get("id");
+    if (id.is_string()) return id.as_string();
+    if (id.is_number()) return std::to_string(static_cast<long long>(id.as_number()));
+    return "";
+}
+
+}  // namespace camel::probes
+
+#if CAMEL_HAVE_PROBES
+
+// Semaphores carry C names so the note can refer to them; weak definitions
+// let every translation unit that includes this header share one copy.
+#define CAMEL_PROBE_SEMAPHORE(name)                                     \
+    __extension__ volatile unsigned short camel_probe_##name##_semaphore \
+        __attribute__((weak, visibility("hidden"), section(".probes"), used)) = 0
+
+extern "C" {
+CAMEL_PROBE_SEMAPHORE(receive);
+CAMEL_PROBE_SEMAPHORE(stage_start);
+CAMEL_PROBE_SEMAPHORE(stage_end);
+CAMEL_PROBE_SEMAPHORE(send);
+CAMEL_PROBE_SEMAPHORE(drop);
+CAMEL_PROBE_SEMAPHORE(enqueue);
+CAMEL_PROBE_SEMAPHORE(dequeue);
+CAMEL_PROBE_SEMAPHORE(deliver);
+}
+
+#define CAMEL_PROBE_ENABLED(name) __builtin_expect(camel_probe_##name##_semaphore != 0, 0)
+
+#define CAMEL_PROBE_NOTE(name, args)                                                   \
+    "990: nop\n"                                                                       \
+    ".pushsection .note.stapsdt,\"?\",\"note\"\n"                                      \
+    ".balign 4\n"                                                                      \
+    ".4byte 992f-991f,994f-993f,3\n"                                                   \
+    "991: .asciz \"stapsdt\"\n"                                                        \
+    "992: .balign 4\n"                                                                 \
+    "993: .8byte 990b\n"                                                               \
+    ".8byte _.stapsdt.base\n"                                                          \
+    ".8byte camel_probe_" #name "_semaphore\n"                                         \
+    ".asciz \"camel\"\n"                                                               \
+    ".asciz \"" #name "\"\n"                                                           \
+    ".asciz \"" args "\"\n"                                                            \
+    "994: .balign 4\n"                                                                 \
+    ".popsection\n"                                                                    \
+    ".ifndef _.stapsdt.base\n"                                                         \
+    ".pushsection .stapsdt.base,\"aG\",\"progbits\",.stapsdt.base,comdat\n"            \
+    ".weak _.stapsdt.base\n"                                                           \
+    ".hidden _.stapsdt.base\n"                                                         \
+    "_.stapsdt.base: .space 1\n"                                                       \
+    ".size _.stapsdt.base, 1\n"                                                        \
+    ".popsection\n"                                                                    \
+    ".endif\n"
+
+// Unary plus decays string literals to pointers and promotes small integers.
+#define CAMEL_PROBE_OP(n, x) [s##n] "n"(::camel::probes::detail::arg_size<decltype(+(x))>()), [a##n] "nor"(+(x))
+
+#define CAMEL_PROBE3(name, x1, x2, x3)                                                                     \
+    __asm__ __volatile__(CAMEL_PROBE_NOTE(name, "%n[s1]@%[a1] %n[s2]@%[a2] %n[s3]@%[a3]")                  \
+                         :                                                                                 \
+                         : CAMEL_PROBE_OP(1, x1), CAMEL_PROBE_OP(2, x2), CAMEL_PROBE_OP(3, x3))
+#define CAMEL_PROBE4(name, x1, x2, x3, x4)                                                                 \
+    __asm__ __volatile__(CAMEL_PROBE_NOTE(name, "%n[s1]@%[a1] %n[s2]@%[a2] %n[s3]@%[a3] %n[s4]@%[a4]")     \
+                         :                                                                                 \
+                         : CAMEL_PROBE_OP(1, x1), CAMEL_PROBE_OP(2, x2), CAMEL_PROBE_OP(3, x3),            \
+                           CAMEL_PROBE_OP(4, x4))
+#define CAMEL_PROBE6(name, x1, x2, x3, x4, x5, x6)                                                         \
+    __asm__ __volatile__(CAMEL_PROBE_NOTE(name, "%n[s1]@%[a1] %n[s2]@%[a2] %n[s3]@%[a3] %n[s4]@%[a4] "     \
+                                                "%n[s5]@%[a5] %n[s6]@%[a6]")                               \
+                         :                                                                                 \
+                         : CAMEL_PROBE_OP(1, x1), CAMEL_PROBE_OP(2, x2), CAMEL_PROBE_OP(3, x3),            \
+                           CAMEL_PROBE_OP(4, x4), CAMEL_PROBE_OP(5, x5), CAMEL_PROBE_OP(6, x6))
+
+#else
+
+#define CAMEL_PROBE_ENABLED(name) false
+#define CAMEL_PROBE3(name, ...) \
+    do {                        \
+        if (false) ::camel::probes::detail::ignore(__VA_ARGS__); \
+    } while (0)
+#define CAMEL_PROBE4 CAMEL_PROBE3
+#define CAMEL_PROBE6 CAMEL_PROBE3
+
+#endif
@@ -0,0 +1,222 @@
+// Shared command-line handling and message loop for C++ external processors.
+//
+// A processor is started once per route and kept alive: it reads one JSON
+// message per line from stdin (or --input), hands it to the handler and
+// writes the resulting message as one line to stdout. The processor config
+// from the route YAML arrives as JSON via --config or --config-file.
+// With --input-format binary, messages are framed as binary envelopes
+// (envelope.hpp) so bulk payloads travel next to the JSON header.
+// Each message gets a trace span when CAMEL_TRACE is set (trace.hpp), is
+// counted in the stage's shared-memory block for cpp_monitor (stage_metrics.hpp)
+// and kept in the flight recorder ring (flight_recorder.hpp). cpp_monitor can
+// ask a running stage for a CPU profile (profiler.hpp).
+#pragma once
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+#include "envelope.hpp"
+#include "flight_recorder.hpp"
+#include "json.hpp"
+#include "probes.hpp"
+#include "profiler.hpp"
+#include "stage_metrics.hpp"
+#include "trace.hpp"
+
+namespace camel {
+
+struct ProcessorOptions {
+    std::string name;
+    std::string input = "-";
+    std::string input_format = "json";   // json | binary
+    std::string output_format;           // defaults to input_format
+    json::Value config = json::Value::object();
+};
+
+inline void log_error(const std::string& name, const std::string& what) {
+    std::fprintf(stderr, "[%s] error: %s\n", name.c_str(), what.c_str());
+}
+
+inline void log_info(const std::string& name, const std::string& what) {
+    std::fprintf(stderr, "[%s] %s\n", name.c_str(), what.c_str());
+}
+
+inline std::string read_file(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) throw std::runtime_error("cannot open " + path);
+    std::ostringstream ss;
+    ss << in.rdbuf();
+    return ss.str();
+}
+
+inline ProcessorOptions parse_options(int argc, char** argv, const char* name) {
+    ProcessorOptions opts;
+    opts.name = name;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        auto value = [&]() -> std::string {
+            if (i + 1 >= argc) throw std::runtime_error("missing value for " + arg);
+            return argv[++i];
+        };
+        if (arg == "--config") {
+            opts.config = json::Value::parse(value());
+        } else if (arg == "--config-file") {
+            opts.config = json::Value::parse(read_file(value()));
+        } else if (arg == "--input") {
+            opts.input = value();
+        } else if (arg == "--name") {
+            opts.name = value();
+        } else if (arg == "--input-format") {
+            opts.input_format = value();
+        } else if (arg == "--output-format") {
+            opts.output_format = value();
+        } else {
+            throw std::runtime_error("unknown argument " + arg);
+        }
+    }
+    if (!opts.config.is_object()) throw std::runtime_error("--config must be a JSON object");
+    if (opts.output_format.empty()) opts.output_format = opts.input_format;
+    for (const std::string* f : {&opts.input_format, &opts.output_format})
+        if (*f != "json" && *f != "binary") throw std::runtime_error("unknown message format '" + *f + "'");
+    return opts;
+}
+
+// Handler contract: mutate the message in place and return true to forward
+// it, or return false to drop it from the route. Exceptions are reported on
+// stderr and the message is forwarded with an "error" field so downstream
+// filters can route around the failure.
+using MessageHandler = std::function<bool(json::Value& message)>;
+
+// Same contract for processors that consume or produce envelope payloads.
+// In JSON mode the payload is empty and is not written out.
+using EnvelopeHandler = std::function<bool(json::Value& message, std::string& payload)>;
+
+inline EnvelopeHandler to_envelope_handler(EnvelopeHandler handle) { return handle; }
+
+inline EnvelopeHandler to_envelope_handler(MessageHandler handle) {
+    return [handle = std::move(handle)](json::Value& message, std::string&) { return handle(message); };
+}
+
+inline int run_message_loop(const ProcessorOptions& opts, const EnvelopeHandler& handle) {
+    std::ifstream file;
+    std::istream* in = &std::cin;
+    if (opts.input != "-") {
+        file.open(opts.input, std::ios::binary);
+        if (!file) {
+            log_error(opts.name, "cannot open input " + opts.input);
+            return 1;
+        }
+        in = &file;
+    }
+    std::ios::sync_with_stdio(false);
+    const bool binary_in = opts.input_format == "binary";
+    const bool binary_out = opts.output_format == "binary";
+    Tracer& tracer = Tracer::instance();
+    tracer.set_service(opts.name);
+    StageMetrics& metrics = StageMetrics::instance();
+    metrics.open(opts.name);
+    FlightRecorder& flight = FlightRecorder::instance();
+    flight.open(opts.name);
+    probes::set_stage(opts.name);
+    const char* route = probes::route();
+    const char* stage = probes::stage();
+
+    std::string line;
+    std::string payload;
+    std::string out;
+    for (uint64_t seq = 0;; ++seq) {
+        json::Value message;
+        payload.clear();
+        try {
+            if (binary_in) {
+                // A malformed envelope loses framing; nothing after it can be trusted.
+                if (!read_envelope(*in, message, payload, &line)) break;
+            } else {
+                if (!std::getline(*in, line)) break;
+                if (line.empty()) continue;
+                message = json::Value::parse(line);
+            }
+        } catch (const json::ParseError& e) {
+            log_error(opts.name, e.what());
+            continue;
+        } catch (const std::exception& e) {
+            log_error(opts.name, e.what());
+            flight.dump("fatal");
+            tracer.flush();
+            return 1;
+        }
+        CAMEL_PROBE4(receive, route, stage, seq, static_cast<uint64_t>(line.size() + payload.size()));
+        std::string probe_id;
+        if (CAMEL_PROBE_ENABLED(stage_start) || CAMEL_PROBE_ENABLED(stage_end)) probe_id = probes::message_id(message);
+        CAMEL_PROBE4(stage_start, route, stage, seq, probe_id.c_str());
+        Span span = tracer.begin(message);
+        metrics.received();
+        poll_profile_request();
+        flight.begin(line, payload);
+        const auto started = std::chrono::steady_clock::now();
+        auto busy_ns = [&] {
+            return static_cast<uint64_t>(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - started).count());
+        };
+        try {
+            if (!handle(message, payload)) {
+                const uint64_t ns = busy_ns();
+                metrics.done(StageMetrics::Outcome::Dropped, ns);
+                flight.end(FlightOutcome::Dropped, ns);
+                CAMEL_PROBE6(stage_end, route, stage, seq, probe_id.c_str(), ns, 1);
+                CAMEL_PROBE4(drop, route, stage, seq, "handler");
+                tracer.end(span, message, "", true);
+                continue;
+            }
+            const uint64_t ns = busy_ns();
+            metrics.done(StageMetrics::Outcome::Forwarded, ns);
+            flight.end(FlightOutcome::Forwarded, ns);
+            CAMEL_PROBE6(stage_end, route, stage, seq, probe_id.c_str(), ns, 0);
+            tracer.end(span, message);
+        } catch (const std::exception& e) {
+            const uint64_t ns = busy_ns();
+            metrics.done(StageMetrics::Outcome::Error, ns);
+            log_error(opts.name, e.what());
+            flight.end(FlightOutcome::Error, ns, e.what());
+            CAMEL_PROBE6(stage_end, route, stage, seq, probe_id.c_str(), ns, 2);
+            if (message.is_object()) message["error"] = std::string(e.what());
+            tracer.end(span, message, e.what());
+        }
+        out.clear();
+        message.dump_to(out);
+        if (binary_out) {
+            write_envelope(stdout, out, payload);
+        } else {
+            out += '\n';
+            std::fwrite(out.data(), 1, out.size(), stdout);
+        }
+        std::fflush(stdout);
+        CAMEL_PROBE4(send, route, stage, seq, static_cast<uint64_t>(out.size() + payload.size()));
+    }
+    tracer.flush();
+    return 0;
+}
+
+inline int run_message_loop(const ProcessorOptions& opts, const MessageHandler& handle) {
+    return run_message_loop(opts, to_envelope_handler(handle));
+}
+
+template <typename Setup>
+int processor_main(int argc, char** argv, const char* name, Setup&& setup) {
+    try {
+        ProcessorOptions opts = parse_options(argc, argv, name);
+        EnvelopeHandler handler = to_envelope_handler(setup(opts));
+        return run_message_loop(opts, handler);
+    } catch (const std::exception& e) {
+        log_error(name, e.what());
+        return 1;
+    }
+}
+
+}  // namespace camel
@@ -0,0 +1,361 @@
+// Sampling CPU profiler that a running processor starts on request.
+//
+// cpp_monitor asks a stage for a profile through its shared-memory metrics
+// block (stage_metrics.hpp). The message loop notices the request on its next
+// message and arms ITIMER_PROF, which delivers SIGPROF to whichever thread is
+// using CPU; the handler records that thread's stack. A helper thread ends
+// the window, symbolizes the stacks from the binaries' ELF symbol tables and
+// publishes them as folded stacks ("frame;frame;frame count" per line) in
+// `/camel_profile_<pid>`. Nothing runs, and no signal fires, while no profile
+// is requested; an idle stage therefore returns an empty profile.
+//
+// Stacks are unwound with backtrace(), which uses the unwind tables every
+// C++ binary carries, so the processors need no frame pointers.
+#pragma once
+
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <elf.h>
+#include <execinfo.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "shm.hpp"
+#include "stage_metrics.hpp"
+
+namespace camel {
+
+namespace detail {
+
+// Function symbols of one ELF file, for addresses relative to its load base.
+class ElfSymbols {
+public:
+    explicit ElfSymbols(const std::string& path) {
+        const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) return;
+        struct stat st {};
+        void* map = fstat(fd, &st) == 0 && st.st_size > 0
+                        ? mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0)
+                        : MAP_FAILED;
+        ::close(fd);
+        if (map == MAP_FAILED) return;
+        load(static_cast<const uint8_t*>(map), static_cast<size_t>(st.st_size));
+        munmap(map, static_cast<size_t>(st.st_size));
+    }
+
+    bool absolute() const { return absolute_; }
+
+    const std::string* find(uintptr_t addr) const {
+        auto it = std::upper_bound(syms_.begin(), syms_.end(), addr,
+                                   [](uintptr_t a, const Sym& s) { return a < s.start; });
+        if (it == syms_.begin()) return nullptr;
+        --it;
+        return addr < it->start + std::max<uintptr_t>(it->size, 1) ? &it->name : nullptr;
+    }
+
+private:
+    struct Sym {
+        uintptr_t start;
+        uintptr_t size;
+        std::string name;
+    };
+
+    void load(const uint8_t* data, size_t size) {
+        if (size < sizeof(Elf64_Ehdr) || std::memcmp(data, ELFMAG, SELFMAG) != 0 || data[EI_CLASS] != ELFCLASS64) return;
+        const auto* eh = reinterpret_cast<const Elf64_Ehdr*>(data);
+        absolute_ = eh->e_type == ET_EXEC;
+        if (eh->e_shoff == 0 || eh->e_shoff + static_cast<size_t>(eh->e_shnum) * sizeof(Elf64_Shdr) > size) return;
+        const auto* sh = reinterpret_cast<const Elf64_Shdr*>(data + eh->e_shoff);
+        // .symtab is a superset of .dynsym when present.
+        bool have_symtab = false;
+        for (int i = 0; i < eh->e_shnum; ++i) have_symtab |= sh[i].sh_type == SHT_SYMTAB;
+        for (int i = 0; i < eh->e_shnum; ++i) {
+            if (sh[i].sh_type != (have_symtab ? SHT_SYMTAB : SHT_DYNSYM) || sh[i].sh_link >= eh->e_shnum) continue;
+            const Elf64_Shdr& strs = sh[sh[i].sh_link];
+            if (sh[i].sh_offset + sh[i].sh_size > size || strs.sh_offset + strs.sh_size > size) continue;
+            const auto* sym = reinterpret_cast<const Elf64_Sym*>(data + sh[i].sh_offset);
+            const size_t n = sh[i].sh_size / sizeof(Elf64_Sym);
+            const char* names = reinterpret_cast<const char*>(data + strs.sh_offset);
+            for (size_t k = 0; k < n; ++k) {
+                if (ELF64_ST_TYPE(sym[k].st_info) != STT_FUNC || sym[k].st_value == 0 || sym[k].st_name >= strs.sh_size)
+                    continue;
+                syms_.push_back({sym[k].st_value, sym[k].st_size, names + sym[k].st_name});
+            }
+        }
+        std::sort(syms_.begin(), syms_.end(), [](const Sym& a, const Sym& b) { return a.start < b.start; });
+    }
+
+    std::vector<Sym> syms_;
+    bool absolute_ = false;
+};
+
+// "camel::Foo::bar(int) const [clone .constprop.0]" -> "camel::Foo::bar";
+// ';' is the folded stack separator and must not appear in a frame.
+inline std::string frame_name(const char* mangled) {
+    int status = 0;
+    std::unique_ptr<char, void (*)(void*)> demangled(abi::__cxa_demangle(mangled, nullptr, nullptr, &status), std::free);
+    std::string name = status == 0 && demangled ? demangled.get() : mangled;
+    if (status == 0) {
+        for (size_t clone; (clone = name.find(" [clone ")) != std::string::npos;) {
+            const size_t close = name.find(']', clone);
+            name.erase(clone, close == std::string::npos ? std::string::npos : close - clone + 1);
+        }
+        size_t end = name.size();
+        if (name.size() > 6 && name.compare(name.size() - 6, 6, " const") == 0) end -= 6;
+        if (end > 0 && name[end - 1] == ')') {
+            int depth = 0;
+            for (size_t i = end; i-- > 0;) {
+                if (name[i] == ')') ++depth;
+                else if (name[i] == '(' && --depth == 0) {
+                    if (i > 0) name.resize(i);
+                    break;
+                }
+            }
+        }
+    }
+    std::replace(name.begin(), name.end(), ';', ':');
+    return name;
+}
+
+}  // namespace detail
+
+class Symbolizer {
+public:
+    std::string name(void* pc) {
+        const auto addr = reinterpret_cast<uintptr_t>(pc);
+        auto cached = cache_.find(addr);
+        if (cached != cache_.end()) return cached->second;
+        std::string out;
+        Dl_info info{};
+        if (dladdr(pc, &info) && info.dli_fname) {
+            auto& file = files_[info.dli_fname];
+            if (!file) file = std::make_unique<detail::ElfSymbols>(resolve(info.dli_fname));
+            const uintptr_t base = reinterpret_cast<uintptr_t>(info.dli_fbase);
+            const std::string* sym = file->find(file->absolute() ? addr : addr - base);
+            if (sym) out = detail::frame_name(sym->c_str());
+            else if (info.dli_sname) out = detail::frame_name(info.dli_sname);
+            else {
+                const char* slash = std::strrchr(info.dli_fname, '/');
+                char off[32];
+                std::snprintf(off, sizeof(off), "+0x%zx", static_cast<size_t>(addr - base));
+                out = std::string(slash ? slash + 1 : info.dli_fname) + off;
+            }
+        } else {
+            out = "[unknown]";
+        }
+        cache_.emplace(addr, out);
+        return out;
+    }
+
+private:
+    // dladdr reports the main program as argv[0]; read it through /proc.
+    static std::string resolve(const char* fname) {
+        Dl_info self{};
+        if (dladdr(reinterpret_cast<void*>(&resolve), &self) && self.dli_fname && std::strcmp(self.dli_fname, fname) == 0)
+            return "/proc/self/exe";
+        return fname;
+    }
+
+    std::unordered_map<uintptr_t, std::string> cache_;
+    std::map<std::string, std::unique_ptr<detail::ElfSymbols>> files_;
+};
+
+class Profiler {
+public:
+    static constexpr int kMaxDepth = 48;
+    static constexpr size_t kMaxSamples = 50000;
+
+    static Profiler& instance() {
+        static Profiler profiler;
+        return profiler;
+    }
+
+    bool running() const { return running_.load(std::memory_order_acquire); }
+
+    // Samples for `seconds` at `hz` per CPU-second, then calls
+    // `done(folded)` on a helper thread. Returns false if already running.
+    template <typename Done>
+    bool start(double seconds, int hz, Done done) {
+        if (running_.exchange(true)) return false;
+        hz = std::clamp(hz, 1, 1000);
+        capacity_ = std::min(kMaxSamples, static_cast<size_t>(seconds * hz * 4) + 64);
+        samples_ = std::make_unique<Sample[]>(capacity_);
+        next_.store(0);
+        void* warm[4];
+        backtrace(warm, 4);  // loads the unwinder outside the signal handler
+        if (!handler_installed_) {
+            struct sigaction sa {};
+            sa.sa_sigaction = &Profiler::on_sigprof;
+            sa.sa_flags = SA_SIGINFO | SA_RESTART;
+            sigemptyset(&sa.sa_mask);
+            sigaction(SIGPROF, &sa, nullptr);
+            handler_installed_ = true;
+        }
+        active_.store(true, std::memory_order_release);
+        itimerval timer{};
+        timer.it_interval.tv_usec = 1000000 / hz;
+        timer.it_value = timer.it_interval;
+        setitimer(ITIMER_PROF, &timer, nullptr);
+        std::thread([this, seconds, done = std::move(done)]() mutable {
+            std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+            itimerval off{};
+            setitimer(ITIMER_PROF, &off, nullptr);
+            active_.store(false, std::memory_order_release);
+            std::string folded = fold();
+            samples_.reset();
+            capacity_ = 0;
+            running_.store(false, std::memory_order_release);
+            done(std::move(folded));
+        }).detach();
+        return true;
+    }
+
+private:
+    struct Sample {
+        std::atomic<bool> ready{false};
+        int depth = 0;
+        char thread[16] = {};
+        void* pcs[kMaxDepth] = {};
+    };
+
+    Profiler() = default;
+
+    static void on_sigprof(int, siginfo_t*, void*) {
+        Profiler& p = instance();
+        if (!p.active_.load(std::memory_order_acquire)) return;
+        const int saved = errno;
+        const size_t i = p.next_.fetch_add(1, std::memory_order_relaxed);
+        if (i < p.capacity_) {
+            Sample& s = p.samples_[i];
+            s.depth = backtrace(s.pcs, kMaxDepth);
+            prctl(PR_GET_NAME, s.thread, 0, 0, 0);
+            s.ready.store(true, std::memory_order_release);
+        }
+        errno = saved;
+    }
+
+    // Root first, thread name as the root frame. The two innermost frames
+    // are this handler and the kernel's signal trampoline.
+    std::string fold() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));  // let in-flight handlers finish
+        Symbolizer symbols;
+        std::map<std::string, uint64_t> stacks;
+        const size_t n = std::min(next_.load(), capacity_);
+        std::string key;
+        for (size_t i = 0; i < n; ++i) {
+            const Sample& s = samples_[i];
+            if (!s.ready.load(std::memory_order_acquire) || s.depth <= 2) continue;
+            key = s.thread[0] ? s.thread : "thread";
+            for (int f = s.depth - 1; f >= 2; --f) {
+                // Return addresses point after the call; look up the call itself.
+                void* pc = f == 2 ? s.pcs[f] : static_cast<char*>(s.pcs[f]) - 1;
+                key += ';';
+                key += symbols.name(pc);
+            }
+            ++stacks[key];
+        }
+        std::string out;
+        for (const auto& [stack, count] : stacks) out += stack + " " + std::to_string(count) + "\n";
+        return out;
+    }
+
+    std::unique_ptr<Sample[]> samples_;
+    size_t capacity_ = 0;
+    std::atomic<size_t> next_{0};
+    std::atomic<bool> active_{false};
+    std::atomic<bool> running_{false};
+    bool handler_installed_ = false;
+};
+
+inline std::string profile_result_name(int pid) { return "/camel_profile_" + std::to_string(pid); }
+
+// Stage side: called for each message; starts a requested profile and
+// publishes the result in /camel_profile_<pid>, unless the monitor stopped
+// waiting for it meanwhile.
+inline void poll_profile_request() {
+    StageMetricsBlock* b = StageMetrics::instance().block();
+    if (!b) return;
+    static uint64_t seen = 0;
+    const uint64_t seq = b->profile_seq.load(std::memory_order_acquire);
+    if (seq == seen) return;
+    Profiler& profiler = Profiler::instance();
+    if (profiler.running()) return;
+    seen = seq;
+    if (unix_ms_now() > b->profile_expires_ms.load(std::memory_order_relaxed)) return;  // monitor gave up
+    const double seconds = b->profile_ms.load(std::memory_order_relaxed) / 1000.0;
+    const int hz = static_cast<int>(b->profile_hz.load(std::memory_order_relaxed));
+    profiler.start(seconds, hz, [b, seq](std::string folded) {
+        if (b->profile_seq.load(std::memory_order_acquire) != seq ||
+            b->profile_expires_ms.load(std::memory_order_acquire) == 0)
+            return;  // abandoned; nobody would unlink the result
+        const std::string name = profile_result_name(::getpid());
+        try {
+            SharedRegion r = SharedRegion::create(name, sizeof(uint64_t) + folded.size());
+            const uint64_t size = folded.size();
+            std::memcpy(r.data(), &size, sizeof(size));
+            std::memcpy(r.data() + sizeof(size), folded.data(), folded.size());
+        } catch (const std::exception&) {
+            return;  // the monitor times out
+        }
+        b->profile_done.store(seq, std::memory_order_release);
+    });
+}
+
+// Monitor side: asks stage `pid` for a profile and waits for it. Returns the
+// folded stacks, "" if the stage handled no message in the window, or throws
+// if the stage is gone.
+inline std::string request_profile(int pid, double seconds, int hz) {
+    const std::string stage = "/camel_stage_" + std::to_string(pid);
+    SharedRegion region = SharedRegion::open(stage, true);
+    if (region.size() < sizeof(StageMetricsBlock)) throw std::runtime_error(stage + " is too small");
+    auto* b = reinterpret_cast<StageMetricsBlock*>(region.data());
+    if (b->magic != StageMetricsBlock::kMagic || b->version != StageMetricsBlock::kVersion)
+        throw std::runtime_error(stage + " has an unknown layout");
+    b->profile_ms.store(static_cast<uint32_t>(std::lround(seconds * 1000)), std::memory_order_relaxed);
+    b->profile_hz.store(static_cast<uint32_t>(hz), std::memory_order_relaxed);
+    b->profile_expires_ms.store(unix_ms_now() + static_cast<uint64_t>(seconds * 1000) + 1000, std::memory_order_relaxed);
+    const uint64_t seq = b->profile_seq.fetch_add(1, std::memory_order_acq_rel) + 1;
+    // The stage starts on its next message, so allow a window's worth of delay.
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::duration<double>(2 * seconds + 2);
+    const std::string result = profile_result_name(pid);
+    while (std::chrono::steady_clock::now() < deadline) {
+        if (b->profile_done.load(std::memory_order_acquire) == seq) {
+            SharedRegion r = SharedRegion::open(result);
+            uint64_t size = 0;
+            if (r.size() >= sizeof(size)) std::memcpy(&size, r.data(), sizeof(size));
+            std::string folded(reinterpret_cast<const char*>(r.data()) + sizeof(size),
+                               std::min<size_t>(size, r.size() - sizeof(size)));
+            shm_unlink(result.c_str());
+            return folded;
+        }
+        if (::kill(pid, 0) != 0 && errno == ESRCH) throw std::runtime_error("stage " + std::to_string(pid) + " exited");
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    // Tell the stage to drop a late result; one already published goes here.
+    b->profile_expires_ms.store(0, std::memory_order_release);
+    if (b->profile_done.load(std::memory_order_acquire) == seq) shm_unlink(result.c_str());
+    return "";
+}
+
+}  // namespace camel
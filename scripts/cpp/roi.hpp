@@ -0,0 +1,178 @@
+// Region-of-interest zones: polygons in which detections matter.
+//
+// The preprocessor runs inference on the bounding crop of the enabled zones
+// only, and passes the zones (in frame pixels) along with the tensor so the
+// stage that produces detections can drop those whose anchor point lies
+// outside every polygon and tag the rest with their zone.
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "json.hpp"
+#include "nms.hpp"
+#include "preprocess.hpp"
+
+namespace camel {
+
+struct Point {
+    float x = 0.0f;
+    float y = 0.0f;
+};
+
+struct Zone {
+    std::string name;
+    std::vector<Point> points;
+
+    // Even-odd ray casting; points on an edge may land on either side.
+    bool contains(Point p) const {
+        bool inside = false;
+        for (size_t i = 0, j = points.size() - 1; i < points.size(); j = i++) {
+            const Point& a = points[i];
+            const Point& b = points[j];
+            if ((a.y > p.y) != (b.y > p.y) && p.x < (b.x - a.x) * (p.y - a.y) / (b.y - a.y) + a.x) inside = !inside;
+        }
+        return inside;
+    }
+};
+
+// Which point of a box has to be inside a zone. Bottom center is where a
+// person or vehicle touches the ground, which is what floor zones describe.
+enum class RoiAnchor { BottomCenter, Center };
+
+inline RoiAnchor parse_roi_anchor(const std::string& s) {
+    if (s == "bottom_center") return RoiAnchor::BottomCenter;
+    if (s == "center") return RoiAnchor::Center;
+    throw std::runtime_error("unknown roi anchor '" + s + "'");
+}
+
+inline Point anchor_point(const Box& b, RoiAnchor a) {
+    return a == RoiAnchor::Center ? Point{b.center_x(), b.center_y()} : Point{b.center_x(), b.y2};
+}
+
+// Zones from route config, points as fractions of the frame:
+//   roi:
+//     - name: "driveway"
+//       points: [[0.1, 0.5], [0.6, 0.45], [0.7, 1.0], [0.05, 1.0]]
+//       enabled: true
+inline std::vector<Zone> parse_zones(const json::Value& v) {
+    std::vector<Zone> zones;
+    if (!v.is_array()) return zones;
+    for (const auto& z : v.as_array()) {
+        if (!z.bool_or("enabled", true)) continue;
+        Zone zone;
+        zone.name = z.string_or("name", "zone" + std::to_string(zones.size()));
+        for (const auto& p : z["points"].as_array()) {
+            if (!p.is_array() || p.size() != 2) throw std::runtime_error("roi point must be [x, y]");
+            Point pt{static_cast<float>(p[0].as_number()), static_cast<float>(p[1].as_number())};
+            if (pt.x < 0.0f || pt.x > 1.0f || pt.y < 0.0f || pt.y > 1.0f)
+                throw std::runtime_error("roi points are fractions of the frame (0..1)");
+            zone.points.push_back(pt);
+        }
+        if (zone.points.size() < 3) throw std::runtime_error("roi zone '" + zone.name + "' needs at least 3 points");
+        zones.push_back(std::move(zone));
+    }
+    return zones;
+}
+
+inline std::vector<Zone> zones_to_pixels(const std::vector<Zone>& zones, int frame_w, int frame_h) {
+    std::vector<Zone> out = zones;
+    for (auto& z : out)
+        for (auto& p : z.points) p = {p.x * frame_w, p.y * frame_h};
+    return out;
+}
+
+// Bounding crop of all zones (pixels), grown by `margin` (fraction of the
+// crop size) so objects straddling a zone edge keep their context.
+inline Rect zones_crop(const std::vector<Zone>& zones, int frame_w, int frame_h, float margin) {
+    if (zones.empty()) return {0, 0, frame_w, frame_h};
+    float x0 = frame_w, y0 = frame_h, x1 = 0.0f, y1 = 0.0f;
+    for (const auto& z : zones) {
+        for (const auto& p : z.points) {
+            x0 = std::min(x0, p.x);
+            y0 = std::min(y0, p.y);
+            x1 = std::max(x1, p.x);
+            y1 = std::max(y1, p.y);
+        }
+    }
+    float mx = margin * (x1 - x0), my = margin * (y1 - y0);
+    int left = std::max(0, static_cast<int>(std::floor(x0 - mx)));
+    int top = std::max(0, static_cast<int>(std::floor(y0 - my)));
+    int right = std::min(frame_w, static_cast<int>(std::ceil(x1 + mx)));
+    int bottom = std::min(frame_h, static_cast<int>(std::ceil(y1 + my)));
+    return {left, top, std::max(1, right - left), std::max(1, bottom - top)};
+}
+
+// Zones in frame pixels plus the anchor rule; travels as tensor.roi.
+struct RoiFilter {
+    std::vector<Zone> zones;
+    RoiAnchor anchor = RoiAnchor::BottomCenter;
+
+    bool empty() const { return zones.empty(); }
+
+    // Index of the first zone containing the box anchor, or -1.
+    int zone_of(const Box& b) const {
+        Point p = anchor_point(b, anchor);
+        for (size_t i = 0; i < zones.size(); ++i)
+            if (zones[i].contains(p)) return static_cast<int>(i);
+        return -1;
+    }
+
+    void filter(std::vector<Detection>& dets) const {
+        if (empty()) return;
+        dets.erase(std::remove_if(dets.begin(), dets.end(), [&](const Detection& d) { return zone_of(d.box) < 0; }),
+                   dets.end());
+    }
+
+    // Adds "zone" to each detection object of a written detections list.
+    void tag(json::Value& detections) const {
+        if (empty() || !detections.is_array()) return;
+        for (auto& d : detections.as_array()) {
+            const json::Value& b = d["bbox"];
+            Box box{static_cast<float>(b[0].as_number()), static_cast<float>(b[1].as_number()),
+                    static_cast<float>(b[2].as_number()), static_cast<float>(b[3].as_number())};
+            int z = zone_of(box);
+            if (z >= 0) d["zone"] = zones[z].name;
+        }
+    }
+
+    json::Value to_json() const {
+        json::Value v = json::Value::object();
+        v["anchor"] = anchor == RoiAnchor::Center ? "center" : "bottom_center";
+        json::Value list = json::Value::array();
+        for (const auto& z : zones) {
+            json::Value zone = json::Value::object();
+            zone["name"] = z.name;
+            json::Value points = json::Value::array();
+            for (const auto& p : z.points) {
+                json::Value pt = json::Value::array();
+                pt.push_back(std::round(p.x * 10.0f) / 10.0f);
+                pt.push_back(std::round(p.y * 10.0f) / 10.0f);
+                points.push_back(std::move(pt));
+            }
+            zone["points"] = std::move(points);
+            list.push_back(std::move(zone));
+        }
+        v["zones"] = std::move(list);
+        return v;
+    }
+
+    static RoiFilter from_json(const json::Value& v) {
+        RoiFilter f;
+        if (!v.is_object()) return f;
+        f.anchor = parse_roi_anchor(v.string_or("anchor", "bottom_center"));
+        for (const auto& z : v["zones"].as_array()) {
+            Zone zone;
+            zone.name = z.string_or("name", "");
+            for (const auto& p : z["points"].as_array())
+                zone.points.push_back({static_cast<float>(p[0].as_number()), static_cast<float>(p[1].as_number())});
+            if (zone.points.size() >= 3) f.zones.push_back(std::move(zone));
+        }
+        return f;
+    }
+};
+
+}  // namespace camel
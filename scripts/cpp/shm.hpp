@@ -0,0 +1,268 @@
+// POSIX shared memory regions used to pass frames and tensors between
+// processors without copying them through the JSON message stream.
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include "probes.hpp"
+
+namespace camel {
+
+class SharedRegion {
+public:
+    SharedRegion() = default;
+    SharedRegion(const SharedRegion&) = delete;
+    SharedRegion& operator=(const SharedRegion&) = delete;
+    SharedRegion(SharedRegion&& o) noexcept { swap(o); }
+    SharedRegion& operator=(SharedRegion&& o) noexcept {
+        if (this != &o) {
+            reset();
+            swap(o);
+        }
+        return *this;
+    }
+    ~SharedRegion() { reset(); }
+
+    // Creates (or resizes) a named region; names follow shm_open rules and
+    // must start with '/'.
+    static SharedRegion create(const std::string& name, size_t size) {
+        int fd = shm_open(name.c_str(), O_RDWR | O_CREAT, 0660);
+        if (fd < 0) throw std::runtime_error("shm_open " + name + ": " + std::strerror(errno));
+        if (ftruncate(fd, static_cast<off_t>(size)) != 0) {
+            int err = errno;
+            close(fd);
+            throw std::runtime_error("ftruncate " + name + ": " + std::strerror(err));
+        }
+        return map_fd(fd, name, size, true);
+    }
+
+    static SharedRegion open(const std::string& name, bool writable = false) {
+        int fd = shm_open(name.c_str(), writable ? O_RDWR : O_RDONLY, 0);
+        if (fd < 0) throw std::runtime_error("shm_open " + name + ": " + std::strerror(errno));
+        return map_fd(fd, name, 0, writable);
+    }
+
+    // Maps a regular file, e.g. a raw frame dumped to disk by a test harness.
+    static SharedRegion open_file(const std::string& path, bool writable = false) {
+        int fd = ::open(path.c_str(), writable ? O_RDWR : O_RDONLY);
+        if (fd < 0) throw std::runtime_error("open " + path + ": " + std::strerror(errno));
+        return map_fd(fd, path, 0, writable);
+    }
+
+    uint8_t* data() const { return data_; }
+    size_t size() const { return size_; }
+    const std::string& name() const { return name_; }
+    explicit operator bool() const { return data_ != nullptr; }
+
+    void reset() {
+        if (data_) munmap(data_, size_);
+        data_ = nullptr;
+        size_ = 0;
+        name_.clear();
+    }
+
+private:
+    static SharedRegion map_fd(int fd, const std::string& name, size_t size, bool writable) {
+        if (size == 0) {
+            struct stat st {};
+            if (fstat(fd, &st) != 0) {
+                close(fd);
+                throw std::runtime_error("fstat " + name + ": " + std::strerror(errno));
+            }
+            size = static_cast<size_t>(st.st_size);
+        }
+        if (size == 0) {
+            close(fd);
+            throw std::runtime_error("empty shared region " + name);
+        }
+        int prot = PROT_READ | (writable ? PROT_WRITE : 0);
+        void* p = mmap(nullptr, size, prot, MAP_SHARED, fd, 0);
+        close(fd);
+        if (p == MAP_FAILED) throw std::runtime_error("mmap " + name + ": " + std::strerror(errno));
+        SharedRegion r;
+        r.data_ = static_cast<uint8_t*>(p);
+        r.size_ = size;
+        r.name_ = name;
+        return r;
+    }
+
+    void swap(SharedRegion& o) noexcept {
+        std::swap(data_, o.data_);
+        std::swap(size_, o.size_);
+        std::swap(name_, o.name_);
+    }
+
+    uint8_t* data_ = nullptr;
+    size_t size_ = 0;
+    std::string name_;
+};
+
+// Multi-slot ring of fixed-size buffers inside one shared region. Writers
+// publish a slot with a seqlock-style sequence (odd while writing); readers
+// check that the sequence they were told about in the message is still the
+// one in the slot, which catches a producer that lapped a slow consumer.
+struct SlotRingHeader {
+    static constexpr uint32_t kMagic = 0x474E5243;  // "CRNG"
+    uint32_t magic;
+    uint32_t slot_count;
+    uint64_t slot_bytes;
+    std::atomic<uint64_t> next_sequence;
+    uint8_t reserved[40];
+};
+static_assert(sizeof(SlotRingHeader) == 64, "ring header must stay one cache line");
+
+struct SlotHeader {
+    std::atomic<uint64_t> sequence;
+    uint64_t payload_bytes;
+    uint8_t reserved[48];
+};
+static_assert(sizeof(SlotHeader) == 64, "slot header must stay one cache line");
+
+class SlotRing {
+public:
+    static constexpr size_t kAlign = 64;
+
+    SlotRing() = default;
+
+    static SlotRing create(const std::string& name, uint32_t slots, size_t slot_bytes) {
+        slot_bytes = (slot_bytes + kAlign - 1) / kAlign * kAlign;
+        size_t total = sizeof(SlotRingHeader) + static_cast<size_t>(slots) * (sizeof(SlotHeader) + slot_bytes);
+        SlotRing ring;
+        ring.region_ = SharedRegion::create(name, total);
+        auto* h = ring.header();
+        if (h->magic != SlotRingHeader::kMagic || h->slot_count != slots || h->slot_bytes != slot_bytes) {
+            std::memset(ring.region_.data(), 0, total);
+            h->slot_count = slots;
+            h->slot_bytes = slot_bytes;
+            h->next_sequence.store(2, std::memory_order_relaxed);
+            h->magic = SlotRingHeader::kMagic;
+        }
+        ring.slots_ = slots;
+        ring.slot_bytes_ = slot_bytes;
+        return ring;
+    }
+
+    static SlotRing open(const std::string& name, bool writable = false) {
+        SlotRing ring;
+        ring.region_ = SharedRegion::open(name, writable);
+        if (ring.region_.size() < sizeof(SlotRingHeader) || ring.header()->magic != SlotRingHeader::kMagic)
+            throw std::runtime_error("not a slot ring: " + name);
+        ring.slots_ = ring.header()->slot_count;
+        ring.slot_bytes_ = ring.header()->slot_bytes;
+        if (ring.region_.size() < ring.total_bytes()) throw std::runtime_error("slot ring " + name + " is truncated");
+        return ring;
+    }
+
+    // True if the writer recreated the region with another geometry since
+    // it was mapped; the mapping has to be reopened before it is read.
+    bool stale() const {
+        const auto* h = header();
+        return h->magic != SlotRingHeader::kMagic || h->slot_count != slots_ || h->slot_bytes != slot_bytes_;
+    }
+
+    struct WriteSlot {
+        uint32_t index;
+        uint64_t sequence;
+        uint8_t* data;
+        size_t capacity;
+    };
+
+    // Reserves the next slot round-robin and marks it as being written.
+    WriteSlot begin_write() {
+        auto* h = header();
+        uint64_t seq = h->next_sequence.fetch_add(2, std::memory_order_relaxed);
+        uint32_t index = static_cast<uint32_t>((seq / 2 - 1) % slots_);
+        SlotHeader* s = slot_header(index);
+        s->sequence.store(seq - 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        return {index, seq, slot_data(index), slot_bytes_};
+    }
+
+    void end_write(const WriteSlot& w, size_t payload_bytes) {
+        SlotHeader* s = slot_header(w.index);
+        s->payload_bytes = payload_bytes;
+        s->sequence.store(w.sequence, std::memory_order_release);
+        CAMEL_PROBE4(enqueue, region_.name().c_str(), w.index, w.sequence, static_cast<uint64_t>(payload_bytes));
+    }
+
+    // Returns the slot payload if it still carries the expected sequence.
+    const uint8_t* read(uint32_t index, uint64_t sequence, size_t* payload_bytes = nullptr) const {
+        if (index >= slot_count()) throw std::runtime_error("slot index out of range");
+        const SlotHeader* s = slot_header(index);
+        if (s->sequence.load(std::memory_order_acquire) != sequence)
+            throw std::runtime_error("slot " + std::to_string(index) + " of " + region_.name() +
+                                     " was overwritten before it was consumed");
+        if (payload_bytes) *payload_bytes = s->payload_bytes;
+        CAMEL_PROBE3(dequeue, region_.name().c_str(), index, sequence);
+        return slot_data(index);
+    }
+
+    // Re-checks the sequence after the reader is done with the payload.
+    bool still_valid(uint32_t index, uint64_t sequence) const {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return slot_header(index)->sequence.load(std::memory_order_relaxed) == sequence;
+    }
+
+    uint8_t* mutable_slot(uint32_t index, uint64_t sequence) {
+        read(index, sequence);
+        return slot_data(index);
+    }
+
+    uint32_t slot_count() const { return slots_; }
+    size_t slot_bytes() const { return slot_bytes_; }
+    const std::string& name() const { return region_.name(); }
+    explicit operator bool() const { return static_cast<bool>(region_); }
+
+    // Whole mapping, for placement calls such as NUMA binding.
+    uint8_t* mapping() const { return region_.data(); }
+    size_t mapping_bytes() const { return region_.size(); }
+
+private:
+    SlotRingHeader* header() const { return reinterpret_cast<SlotRingHeader*>(region_.data()); }
+    // Offsets come from the geometry seen at map time, never from the live
+    // header, so a recreated region cannot send them past the mapping.
+    SlotHeader* slot_header(uint32_t index) const {
+        uint8_t* base = region_.data() + sizeof(SlotRingHeader);
+        return reinterpret_cast<SlotHeader*>(base + index * (sizeof(SlotHeader) + slot_bytes_));
+    }
+    uint8_t* slot_data(uint32_t index) const { return reinterpret_cast<uint8_t*>(slot_header(index) + 1); }
+    size_t total_bytes() const { return sizeof(SlotRingHeader) + static_cast<size_t>(slots_) * (sizeof(SlotHeader) + slot_bytes_); }
+
+    SharedRegion region_;
+    uint32_t slots_ = 0;
+    size_t slot_bytes_ = 0;
+};
+
+// (Re)creates `ring` so its slots hold `bytes`. Readers keep their mapping
+// of a ring, so one that has to grow is published under a new name
+// (`<base>_g<n>`) instead of being resized in place; messages name their
+// ring, so consumers follow. Returns true if a ring was created.
+inline bool ensure_slot_ring(std::unique_ptr<SlotRing>& ring, const std::string& base, uint32_t slots, size_t bytes) {
+    if (ring && ring->slot_bytes() >= bytes) return false;
+    std::string name = base;
+    if (ring) {
+        const std::string& old = ring->name();
+        const unsigned long gen = old.size() > base.size() + 2 ? std::strtoul(old.c_str() + base.size() + 2, nullptr, 10) : 0;
+        name = base + "_g" + std::to_string(gen + 1);
+        // Readers that already mapped the old ring keep it; new ones fail
+        // the frames still in flight there instead of reading stale pixels.
+        shm_unlink(old.c_str());
+    }
+    ring = std::make_unique<SlotRing>(SlotRing::create(name, slots, bytes));
+    return true;
+}
+
+}  // namespace camel
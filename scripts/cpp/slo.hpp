@@ -0,0 +1,184 @@
+// Latency SLOs per route, evaluated from the stage latency histograms.
+//
+// An SLO says that `objective` of a route's messages (0.99 for a p99
+// target) finish each stage within `target_ms`, measured over `window`.
+// Every sample adds the messages each stage handled since the last one and
+// how many of them were slow. Slow counts come from the log2 histograms,
+// interpolating inside the bucket that holds the target. A route is as bad
+// as its worst stage. Handler time excludes pipe and queue time, so this is
+// a lower bound on end-to-end latency.
+//
+// Alerting follows the multiwindow burn-rate rules: burn rate is the slow
+// share divided by the error budget (1 - objective). An alert fires when
+// both a long and a short window burn fast enough to spend a fixed part of
+// the budget:
+//   critical  2% of the budget in 1 h, confirmed over 5 min
+//   warning   5% of the budget in 6 h, confirmed over 30 min
+// For a 30 day window these are the usual 14.4x and 6x thresholds. A rule
+// is only applied once the history spans its short window; before that
+// every window sees the same few seconds and one slow burst would fire it.
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <iterator>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "stage_metrics.hpp"
+
+namespace camel {
+
+struct SloConfig {
+    std::string route;
+    std::string stage;                // only this stage; empty = all
+    double target_ms = 0.0;
+    double objective = 0.99;
+    double window_s = 30 * 86400.0;
+    std::vector<std::string> notify;  // log:// and email:// targets
+};
+
+// Messages in the histogram slower than target_us; the bucket holding the
+// target counts in proportion to the part of its range above it.
+inline double slow_count(const uint64_t* latency, double target_us) {
+    double slow = 0.0;
+    for (int i = 0; i < kLatencyBuckets; ++i) {
+        if (!latency[i]) continue;
+        const double lo = i == 0 ? 0.0 : latency_bucket_bound_us(i - 1), hi = latency_bucket_bound_us(i);
+        if (lo >= target_us) slow += static_cast<double>(latency[i]);
+        else if (hi > target_us) slow += static_cast<double>(latency[i]) * (hi - target_us) / (hi - lo);
+    }
+    return slow;
+}
+
+struct SloWindow {
+    const char* name;
+    double seconds;
+};
+
+inline constexpr SloWindow kSloWindows[] = {{"5m", 300}, {"30m", 1800}, {"1h", 3600}, {"6h", 21600}};
+
+enum class SloLevel { Ok, Warning, Critical };
+
+inline const char* slo_level_name(SloLevel l) {
+    switch (l) {
+        case SloLevel::Ok: return "ok";
+        case SloLevel::Warning: return "warning";
+        case SloLevel::Critical: return "critical";
+    }
+    return "ok";
+}
+
+struct SloStatus {
+    double burn[std::size(kSloWindows)] = {};
+    double compliance = 1.0;      // good share over the SLO window so far
+    double budget_remaining = 1.0;
+    double covered_s = 0.0;       // history the figures are based on
+    std::string worst_stage;
+    SloLevel level = SloLevel::Ok;
+    double critical_threshold = 0.0, warning_threshold = 0.0;
+};
+
+class SloTracker {
+public:
+    explicit SloTracker(SloConfig cfg) : cfg_(std::move(cfg)) {
+        critical_ = std::max(1.0, 0.02 * cfg_.window_s / 3600);
+        warning_ = std::max(1.0, 0.05 * cfg_.window_s / 21600);
+        coarse_step_ = std::max(600.0, cfg_.window_s / 4320);
+    }
+
+    const SloConfig& config() const { return cfg_; }
+
+    // One stage block of this route; counters of restarted processes
+    // continue from where the stage left off.
+    void observe(const StageSample& s) {
+        if (s.route != cfg_.route || (!cfg_.stage.empty() && s.stage != cfg_.stage)) return;
+        uint64_t total = 0;
+        for (int i = 0; i < kLatencyBuckets; ++i) total += s.latency[i];
+        const double slow = slow_count(s.latency, cfg_.target_ms * 1000.0);
+        Block& b = blocks_[s.shm];
+        Stage& st = stages_[s.stage];
+        if (total >= b.total) {
+            st.total += static_cast<double>(total - b.total);
+            st.slow += std::max(0.0, slow - b.slow);
+        }
+        b = {total, slow, true};
+    }
+
+    // Closes a sample: forgets blocks that were not seen and records the
+    // counters for the windows.
+    SloStatus evaluate(double now) {
+        for (auto it = blocks_.begin(); it != blocks_.end();) {
+            if (!it->second.seen) it = blocks_.erase(it);
+            else (it++)->second.seen = false;
+        }
+        SloStatus status;
+        status.critical_threshold = critical_;
+        status.warning_threshold = warning_;
+        const double budget = 1.0 - cfg_.objective;
+        double worst_share = 0.0;
+        for (auto& [name, st] : stages_) {
+            append(st.fine, now, st, 60.0, 21600.0);
+            append(st.coarse, now, st, coarse_step_, cfg_.window_s);
+            for (size_t w = 0; w < std::size(kSloWindows); ++w) {
+                const double share = slow_share(st, now - kSloWindows[w].seconds);
+                status.burn[w] = std::max(status.burn[w], budget > 0 ? share / budget : 0.0);
+            }
+            const double share = slow_share(st, now - cfg_.window_s);
+            if (share >= worst_share) {
+                worst_share = share;
+                status.worst_stage = name;
+            }
+            if (!st.coarse.empty()) status.covered_s = std::max(status.covered_s, now - st.coarse.front().time);
+        }
+        status.compliance = 1.0 - worst_share;
+        status.budget_remaining = budget > 0 ? 1.0 - worst_share / budget : 0.0;
+        const bool covers_5m = status.covered_s >= kSloWindows[0].seconds;
+        const bool covers_30m = status.covered_s >= kSloWindows[1].seconds;
+        if (covers_5m && status.burn[2] > critical_ && status.burn[0] > critical_) status.level = SloLevel::Critical;
+        else if (covers_30m && status.burn[3] > warning_ && status.burn[1] > warning_) status.level = SloLevel::Warning;
+        return status;
+    }
+
+private:
+    struct Block {
+        uint64_t total = 0;
+        double slow = 0.0;
+        bool seen = false;
+    };
+    struct Point {
+        double time, total, slow;
+    };
+    struct Stage {
+        double total = 0.0, slow = 0.0;  // cumulative
+        std::deque<Point> fine;          // one point a minute for 6 h
+        std::deque<Point> coarse;        // spans the SLO window
+    };
+
+    static void append(std::deque<Point>& points, double now, const Stage& st, double step, double span) {
+        if (points.empty() || now - points.back().time >= step) points.push_back({now, st.total, st.slow});
+        while (points.size() > 2 && now - points[1].time >= span) points.pop_front();
+    }
+
+    // Slow share since `from`, against the oldest point at or after it; a
+    // window longer than the history uses all of it.
+    static double slow_share(const Stage& st, double from) {
+        const std::deque<Point>& points = !st.fine.empty() && st.fine.front().time <= from ? st.fine : st.coarse;
+        if (points.empty()) return 0.0;
+        auto it = std::lower_bound(points.begin(), points.end(), from,
+                                   [](const Point& p, double t) { return p.time < t; });
+        if (it == points.end()) --it;
+        const double total = st.total - it->total;
+        return total > 0 ? (st.slow - it->slow) / total : 0.0;
+    }
+
+    SloConfig cfg_;
+    double critical_ = 14.4, warning_ = 6.0, coarse_step_ = 600.0;
+    std::map<std::string, Block> blocks_;  // by shm name
+    std::map<std::string, Stage> stages_;  // by stage name
+};
+
+}  // namespace camel
@@ -0,0 +1,198 @@
+// Per-process stage counters in shared memory, read by cpp_monitor.
+//
+// Every processor publishes one `/camel_stage_<pid>` block. The message
+// loop is its only writer and updates plain relaxed atomics, so the hot path
+// never takes a lock and never talks to the monitor; the monitor maps the
+// blocks and samples them on its own schedule. The block is unlinked when
+// the processor exits cleanly; the monitor reports a block whose process is
+// gone as failed and removes it later.
+//
+// Environment:
+//   CAMEL_ROUTE      route the stage belongs to, default "default"
+//   CAMEL_METRICS    "off" disables the block
+#pragma once
+
+#include <dirent.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "shm.hpp"
+
+namespace camel {
+
+// Bucket i counts latencies below 2^i microseconds (bucket 0: under 1 us);
+// the last bucket is open ended (over ~2 minutes).
+constexpr int kLatencyBuckets = 28;
+
+inline int latency_bucket(uint64_t us) {
+    int b = us == 0 ? 0 : 64 - __builtin_clzll(us);
+    return std::min(b, kLatencyBuckets - 1);
+}
+
+// Upper bound of bucket i in microseconds.
+inline double latency_bucket_bound_us(int i) { return static_cast<double>(1ull << i); }
+
+struct StageMetricsBlock {
+    static constexpr uint32_t kMagic = 0x5453524d;  // "MRST"
+    static constexpr uint32_t kVersion = 3;
+
+    uint32_t magic;
+    uint32_t version;
+    int32_t pid;
+    uint32_t reserved0;
+    uint64_t started_unix_ms;
+    char route[64];
+    char stage[64];
+    std::atomic<uint64_t> received;
+    std::atomic<uint64_t> forwarded;
+    std::atomic<uint64_t> dropped;
+    std::atomic<uint64_t> errors;
+    std::atomic<uint64_t> busy_ns;       // time spent in the handler
+    std::atomic<uint64_t> last_unix_ms;  // last message handled
+    std::atomic<uint64_t> latency[kLatencyBuckets];
+    // Profile requests from cpp_monitor (profiler.hpp): the monitor sets
+    // the window, hz and a start deadline, then bumps profile_seq; the stage
+    // stores the served sequence in profile_done once the result is out. A
+    // monitor that gives up clears profile_expires_ms.
+    std::atomic<uint32_t> profile_ms;
+    std::atomic<uint32_t> profile_hz;
+    std::atomic<uint64_t> profile_expires_ms;  // start no later than this
+    std::atomic<uint64_t> profile_seq;
+    std::atomic<uint64_t> profile_done;
+};
+
+inline uint64_t unix_ms_now() {
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count());
+}
+
+// Writer side, one per process.
+class StageMetrics {
+public:
+    enum class Outcome { Forwarded, Dropped, Error };
+
+    static StageMetrics& instance() {
+        static StageMetrics metrics;
+        return metrics;
+    }
+
+    ~StageMetrics() {
+        if (block_) shm_unlink(name_.c_str());
+    }
+
+    // Creates the block for this process; later calls are no-ops.
+    void open(const std::string& stage) {
+        if (block_ || disabled_) return;
+        const char* off = std::getenv("CAMEL_METRICS");
+        if (off && std::strcmp(off, "off") == 0) {
+            disabled_ = true;
+            return;
+        }
+        const char* route = std::getenv("CAMEL_ROUTE");
+        name_ = "/camel_stage_" + std::to_string(::getpid());
+        try {
+            region_ = SharedRegion::create(name_, sizeof(StageMetricsBlock));
+        } catch (const std::exception&) {
+            disabled_ = true;  // no /dev/shm: run without metrics
+            return;
+        }
+        auto* b = reinterpret_cast<StageMetricsBlock*>(region_.data());
+        std::memset(static_cast<void*>(b), 0, sizeof(*b));
+        b->version = StageMetricsBlock::kVersion;
+        b->pid = static_cast<int32_t>(::getpid());
+        b->started_unix_ms = unix_ms_now();
+        std::strncpy(b->route, route && *route ? route : "default", sizeof(b->route) - 1);
+        std::strncpy(b->stage, stage.c_str(), sizeof(b->stage) - 1);
+        std::atomic_thread_fence(std::memory_order_release);
+        b->magic = StageMetricsBlock::kMagic;
+        block_ = b;
+    }
+
+    void received() {
+        if (block_) block_->received.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void done(Outcome outcome, uint64_t busy_ns) {
+        if (!block_) return;
+        std::atomic<uint64_t>& counter = outcome == Outcome::Forwarded ? block_->forwarded
+                                         : outcome == Outcome::Dropped ? block_->dropped
+                                                                       : block_->errors;
+        counter.fetch_add(1, std::memory_order_relaxed);
+        block_->busy_ns.fetch_add(busy_ns, std::memory_order_relaxed);
+        block_->latency[latency_bucket(busy_ns / 1000)].fetch_add(1, std::memory_order_relaxed);
+        block_->last_unix_ms.store(unix_ms_now(), std::memory_order_relaxed);
+    }
+
+    StageMetricsBlock* block() const { return block_; }
+
+private:
+    StageMetrics() = default;
+
+    std::string name_;
+    SharedRegion region_;
+    StageMetricsBlock* block_ = nullptr;
+    bool disabled_ = false;
+};
+
+// Reader side: a copy of one block.
+struct StageSample {
+    std::string shm;
+    std::string route;
+    std::string stage;
+    int pid = 0;
+    bool alive = false;
+    uint64_t started_unix_ms = 0;
+    uint64_t received = 0, forwarded = 0, dropped = 0, errors = 0;
+    uint64_t busy_ns = 0;
+    uint64_t last_unix_ms = 0;
+    uint64_t latency[kLatencyBuckets] = {};
+};
+
+// Maps every stage block on the node and copies its counters.
+inline std::vector<StageSample> sample_stages() {
+    std::vector<StageSample> out;
+    DIR* dir = opendir("/dev/shm");
+    if (!dir) return out;
+    while (dirent* e = readdir(dir)) {
+        if (std::strncmp(e->d_name, "camel_stage_", 12) != 0) continue;
+        StageSample s;
+        s.shm = std::string("/") + e->d_name;
+        try {
+            SharedRegion r = SharedRegion::open(s.shm);
+            if (r.size() < sizeof(StageMetricsBlock)) continue;
+            const auto* b = reinterpret_cast<const StageMetricsBlock*>(r.data());
+            if (b->magic != StageMetricsBlock::kMagic || b->version != StageMetricsBlock::kVersion) continue;
+            std::atomic_thread_fence(std::memory_order_acquire);
+            s.route.assign(b->route, strnlen(b->route, sizeof(b->route)));
+            s.stage.assign(b->stage, strnlen(b->stage, sizeof(b->stage)));
+            s.pid = b->pid;
+            s.alive = ::kill(b->pid, 0) == 0 || errno == EPERM;
+            s.started_unix_ms = b->started_unix_ms;
+            s.received = b->received.load(std::memory_order_relaxed);
+            s.forwarded = b->forwarded.load(std::memory_order_relaxed);
+            s.dropped = b->dropped.load(std::memory_order_relaxed);
+            s.errors = b->errors.load(std::memory_order_relaxed);
+            s.busy_ns = b->busy_ns.load(std::memory_order_relaxed);
+            s.last_unix_ms = b->last_unix_ms.load(std::memory_order_relaxed);
+            for (int i = 0; i < kLatencyBuckets; ++i) s.latency[i] = b->latency[i].load(std::memory_order_relaxed);
+        } catch (const std::exception&) {
+            continue;  // unlinked between readdir and open
+        }
+        out.push_back(std::move(s));
+    }
+    closedir(dir);
+    return out;
+}
+
+}  // namespace camel
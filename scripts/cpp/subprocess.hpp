@@ -0,0 +1,150 @@
+// Child processes with piped stdin/stdout (ffmpeg ingest and muxing).
+//
+// Arguments are passed as a vector and exec'd directly, so camera URLs and
+// paths from config never go through a shell.
+#pragma once
+
+#include <fcntl.h>
+#include <sched.h>
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace camel {
+
+class Subprocess {
+public:
+    enum Pipe { None = 0, Stdin = 1, Stdout = 2 };
+
+    Subprocess() = default;
+    Subprocess(const Subprocess&) = delete;
+    Subprocess& operator=(const Subprocess&) = delete;
+    Subprocess(Subprocess&& o) noexcept { *this = std::move(o); }
+    Subprocess& operator=(Subprocess&& o) noexcept {
+        if (this != &o) {
+            kill_and_wait();
+            pid_ = o.pid_;
+            in_ = o.in_;
+            out_ = o.out_;
+            o.pid_ = -1;
+            o.in_ = o.out_ = -1;
+        }
+        return *this;
+    }
+    ~Subprocess() { kill_and_wait(); }
+
+    // Starts argv[0] (looked up in PATH). stderr is inherited so tool errors
+    // end up in the processor log. A non-empty `cpus` pins the child.
+    static Subprocess spawn(const std::vector<std::string>& argv, int pipes, const std::vector<int>& cpus = {}) {
+        if (argv.empty()) throw std::runtime_error("empty command");
+        int in[2] = {-1, -1}, out[2] = {-1, -1};
+        if ((pipes & Stdin) && pipe2(in, O_CLOEXEC) != 0) throw std::runtime_error("pipe failed");
+        if ((pipes & Stdout) && pipe2(out, O_CLOEXEC) != 0) throw std::runtime_error("pipe failed");
+
+        std::vector<char*> args;
+        for (const auto& a : argv) args.push_back(const_cast<char*>(a.c_str()));
+        args.push_back(nullptr);
+
+        pid_t pid = fork();
+        if (pid < 0) throw std::runtime_error(std::string("fork failed: ") + std::strerror(errno));
+        if (pid == 0) {
+            if (!cpus.empty()) {
+                cpu_set_t set;
+                CPU_ZERO(&set);
+                for (int c : cpus) CPU_SET(c, &set);
+                sched_setaffinity(0, sizeof(set), &set);
+            }
+            if (pipes & Stdin) dup2(in[0], STDIN_FILENO);
+            else dup2(open("/dev/null", O_RDONLY), STDIN_FILENO);
+            if (pipes & Stdout) dup2(out[1], STDOUT_FILENO);
+            else dup2(open("/dev/null", O_WRONLY), STDOUT_FILENO);
+            execvp(args[0], args.data());
+            _exit(127);
+        }
+        Subprocess p;
+        p.pid_ = pid;
+        if (pipes & Stdin) {
+            close(in[0]);
+            p.in_ = in[1];
+        }
+        if (pipes & Stdout) {
+            close(out[1]);
+            p.out_ = out[0];
+        }
+        return p;
+    }
+
+    bool running() const { return pid_ > 0; }
+    int stdout_fd() const { return out_; }
+    int stdin_fd() const { return in_; }
+
+    // Reads up to n bytes of the child's stdout; 0 on end of stream.
+    ssize_t read(void* buf, size_t n) {
+        for (;;) {
+            ssize_t r = ::read(out_, buf, n);
+            if (r >= 0 || errno != EINTR) return r;
+        }
+    }
+
+    // Writes all bytes to the child's stdin; false once the child is gone.
+    bool write(const void* data, size_t n) {
+        const auto* p = static_cast<const uint8_t*>(data);
+        while (n > 0) {
+            ssize_t w = ::write(in_, p, n);
+            if (w < 0) {
+                if (errno == EINTR) continue;
+                return false;
+            }
+            p += w;
+            n -= static_cast<size_t>(w);
+        }
+        return true;
+    }
+
+    void close_stdin() {
+        if (in_ >= 0) ::close(in_);
+        in_ = -1;
+    }
+
+    // Closes the pipes and waits; returns the exit status (-1 if signalled).
+    int wait() {
+        close_stdin();
+        if (out_ >= 0) ::close(out_);
+        out_ = -1;
+        if (pid_ <= 0) return -1;
+        int status = 0;
+        while (waitpid(pid_, &status, 0) < 0 && errno == EINTR) {
+        }
+        pid_ = -1;
+        return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+    }
+
+    void terminate() {
+        if (pid_ > 0) ::kill(pid_, SIGTERM);
+    }
+
+private:
+    void kill_and_wait() {
+        if (pid_ > 0) {
+            ::kill(pid_, SIGKILL);
+            wait();
+        }
+        close_stdin();
+        if (out_ >= 0) ::close(out_);
+        out_ = -1;
+    }
+
+    pid_t pid_ = -1;
+    int in_ = -1;
+    int out_ = -1;
+};
+
+}  // namespace camel
@@ -0,0 +1,221 @@
+// Tiled inference on high-resolution frames.
+//
+// A frame is cut into overlapping tiles that are letterboxed into one batch
+// tensor, so small objects are seen near native resolution instead of being
+// lost to a single downscale. Objects crossing a seam show up as fragments
+// in neighbouring tiles; merge_tiles() joins them with a coordinate-aware NMS
+// that knows where each tile ends.
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <numeric>
+#include <stdexcept>
+#include <vector>
+
+#include "json.hpp"
+#include "nms.hpp"
+#include "preprocess.hpp"
+#include "yolo.hpp"
+
+namespace camel {
+
+// Rectangle in fractions of the frame size, so one config serves every
+// stream resolution of a camera.
+struct Region {
+    float x = 0.0f;
+    float y = 0.0f;
+    float w = 1.0f;
+    float h = 1.0f;
+
+    Rect to_pixels(int frame_w, int frame_h) const {
+        int x0 = static_cast<int>(std::floor(x * frame_w)), y0 = static_cast<int>(std::floor(y * frame_h));
+        int x1 = static_cast<int>(std::ceil((x + w) * frame_w)), y1 = static_cast<int>(std::ceil((y + h) * frame_h));
+        return {x0, y0, x1 - x0, y1 - y0};
+    }
+};
+
+// "regions_of_interest": [[x, y, w, h], ...]
+inline std::vector<Region> parse_regions(const json::Value& v) {
+    std::vector<Region> regions;
+    if (!v.is_array()) return regions;
+    for (const auto& r : v.as_array()) {
+        if (!r.is_array() || r.size() != 4) throw std::runtime_error("region of interest must be [x, y, w, h]");
+        Region g{static_cast<float>(r[0].as_number()), static_cast<float>(r[1].as_number()),
+                 static_cast<float>(r[2].as_number()), static_cast<float>(r[3].as_number())};
+        if (g.w <= 0.0f || g.h <= 0.0f || g.x < 0.0f || g.y < 0.0f || g.x + g.w > 1.0f + 1e-6f || g.y + g.h > 1.0f + 1e-6f)
+            throw std::runtime_error("region of interest must lie within the frame (fractions of 0..1)");
+        regions.push_back(g);
+    }
+    return regions;
+}
+
+inline bool rects_overlap(const Rect& a, const Rect& b) {
+    return a.x < b.x + b.w && b.x < a.x + a.w && a.y < b.y + b.h && b.y < a.y + a.h;
+}
+
+struct TilingOptions {
+    int tile_width = 640;    // source pixels; equal to the model input for 1:1 tiles
+    int tile_height = 640;
+    float overlap = 0.2f;    // fraction of a tile shared with its neighbour
+    bool full_frame = true;  // also run the downscaled frame, for objects larger than a tile
+
+    // "tiling": {"tile_size": 640, "overlap": 0.2, "full_frame": true}
+    static TilingOptions from_json(const json::Value& v, int input_w, int input_h) {
+        TilingOptions o;
+        o.tile_width = static_cast<int>(v.number_or("tile_size", input_w));
+        o.tile_height = static_cast<int>(std::lround(static_cast<double>(o.tile_width) * input_h / input_w));
+        o.overlap = static_cast<float>(v.number_or("overlap", o.overlap));
+        o.full_frame = v.bool_or("full_frame", o.full_frame);
+        if (o.tile_width < 32 || o.tile_height < 32) throw std::runtime_error("tile_size must be at least 32");
+        if (o.overlap < 0.0f || o.overlap >= 0.9f) throw std::runtime_error("overlap must be in [0, 0.9)");
+        return o;
+    }
+};
+
+// Evenly spread tile origins along one axis; the first tile starts at 0
+// and the last one ends at the frame edge.
+inline std::vector<int> tile_starts(int length, int tile, float overlap) {
+    if (length <= tile) return {0};
+    int stride = std::max(1, static_cast<int>(tile * (1.0f - overlap)));
+    int count = (length - tile + stride - 1) / stride + 1;
+    std::vector<int> starts(count);
+    for (int i = 0; i < count; ++i)
+        starts[i] = static_cast<int>(static_cast<int64_t>(i) * (length - tile) / (count - 1));
+    return starts;
+}
+
+// Crops to run for one frame: `area` itself first (if full_frame is set),
+// then a tile grid over `area`, keeping the tiles that overlap one of `rois`
+// (all tiles when empty). `area` is the whole frame unless ROI zones narrow
+// it down.
+inline std::vector<Rect> plan_tiles(const Rect& area, const TilingOptions& o, const std::vector<Rect>& rois) {
+    std::vector<Rect> crops;
+    if (o.full_frame) crops.push_back(area);
+    const int tw = std::min(o.tile_width, area.w), th = std::min(o.tile_height, area.h);
+    for (int y : tile_starts(area.h, th, o.overlap)) {
+        for (int x : tile_starts(area.w, tw, o.overlap)) {
+            Rect tile{area.x + x, area.y + y, tw, th};
+            if (rois.empty() || std::any_of(rois.begin(), rois.end(), [&](const Rect& r) { return rects_overlap(tile, r); }))
+                crops.push_back(tile);
+        }
+    }
+    return crops;
+}
+
+inline json::Value rects_to_json(const std::vector<Rect>& rects) {
+    json::Value list = json::Value::array();
+    for (const auto& r : rects) {
+        json::Value v = json::Value::array();
+        for (int c : {r.x, r.y, r.w, r.h}) v.push_back(c);
+        list.push_back(std::move(v));
+    }
+    return list;
+}
+
+inline std::vector<Rect> rects_from_json(const json::Value& v) {
+    std::vector<Rect> rects;
+    for (const auto& r : v.as_array())
+        rects.push_back({static_cast<int>(r[0].as_number()), static_cast<int>(r[1].as_number()),
+                         static_cast<int>(r[2].as_number()), static_cast<int>(r[3].as_number())});
+    return rects;
+}
+
+// Per-item detections of a tiled batch as one list for the frame, by
+// descending score, each tagged with the batch item ("tile") it came from.
+inline void write_tiled_detections(json::Value& message, const std::vector<std::vector<Detection>>& per_tile,
+                                   const ClassNames& names) {
+    std::vector<Detection> all;
+    std::vector<int> tile_of;
+    for (size_t t = 0; t < per_tile.size(); ++t) {
+        all.insert(all.end(), per_tile[t].begin(), per_tile[t].end());
+        tile_of.insert(tile_of.end(), per_tile[t].size(), static_cast<int>(t));
+    }
+    std::vector<uint32_t> order(all.size());
+    std::iota(order.begin(), order.end(), 0u);
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return all[a].score > all[b].score; });
+    std::vector<Detection> sorted;
+    for (uint32_t i : order) sorted.push_back(all[i]);
+    write_detections(message, sorted, names);
+    json::Value& list = message["detections"];
+    for (size_t i = 0; i < order.size(); ++i) list[i]["tile"] = tile_of[order[i]];
+}
+
+struct TileMergeOptions {
+    NmsOptions nms;
+    float ios_threshold = 0.6f;  // intersection over the smaller box, for seam fragments
+    float seam_margin = 4.0f;    // pixels from an inner tile edge that count as cut
+
+    static TileMergeOptions from_json(const json::Value& c) {
+        TileMergeOptions o;
+        o.nms.iou_threshold = static_cast<float>(c.number_or("iou_threshold", o.nms.iou_threshold));
+        o.nms.class_aware = !c.bool_or("class_agnostic", false);
+        o.nms.max_detections = static_cast<size_t>(c.number_or("max_detections", 300));
+        o.ios_threshold = static_cast<float>(c.number_or("ios_threshold", o.ios_threshold));
+        o.seam_margin = static_cast<float>(c.number_or("seam_margin", o.seam_margin));
+        return o;
+    }
+};
+
+struct MergedDetection {
+    uint32_t index;  // into the input list
+    Box box;         // grown to the union of the fragments it absorbed
+};
+
+// Greedy NMS across tiles. Boxes from the same tile use plain IoU. A box that
+// touches a tile edge lying inside the frame was probably cut by the seam,
+// so across tiles a pair also matches when most of the smaller box lies in
+// the larger one (IoU of a fragment and the whole object is low). Fragments
+// are merged into the surviving box instead of only being suppressed.
+inline std::vector<MergedDetection> merge_tiles(const std::vector<Detection>& dets, const std::vector<int>& tile_of,
+                                                const std::vector<Rect>& tiles, int frame_w, int frame_h,
+                                                const TileMergeOptions& opt) {
+    const float m = opt.seam_margin;
+    auto cut = [&](size_t i) {
+        int t = tile_of[i];
+        if (t < 0 || static_cast<size_t>(t) >= tiles.size()) return false;
+        const Rect& r = tiles[t];
+        const Box& b = dets[i].box;
+        return (r.x > 0 && b.x1 <= r.x + m) || (r.y > 0 && b.y1 <= r.y + m) ||
+               (r.x + r.w < frame_w && b.x2 >= r.x + r.w - m) || (r.y + r.h < frame_h && b.y2 >= r.y + r.h - m);
+    };
+
+    std::vector<uint32_t> order(dets.size());
+    std::iota(order.begin(), order.end(), 0u);
+    std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return dets[a].score > dets[b].score; });
+    std::vector<uint8_t> is_cut(dets.size()), suppressed(dets.size(), 0);
+    for (size_t i = 0; i < dets.size(); ++i) is_cut[i] = cut(i);
+
+    std::vector<MergedDetection> kept;
+    for (size_t i = 0; i < order.size() && kept.size() < opt.nms.max_detections; ++i) {
+        uint32_t a = order[i];
+        if (suppressed[a]) continue;
+        MergedDetection out{a, dets[a].box};
+        bool fragment = is_cut[a];
+        for (size_t j = i + 1; j < order.size(); ++j) {
+            uint32_t b = order[j];
+            if (suppressed[b]) continue;
+            if (opt.nms.class_aware && dets[b].class_id != dets[a].class_id) continue;
+            const Box& bb = dets[b].box;
+            float inter = intersection_area(out.box, bb);
+            if (inter <= 0.0f) continue;
+            float area_a = out.box.area(), area_b = bb.area();
+            float uni = area_a + area_b - inter;
+            bool overlap = uni > 0.0f && inter > opt.nms.iou_threshold * uni;
+            bool seam = tile_of[b] != tile_of[a] && (fragment || is_cut[b]) &&
+                        inter > opt.ios_threshold * std::min(area_a, area_b);
+            if (!overlap && !seam) continue;
+            suppressed[b] = 1;
+            if (seam) {
+                out.box = {std::min(out.box.x1, bb.x1), std::min(out.box.y1, bb.y1), std::max(out.box.x2, bb.x2),
+                           std::max(out.box.y2, bb.y2)};
+                fragment = fragment || is_cut[b];
+            }
+        }
+        kept.push_back(out);
+    }
+    return kept;
+}
+
+}  // namespace camel
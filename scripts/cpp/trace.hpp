@@ -0,0 +1,429 @@
+// Per-message tracing across processors.
+//
+// The trace context travels inside the message, so it crosses every stage
+// whatever language the stage is written in:
+//   "trace": {"traceparent": "00-<32 hex trace id>-<16 hex span id>-01",
+//             "start_us": 1760000000123456,
+//             "spans": [["cpp_preprocessor", "<span id>", "<parent id>",
+//                        start_us, end_us, 0], ...]}
+// `traceparent` is W3C Trace Context; its span id is the parent for the next
+// stage and its last field carries the head-sampling decision. A stage
+// started with a TRACEPARENT environment variable uses it for messages that
+// arrive without a context.
+//
+// Head-sampled traces are exported span by span by every stage. For the
+// others each stage appends its span to the compact `spans` list (up to
+// kMaxInbandSpans); when a trace turns out slow (older than
+// CAMEL_TRACE_SLOW_MS at the end of a stage) or fails, that stage exports
+// the whole list and flips the trace to sampled, so one slow alert yields
+// one complete trace without exporting every message.
+//
+// Spans are collected in a thread-local buffer and written by a background
+// thread as OTLP/JSON lines (one ExportTraceServiceRequest per line, the
+// format read by the OpenTelemetry Collector's otlpjsonfile receiver).
+// Several processes may append to the same file.
+//
+// Environment:
+//   CAMEL_TRACE            output file; tracing is off when unset
+//   CAMEL_TRACE_SAMPLE     head-sampling ratio, default 0.01
+//   CAMEL_TRACE_SLOW_MS    tail-sampling threshold, default 0 (off)
+#pragma once
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "json.hpp"
+
+namespace camel {
+
+struct TraceId {
+    uint64_t hi = 0, lo = 0;
+    bool valid() const { return hi || lo; }
+};
+
+struct SpanRecord {
+    TraceId trace;
+    uint64_t span = 0;
+    uint64_t parent = 0;
+    std::string name;
+    uint64_t start_us = 0;
+    uint64_t end_us = 0;
+    bool error = false;
+    std::string message_id;
+    std::string detail;  // error text, or "dropped"
+};
+
+namespace detail {
+
+inline void put_hex(std::string& out, uint64_t v) {
+    static const char digits[] = "0123456789abcdef";
+    for (int shift = 60; shift >= 0; shift -= 4) out += digits[(v >> shift) & 0xf];
+}
+
+inline bool parse_hex(const std::string& s, size_t pos, uint64_t& v) {
+    if (pos + 16 > s.size()) return false;
+    v = 0;
+    for (size_t i = pos; i < pos + 16; ++i) {
+        const char c = s[i];
+        const int d = c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10 : -1;
+        if (d < 0) return false;
+        v = (v << 4) | static_cast<uint64_t>(d);
+    }
+    return true;
+}
+
+inline uint64_t random_id() {
+    thread_local std::mt19937_64 rng(std::random_device{}() ^
+                                     static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count()));
+    uint64_t v;
+    do v = rng();
+    while (v == 0);
+    return v;
+}
+
+}  // namespace detail
+
+inline uint64_t trace_now_us() {
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count());
+}
+
+inline std::string hex_id(uint64_t v) {
+    std::string s;
+    detail::put_hex(s, v);
+    return s;
+}
+
+inline std::string format_traceparent(const TraceId& t, uint64_t span, bool sampled) {
+    std::string s = "00-";
+    detail::put_hex(s, t.hi);
+    detail::put_hex(s, t.lo);
+    s += '-';
+    detail::put_hex(s, span);
+    s += sampled ? "-01" : "-00";
+    return s;
+}
+
+inline bool parse_traceparent(const std::string& s, TraceId& t, uint64_t& span, bool& sampled) {
+    if (s.size() < 55 || s[2] != '-' || s[35] != '-' || s[52] != '-') return false;
+    if (!detail::parse_hex(s, 3, t.hi) || !detail::parse_hex(s, 19, t.lo) || !detail::parse_hex(s, 36, span)) return false;
+    sampled = s[54] == '1' || s[54] == '3';
+    return t.valid() && span != 0;
+}
+
+// One stage's work on one message.
+struct Span {
+    bool active = false;
+    bool sampled = false;
+    TraceId trace;
+    uint64_t id = 0;
+    uint64_t parent = 0;
+    uint64_t trace_start_us = 0;
+    uint64_t start_us = 0;
+};
+
+class Tracer {
+public:
+    static constexpr size_t kMaxInbandSpans = 32;
+    static constexpr size_t kFlushSpans = 256;
+
+    // Process-wide tracer configured from the environment.
+    static Tracer& instance() {
+        static Tracer tracer;
+        return tracer;
+    }
+
+    ~Tracer() { shutdown(); }
+
+    bool enabled() const { return fd_ >= 0; }
+    void set_service(std::string name) { service_ = std::move(name); }
+
+    // Starts a span for a message, continuing its trace or starting one.
+    // `start_us` backdates the span, e.g. to when the message was queued.
+    Span begin(const json::Value& message, uint64_t start_us = 0) {
+        Span s;
+        if (!enabled()) return s;
+        s.active = true;
+        s.start_us = start_us ? start_us : trace_now_us();
+        s.id = detail::random_id();
+        const json::Value& ctx = message.get("trace");
+        bool sampled = false;
+        if (ctx.is_object() && parse_traceparent(ctx.string_or("traceparent", ""), s.trace, s.parent, sampled)) {
+            s.sampled = sampled;
+            s.trace_start_us = static_cast<uint64_t>(ctx.number_or("start_us", static_cast<double>(s.start_us)));
+        } else if (env_parent_.trace.valid()) {
+            s.trace = env_parent_.trace;
+            s.parent = env_parent_.id;
+            s.sampled = env_parent_.sampled;
+            s.trace_start_us = s.start_us;
+        } else {
+            s.trace = {detail::random_id(), detail::random_id()};
+            s.sampled = head_sample(s.trace);
+            s.trace_start_us = s.start_us;
+        }
+        return s;
+    }
+
+    // Root span of a message created by a source, started at `start_us`.
+    Span begin_root(uint64_t start_us) {
+        Span s;
+        if (!enabled()) return s;
+        s.active = true;
+        s.start_us = s.trace_start_us = start_us;
+        s.id = detail::random_id();
+        s.trace = {detail::random_id(), detail::random_id()};
+        s.sampled = head_sample(s.trace);
+        return s;
+    }
+
+    // Ends the span and writes the updated context into the message.
+    // `error` is the failure text, if any; dropped messages end their trace.
+    void end(Span& s, json::Value& message, const std::string& error = "", bool dropped = false) {
+        if (!s.active) return;
+        s.active = false;
+        SpanRecord r;
+        r.trace = s.trace;
+        r.span = s.id;
+        r.parent = s.parent;
+        r.name = service_;
+        r.start_us = s.start_us;
+        r.end_us = trace_now_us();
+        r.error = !error.empty();
+        r.detail = r.error ? error : dropped ? "dropped" : "";
+        if (message.is_object()) {
+            const json::Value& id = message.get("id");
+            if (id.is_string()) r.message_id = id.as_string();
+            else if (id.is_number()) r.message_id = std::to_string(static_cast<long long>(id.as_number()));
+        }
+        const bool slow = slow_us_ > 0 && r.end_us >= s.trace_start_us + slow_us_;
+        json::Value inband = json::Value::array();
+        if (message.is_object() && message.get("trace").is_object() && message.get("trace").get("spans").is_array())
+            inband = message.get("trace").get("spans");
+        if (!s.sampled && (slow || r.error)) {
+            // Tail decision: export what earlier stages left in the message.
+            for (const auto& v : inband.as_array()) push(from_inband(s.trace, v));
+            inband = json::Value::array();
+            s.sampled = true;
+        }
+        if (s.sampled) {
+            push(std::move(r));
+        } else if (inband.size() < kMaxInbandSpans) {
+            json::Value e = json::Value::array();
+            e.push_back(r.name);
+            e.push_back(hex_id(r.span));
+            e.push_back(hex_id(r.parent));
+            e.push_back(static_cast<double>(r.start_us));
+            e.push_back(static_cast<double>(r.end_us));
+            e.push_back(dropped ? 1 : 0);
+            inband.push_back(std::move(e));
+        }
+        if (!message.is_object() || dropped) return;
+        json::Value ctx = json::Value::object();
+        ctx["traceparent"] = format_traceparent(s.trace, s.id, s.sampled);
+        ctx["start_us"] = static_cast<double>(s.trace_start_us);
+        if (!s.sampled) ctx["spans"] = std::move(inband);
+        message["trace"] = std::move(ctx);
+    }
+
+    // Hands the calling thread's buffered spans to the writer; message loops
+    // call it before they return.
+    void flush() {
+        Buffer& b = buffer();
+        if (b.spans.empty()) return;
+        {
+            std::lock_guard<std::mutex> lock(mu_);
+            for (auto& r : b.spans) queue_.push_back(std::move(r));
+        }
+        b.spans.clear();
+        b.flushed = std::chrono::steady_clock::now();
+        cv_.notify_one();
+    }
+
+    // Writes out what was flushed and closes the file.
+    void shutdown() {
+        if (!enabled()) return;
+        {
+            std::lock_guard<std::mutex> lock(mu_);
+            stop_ = true;
+        }
+        cv_.notify_one();
+        if (writer_.joinable()) writer_.join();
+        ::close(fd_);
+        fd_ = -1;
+    }
+
+private:
+    struct Buffer {
+        std::vector<SpanRecord> spans;
+        std::chrono::steady_clock::time_point flushed = std::chrono::steady_clock::now();
+    };
+
+    Tracer() {
+        const char* path = std::getenv("CAMEL_TRACE");
+        if (!path || !*path) return;
+        if (const char* v = std::getenv("CAMEL_TRACE_SAMPLE")) sample_ = std::atof(v);
+        if (const char* v = std::getenv("CAMEL_TRACE_SLOW_MS")) slow_us_ = static_cast<uint64_t>(std::atof(v) * 1000.0);
+        if (const char* v = std::getenv("TRACEPARENT")) {
+            uint64_t span = 0;
+            if (parse_traceparent(v, env_parent_.trace, span, env_parent_.sampled)) env_parent_.id = span;
+        }
+        fd_ = ::open(path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        if (fd_ < 0) {
+            std::fprintf(stderr, "[trace] error: cannot open %s, tracing disabled\n", path);
+            return;
+        }
+        writer_ = std::thread([this] { write_loop(); });
+    }
+
+    // Same decision in every process for a given trace id.
+    bool head_sample(const TraceId& t) const {
+        if (sample_ >= 1.0) return true;
+        if (sample_ <= 0.0) return false;
+        return static_cast<double>(t.lo >> 11) * (1.0 / 9007199254740992.0) < sample_;
+    }
+
+    static SpanRecord from_inband(const TraceId& trace, const json::Value& v) {
+        SpanRecord r;
+        r.trace = trace;
+        if (!v.is_array() || v.size() < 6) return r;
+        r.name = v[0].is_string() ? v[0].as_string() : "";
+        if (v[1].is_string()) detail::parse_hex(v[1].as_string(), 0, r.span);
+        if (v[2].is_string()) detail::parse_hex(v[2].as_string(), 0, r.parent);
+        r.start_us = static_cast<uint64_t>(v[3].as_number());
+        r.end_us = static_cast<uint64_t>(v[4].as_number());
+        if (v[5].is_number() && v[5].as_number() == 1) r.detail = "dropped";
+        return r;
+    }
+
+    static Buffer& buffer() {
+        thread_local Buffer b;
+        return b;
+    }
+
+    void push(SpanRecord&& r) {
+        if (r.span == 0) return;
+        Buffer& b = buffer();
+        b.spans.push_back(std::move(r));
+        if (b.spans.size() >= kFlushSpans || std::chrono::steady_clock::now() - b.flushed > std::chrono::seconds(1)) flush();
+    }
+
+    void write_loop() {
+        std::vector<SpanRecord> batch;
+        std::string line;
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lock(mu_);
+                cv_.wait(lock, [&] { return stop_ || !queue_.empty(); });
+                if (queue_.empty() && stop_) return;
+                batch.swap(queue_);
+            }
+            line.clear();
+            encode(batch, line);
+            batch.clear();
+            // One write per line keeps lines from several processes whole.
+            const char* p = line.data();
+            size_t n = line.size();
+            while (n > 0) {
+                ssize_t w = ::write(fd_, p, n);
+                if (w < 0 && errno == EINTR) continue;
+                if (w <= 0) break;
+                p += w;
+                n -= static_cast<size_t>(w);
+            }
+        }
+    }
+
+    // One resourceSpans entry per stage, since spans exported by the tail
+    // decision come from earlier stages.
+    void encode(const std::vector<SpanRecord>& spans, std::string& out) const {
+        auto attr = [&](const char* key, const std::string& value, bool& first) {
+            out += first ? "" : ",";
+            first = false;
+            out += "{\"key\":\"";
+            out += key;
+            out += "\",\"value\":{\"stringValue\":";
+            json::detail::dump_string(out, value);
+            out += "}}";
+        };
+        std::vector<const std::string*> stages;
+        for (const auto& r : spans) {
+            bool seen = false;
+            for (const std::string* n : stages) seen = seen || *n == r.name;
+            if (!seen) stages.push_back(&r.name);
+        }
+        out += "{\"resourceSpans\":[";
+        for (size_t g = 0; g < stages.size(); ++g) {
+            if (g) out += ',';
+            out += "{\"resource\":{\"attributes\":[";
+            bool first = true;
+            attr("service.name", *stages[g], first);
+            out += "]},\"scopeSpans\":[{\"scope\":{\"name\":\"camel\"},\"spans\":[";
+            bool first_span = true;
+            for (const auto& r : spans) {
+                if (r.name != *stages[g]) continue;
+                if (!first_span) out += ',';
+                first_span = false;
+                encode_span(r, out, attr);
+            }
+            out += "]}]}";
+        }
+        out += "]}\n";
+    }
+
+    template <typename Attr>
+    static void encode_span(const SpanRecord& r, std::string& out, Attr& attr) {
+        out += "{\"traceId\":\"";
+        detail::put_hex(out, r.trace.hi);
+        detail::put_hex(out, r.trace.lo);
+        out += "\",\"spanId\":\"";
+        detail::put_hex(out, r.span);
+        out += '"';
+        if (r.parent) {
+            out += ",\"parentSpanId\":\"";
+            detail::put_hex(out, r.parent);
+            out += '"';
+        }
+        out += ",\"name\":";
+        json::detail::dump_string(out, r.name);
+        out += ",\"kind\":1,\"startTimeUnixNano\":\"" + std::to_string(r.start_us * 1000) +
+               "\",\"endTimeUnixNano\":\"" + std::to_string(r.end_us * 1000) + "\",\"attributes\":[";
+        bool first_attr = true;
+        attr("camel.stage", r.name, first_attr);
+        if (!r.message_id.empty()) attr("camel.message_id", r.message_id, first_attr);
+        if (r.detail == "dropped") attr("camel.dropped", "true", first_attr);
+        out += "]";
+        if (r.error) {
+            out += ",\"status\":{\"code\":2,\"message\":";
+            json::detail::dump_string(out, r.detail);
+            out += "}";
+        }
+        out += '}';
+    }
+
+    int fd_ = -1;
+    double sample_ = 0.01;
+    uint64_t slow_us_ = 0;
+    Span env_parent_;
+    std::string service_ = "camel";
+    std::mutex mu_;
+    std::condition_variable cv_;
+    std::vector<SpanRecord> queue_;
+    bool stop_ = false;
+    std::thread writer_;
+};
+
+}  // namespace camel
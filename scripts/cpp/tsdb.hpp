@@ -0,0 +1,384 @@
+// Embedded time-series store for cpp_monitor's metric history.
+//
+// Each series keeps three tiers: 1 s points, 1 min means and 10 min means.
+// Samples are averaged into the current 1 s bucket; a closed bucket is
+// appended to the 1 s tier and folded into the minute bucket, which feeds the
+// 10 min tier the same way. Every tier is a ring of fixed-capacity chunks
+// compressed as in Gorilla (Pelkonen et al., VLDB 2015): timestamps as
+// delta-of-delta, values as XOR against the previous value. Regular steps and
+// slowly changing values cost a few bits per point, so a day of history for a
+// few hundred series stays within a few MB. The oldest chunk is dropped when
+// a tier is full, so memory is bounded by configuration, not by uptime.
+//
+// Not thread-safe; cpp_monitor guards the store with a mutex.
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace camel {
+
+struct TsPoint {
+    int64_t t;  // unix seconds, start of the bucket
+    double v;
+};
+
+namespace detail {
+
+class BitWriter {
+public:
+    void write(uint64_t value, int bits) {
+        while (bits > 0) {
+            if (used_ == 0) words_.push_back(0);
+            const int room = 64 - used_;
+            const int n = std::min(room, bits);
+            const uint64_t chunk = (value >> (bits - n)) & (n == 64 ? ~0ull : ((1ull << n) - 1));
+            words_.back() |= chunk << (room - n);
+            used_ = (used_ + n) & 63;
+            bits -= n;
+        }
+    }
+    const std::vector<uint64_t>& words() const { return words_; }
+    size_t bytes() const { return words_.capacity() * sizeof(uint64_t); }
+    void shrink() { words_.shrink_to_fit(); }
+
+private:
+    std::vector<uint64_t> words_;
+    int used_ = 0;  // bits used in the last word, 0 = full
+};
+
+class BitReader {
+public:
+    explicit BitReader(const std::vector<uint64_t>& words) : words_(words) {}
+    uint64_t read(int bits) {
+        uint64_t out = 0;
+        while (bits > 0) {
+            const size_t word = pos_ >> 6;
+            const int offset = static_cast<int>(pos_ & 63);
+            const int n = std::min(64 - offset, bits);
+            const uint64_t w = word < words_.size() ? words_[word] : 0;
+            const uint64_t chunk = (w >> (64 - offset - n)) & (n == 64 ? ~0ull : ((1ull << n) - 1));
+            out = n == 64 ? chunk : (out << n) | chunk;
+            pos_ += static_cast<size_t>(n);
+            bits -= n;
+        }
+        return out;
+    }
+    bool bit() { return read(1) != 0; }
+
+private:
+    const std::vector<uint64_t>& words_;
+    size_t pos_ = 0;
+};
+
+inline uint64_t double_bits(double v) {
+    uint64_t u;
+    std::memcpy(&u, &v, sizeof(u));
+    return u;
+}
+
+inline double bits_double(uint64_t u) {
+    double v;
+    std::memcpy(&v, &u, sizeof(v));
+    return v;
+}
+
+inline int64_t sign_extend(uint64_t v, int bits) {
+    const uint64_t m = 1ull << (bits - 1);
+    return static_cast<int64_t>((v ^ m) - m);
+}
+
+}  // namespace detail
+
+// One compressed run of points with increasing timestamps.
+class GorillaChunk {
+public:
+    explicit GorillaChunk(size_t capacity) : capacity_(capacity) {}
+
+    bool full() const { return count_ >= capacity_; }
+    size_t size() const { return count_; }
+    int64_t first_time() const { return first_t_; }
+    int64_t last_time() const { return prev_t_; }
+    size_t bytes() const { return sizeof(*this) + bits_.bytes(); }
+    void seal() { bits_.shrink(); }
+
+    void append(int64_t t, double v) {
+        const uint64_t vb = detail::double_bits(v);
+        if (count_ == 0) {
+            first_t_ = t;
+            bits_.write(static_cast<uint64_t>(t), 64);
+            bits_.write(vb, 64);
+        } else {
+            write_time(t);
+            write_value(vb);
+        }
+        prev_delta_ = count_ == 0 ? 0 : t - prev_t_;
+        prev_t_ = t;
+        prev_v_ = vb;
+        ++count_;
+    }
+
+    template <typename Fn>
+    void for_each(Fn&& fn) const {
+        detail::BitReader r(bits_.words());
+        int64_t t = 0, delta = 0;
+        uint64_t v = 0;
+        int leading = 0, meaningful = 0;
+        for (size_t i = 0; i < count_; ++i) {
+            if (i == 0) {
+                t = static_cast<int64_t>(r.read(64));
+                v = r.read(64);
+            } else {
+                delta += read_dod(r);
+                t += delta;
+                if (r.bit()) {
+                    if (r.bit()) {
+                        leading = static_cast<int>(r.read(5));
+                        meaningful = static_cast<int>(r.read(6)) + 1;
+                    }
+                    v ^= r.read(meaningful) << (64 - leading - meaningful);
+                }
+            }
+            fn(TsPoint{t, detail::bits_double(v)});
+        }
+    }
+
+private:
+    // Delta-of-delta in the paper's buckets: 0 | 10+7 | 110+9 | 1110+12 | 1111+32 bits.
+    void write_time(int64_t t) {
+        const int64_t delta = t - prev_t_;
+        const int64_t dod = delta - prev_delta_;
+        if (dod == 0) {
+            bits_.write(0, 1);
+        } else if (dod >= -64 && dod <= 63) {
+            bits_.write(0b10, 2);
+            bits_.write(static_cast<uint64_t>(dod) & 0x7f, 7);
+        } else if (dod >= -256 && dod <= 255) {
+            bits_.write(0b110, 3);
+            bits_.write(static_cast<uint64_t>(dod) & 0x1ff, 9);
+        } else if (dod >= -2048 && dod <= 2047) {
+            bits_.write(0b1110, 4);
+            bits_.write(static_cast<uint64_t>(dod) & 0xfff, 12);
+        } else {
+            bits_.write(0b1111, 4);
+            bits_.write(static_cast<uint64_t>(dod) & 0xffffffffull, 32);
+        }
+    }
+
+    static int64_t read_dod(detail::BitReader& r) {
+        if (!r.bit()) return 0;
+        if (!r.bit()) return detail::sign_extend(r.read(7), 7);
+        if (!r.bit()) return detail::sign_extend(r.read(9), 9);
+        if (!r.bit()) return detail::sign_extend(r.read(12), 12);
+        return detail::sign_extend(r.read(32), 32);
+    }
+
+    void write_value(uint64_t vb) {
+        const uint64_t x = vb ^ prev_v_;
+        if (x == 0) {
+            bits_.write(0, 1);
+            return;
+        }
+        bits_.write(1, 1);
+        int leading = std::min(__builtin_clzll(x), 31);
+        const int trailing = __builtin_ctzll(x);
+        if (meaningful_ > 0 && leading >= leading_ && trailing >= 64 - leading_ - meaningful_) {
+            bits_.write(0, 1);
+            bits_.write(x >> (64 - leading_ - meaningful_), meaningful_);
+            return;
+        }
+        const int meaningful = 64 - leading - trailing;
+        bits_.write(1, 1);
+        bits_.write(static_cast<uint64_t>(leading), 5);
+        bits_.write(static_cast<uint64_t>(meaningful - 1), 6);
+        bits_.write(x >> trailing, meaningful);
+        leading_ = leading;
+        meaningful_ = meaningful;
+    }
+
+    size_t capacity_;
+    size_t count_ = 0;
+    detail::BitWriter bits_;
+    int64_t first_t_ = 0, prev_t_ = 0, prev_delta_ = 0;
+    uint64_t prev_v_ = 0;
+    int leading_ = 0, meaningful_ = 0;
+};
+
+// Fixed-step tier: a ring of chunks covering at least `points` steps.
+class TsTier {
+public:
+    static constexpr size_t kChunkPoints = 120;
+
+    TsTier(int64_t step, size_t points) : step_(step), max_chunks_((points + kChunkPoints - 1) / kChunkPoints + 1) {}
+
+    int64_t step() const { return step_; }
+
+    void append(int64_t t, double v) {
+        if (chunks_.empty() || chunks_.back().full()) {
+            if (!chunks_.empty()) chunks_.back().seal();
+            if (chunks_.size() == max_chunks_) chunks_.pop_front();
+            chunks_.emplace_back(kChunkPoints);
+        }
+        chunks_.back().append(t, v);
+    }
+
+    int64_t oldest() const { return chunks_.empty() ? INT64_MAX : chunks_.front().first_time(); }
+
+    template <typename Fn>
+    void scan(int64_t from, int64_t to, Fn&& fn) const {
+        for (const GorillaChunk& c : chunks_) {
+            if (c.size() == 0 || c.last_time() < from || c.first_time() > to) continue;
+            c.for_each([&](const TsPoint& p) {
+                if (p.t >= from && p.t <= to) fn(p);
+            });
+        }
+    }
+
+    size_t bytes() const {
+        size_t n = sizeof(*this);
+        for (const GorillaChunk& c : chunks_) n += c.bytes();
+        return n;
+    }
+
+private:
+    int64_t step_;
+    size_t max_chunks_;
+    std::deque<GorillaChunk> chunks_;
+};
+
+struct TsdbConfig {
+    size_t raw_points = 3600;        // 1 s tier: 1 hour
+    size_t minute_points = 1440;     // 1 min tier: 24 hours
+    size_t ten_minute_points = 1008; // 10 min tier: 7 days
+    size_t max_series = 512;
+};
+
+class TimeSeries {
+public:
+    explicit TimeSeries(const TsdbConfig& cfg)
+        : tiers_{TsTier(1, cfg.raw_points), TsTier(60, cfg.minute_points), TsTier(600, cfg.ten_minute_points)} {}
+
+    void add(int64_t t, double v) {
+        if (!std::isfinite(v)) return;
+        add_to(0, t, v);
+    }
+
+    // Points in [from, to] from the finest tier that still reaches `from`,
+    // averaged into `step`-second buckets when `step` is coarser.
+    std::vector<TsPoint> query(int64_t from, int64_t to, int64_t step = 0) const {
+        size_t tier = 0;
+        while (tier + 1 < kTiers && (tiers_[tier].oldest() > from || tiers_[tier].step() < step / 2)) {
+            if (tiers_[tier + 1].oldest() == INT64_MAX) break;
+            ++tier;
+        }
+        std::vector<TsPoint> out;
+        const int64_t native = tiers_[tier].step();
+        if (step <= native) {
+            tiers_[tier].scan(from, to, [&](const TsPoint& p) { out.push_back(p); });
+            return out;
+        }
+        int64_t bucket = INT64_MIN;
+        double sum = 0;
+        int n = 0;
+        tiers_[tier].scan(from, to, [&](const TsPoint& p) {
+            const int64_t b = p.t - ((p.t % step) + step) % step;
+            if (b != bucket && n > 0) {
+                out.push_back({bucket, sum / n});
+                sum = 0;
+                n = 0;
+            }
+            bucket = b;
+            sum += p.v;
+            ++n;
+        });
+        if (n > 0) out.push_back({bucket, sum / n});
+        return out;
+    }
+
+    size_t bytes() const {
+        size_t n = sizeof(*this);
+        for (const TsTier& t : tiers_) n += t.bytes();
+        return n;
+    }
+
+private:
+    static constexpr size_t kTiers = 3;
+
+    struct Pending {
+        int64_t bucket = INT64_MIN;
+        double sum = 0;
+        int n = 0;
+    };
+
+    void add_to(size_t tier, int64_t t, double v) {
+        Pending& p = pending_[tier];
+        const int64_t step = tiers_[tier].step();
+        const int64_t bucket = t - ((t % step) + step) % step;
+        if (bucket < p.bucket) return;  // clock went backwards
+        if (bucket != p.bucket && p.n > 0) {
+            const double mean = p.sum / p.n;
+            tiers_[tier].append(p.bucket, mean);
+            if (tier + 1 < kTiers) add_to(tier + 1, p.bucket, mean);
+            p.sum = 0;
+            p.n = 0;
+        }
+        p.bucket = bucket;
+        p.sum += v;
+        ++p.n;
+    }
+
+    TsTier tiers_[kTiers];
+    Pending pending_[kTiers];
+};
+
+class Tsdb {
+public:
+    explicit Tsdb(TsdbConfig cfg = {}) : cfg_(cfg) {}
+
+    // Records one sample; new series beyond `max_series` are ignored.
+    void add(const std::string& name, int64_t t, double v) {
+        auto it = series_.find(name);
+        if (it == series_.end()) {
+            if (series_.size() >= cfg_.max_series) {
+                ++rejected_;
+                return;
+            }
+            it = series_.emplace(name, TimeSeries(cfg_)).first;
+        }
+        it->second.add(t, v);
+    }
+
+    const TimeSeries* find(const std::string& name) const {
+        auto it = series_.find(name);
+        return it == series_.end() ? nullptr : &it->second;
+    }
+
+    std::vector<std::string> names() const {
+        std::vector<std::string> out;
+        out.reserve(series_.size());
+        for (const auto& [name, s] : series_) out.push_back(name);
+        return out;
+    }
+
+    size_t bytes() const {
+        size_t n = sizeof(*this);
+        for (const auto& [name, s] : series_) n += name.size() + s.bytes();
+        return n;
+    }
+
+    size_t rejected() const { return rejected_; }
+
+private:
+    TsdbConfig cfg_;
+    std::map<std::string, TimeSeries> series_;
+    size_t rejected_ = 0;
+};
+
+}  // namespace camel
@@ -0,0 +1,108 @@
+// Fixed set of worker threads for fan-out work inside one message (e.g.
+// encoding several crops). Threads live as long as the pool, so per-thread
+// state such as encoders is created once.
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace camel {
+
+class WorkerPool {
+public:
+    explicit WorkerPool(size_t threads) {
+        for (size_t i = 0; i < threads; ++i) workers_.emplace_back([this] { loop(); });
+    }
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+    ~WorkerPool() {
+        {
+            std::lock_guard<std::mutex> lock(mu_);
+            stopping_ = true;
+        }
+        cv_.notify_all();
+        for (auto& t : workers_) t.join();
+    }
+
+    size_t size() const { return workers_.size(); }
+
+    // Runs all jobs and blocks until they are finished; rethrows the first
+    // exception. The calling thread runs jobs too, so a pool of size 0 is
+    // plain sequential execution.
+    void run(std::vector<std::function<void()>>& jobs) {
+        Batch batch;
+        batch.pending = jobs.size();
+        {
+            std::lock_guard<std::mutex> lock(mu_);
+            for (auto& j : jobs) queue_.push_back({&j, &batch});
+        }
+        cv_.notify_all();
+        for (Task t; take(t, &batch);) execute(t);
+        std::unique_lock<std::mutex> lock(mu_);
+        batch.done.wait(lock, [&] { return batch.pending == 0; });
+        if (batch.error) std::rethrow_exception(batch.error);
+    }
+
+private:
+    struct Batch {
+        size_t pending = 0;
+        std::exception_ptr error;
+        std::condition_variable done;
+    };
+    struct Task {
+        std::function<void()>* job = nullptr;
+        Batch* batch = nullptr;
+    };
+
+    // Next queued task (of `only`, when given); false when there is none.
+    bool take(Task& t, Batch* only) {
+        std::lock_guard<std::mutex> lock(mu_);
+        for (auto it = queue_.begin(); it != queue_.end(); ++it) {
+            if (only && it->batch != only) continue;
+            t = *it;
+            queue_.erase(it);
+            return true;
+        }
+        return false;
+    }
+
+    void execute(const Task& t) {
+        std::exception_ptr error;
+        try {
+            (*t.job)();
+        } catch (...) {
+            error = std::current_exception();
+        }
+        std::lock_guard<std::mutex> lock(mu_);
+        if (error && !t.batch->error) t.batch->error = error;
+        if (--t.batch->pending == 0) t.batch->done.notify_all();
+    }
+
+    void loop() {
+        for (;;) {
+            Task t;
+            {
+                std::unique_lock<std::mutex> lock(mu_);
+                cv_.wait(lock, [&] { return stopping_ || !queue_.empty(); });
+                if (queue_.empty()) return;
+                t = queue_.front();
+                queue_.pop_front();
+            }
+            execute(t);
+        }
+    }
+
+    std::mutex mu_;
+    std::condition_variable cv_;
+    std::deque<Task> queue_;
+    bool stopping_ = false;
+    std::vector<std::thread> workers_;
+};
+
+}  // namespace camel
@@ -0,0 +1,175 @@
+// YUV4MPEG2 stream reading (ffmpeg `-f yuv4mpegpipe`).
+//
+// Unlike `-f rawvideo`, the stream header carries the geometry, so a
+// decoder pipe can be read without knowing the camera resolution up front.
+// Only 4:2:0 streams are accepted; frames come out as packed I420.
+#pragma once
+
+#include <sys/types.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "frame.hpp"
+
+namespace camel {
+
+// "YUV4MPEG2 W1920 H1080 F25:1 Ip A1:1 C420jpeg" -> width, height.
+inline void parse_y4m_header(const std::string& line, int& width, int& height) {
+    if (line.rfind("YUV4MPEG2", 0) != 0) throw std::runtime_error("not a YUV4MPEG2 stream");
+    std::string chroma = "420jpeg";
+    width = height = 0;
+    for (size_t pos = 9; pos < line.size();) {
+        while (pos < line.size() && line[pos] == ' ') ++pos;
+        size_t end = line.find(' ', pos);
+        if (end == std::string::npos) end = line.size();
+        if (end > pos) {
+            char tag = line[pos];
+            std::string value = line.substr(pos + 1, end - pos - 1);
+            if (tag == 'W') width = std::stoi(value);
+            else if (tag == 'H') height = std::stoi(value);
+            else if (tag == 'C') chroma = value;
+        }
+        pos = end;
+    }
+    if (width <= 0 || height <= 0) throw std::runtime_error("YUV4MPEG2 header without W/H");
+    if (chroma.rfind("420", 0) != 0) throw std::runtime_error("unsupported YUV4MPEG2 chroma C" + chroma);
+}
+
+// Blocking reader over a read(2)-like function.
+class Y4mReader {
+public:
+    // `read` behaves like read(2): bytes read, 0 at end of stream, < 0 on error.
+    using ReadFn = std::function<ssize_t(void*, size_t)>;
+
+    explicit Y4mReader(ReadFn read) : read_(std::move(read)) {}
+
+    int width() const { return width_; }
+    int height() const { return height_; }
+
+    // Parses the stream header; false if the stream ended before one arrived.
+    bool read_header() {
+        std::string line;
+        if (!read_line(line)) return false;
+        parse_y4m_header(line, width_, height_);
+        return true;
+    }
+
+    // Reads the next frame into `out` (packed I420); false at end of stream.
+    bool next_frame(std::vector<uint8_t>& out) {
+        std::string line;
+        if (!read_line(line)) return false;
+        if (line.rfind("FRAME", 0) != 0) throw std::runtime_error("corrupt YUV4MPEG2 stream");
+        out.resize(frame_bytes(PixelFormat::I420, width_, height_));
+        return read_exact(out.data(), out.size());
+    }
+
+private:
+    bool read_line(std::string& line) {
+        line.clear();
+        for (char c;;) {
+            if (!read_exact(&c, 1)) return false;
+            if (c == '\n') return true;
+            line.push_back(c);
+            if (line.size() > 4096) throw std::runtime_error("YUV4MPEG2 header line too long");
+        }
+    }
+
+    // Buffered exact read; false on end of stream.
+    bool read_exact(void* dst, size_t n) {
+        auto* p = static_cast<uint8_t*>(dst);
+        while (n > 0) {
+            if (pos_ == len_) {
+                if (n >= sizeof(buf_)) {  // large frame payloads bypass the buffer
+                    ssize_t r = read_(p, n);
+                    if (r <= 0) return false;
+                    p += r;
+                    n -= static_cast<size_t>(r);
+                    continue;
+                }
+                ssize_t r = read_(buf_, sizeof(buf_));
+                if (r <= 0) return false;
+                pos_ = 0;
+                len_ = static_cast<size_t>(r);
+            }
+            size_t take = std::min(n, len_ - pos_);
+            std::memcpy(p, buf_ + pos_, take);
+            pos_ += take;
+            p += take;
+            n -= take;
+        }
+        return true;
+    }
+
+    ReadFn read_;
+    int width_ = 0;
+    int height_ = 0;
+    uint8_t buf_[4096];
+    size_t pos_ = 0;
+    size_t len_ = 0;
+};
+
+// Incremental parser for non-blocking pipes: feed() whatever arrived. The
+// sink chooses where each frame's payload lands, so frames can be decoded
+// straight into a shared-memory slot:
+//   sink.begin_frame(width, height, bytes) -> uint8_t* (capacity >= bytes)
+//   sink.end_frame()
+class Y4mParser {
+public:
+    int width() const { return width_; }
+    int height() const { return height_; }
+
+    template <typename Sink>
+    void feed(const uint8_t* data, size_t n, Sink& sink) {
+        while (n > 0) {
+            if (remaining_ == 0) {
+                const uint8_t* nl = static_cast<const uint8_t*>(std::memchr(data, '\n', n));
+                size_t take = nl ? static_cast<size_t>(nl - data) : n;
+                line_.append(reinterpret_cast<const char*>(data), take);
+                if (line_.size() > 4096) throw std::runtime_error("YUV4MPEG2 header line too long");
+                data += take;
+                n -= take;
+                if (!nl) return;
+                ++data;
+                --n;
+                if (width_ == 0) {
+                    parse_y4m_header(line_, width_, height_);
+                } else {
+                    if (line_.rfind("FRAME", 0) != 0) throw std::runtime_error("corrupt YUV4MPEG2 stream");
+                    remaining_ = frame_bytes(PixelFormat::I420, width_, height_);
+                    dst_ = sink.begin_frame(width_, height_, remaining_);
+                }
+                line_.clear();
+                continue;
+            }
+            size_t take = std::min(n, remaining_);
+            std::memcpy(dst_, data, take);
+            dst_ += take;
+            data += take;
+            n -= take;
+            remaining_ -= take;
+            if (remaining_ == 0) sink.end_frame();
+        }
+    }
+
+    // Decoder restarted: expect a new stream header.
+    void reset() {
+        width_ = height_ = 0;
+        remaining_ = 0;
+        line_.clear();
+    }
+
+private:
+    int width_ = 0;
+    int height_ = 0;
+    size_t remaining_ = 0;
+    uint8_t* dst_ = nullptr;
+    std::string line_;
+};
+
+}  // namespace camel
@@ -0,0 +1,161 @@
+// YOLOv8 output head decoding and detection message helpers.
+//
+// An exported YOLOv8 detector produces a [batch, 4 + classes, anchors]
+// tensor: per anchor the box center/size in input-tensor pixels followed by
+// one score per class (already sigmoid-activated, no objectness).
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "json.hpp"
+#include "nms.hpp"
+#include "preprocess.hpp"
+
+namespace camel {
+
+inline const std::array<const char*, 80>& coco_class_names() {
+    static const std::array<const char*, 80> names = {
+        "person",        "bicycle",      "car",        "motorcycle",    "airplane",     "bus",
+        "train",         "truck",        "boat",       "traffic light", "fire hydrant", "stop sign",
+        "parking meter", "bench",        "bird",       "cat",           "dog",          "horse",
+        "sheep",         "cow",          "elephant",   "bear",          "zebra",        "giraffe",
+        "backpack",      "umbrella",     "handbag",    "tie",           "suitcase",     "frisbee",
+        "skis",          "snowboard",    "sports ball", "kite",         "baseball bat", "baseball glove",
+        "skateboard",    "surfboard",    "tennis racket", "bottle",     "wine glass",   "cup",
+        "fork",          "knife",        "spoon",      "bowl",          "banana",       "apple",
+        "sandwich",      "orange",       "broccoli",   "carrot",        "hot dog",      "pizza",
+        "donut",         "cake",         "chair",      "couch",         "potted plant", "bed",
+        "dining table",  "toilet",       "tv",         "laptop",        "mouse",        "remote",
+        "keyboard",      "cell phone",   "microwave",  "oven",          "toaster",      "sink",
+        "refrigerator",  "book",         "clock",      "vase",          "scissors",     "teddy bear",
+        "hair drier",    "toothbrush"};
+    return names;
+}
+
+// Class names in model order; custom models supply their own via the
+// "class_names" config key.
+class ClassNames {
+public:
+    ClassNames() {
+        for (const char* n : coco_class_names()) names_.emplace_back(n);
+    }
+
+    explicit ClassNames(const json::Value& custom) : ClassNames() {
+        if (!custom.is_array()) return;
+        names_.clear();
+        for (const auto& v : custom.as_array()) names_.push_back(v.as_string());
+    }
+
+    const std::string& name(int id) const {
+        static const std::string unknown = "unknown";
+        return id >= 0 && static_cast<size_t>(id) < names_.size() ? names_[id] : unknown;
+    }
+
+    int id(const std::string& name) const {
+        for (size_t i = 0; i < names_.size(); ++i)
+            if (names_[i] == name) return static_cast<int>(i);
+        return -1;
+    }
+
+    size_t size() const { return names_.size(); }
+
+    // Per-class keep mask from a "target_objects" list; empty list keeps all.
+    std::vector<uint8_t> target_mask(const json::Value& targets, size_t num_classes) const {
+        std::vector<uint8_t> mask(num_classes, targets.is_array() && targets.size() > 0 ? 0 : 1);
+        if (!targets.is_array()) return mask;
+        for (const auto& t : targets.as_array()) {
+            int id = this->id(t.as_string());
+            if (id < 0) throw std::runtime_error("unknown target object '" + t.as_string() + "'");
+            if (static_cast<size_t>(id) < num_classes) mask[id] = 1;
+        }
+        return mask;
+    }
+
+private:
+    std::vector<std::string> names_;
+};
+
+struct YoloLayout {
+    int num_classes = 80;
+    int num_anchors = 8400;
+};
+
+// Infers the head layout from an output shape of [batch, 4 + classes, anchors].
+inline YoloLayout yolo_layout_from_shape(const std::vector<int64_t>& shape) {
+    if (shape.size() != 3 || shape[1] <= 4) throw std::runtime_error("unexpected YOLO output shape");
+    YoloLayout l;
+    l.num_classes = static_cast<int>(shape[1] - 4);
+    l.num_anchors = static_cast<int>(shape[2]);
+    return l;
+}
+
+// Scalar reference decoder: per-anchor class argmax, confidence threshold
+// and cxcywh -> xyxy conversion, in input-tensor coordinates.
+inline void decode_yolov8(const float* head, const YoloLayout& l, float conf_threshold,
+                          const std::vector<uint8_t>& class_mask, std::vector<Detection>& out) {
+    const size_t n = static_cast<size_t>(l.num_anchors);
+    const float* scores = head + 4 * n;
+    for (size_t a = 0; a < n; ++a) {
+        float best = scores[a];
+        int best_cls = 0;
+        for (int c = 1; c < l.num_classes; ++c) {
+            float s = scores[c * n + a];
+            if (s > best) {
+                best = s;
+                best_cls = c;
+            }
+        }
+        if (best < conf_threshold || !class_mask[best_cls]) continue;
+        float cx = head[a], cy = head[n + a], w = head[2 * n + a], h = head[3 * n + a];
+        out.push_back({{cx - 0.5f * w, cy - 0.5f * h, cx + 0.5f * w, cy + 0.5f * h}, best, best_cls});
+    }
+}
+
+// Maps a tensor-space box back to source frame pixels and clips it.
+inline Box to_frame(const Box& b, const LetterboxTransform& t, int frame_w, int frame_h) {
+    auto mx = [&](float x) {
+        return std::clamp((x - t.pad_x) / t.scale + t.offset_x, 0.0f, static_cast<float>(frame_w));
+    };
+    auto my = [&](float y) {
+        return std::clamp((y - t.pad_y) / t.scale + t.offset_y, 0.0f, static_cast<float>(frame_h));
+    };
+    return {mx(b.x1), my(b.y1), mx(b.x2), my(b.y2)};
+}
+
+inline double round_score(float s) { return std::round(s * 1e4) / 1e4; }
+
+inline json::Value detection_to_json(const Detection& d, const ClassNames& names) {
+    json::Value v = json::Value::object();
+    v["class"] = names.name(d.class_id);
+    v["class_id"] = d.class_id;
+    v["confidence"] = round_score(d.score);
+    json::Value bbox = json::Value::array();
+    for (float c : {d.box.x1, d.box.y1, d.box.x2, d.box.y2}) bbox.push_back(std::round(c * 10.0f) / 10.0f);
+    v["bbox"] = std::move(bbox);
+    return v;
+}
+
+// Writes detections in the shape produced by scripts/detect_objects.py so
+// existing filters and templates ({{detection_count}}, {{object_type}},
+// {{confidence}}, {{position}}) keep working.
+inline void write_detections(json::Value& target, const std::vector<Detection>& dets, const ClassNames& names) {
+    json::Value list = json::Value::array();
+    for (const auto& d : dets) list.push_back(detection_to_json(d, names));
+    target["detections"] = std::move(list);
+    target["detection_count"] = dets.size();
+    if (dets.empty()) return;
+    const Detection& top = dets.front();
+    target["object_type"] = names.name(top.class_id);
+    target["confidence"] = round_score(top.score);
+    json::Value pos = json::Value::object();
+    pos["x"] = std::round(top.box.center_x());
+    pos["y"] = std::round(top.box.center_y());
+    target["position"] = std::move(pos);
+}
+
+}  // namespace camel
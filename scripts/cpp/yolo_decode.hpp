@@ -0,0 +1,281 @@
+// Vectorized YOLOv8 head decoding.
+//
+// The head is channel-major ([4 + classes, anchors]), so eight consecutive
+// anchors of one class are one contiguous vector. Anchors are processed in
+// tiles of 32: the class loop runs over the tile with the running max and
+// argmax held in registers, which keeps each pass over the 80 class rows
+// inside L1. Survivors of the confidence threshold are converted to xyxy and
+// compacted into a structure-of-arrays candidate list that the SIMD NMS
+// below consumes directly.
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <numeric>
+#include <vector>
+
+#include "nms.hpp"
+#include "preprocess.hpp"
+#include "yolo.hpp"
+
+#if defined(__AVX2__) && defined(__FMA__)
+#include <immintrin.h>
+#define CAMEL_DECODE_AVX2 1
+#endif
+
+namespace camel {
+
+// Structure-of-arrays detections. Storage keeps 8 floats of slack past
+// size() so vector stores of compacted lanes never need a bounds check.
+class CandidateList {
+public:
+    static constexpr size_t kSlack = 8;
+
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    void clear() { size_ = 0; }
+
+    void reserve(size_t n) {
+        if (x1.size() >= n + kSlack) return;
+        for (auto* v : {&x1, &y1, &x2, &y2, &score}) v->resize(n + kSlack);
+        class_id.resize(n + kSlack);
+    }
+
+    void push_back(const Detection& d) {
+        reserve(size_ + 1);
+        x1[size_] = d.box.x1;
+        y1[size_] = d.box.y1;
+        x2[size_] = d.box.x2;
+        y2[size_] = d.box.y2;
+        score[size_] = d.score;
+        class_id[size_] = d.class_id;
+        ++size_;
+    }
+
+    Detection at(size_t i) const { return {{x1[i], y1[i], x2[i], y2[i]}, score[i], class_id[i]}; }
+
+    std::vector<float> x1, y1, x2, y2, score;
+    std::vector<int32_t> class_id;
+
+private:
+    friend void decode_yolov8_simd(const float*, const YoloLayout&, float, const std::vector<uint8_t>&,
+                                   CandidateList&);
+    size_t size_ = 0;
+};
+
+#ifdef CAMEL_DECODE_AVX2
+namespace detail {
+
+// Lane permutation that moves the set lanes of an 8-bit mask to the front.
+struct alignas(32) CompactionLanes {
+    int32_t lane[8];
+};
+
+inline const std::array<CompactionLanes, 256>& compaction_table() {
+    static const std::array<CompactionLanes, 256> table = [] {
+        std::array<CompactionLanes, 256> t{};
+        for (int mask = 0; mask < 256; ++mask) {
+            int n = 0;
+            for (int lane = 0; lane < 8; ++lane)
+                if (mask & (1 << lane)) t[mask].lane[n++] = lane;
+        }
+        return t;
+    }();
+    return table;
+}
+
+}  // namespace detail
+#endif
+
+// Same result as decode_yolov8() (yolo.hpp), in the same anchor order.
+inline void decode_yolov8_simd(const float* head, const YoloLayout& l, float conf_threshold,
+                               const std::vector<uint8_t>& class_mask, CandidateList& out) {
+    const size_t n = static_cast<size_t>(l.num_anchors);
+    const int classes = l.num_classes;
+    const float* scores = head + 4 * n;
+    out.reserve(out.size_ + n);
+    size_t a = 0;
+
+#ifdef CAMEL_DECODE_AVX2
+    const bool all_classes = std::all_of(class_mask.begin(), class_mask.end(), [](uint8_t m) { return m != 0; });
+    const auto& table = detail::compaction_table();
+    const __m256 threshold = _mm256_set1_ps(conf_threshold);
+    const __m256 half = _mm256_set1_ps(0.5f);
+
+    // Thresholds, filters by class and appends 8 anchors starting at `base`.
+    auto emit = [&](size_t base, __m256 best, __m256 best_cls) {
+        int mask = _mm256_movemask_ps(_mm256_cmp_ps(best, threshold, _CMP_GE_OQ));
+        if (mask == 0) return;
+        __m256i cls = _mm256_cvttps_epi32(best_cls);
+        if (!all_classes) {
+            alignas(32) int32_t ids[8];
+            _mm256_store_si256(reinterpret_cast<__m256i*>(ids), cls);
+            for (int lane = 0; lane < 8; ++lane)
+                if ((mask & (1 << lane)) && !class_mask[ids[lane]]) mask &= ~(1 << lane);
+            if (mask == 0) return;
+        }
+        __m256 cx = _mm256_loadu_ps(head + base), cy = _mm256_loadu_ps(head + n + base);
+        __m256 hw = _mm256_mul_ps(half, _mm256_loadu_ps(head + 2 * n + base));
+        __m256 hh = _mm256_mul_ps(half, _mm256_loadu_ps(head + 3 * n + base));
+        const __m256i perm = _mm256_load_si256(reinterpret_cast<const __m256i*>(table[mask].lane));
+        const size_t at = out.size_;
+        _mm256_storeu_ps(out.x1.data() + at, _mm256_permutevar8x32_ps(_mm256_sub_ps(cx, hw), perm));
+        _mm256_storeu_ps(out.y1.data() + at, _mm256_permutevar8x32_ps(_mm256_sub_ps(cy, hh), perm));
+        _mm256_storeu_ps(out.x2.data() + at, _mm256_permutevar8x32_ps(_mm256_add_ps(cx, hw), perm));
+        _mm256_storeu_ps(out.y2.data() + at, _mm256_permutevar8x32_ps(_mm256_add_ps(cy, hh), perm));
+        _mm256_storeu_ps(out.score.data() + at, _mm256_permutevar8x32_ps(best, perm));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out.class_id.data() + at),
+                            _mm256_permutevar8x32_epi32(cls, perm));
+        out.size_ += static_cast<size_t>(__builtin_popcount(mask));
+    };
+
+    // Strict '>' keeps the first maximal class, matching the scalar decoder.
+    for (; a + 32 <= n; a += 32) {
+        __m256 best[4], best_cls[4];
+        for (int k = 0; k < 4; ++k) {
+            best[k] = _mm256_loadu_ps(scores + a + 8 * k);
+            best_cls[k] = _mm256_setzero_ps();
+        }
+        for (int c = 1; c < classes; ++c) {
+            const float* row = scores + static_cast<size_t>(c) * n + a;
+            const __m256 cf = _mm256_set1_ps(static_cast<float>(c));
+            for (int k = 0; k < 4; ++k) {
+                __m256 s = _mm256_loadu_ps(row + 8 * k);
+                __m256 gt = _mm256_cmp_ps(s, best[k], _CMP_GT_OQ);
+                best[k] = _mm256_blendv_ps(best[k], s, gt);
+                best_cls[k] = _mm256_blendv_ps(best_cls[k], cf, gt);
+            }
+        }
+        for (int k = 0; k < 4; ++k) emit(a + 8 * k, best[k], best_cls[k]);
+    }
+    for (; a + 8 <= n; a += 8) {
+        __m256 best = _mm256_loadu_ps(scores + a), best_cls = _mm256_setzero_ps();
+        for (int c = 1; c < classes; ++c) {
+            __m256 s = _mm256_loadu_ps(scores + static_cast<size_t>(c) * n + a);
+            __m256 gt = _mm256_cmp_ps(s, best, _CMP_GT_OQ);
+            best = _mm256_blendv_ps(best, s, gt);
+            best_cls = _mm256_blendv_ps(best_cls, _mm256_set1_ps(static_cast<float>(c)), gt);
+        }
+        emit(a, best, best_cls);
+    }
+#endif
+
+    for (; a < n; ++a) {
+        float best = scores[a];
+        int best_cls = 0;
+        for (int c = 1; c < classes; ++c) {
+            float s = scores[static_cast<size_t>(c) * n + a];
+            if (s > best) {
+                best = s;
+                best_cls = c;
+            }
+        }
+        if (best < conf_threshold || !class_mask[best_cls]) continue;
+        float cx = head[a], cy = head[n + a], hw = 0.5f * head[2 * n + a], hh = 0.5f * head[3 * n + a];
+        const size_t at = out.size_++;
+        out.x1[at] = cx - hw;
+        out.y1[at] = cy - hh;
+        out.x2[at] = cx + hw;
+        out.y2[at] = cy + hh;
+        out.score[at] = best;
+        out.class_id[at] = best_cls;
+    }
+}
+
+// to_frame() (yolo.hpp) applied to every candidate.
+inline void candidates_to_frame(CandidateList& c, const LetterboxTransform& t, int frame_w, int frame_h) {
+    const float fw = static_cast<float>(frame_w), fh = static_cast<float>(frame_h);
+    auto map = [](std::vector<float>& v, size_t count, float pad, float scale, float offset, float limit) {
+        size_t i = 0;
+#ifdef CAMEL_DECODE_AVX2
+        const __m256 vpad = _mm256_set1_ps(pad), vscale = _mm256_set1_ps(scale), voff = _mm256_set1_ps(offset);
+        const __m256 zero = _mm256_setzero_ps(), vlimit = _mm256_set1_ps(limit);
+        for (; i + 8 <= count; i += 8) {
+            __m256 x = _mm256_div_ps(_mm256_sub_ps(_mm256_loadu_ps(v.data() + i), vpad), vscale);
+            x = _mm256_add_ps(x, voff);
+            _mm256_storeu_ps(v.data() + i, _mm256_min_ps(_mm256_max_ps(x, zero), vlimit));
+        }
+#endif
+        for (; i < count; ++i) v[i] = std::clamp((v[i] - pad) / scale + offset, 0.0f, limit);
+    };
+    map(c.x1, c.size(), t.pad_x, t.scale, t.offset_x, fw);
+    map(c.x2, c.size(), t.pad_x, t.scale, t.offset_x, fw);
+    map(c.y1, c.size(), t.pad_y, t.scale, t.offset_y, fh);
+    map(c.y2, c.size(), t.pad_y, t.scale, t.offset_y, fh);
+}
+
+// Greedy NMS over a candidate list; same survivors as nms() (nms.hpp).
+// Candidates are sorted once into padded SoA scratch arrays, then each kept
+// box suppresses the remaining ones eight at a time.
+class CandidateNms {
+public:
+    std::vector<Detection> run(const CandidateList& c, const NmsOptions& opt) {
+        const size_t n = c.size();
+        order_.resize(n);
+        std::iota(order_.begin(), order_.end(), 0u);
+        std::sort(order_.begin(), order_.end(), [&](uint32_t a, uint32_t b) { return c.score[a] > c.score[b]; });
+
+        const size_t padded = (n + 7) & ~size_t(7);
+        for (auto* v : {&x1_, &y1_, &x2_, &y2_, &area_}) v->assign(padded, 0.0f);
+        cls_.assign(padded, -1);
+        suppressed_.assign(padded, 0);
+        for (size_t i = 0; i < n; ++i) {
+            uint32_t k = order_[i];
+            x1_[i] = c.x1[k];
+            y1_[i] = c.y1[k];
+            x2_[i] = c.x2[k];
+            y2_[i] = c.y2[k];
+            area_[i] = std::max(0.0f, x2_[i] - x1_[i]) * std::max(0.0f, y2_[i] - y1_[i]);
+            cls_[i] = c.class_id[k];
+        }
+
+        std::vector<Detection> kept;
+        for (size_t i = 0; i < n && kept.size() < opt.max_detections; ++i) {
+            if (suppressed_[i]) continue;
+            kept.push_back(c.at(order_[i]));
+            suppress_after(i, padded, opt);
+        }
+        return kept;
+    }
+
+private:
+    void suppress_after(size_t i, size_t padded, const NmsOptions& opt) {
+        size_t j = (i + 1) & ~size_t(7);
+#ifdef CAMEL_DECODE_AVX2
+        const __m256 ax1 = _mm256_set1_ps(x1_[i]), ay1 = _mm256_set1_ps(y1_[i]);
+        const __m256 ax2 = _mm256_set1_ps(x2_[i]), ay2 = _mm256_set1_ps(y2_[i]);
+        const __m256 aarea = _mm256_set1_ps(area_[i]), thr = _mm256_set1_ps(opt.iou_threshold);
+        const __m256 zero = _mm256_setzero_ps();
+        const __m256i acls = _mm256_set1_epi32(cls_[i]), ai = _mm256_set1_epi32(static_cast<int>(i));
+        const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+        for (; j < padded; j += 8) {
+            __m256 w = _mm256_sub_ps(_mm256_min_ps(ax2, _mm256_loadu_ps(&x2_[j])),
+                                     _mm256_max_ps(ax1, _mm256_loadu_ps(&x1_[j])));
+            __m256 h = _mm256_sub_ps(_mm256_min_ps(ay2, _mm256_loadu_ps(&y2_[j])),
+                                     _mm256_max_ps(ay1, _mm256_loadu_ps(&y1_[j])));
+            __m256 inter = _mm256_mul_ps(_mm256_max_ps(w, zero), _mm256_max_ps(h, zero));
+            __m256 uni = _mm256_sub_ps(_mm256_add_ps(aarea, _mm256_loadu_ps(&area_[j])), inter);
+            __m256i hit = _mm256_castps_si256(_mm256_cmp_ps(inter, _mm256_mul_ps(thr, uni), _CMP_GT_OQ));
+            hit = _mm256_and_si256(hit, _mm256_cmpgt_epi32(_mm256_add_epi32(lanes, _mm256_set1_epi32(static_cast<int>(j))), ai));
+            if (opt.class_aware)
+                hit = _mm256_and_si256(hit, _mm256_cmpeq_epi32(acls, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&cls_[j]))));
+            auto* s = reinterpret_cast<__m256i*>(&suppressed_[j]);
+            _mm256_storeu_si256(s, _mm256_or_si256(_mm256_loadu_si256(s), hit));
+        }
+#endif
+        for (j = std::max(j, i + 1); j < padded; ++j) {
+            if (opt.class_aware && cls_[j] != cls_[i]) continue;
+            float w = std::min(x2_[i], x2_[j]) - std::max(x1_[i], x1_[j]);
+            float h = std::min(y2_[i], y2_[j]) - std::max(y1_[i], y1_[j]);
+            float inter = std::max(w, 0.0f) * std::max(h, 0.0f);
+            if (inter > opt.iou_threshold * (area_[i] + area_[j] - inter)) suppressed_[j] = -1;
+        }
+    }
+
+    std::vector<uint32_t> order_;
+    std::vector<float> x1_, y1_, x2_, y2_, area_;
+    std::vector<int32_t> cls_, suppressed_;
+};
+
+}  // namespace camel
@@ -0,0 +1,326 @@
+// Planar 4:2:0 images and the pixel operations of the alert stages: crop
+// (with video-to-full range expansion for JPEG), downscaling and box
+// drawing. Everything works on Y/U/V planes directly; frames are never
+// converted to RGB.
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "frame.hpp"
+#include "preprocess.hpp"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define CAMEL_YUV_AVX2 1
+#endif
+
+namespace camel {
+
+// Owning I420 image. Rows are padded (and over-allocated by 32 bytes) so
+// vector loops and the JPEG encoder's 16-pixel MCUs may run past `width`.
+struct YuvImage {
+    int width = 0;
+    int height = 0;
+    std::vector<uint8_t> data;
+    FrameView view;
+
+    void allocate(int w, int h) {
+        if (w <= 0 || h <= 0 || (w & 1) || (h & 1)) throw std::runtime_error("I420 image size must be even");
+        width = w;
+        height = h;
+        int ys = (w + 16 + 31) & ~31, cs = (w / 2 + 16 + 31) & ~31;
+        size_t y_bytes = static_cast<size_t>(ys) * h, c_bytes = static_cast<size_t>(cs) * (h / 2);
+        data.resize(y_bytes + 2 * c_bytes + 32);
+        view.format = PixelFormat::I420;
+        view.width = w;
+        view.height = h;
+        view.planes[0] = data.data();
+        view.planes[1] = data.data() + y_bytes;
+        view.planes[2] = data.data() + y_bytes + c_bytes;
+        view.strides[0] = ys;
+        view.strides[1] = view.strides[2] = cs;
+    }
+
+    uint8_t* row(int plane, int y) { return view.planes[plane] + static_cast<size_t>(y) * view.strides[plane]; }
+    const uint8_t* row(int plane, int y) const {
+        return view.planes[plane] + static_cast<size_t>(y) * view.strides[plane];
+    }
+    int plane_width(int plane) const { return plane == 0 ? width : width / 2; }
+    int plane_height(int plane) const { return plane == 0 ? height : height / 2; }
+};
+
+// Video (limited, 16-235/240) to full range, as JPEG/JFIF expects:
+//   y' = (y - 16) * 255 / 219,  c' = (c - 128) * 255 / 224 + 128
+// computed as a + round(a * k) in Q15 so scalar and AVX2 results agree.
+namespace detail {
+
+constexpr int kLumaGainQ15 = 5387;    // 255/219 - 1
+constexpr int kChromaGainQ15 = 4535;  // 255/224 - 1
+
+inline uint8_t clamp_u8(int v) { return static_cast<uint8_t>(std::clamp(v, 0, 255)); }
+
+inline void expand_row(const uint8_t* src, uint8_t* dst, int n, int bias, int gain, int out_bias) {
+    int x = 0;
+#ifdef CAMEL_YUV_AVX2
+    const __m256i vbias = _mm256_set1_epi16(static_cast<int16_t>(bias)), vgain = _mm256_set1_epi16(static_cast<int16_t>(gain));
+    const __m256i vout = _mm256_set1_epi16(static_cast<int16_t>(out_bias));
+    for (; x + 32 <= n; x += 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + x));
+        __m256i lo = _mm256_sub_epi16(_mm256_cvtepu8_epi16(_mm256_castsi256_si128(v)), vbias);
+        __m256i hi = _mm256_sub_epi16(_mm256_cvtepu8_epi16(_mm256_extracti128_si256(v, 1)), vbias);
+        lo = _mm256_add_epi16(_mm256_add_epi16(lo, _mm256_mulhrs_epi16(lo, vgain)), vout);
+        hi = _mm256_add_epi16(_mm256_add_epi16(hi, _mm256_mulhrs_epi16(hi, vgain)), vout);
+        __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(lo, hi), 0xd8);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x), packed);
+    }
+#endif
+    for (; x < n; ++x) {
+        int a = src[x] - bias;
+        dst[x] = clamp_u8(a + ((a * gain + 16384) >> 15) + out_bias);
+    }
+}
+
+// NV12 UVUV... -> separate U and V rows.
+inline void deinterleave_row(const uint8_t* uv, uint8_t* u, uint8_t* v, int n) {
+    int x = 0;
+#ifdef CAMEL_YUV_AVX2
+    const __m256i shuf = _mm256_setr_epi8(0, 2, 4, 6, 8, 10, 12, 14, 1, 3, 5, 7, 9, 11, 13, 15,
+                                          0, 2, 4, 6, 8, 10, 12, 14, 1, 3, 5, 7, 9, 11, 13, 15);
+    for (; x + 16 <= n; x += 16) {
+        __m256i s = _mm256_shuffle_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(uv + 2 * x)), shuf);
+        s = _mm256_permute4x64_epi64(s, 0xd8);  // [U0-7 U8-15 | V0-7 V8-15]
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(u + x), _mm256_castsi256_si128(s));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(v + x), _mm256_extracti128_si256(s, 1));
+    }
+#endif
+    for (; x < n; ++x) {
+        u[x] = uv[2 * x];
+        v[x] = uv[2 * x + 1];
+    }
+}
+
+// Separate U and V rows -> NV12 UVUV...
+inline void interleave_row(const uint8_t* u, const uint8_t* v, uint8_t* uv, int n) {
+    int x = 0;
+#ifdef CAMEL_YUV_AVX2
+    for (; x + 16 <= n; x += 16) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(u + x));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(v + x));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(uv + 2 * x), _mm_unpacklo_epi8(a, b));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(uv + 2 * x + 16), _mm_unpackhi_epi8(a, b));
+    }
+#endif
+    for (; x < n; ++x) {
+        uv[2 * x] = u[x];
+        uv[2 * x + 1] = v[x];
+    }
+}
+
+}  // namespace detail
+
+// Even-aligned crop clamped to the frame; an empty rect means the whole frame.
+inline Rect even_crop(const FrameView& f, Rect c) {
+    if (c.w <= 0 || c.h <= 0) c = {0, 0, f.width, f.height};
+    int x0 = std::clamp(c.x, 0, f.width - 2) & ~1, y0 = std::clamp(c.y, 0, f.height - 2) & ~1;
+    int x1 = std::clamp(c.x + c.w, x0 + 2, f.width) & ~1, y1 = std::clamp(c.y + c.h, y0 + 2, f.height) & ~1;
+    return {x0, y0, x1 - x0, y1 - y0};
+}
+
+// Copies `crop` of a frame into an I420 image, expanding video range to
+// full range when `expand_range` is set. BGR input is converted with the
+// JFIF (full range) matrix.
+inline void copy_to_i420(const FrameView& src, Rect crop, YuvImage& out, bool expand_range) {
+    crop = even_crop(src, crop);
+    out.allocate(crop.w, crop.h);
+    const int cw = crop.w / 2, ch = crop.h / 2, cx = crop.x / 2, cy = crop.y / 2;
+    if (src.format == PixelFormat::BGR) {
+        for (int y = 0; y < crop.h; y += 2) {
+            for (int x = 0; x < crop.w; x += 2) {
+                int su = 0, sv = 0;
+                for (int dy = 0; dy < 2; ++dy) {
+                    const uint8_t* p = src.planes[0] + static_cast<size_t>(crop.y + y + dy) * src.strides[0] + (crop.x + x) * 3;
+                    for (int dx = 0; dx < 2; ++dx, p += 3) {
+                        int b = p[0], g = p[1], r = p[2];
+                        out.row(0, y + dy)[x + dx] = detail::clamp_u8((19595 * r + 38470 * g + 7471 * b + 32768) >> 16);
+                        su += -11059 * r - 21709 * g + 32768 * b;
+                        sv += 32768 * r - 27439 * g - 5329 * b;
+                    }
+                }
+                out.row(1, y / 2)[x / 2] = detail::clamp_u8(((su + 131072) >> 18) + 128);
+                out.row(2, y / 2)[x / 2] = detail::clamp_u8(((sv + 131072) >> 18) + 128);
+            }
+        }
+        return;
+    }
+    auto copy = [&](const uint8_t* s, uint8_t* d, int n, bool luma) {
+        if (!expand_range) std::memcpy(d, s, n);
+        else if (luma) detail::expand_row(s, d, n, 16, detail::kLumaGainQ15, 0);
+        else detail::expand_row(s, d, n, 128, detail::kChromaGainQ15, 128);
+    };
+    for (int y = 0; y < crop.h; ++y)
+        copy(src.planes[0] + static_cast<size_t>(crop.y + y) * src.strides[0] + crop.x, out.row(0, y), crop.w, true);
+    for (int y = 0; y < ch; ++y) {
+        uint8_t* u = out.row(1, y);
+        uint8_t* v = out.row(2, y);
+        if (src.format == PixelFormat::I420) {
+            copy(src.planes[1] + static_cast<size_t>(cy + y) * src.strides[1] + cx, u, cw, false);
+            copy(src.planes[2] + static_cast<size_t>(cy + y) * src.strides[2] + cx, v, cw, false);
+        } else {
+            detail::deinterleave_row(src.planes[1] + static_cast<size_t>(cy + y) * src.strides[1] + 2 * cx, u, v, cw);
+            if (expand_range) {
+                detail::expand_row(u, u, cw, 128, detail::kChromaGainQ15, 128);
+                detail::expand_row(v, v, cw, 128, detail::kChromaGainQ15, 128);
+            }
+        }
+    }
+}
+
+namespace detail {
+
+// 2x2 box average of one plane (odd trailing row/column dropped).
+inline void halve_plane(const uint8_t* src, int sstride, int w, int h, uint8_t* dst, int dstride) {
+    const int dw = w / 2, dh = h / 2;
+    for (int y = 0; y < dh; ++y) {
+        const uint8_t* r0 = src + static_cast<size_t>(2 * y) * sstride;
+        const uint8_t* r1 = r0 + sstride;
+        uint8_t* d = dst + static_cast<size_t>(y) * dstride;
+        int x = 0;
+#ifdef CAMEL_YUV_AVX2
+        const __m256i ones = _mm256_set1_epi8(1), one16 = _mm256_set1_epi16(1);
+        for (; x + 16 <= dw; x += 16) {
+            __m256i v = _mm256_avg_epu8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(r0 + 2 * x)),
+                                        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(r1 + 2 * x)));
+            __m256i sums = _mm256_srli_epi16(_mm256_add_epi16(_mm256_maddubs_epi16(v, ones), one16), 1);
+            __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(sums, sums), 0xd8);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(d + x), _mm256_castsi256_si128(packed));
+        }
+#endif
+        for (; x < dw; ++x) {
+            int a = (r0[2 * x] + r1[2 * x] + 1) >> 1, b = (r0[2 * x + 1] + r1[2 * x + 1] + 1) >> 1;
+            d[x] = static_cast<uint8_t>((a + b + 1) >> 1);
+        }
+    }
+}
+
+// Bilinear resize of one plane, 16.16 fixed point, pixel-center aligned.
+inline void resize_plane(const uint8_t* src, int sstride, int sw, int sh, uint8_t* dst, int dstride, int dw, int dh) {
+    std::vector<int> x0(dw), fx(dw);
+    for (int x = 0; x < dw; ++x) {
+        int64_t p = std::max<int64_t>(0, ((2 * x + 1) * static_cast<int64_t>(sw) << 15) / dw - 32768);
+        x0[x] = std::min(static_cast<int>(p >> 16), sw - 1);
+        fx[x] = x0[x] + 1 < sw ? static_cast<int>((p & 0xffff) >> 8) : 0;
+    }
+    for (int y = 0; y < dh; ++y) {
+        int64_t p = std::max<int64_t>(0, ((2 * y + 1) * static_cast<int64_t>(sh) << 15) / dh - 32768);
+        int y0 = std::min(static_cast<int>(p >> 16), sh - 1), y1 = std::min(y0 + 1, sh - 1);
+        int fy = static_cast<int>((p & 0xffff) >> 8);
+        const uint8_t* a = src + static_cast<size_t>(y0) * sstride;
+        const uint8_t* b = src + static_cast<size_t>(y1) * sstride;
+        uint8_t* d = dst + static_cast<size_t>(y) * dstride;
+        for (int x = 0; x < dw; ++x) {
+            int i = x0[x], f = fx[x];
+            int top = a[i] * (256 - f) + a[i + (f ? 1 : 0)] * f;
+            int bot = b[i] * (256 - f) + b[i + (f ? 1 : 0)] * f;
+            d[x] = static_cast<uint8_t>((top * (256 - fy) + bot * fy + 32768) >> 16);
+        }
+    }
+}
+
+}  // namespace detail
+
+// Area-style downscale: 2x2 box halving while the image is at least twice
+// the target, then one bilinear step to the exact size.
+inline void downscale(const YuvImage& src, int dw, int dh, YuvImage& out) {
+    out.allocate(dw, dh);
+    std::vector<uint8_t> a, b;
+    for (int p = 0; p < 3; ++p) {
+        const uint8_t* s = src.view.planes[p];
+        int sstride = src.view.strides[p], sw = src.plane_width(p), sh = src.plane_height(p);
+        const int tw = out.plane_width(p), th = out.plane_height(p);
+        std::vector<uint8_t>* buf = &a;
+        while (sw >= 2 * tw && sh >= 2 * th) {
+            int hw = sw / 2, hh = sh / 2, hstride = (hw + 32 + 31) & ~31;
+            buf->resize(static_cast<size_t>(hstride) * hh + 32);
+            detail::halve_plane(s, sstride, sw, sh, buf->data(), hstride);
+            s = buf->data();
+            sstride = hstride;
+            sw = hw;
+            sh = hh;
+            buf = buf == &a ? &b : &a;
+        }
+        detail::resize_plane(s, sstride, sw, sh, out.view.planes[p], out.view.strides[p], tw, th);
+    }
+}
+
+struct YuvColor {
+    uint8_t y = 0, u = 128, v = 128;
+};
+
+// BT.601 color for drawing; `full_range` for JPEG-bound images, video range
+// for frames that go back into a video stream.
+inline YuvColor yuv_color(int r, int g, int b, bool full_range) {
+    double y = 0.299 * r + 0.587 * g + 0.114 * b;
+    double u = (b - y) / 1.772, v = (r - y) / 1.402;
+    if (full_range)
+        return {detail::clamp_u8(static_cast<int>(y + 0.5)), detail::clamp_u8(static_cast<int>(u + 128.5)),
+                detail::clamp_u8(static_cast<int>(v + 128.5))};
+    return {detail::clamp_u8(static_cast<int>(16 + y * 219 / 255 + 0.5)),
+            detail::clamp_u8(static_cast<int>(128 + u * 224 / 255 + 0.5)),
+            detail::clamp_u8(static_cast<int>(128 + v * 224 / 255 + 0.5))};
+}
+
+// "#rrggbb" or a basic color name.
+inline YuvColor parse_color(const std::string& s, bool full_range) {
+    static const std::pair<const char*, uint32_t> names[] = {
+        {"red", 0xff3b30}, {"green", 0x34c759}, {"blue", 0x007aff}, {"yellow", 0xffcc00},
+        {"orange", 0xff9500}, {"white", 0xffffff}, {"black", 0x000000}};
+    uint32_t rgb = 0;
+    if (s.size() == 7 && s[0] == '#') {
+        rgb = static_cast<uint32_t>(std::stoul(s.substr(1), nullptr, 16));
+    } else {
+        auto it = std::find_if(std::begin(names), std::end(names), [&](const auto& n) { return s == n.first; });
+        if (it == std::end(names)) throw std::runtime_error("unknown color '" + s + "'");
+        rgb = it->second;
+    }
+    return yuv_color((rgb >> 16) & 0xff, (rgb >> 8) & 0xff, rgb & 0xff, full_range);
+}
+
+// Solid rectangle on a YUV 4:2:0 frame (I420 or NV12), clipped.
+inline void fill_rect(FrameView& f, Rect r, YuvColor c) {
+    int x0 = std::max(0, r.x), y0 = std::max(0, r.y);
+    int x1 = std::min(f.width, r.x + r.w), y1 = std::min(f.height, r.y + r.h);
+    if (x0 >= x1 || y0 >= y1) return;
+    if (f.format == PixelFormat::BGR) {
+        throw std::runtime_error("drawing needs a YUV frame");
+    }
+    for (int y = y0; y < y1; ++y) std::memset(f.planes[0] + static_cast<size_t>(y) * f.strides[0] + x0, c.y, x1 - x0);
+    int cx0 = x0 / 2, cx1 = (x1 + 1) / 2, cy0 = y0 / 2, cy1 = (y1 + 1) / 2;
+    for (int y = cy0; y < cy1; ++y) {
+        if (f.format == PixelFormat::I420) {
+            std::memset(f.planes[1] + static_cast<size_t>(y) * f.strides[1] + cx0, c.u, cx1 - cx0);
+            std::memset(f.planes[2] + static_cast<size_t>(y) * f.strides[2] + cx0, c.v, cx1 - cx0);
+        } else {
+            uint8_t* uv = f.planes[1] + static_cast<size_t>(y) * f.strides[1];
+            for (int x = cx0; x < cx1; ++x) {
+                uv[2 * x] = c.u;
+                uv[2 * x + 1] = c.v;
+            }
+        }
+    }
+}
+
+// Box outline of the given thickness, drawn inside `r`.
+inline void draw_rect(FrameView& f, Rect r, int thickness, YuvColor c) {
+    int t = std::max(1, std::min({thickness, r.w / 2, r.h / 2}));
+    fill_rect(f, {r.x, r.y, r.w, t}, c);
+    fill_rect(f, {r.x, r.y + r.h - t, r.w, t}, c);
+    fill_rect(f, {r.x, r.y + t, t, r.h - 2 * t}, c);
+    fill_rect(f, {r.x + r.w - t, r.y + t, t, r.h - 2 * t}, c);
+}
+
+}  // namespace camel
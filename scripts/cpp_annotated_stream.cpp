@@ -0,0 +1,344 @@
+// Live re-stream of a camera with detection overlays, encoded on demand.
+//
+// Boxes are drawn straight onto an I420 copy of the frame and the result
+// is published through a persistent ffmpeg x264 session (ultrafast,
+// zerolatency) to an RTSP or RTMP server such as mediamtx. Encoding only
+// runs while somebody watches: the stage listens on a small TCP "demand"
+// port, and every open connection, or one made in the last `demand_grace`
+// seconds, counts as a viewer. mediamtx's runOnDemand hook keeps such a
+// connection alive exactly while the path has readers. With no viewers a
+// frame costs one atomic load.
+//
+// Frames are copied into one of three reused canvases; a writer thread
+// feeds the newest one to the encoder, so a slow network drops frames
+// here instead of stalling the route. Messages pass through unchanged.
+//
+// Route usage:
+//   - type: "external"
+//     command: "./bin/cpp_annotated_stream"
+//     config:
+//       url: "rtsp://mediamtx:8554/annotated/front_door"
+//       demand_port: 8091
+//       fps: 10
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "cpp/frame.hpp"
+#include "cpp/json.hpp"
+#include "cpp/processor.hpp"
+#include "cpp/subprocess.hpp"
+#include "cpp/yuv.hpp"
+
+using namespace camel;
+
+namespace {
+
+double now_seconds() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+struct StreamConfig {
+    std::string url;
+    int demand_port = 8091;     // 0 = encode all the time
+    double demand_grace = 10.0;
+    double fps = 10.0;
+    int width = 0;              // output width (even); 0 = source width
+    int bitrate_kbps = 1500;
+    double gop_seconds = 2.0;
+    std::string preset = "ultrafast";
+    int box_thickness = 3;
+    std::map<std::string, std::string> colors;  // class -> color; others cycle through a palette
+    std::string ffmpeg = "ffmpeg";
+
+    static StreamConfig from_json(const json::Value& c) {
+        StreamConfig cfg;
+        cfg.url = c.string_or("url", "");
+        if (cfg.url.rfind("rtsp://", 0) != 0 && cfg.url.rfind("rtmp://", 0) != 0)
+            throw std::runtime_error("config.url must be an rtsp:// or rtmp:// publish URL");
+        cfg.demand_port = static_cast<int>(c.number_or("demand_port", cfg.demand_port));
+        cfg.demand_grace = c.number_or("demand_grace", cfg.demand_grace);
+        cfg.fps = c.number_or("fps", cfg.fps);
+        cfg.width = static_cast<int>(c.number_or("width", cfg.width)) & ~1;
+        cfg.bitrate_kbps = static_cast<int>(c.number_or("bitrate_kbps", cfg.bitrate_kbps));
+        cfg.gop_seconds = c.number_or("gop_seconds", cfg.gop_seconds);
+        cfg.preset = c.string_or("preset", cfg.preset);
+        cfg.box_thickness = static_cast<int>(c.number_or("box_thickness", cfg.box_thickness));
+        if (c.get("colors").is_object())
+            for (const auto& [cls, color] : c.get("colors").as_object()) {
+                parse_color(color.as_string(), false);  // validate
+                cfg.colors[cls] = color.as_string();
+            }
+        cfg.ffmpeg = c.string_or("ffmpeg", cfg.ffmpeg);
+        if (cfg.fps <= 0 || cfg.bitrate_kbps <= 0) throw std::runtime_error("fps and bitrate_kbps must be positive");
+        if (cfg.demand_port < 0 || cfg.demand_port > 65535) throw std::runtime_error("invalid demand_port");
+        return cfg;
+    }
+};
+
+// Viewer demand from connections to a TCP port.
+class DemandListener {
+public:
+    DemandListener(int port, double grace, std::string name) : grace_(grace), name_(std::move(name)) {
+        fd_ = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        int one = 1;
+        setsockopt(fd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_ANY);
+        addr.sin_port = htons(static_cast<uint16_t>(port));
+        if (fd_ < 0 || ::bind(fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || ::listen(fd_, 16) != 0)
+            throw std::runtime_error("cannot listen on demand port " + std::to_string(port) + ": " + std::strerror(errno));
+        thread_ = std::thread([this] { loop(); });
+    }
+
+    ~DemandListener() {
+        stop_ = true;
+        thread_.join();
+        ::close(fd_);
+    }
+
+    bool active() const { return open_.load() > 0 || now_seconds() - last_seen_.load() < grace_; }
+
+private:
+    void loop() {
+        std::vector<pollfd> fds = {{fd_, POLLIN, 0}};
+        char buf[256];
+        while (!stop_) {
+            if (::poll(fds.data(), fds.size(), 200) <= 0) continue;
+            for (size_t i = fds.size(); i-- > 1;) {
+                if (!fds[i].revents) continue;
+                if (::read(fds[i].fd, buf, sizeof(buf)) > 0) continue;  // content is ignored
+                ::close(fds[i].fd);
+                fds.erase(fds.begin() + static_cast<std::ptrdiff_t>(i));
+            }
+            if (fds[0].revents & POLLIN) {
+                int c = ::accept4(fd_, nullptr, nullptr, SOCK_CLOEXEC);
+                if (c >= 0) {
+                    if (open_.load() == 0 && now_seconds() - last_seen_.load() >= grace_) log_info(name_, "viewer connected");
+                    fds.push_back({c, POLLIN, 0});
+                }
+            }
+            open_ = static_cast<int>(fds.size()) - 1;
+            if (open_ > 0 || (fds[0].revents & POLLIN)) last_seen_ = now_seconds();
+        }
+        for (size_t i = 1; i < fds.size(); ++i) ::close(fds[i].fd);
+    }
+
+    int fd_ = -1;
+    double grace_;
+    std::string name_;
+    std::atomic<int> open_{0};
+    std::atomic<double> last_seen_{-1e9};
+    std::atomic<bool> stop_{false};
+    std::thread thread_;
+};
+
+// Persistent encoder session fed by a writer thread from a one-frame mailbox.
+class StreamEncoder {
+public:
+    StreamEncoder(const StreamConfig& cfg, std::string name) : cfg_(cfg), name_(std::move(name)) {
+        thread_ = std::thread([this] { loop(); });
+    }
+
+    ~StreamEncoder() {
+        {
+            std::lock_guard<std::mutex> lock(mu_);
+            stop_ = true;
+        }
+        cv_.notify_one();
+        thread_.join();
+    }
+
+    // Hands over a drawn canvas and returns a free one in its place; a frame
+    // the writer has not picked up yet is replaced.
+    void submit(YuvImage& canvas, bool full_range) {
+        {
+            std::lock_guard<std::mutex> lock(mu_);
+            std::swap(canvas, pending_);
+            pending_full_range_ = full_range;
+            has_pending_ = true;
+        }
+        cv_.notify_one();
+    }
+
+    // No viewers: the session is closed by the writer thread.
+    void idle() {
+        if (!running_.load()) return;
+        {
+            std::lock_guard<std::mutex> lock(mu_);
+            close_ = true;
+        }
+        cv_.notify_one();
+    }
+
+private:
+    void loop() {
+        double retry_at = 0.0;
+        for (;;) {
+            bool close_now = false, full_range = false;
+            {
+                std::unique_lock<std::mutex> lock(mu_);
+                cv_.wait(lock, [&] { return stop_ || has_pending_ || close_; });
+                if (stop_) break;
+                close_now = close_;
+                close_ = false;
+                if (has_pending_) {
+                    std::swap(pending_, writing_);
+                    full_range = pending_full_range_;
+                    has_pending_ = false;
+                }
+            }
+            if (close_now) {
+                stop_encoder("no viewers, encoder stopped");
+                continue;
+            }
+            if (writing_.width == 0 || now_seconds() < retry_at) continue;
+            try {
+                if (encoder_.running() && (writing_.width != enc_w_ || writing_.height != enc_h_)) stop_encoder("");
+                if (!encoder_.running()) start_encoder(writing_.width, writing_.height, full_range);
+                write_frame(writing_);
+            } catch (const std::exception& e) {
+                log_error(name_, e.what());
+                stop_encoder("");
+                retry_at = now_seconds() + 2.0;
+            }
+        }
+        stop_encoder("");
+    }
+
+    void start_encoder(int w, int h, bool full_range) {
+        const int gop = std::max(1, static_cast<int>(cfg_.gop_seconds * cfg_.fps + 0.5));
+        std::vector<std::string> argv = {cfg_.ffmpeg, "-hide_banner", "-loglevel", "error", "-f", "rawvideo",
+                                         "-pix_fmt", "yuv420p", "-video_size", std::to_string(w) + "x" + std::to_string(h),
+                                         "-color_range", full_range ? "pc" : "tv", "-use_wallclock_as_timestamps", "1",
+                                         "-i", "pipe:0", "-an", "-c:v", "libx264", "-preset", cfg_.preset, "-tune",
+                                         "zerolatency", "-bf", "0", "-g", std::to_string(gop), "-b:v",
+                                         std::to_string(cfg_.bitrate_kbps) + "k", "-maxrate",
+                                         std::to_string(cfg_.bitrate_kbps) + "k", "-bufsize",
+                                         std::to_string(cfg_.bitrate_kbps / 2) + "k", "-vsync", "0"};
+        if (cfg_.url.rfind("rtsp://", 0) == 0) argv.insert(argv.end(), {"-f", "rtsp", "-rtsp_transport", "tcp"});
+        else argv.insert(argv.end(), {"-f", "flv"});
+        argv.push_back(cfg_.url);
+        encoder_ = Subprocess::spawn(argv, Subprocess::Stdin);
+        enc_w_ = w;
+        enc_h_ = h;
+        running_ = true;
+        log_info(name_, "encoding " + std::to_string(w) + "x" + std::to_string(h) + " to " + cfg_.url);
+    }
+
+    void stop_encoder(const std::string& why) {
+        if (!encoder_.running()) return;
+        encoder_.close_stdin();
+        encoder_.wait();
+        running_ = false;
+        if (!why.empty()) log_info(name_, why);
+    }
+
+    void write_frame(const YuvImage& img) {
+        packed_.resize(frame_bytes(PixelFormat::I420, img.width, img.height));
+        uint8_t* out = packed_.data();
+        for (int p = 0; p < 3; ++p)
+            for (int y = 0; y < img.plane_height(p); ++y, out += img.plane_width(p))
+                std::memcpy(out, img.row(p, y), img.plane_width(p));
+        if (!encoder_.write(packed_.data(), packed_.size())) throw std::runtime_error("encoder exited");
+    }
+
+    const StreamConfig& cfg_;
+    std::string name_;
+    std::mutex mu_;
+    std::condition_variable cv_;
+    bool stop_ = false, close_ = false, has_pending_ = false, pending_full_range_ = false;
+    YuvImage pending_, writing_;
+    std::vector<uint8_t> packed_;
+    Subprocess encoder_;
+    int enc_w_ = 0, enc_h_ = 0;
+    std::atomic<bool> running_{false};
+    std::thread thread_;
+};
+
+class AnnotatedStream {
+public:
+    AnnotatedStream(StreamConfig cfg, std::string name) : cfg_(std::move(cfg)), encoder_(cfg_, name) {
+        if (cfg_.demand_port > 0) demand_ = std::make_unique<DemandListener>(cfg_.demand_port, cfg_.demand_grace, name);
+    }
+
+    bool handle(json::Value& message) {
+        if (demand_ && !demand_->active()) {
+            encoder_.idle();
+            return true;
+        }
+        const double now = now_seconds();
+        if (now < next_frame_) return true;
+        next_frame_ = std::max(next_frame_ + 1.0 / cfg_.fps, now + 0.5 / cfg_.fps);
+
+        const json::Value& ref = message.get("frame");
+        FrameView frame = frames_.resolve(ref);
+        const bool full_range = frame.format == PixelFormat::BGR;  // BGR converts with the JFIF matrix
+        if (cfg_.width > 0 && cfg_.width < frame.width) {
+            copy_to_i420(frame, Rect{}, full_, false);
+            const int h = static_cast<int>(static_cast<long>(full_.height) * cfg_.width / full_.width) & ~1;
+            downscale(full_, cfg_.width, std::max(2, h), canvas_);
+        } else {
+            copy_to_i420(frame, Rect{}, canvas_, false);
+        }
+        if (!frames_.still_valid(ref)) return true;  // torn copy: skip this frame
+        draw_detections(message.get("detections"), canvas_, frame.width, frame.height, full_range);
+        encoder_.submit(canvas_, full_range);
+        return true;
+    }
+
+private:
+    void draw_detections(const json::Value& dets, YuvImage& img, int fw, int fh, bool full_range) {
+        if (!dets.is_array()) return;
+        static const char* palette[] = {"green", "red", "blue", "yellow", "orange", "white"};
+        const double sx = static_cast<double>(img.width) / fw, sy = static_cast<double>(img.height) / fh;
+        for (const auto& d : dets.as_array()) {
+            const json::Value& b = d["bbox"];
+            if (!b.is_array() || b.size() != 4) continue;
+            const std::string cls = d.string_or("class", "");
+            auto it = cfg_.colors.find(cls);
+            const std::string& color = it != cfg_.colors.end()
+                                           ? it->second
+                                           : std::string(palette[std::hash<std::string>()(cls) % std::size(palette)]);
+            int x1 = static_cast<int>(b[0].as_number() * sx), y1 = static_cast<int>(b[1].as_number() * sy);
+            int x2 = static_cast<int>(b[2].as_number() * sx), y2 = static_cast<int>(b[3].as_number() * sy);
+            draw_rect(img.view, {x1, y1, x2 - x1, y2 - y1}, cfg_.box_thickness, parse_color(color, full_range));
+        }
+    }
+
+    StreamConfig cfg_;
+    StreamEncoder encoder_;
+    std::unique_ptr<DemandListener> demand_;
+    FrameStore frames_;
+    YuvImage canvas_, full_;
+    double next_frame_ = 0.0;
+};
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    signal(SIGPIPE, SIG_IGN);
+    return processor_main(argc, argv, "cpp_annotated_stream", [](const ProcessorOptions& opts) -> MessageHandler {
+        auto stream = std::make_shared<AnnotatedStream>(StreamConfig::from_json(opts.config), opts.name);
+        return [stream](json::Value& message) { return stream->handle(message); };
+    });
+}
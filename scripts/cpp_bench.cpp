@@ -0,0 +1,251 @@
+// Microbenchmarks for the primitives every native stage runs per message,
+// built on Google Benchmark. `make benchmark` runs them, writes
+// results/benchmark.json and compares it against
+// results/benchmark_baseline.json (scripts/compare_benchmarks.py).
+//
+// Groups:
+//   BM_Json*        message parse and dump, the cost of every stdin line, and
+//                   an exact round trip of fractional numbers
+//   BM_Envelope*    binary envelope encode and decode by payload size
+//   BM_SlotRing*    frame hand-off through a shared memory slot ring
+//   BM_DoubleBuffer snapshot publish and read
+//   BM_WorkerPool   fan-out of small jobs to the pool and back
+//   BM_Nms          greedy NMS by box count and IoU threshold (percent)
+//   BM_RoiFilter    zone test of each detection by detection count
+//
+// Usual flags apply, e.g. `bin/cpp_bench --benchmark_filter=Nms`.
+
+#include <benchmark/benchmark.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "cpp/double_buffer.hpp"
+#include "cpp/envelope.hpp"
+#include "cpp/json.hpp"
+#include "cpp/nms.hpp"
+#include "cpp/roi.hpp"
+#include "cpp/shm.hpp"
+#include "cpp/worker_pool.hpp"
+
+using namespace camel;
+
+namespace {
+
+// Detections spread over a 1920x1080 frame in clusters, so IoU thresholds
+// change how much gets suppressed as they would on real detector output.
+std::vector<Detection> make_detections(size_t count, uint32_t seed = 42) {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> center_x(100.0f, 1820.0f), center_y(100.0f, 980.0f);
+    std::uniform_real_distribution<float> size(40.0f, 200.0f), jitter(-12.0f, 12.0f), score(0.25f, 1.0f);
+    std::uniform_int_distribution<int> cls(0, 3);
+    std::vector<Detection> dets;
+    dets.reserve(count);
+    while (dets.size() < count) {
+        const float cx = center_x(rng), cy = center_y(rng), w = size(rng), h = size(rng);
+        const int c = cls(rng);
+        for (int k = 0; k < 8 && dets.size() < count; ++k) {
+            const float x = cx + jitter(rng), y = cy + jitter(rng);
+            dets.push_back({{x - w / 2, y - h / 2, x + w / 2, y + h / 2}, score(rng), c});
+        }
+    }
+    return dets;
+}
+
+// A message as it leaves the postprocessor.
+std::string detection_message(size_t count) {
+    json::Value msg = json::Value::object();
+    msg["id"] = "cam1-000123";
+    msg["camera"] = "front_door";
+    msg["timestamp"] = 1760000000.123;
+    json::Value list = json::Value::array();
+    for (const auto& d : make_detections(count)) {
+        json::Value det = json::Value::object();
+        det["class"] = "person";
+        det["confidence"] = d.score;
+        json::Value bbox = json::Value::array();
+        for (float v : {d.box.x1, d.box.y1, d.box.x2, d.box.y2}) bbox.push_back(v);
+        det["bbox"] = std::move(bbox);
+        list.push_back(std::move(det));
+    }
+    msg["detections"] = std::move(list);
+    return msg.dump();
+}
+
+void BM_JsonParse(benchmark::State& state) {
+    const std::string text = detection_message(static_cast<size_t>(state.range(0)));
+    for (auto _ : state) {
+        json::Value v = json::Value::parse(text);
+        benchmark::DoNotOptimize(v);
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * text.size()));
+}
+BENCHMARK(BM_JsonParse)->Arg(1)->Arg(20)->Arg(200);
+
+void BM_JsonDump(benchmark::State& state) {
+    const json::Value v = json::Value::parse(detection_message(static_cast<size_t>(state.range(0))));
+    for (auto _ : state) {
+        std::string text = v.dump();
+        benchmark::DoNotOptimize(text);
+    }
+}
+BENCHMARK(BM_JsonDump)->Arg(1)->Arg(20)->Arg(200);
+
+// Fractional values must survive parse -> dump -> parse unchanged, since
+// every stage re-serializes the message; errors out if one does not.
+void BM_JsonNumberRoundTrip(benchmark::State& state) {
+    std::mt19937_64 rng(7);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    std::vector<double> values = {1760000000.123, 0.1, 1.0 / 3.0, 123456.789e-12, -2.5e300, 0.15625};
+    while (values.size() < 1000) values.push_back((unit(rng) - 0.5) * std::pow(10.0, unit(rng) * 40.0 - 20.0));
+    std::string text;
+    for (auto _ : state) {
+        for (double v : values) {
+            text.clear();
+            json::Value(v).dump_to(text);
+            const double back = json::Value::parse(text).as_number();
+            if (back != v) {
+                state.SkipWithError(("number " + text + " does not round-trip").c_str());
+                return;
+            }
+        }
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * values.size()));
+}
+BENCHMARK(BM_JsonNumberRoundTrip);
+
+void BM_EnvelopeEncode(benchmark::State& state) {
+    const std::string header = detection_message(1);
+    const std::string payload(static_cast<size_t>(state.range(0)), '\x5a');
+    std::vector<char> buffer(16 + header.size() + payload.size());
+    FILE* out = fmemopen(buffer.data(), buffer.size(), "w");
+    std::setvbuf(out, nullptr, _IONBF, 0);
+    for (auto _ : state) {
+        std::rewind(out);
+        write_envelope(out, header, payload);
+        benchmark::ClobberMemory();
+    }
+    std::fclose(out);
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * buffer.size()));
+}
+BENCHMARK(BM_EnvelopeEncode)->Arg(0)->Arg(4 << 10)->Arg(1 << 20);
+
+void BM_EnvelopeDecode(benchmark::State& state) {
+    const std::string header = detection_message(1);
+    const std::string payload(static_cast<size_t>(state.range(0)), '\x5a');
+    char* data = nullptr;
+    size_t size = 0;
+    FILE* out = open_memstream(&data, &size);
+    write_envelope(out, header, payload);
+    std::fclose(out);
+    std::istringstream in(std::string(data, size));
+    std::free(data);
+    json::Value h;
+    std::string p;
+    for (auto _ : state) {
+        in.clear();
+        in.seekg(0);
+        read_envelope(in, h, p);
+        benchmark::DoNotOptimize(p.data());
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * size));
+}
+BENCHMARK(BM_EnvelopeDecode)->Arg(0)->Arg(4 << 10)->Arg(1 << 20);
+
+// Writer and reader in one thread: the cost of the hand-off protocol and
+// the copy, without scheduling noise.
+void BM_SlotRingHandoff(benchmark::State& state) {
+    const size_t bytes = static_cast<size_t>(state.range(0));
+    const std::string name = "/camel_bench_" + std::to_string(::getpid());
+    SlotRing ring = SlotRing::create(name, 8, bytes);
+    shm_unlink(name.c_str());
+    std::vector<uint8_t> frame(bytes, 0x80), copy(bytes);
+    for (auto _ : state) {
+        SlotRing::WriteSlot slot = ring.begin_write();
+        std::memcpy(slot.data, frame.data(), bytes);
+        ring.end_write(slot, bytes);
+        size_t n = 0;
+        const uint8_t* p = ring.read(slot.index, slot.sequence, &n);
+        std::memcpy(copy.data(), p, n);
+        benchmark::DoNotOptimize(ring.still_valid(slot.index, slot.sequence));
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * bytes));
+}
+BENCHMARK(BM_SlotRingHandoff)->Arg(64)->Arg(640 * 640 * 3)->Arg(1920 * 1080 * 3 / 2);
+
+// Publish from the benchmark thread while ThreadRange readers pin snapshots.
+void BM_DoubleBuffer(benchmark::State& state) {
+    static DoubleBuffer<std::vector<double>> buffer;
+    if (state.thread_index() == 0) {
+        uint64_t skipped = 0;
+        for (auto _ : state)
+            if (!buffer.publish([](std::vector<double>& v) { v.assign(64, 1.0); })) ++skipped;
+        state.counters["skipped"] = benchmark::Counter(static_cast<double>(skipped), benchmark::Counter::kAvgIterations);
+    } else {
+        for (auto _ : state) {
+            auto ref = buffer.read();
+            benchmark::DoNotOptimize(ref->size());
+        }
+    }
+}
+BENCHMARK(BM_DoubleBuffer)->ThreadRange(1, 4)->UseRealTime();
+
+void BM_WorkerPool(benchmark::State& state) {
+    WorkerPool pool(4);
+    std::vector<double> out(static_cast<size_t>(state.range(0)));
+    for (auto _ : state) {
+        std::vector<std::function<void()>> jobs;
+        for (size_t i = 0; i < out.size(); ++i)
+            jobs.emplace_back([&out, i] { out[i] = std::sqrt(static_cast<double>(i)); });
+        pool.run(jobs);
+        benchmark::DoNotOptimize(out.data());
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * out.size()));
+}
+BENCHMARK(BM_WorkerPool)->Arg(4)->Arg(64)->UseRealTime();
+
+void BM_Nms(benchmark::State& state) {
+    const std::vector<Detection> dets = make_detections(static_cast<size_t>(state.range(0)));
+    NmsOptions opt;
+    opt.iou_threshold = static_cast<float>(state.range(1)) / 100.0f;
+    opt.max_detections = dets.size();
+    size_t kept = 0;
+    for (auto _ : state) {
+        std::vector<uint32_t> idx = nms_indices(dets, opt);
+        kept = idx.size();
+        benchmark::DoNotOptimize(idx.data());
+    }
+    state.counters["kept"] = static_cast<double>(kept);
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * dets.size()));
+}
+BENCHMARK(BM_Nms)->ArgsProduct({{10, 100, 1000, 5000}, {30, 45, 70}})->ArgNames({"boxes", "iou"});
+
+void BM_RoiFilter(benchmark::State& state) {
+    const json::Value zones = json::Value::parse(R"([
+        {"name": "driveway", "points": [[0.1, 0.5], [0.6, 0.45], [0.7, 1.0], [0.05, 1.0]]},
+        {"name": "porch", "points": [[0.7, 0.3], [0.95, 0.3], [0.95, 0.7], [0.85, 0.8], [0.7, 0.7]]}
+    ])");
+    RoiFilter roi;
+    roi.zones = zones_to_pixels(parse_zones(zones), 1920, 1080);
+    const std::vector<Detection> dets = make_detections(static_cast<size_t>(state.range(0)));
+    for (auto _ : state) {
+        size_t inside = 0;
+        for (const auto& d : dets) inside += roi.zone_of(d.box) >= 0;
+        benchmark::DoNotOptimize(inside);
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * dets.size()));
+}
+BENCHMARK(BM_RoiFilter)->Arg(10)->Arg(100)->Arg(1000);
+
+}  // namespace
+
+BENCHMARK_MAIN();
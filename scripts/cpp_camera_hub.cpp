@@ -0,0 +1,482 @@
+// Node-level camera ingest and decode.
+//
+// One process serves every camera on the node. A single epoll thread
+// multiplexes the RTSP sessions (ffmpeg stream copies to Annex-B), the
+// decoder pipes and the decoded output; a DecodeScheduler decides which
+// compressed picture is decoded next, with per-camera fairness, frame-rate
+// caps and stale-GOP dropping, and caps how many pictures are decoded at
+// once node-wide. Decoders are single-threaded ffmpeg processes pinned to
+// the CPUs of their camera's NUMA node, and each camera's frame ring is
+// bound to the same node.
+//
+// Decoded frames are written straight from the decoder pipe into
+// `/camel_frames_<camera>` slot rings, and one NDJSON message per published
+// frame goes to stdout:
+//   {"camera": "front", "frame": {"shm": "/camel_frames_front", ...},
+//    "frame_time_ms": 1760000000123, "numa_node": 0}
+// The hub stops when its stdin closes or on SIGTERM. With tracing on, each
+// message starts a trace whose first span runs from the arrival of the
+// compressed picture to the publication of its frame.
+//
+// With `capture` set, every compressed picture received is also appended
+// to a capture file (cpp/capture.hpp). A camera whose source is a
+// `replay://` URI is fed from such a file by cpp_replay instead of ffmpeg,
+// so recorded traffic goes through the same decode path as live cameras.
+//
+// Usage:
+//   ./bin/cpp_camera_hub --config-file cameras.json | ./bin/cpp_preprocessor ...
+
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "cpp/annexb.hpp"
+#include "cpp/capture.hpp"
+#include "cpp/decode_scheduler.hpp"
+#include "cpp/frame.hpp"
+#include "cpp/json.hpp"
+#include "cpp/numa.hpp"
+#include "cpp/processor.hpp"
+#include "cpp/shm.hpp"
+#include "cpp/subprocess.hpp"
+#include "cpp/trace.hpp"
+#include "cpp/y4m.hpp"
+
+using namespace camel;
+
+namespace {
+
+volatile std::sig_atomic_t g_stop = 0;
+
+double now_seconds() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+double unix_seconds() {
+    return std::chrono::duration<double>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+struct CameraConfig {
+    std::string name;
+    std::string source;
+    VideoCodec codec = VideoCodec::H264;
+    CameraPolicy policy;
+    int numa_node = -1;  // -1 = spread round-robin over nodes
+
+    static CameraConfig from_json(const json::Value& c) {
+        CameraConfig cfg;
+        cfg.name = c.string_or("name", "");
+        cfg.source = c.string_or("source", "");
+        if (cfg.name.empty() || cfg.source.empty()) throw std::runtime_error("every camera needs a name and a source");
+        cfg.codec = parse_video_codec(c.string_or("codec", "h264"));
+        cfg.policy.max_fps = c.number_or("max_fps", cfg.policy.max_fps);
+        cfg.policy.weight = c.number_or("weight", cfg.policy.weight);
+        cfg.numa_node = static_cast<int>(c.number_or("numa_node", cfg.numa_node));
+        return cfg;
+    }
+};
+
+struct HubConfig {
+    std::vector<CameraConfig> cameras;
+    SchedulerOptions scheduler;
+    std::string ffmpeg = "ffmpeg";
+    std::string replay = "./bin/cpp_replay";
+    std::string capture;  // capture file for received pictures; empty = off
+    std::string shm_prefix = "/camel_frames_";
+    uint32_t slots = 8;
+    double stats_interval = 30.0;
+
+    static HubConfig from_json(const json::Value& c) {
+        HubConfig cfg;
+        const json::Value& cams = c.get("cameras");
+        if (!cams.is_array() || cams.size() == 0) throw std::runtime_error("config.cameras must be a non-empty list");
+        for (const auto& v : cams.as_array()) cfg.cameras.push_back(CameraConfig::from_json(v));
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        cfg.scheduler.workers = static_cast<int>(c.number_or("decode_workers", std::max(1L, cores - 1)));
+        cfg.scheduler.depth = static_cast<int>(c.number_or("decoder_depth", cfg.scheduler.depth));
+        cfg.scheduler.max_queue_seconds = c.number_or("max_queue_seconds", cfg.scheduler.max_queue_seconds);
+        cfg.ffmpeg = c.string_or("ffmpeg", cfg.ffmpeg);
+        cfg.replay = c.string_or("replay", cfg.replay);
+        cfg.capture = c.string_or("capture", cfg.capture);
+        cfg.shm_prefix = c.string_or("shm_prefix", cfg.shm_prefix);
+        cfg.slots = static_cast<uint32_t>(c.number_or("slots", cfg.slots));
+        cfg.stats_interval = c.number_or("stats_interval", cfg.stats_interval);
+        if (cfg.scheduler.workers < 1 || cfg.scheduler.depth < 1) throw std::runtime_error("decode_workers and decoder_depth must be >= 1");
+        if (cfg.slots < 2) throw std::runtime_error("slots must be >= 2");
+        return cfg;
+    }
+};
+
+class CameraHub {
+public:
+    CameraHub(HubConfig cfg, std::string name) : cfg_(std::move(cfg)), name_(std::move(name)), sched_(cfg_.scheduler) {
+        epoll_ = epoll_create1(EPOLL_CLOEXEC);
+        if (epoll_ < 0) throw std::runtime_error("epoll_create1 failed");
+        const int nodes = numa_node_count();
+        for (size_t i = 0; i < cfg_.cameras.size(); ++i) {
+            auto cam = std::make_unique<Camera>(cfg_.cameras[i]);
+            cam->id = sched_.add_camera(cam->cfg.policy);
+            cam->node = cam->cfg.numa_node >= 0 ? cam->cfg.numa_node % nodes : static_cast<int>(i) % nodes;
+            cam->cpus = numa_node_cpus(cam->node);
+            cams_.push_back(std::move(cam));
+        }
+        watch(STDIN_FILENO, EPOLLIN, token(0, kControl));  // fails harmlessly for /dev/null or files
+        if (!cfg_.capture.empty()) {
+            capture_ = std::make_unique<CaptureWriter>(cfg_.capture);
+            log_info(name_, "capturing received pictures to " + cfg_.capture);
+        }
+    }
+
+    ~CameraHub() { close(epoll_); }
+
+    int run() {
+        log_info(name_, std::to_string(cams_.size()) + " cameras, " + std::to_string(cfg_.scheduler.workers) +
+                            " decode workers, " + std::to_string(numa_node_count()) + " NUMA node(s)");
+        double next_stats = now_seconds() + cfg_.stats_interval;
+        epoll_event events[64];
+        while (!g_stop && !stopping_) {
+            int n = epoll_wait(epoll_, events, 64, 100);
+            if (n < 0 && errno != EINTR) throw std::runtime_error("epoll_wait failed");
+            for (int i = 0; i < n; ++i) dispatch(events[i]);
+            const double now = now_seconds();
+            for (auto& cam : cams_) maintain(*cam, now);
+            sched_.tick(now);
+            feed(now);
+            if (cfg_.stats_interval > 0 && now >= next_stats) {
+                log_stats();
+                next_stats = now + cfg_.stats_interval;
+            }
+        }
+        log_stats();
+        return 0;
+    }
+
+private:
+    enum Kind : uint64_t { kIngest = 0, kDecoderIn = 1, kDecoderOut = 2, kControl = 3 };
+
+    struct Camera {
+        explicit Camera(CameraConfig c)
+            : cfg(std::move(c)), parser(cfg.codec), delimiter(access_unit_delimiter(cfg.codec)) {}
+
+        CameraConfig cfg;
+        size_t id = 0;
+        int node = 0;
+        std::vector<int> cpus;
+
+        Subprocess ingest;
+        AccessUnitParser parser;
+        double ingest_retry = 0.0;
+        double ingest_started = 0.0;
+        double backoff = 1.0;
+
+        Subprocess decoder;
+        double decoder_retry = 0.0;
+        bool decoder_fresh = true;  // nothing fed since start: prepend parameter sets
+        std::vector<uint8_t> delimiter;
+        std::vector<uint8_t> pending;
+        size_t pending_off = 0;
+
+        Y4mParser y4m;
+        std::unique_ptr<SlotRing> ring;
+        SlotRing::WriteSlot slot{};
+        size_t frame_size = 0;
+        bool publishing = false;
+        std::vector<uint8_t> scratch;
+        std::deque<uint64_t> fed_us;  // arrival of the pictures in the decoder, oldest first
+        uint64_t last_received = 0;
+        uint64_t last_decoded = 0;
+    };
+
+    // Receives decoded frames from the Y4M parser of one camera.
+    struct FrameSink {
+        CameraHub* hub;
+        Camera* cam;
+        uint8_t* begin_frame(int w, int h, size_t bytes) { return hub->begin_frame(*cam, w, h, bytes); }
+        void end_frame() { hub->end_frame(*cam); }
+    };
+
+    static uint64_t token(size_t cam, Kind kind) { return (static_cast<uint64_t>(cam) << 2) | kind; }
+
+    bool watch(int fd, uint32_t events, uint64_t tok) {
+        epoll_event ev{};
+        ev.events = events;
+        ev.data.u64 = tok;
+        return epoll_ctl(epoll_, EPOLL_CTL_ADD, fd, &ev) == 0;
+    }
+
+    static void set_nonblocking(int fd) { fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK); }
+
+    void dispatch(const epoll_event& ev) {
+        const auto kind = static_cast<Kind>(ev.data.u64 & 3);
+        if (kind == kControl) {
+            char buf[4096];
+            ssize_t r = ::read(STDIN_FILENO, buf, sizeof(buf));
+            if (r == 0 || (r < 0 && errno != EAGAIN && errno != EINTR)) stopping_ = true;
+            return;
+        }
+        Camera& cam = *cams_[ev.data.u64 >> 2];
+        try {
+            if (kind == kIngest && cam.ingest.running()) read_ingest(cam);
+            else if (kind == kDecoderIn && cam.decoder.running()) flush(cam);
+            else if (kind == kDecoderOut && cam.decoder.running()) read_decoder(cam);
+        } catch (const std::exception& e) {
+            log_error(name_, cam.cfg.name + ": " + e.what());
+            stop_decoder(cam);
+        }
+    }
+
+    void read_ingest(Camera& cam) {
+        uint8_t buf[1 << 16];
+        ssize_t r = cam.ingest.read(buf, sizeof(buf));
+        if (r < 0 && errno == EAGAIN) return;
+        const double now = now_seconds();
+        auto push = [&](AccessUnit&& u) {
+            u.time = now;
+            if (capture_) record(cam, u);
+            sched_.push(cam.id, std::make_shared<const AccessUnit>(std::move(u)));
+        };
+        if (r > 0) {
+            cam.parser.feed(buf, static_cast<size_t>(r), push);
+            return;
+        }
+        cam.parser.flush(push);
+        cam.parser = AccessUnitParser(cam.cfg.codec);
+        cam.ingest.wait();
+        if (now - cam.ingest_started > 30.0) cam.backoff = 1.0;
+        log_error(name_, "stream " + cam.cfg.name + " ended, reconnecting in " + std::to_string(static_cast<int>(cam.backoff)) + "s");
+        cam.ingest_retry = now + cam.backoff;
+        cam.backoff = std::min(cam.backoff * 2.0, 30.0);
+    }
+
+    // Captured keyframes get the parameter sets prepended so a replay can
+    // start decoding at any of them.
+    void record(Camera& cam, const AccessUnit& u) {
+        json::Value h = json::Value::object();
+        h["camera"] = cam.cfg.name;
+        h["codec"] = annexb_format(cam.cfg.codec);
+        h["keyframe"] = u.keyframe;
+        capture_header_.clear();
+        h.dump_to(capture_header_);
+        capture_payload_.clear();
+        if (u.keyframe && !u.has_parameter_sets) {
+            const auto& ps = cam.parser.parameter_sets();
+            capture_payload_.assign(ps.begin(), ps.end());
+        }
+        capture_payload_.append(u.data.begin(), u.data.end());
+        try {
+            capture_->write(RecordType::AccessUnit, capture_header_, capture_payload_);
+        } catch (const std::exception& e) {
+            log_error(name_, std::string(e.what()) + ", capture stopped");
+            capture_.reset();
+        }
+    }
+
+    void read_decoder(Camera& cam) {
+        uint8_t buf[1 << 18];
+        ssize_t r = cam.decoder.read(buf, sizeof(buf));
+        if (r < 0 && errno == EAGAIN) return;
+        if (r <= 0) {
+            log_error(name_, "decoder for " + cam.cfg.name + " exited");
+            stop_decoder(cam);
+            return;
+        }
+        FrameSink sink{this, &cam};
+        cam.y4m.feed(buf, static_cast<size_t>(r), sink);
+    }
+
+    uint8_t* begin_frame(Camera& cam, int w, int h, size_t bytes) {
+        cam.frame_size = bytes;
+        cam.publishing = sched_.admit(cam.id, now_seconds());
+        if (!cam.publishing) {
+            cam.scratch.resize(bytes);
+            return cam.scratch.data();
+        }
+        if (ensure_slot_ring(cam.ring, cfg_.shm_prefix + cam.cfg.name, cfg_.slots, bytes)) {
+            const std::string& shm = cam.ring->name();
+            if (!numa_bind_memory(cam.ring->mapping(), cam.ring->mapping_bytes(), cam.node) && numa_node_count() > 1)
+                log_error(name_, "could not bind " + shm + " to NUMA node " + std::to_string(cam.node));
+            log_info(name_, cam.cfg.name + ": " + std::to_string(w) + "x" + std::to_string(h) + " into " + shm);
+        }
+        cam.slot = cam.ring->begin_write();
+        return cam.slot.data;
+    }
+
+    void end_frame(Camera& cam) {
+        const double now = now_seconds();
+        sched_.decoded(cam.id, cam.publishing, now);
+        // Every picture out pops its arrival, published or not, so the
+        // queue stays aligned with the decoder's output.
+        uint64_t fed_us = 0;
+        if (!cam.fed_us.empty()) {
+            fed_us = cam.fed_us.front();
+            cam.fed_us.pop_front();
+        }
+        if (!cam.publishing) return;
+        cam.ring->end_write(cam.slot, cam.frame_size);
+        Span span;
+        if (fed_us) span = tracer_.begin_root(fed_us);
+        json::Value msg = json::Value::object();
+        msg["camera"] = cam.cfg.name;
+        msg["frame"] = frame_reference(*cam.ring, cam.slot, PixelFormat::I420, cam.y4m.width(), cam.y4m.height());
+        msg["frame_time_ms"] = std::round(unix_seconds() * 1000.0);
+        msg["numa_node"] = cam.node;
+        tracer_.end(span, msg);
+        out_.clear();
+        msg.dump_to(out_);
+        out_ += '\n';
+        std::fwrite(out_.data(), 1, out_.size(), stdout);
+        std::fflush(stdout);
+    }
+
+    void start_ingest(Camera& cam, double now) {
+        std::vector<std::string> argv;
+        if (cam.cfg.source.rfind("replay://", 0) == 0) {
+            json::Value rc = json::Value::object();
+            rc["uri"] = cam.cfg.source;
+            rc["camera"] = cam.cfg.name;
+            rc["output"] = "annexb";
+            argv = {cfg_.replay, "--name", "cpp_replay:" + cam.cfg.name, "--config", rc.dump()};
+        } else {
+            argv = ffmpeg_copy_args(cfg_.ffmpeg, cam.cfg.source, cam.cfg.codec);
+        }
+        cam.ingest = Subprocess::spawn(argv, Subprocess::Stdout);
+        set_nonblocking(cam.ingest.stdout_fd());
+        watch(cam.ingest.stdout_fd(), EPOLLIN, token(cam.id, kIngest));
+        cam.ingest_started = now;
+    }
+
+    void start_decoder(Camera& cam) {
+        cam.decoder = Subprocess::spawn({cfg_.ffmpeg, "-hide_banner", "-loglevel", "error", "-threads", "1", "-fflags",
+                                         "nobuffer", "-flags", "low_delay", "-f", annexb_format(cam.cfg.codec), "-i",
+                                         "pipe:0", "-an", "-pix_fmt", "yuv420p", "-vsync", "0", "-f", "yuv4mpegpipe",
+                                         "pipe:1"},
+                                        Subprocess::Stdin | Subprocess::Stdout, cam.cpus);
+        set_nonblocking(cam.decoder.stdin_fd());
+        set_nonblocking(cam.decoder.stdout_fd());
+        watch(cam.decoder.stdin_fd(), EPOLLOUT | EPOLLET, token(cam.id, kDecoderIn));
+        watch(cam.decoder.stdout_fd(), EPOLLIN, token(cam.id, kDecoderOut));
+        cam.decoder_fresh = true;
+        cam.pending.clear();
+        cam.pending_off = 0;
+        cam.y4m.reset();
+        cam.fed_us.clear();
+        sched_.reset(cam.id);
+    }
+
+    void stop_decoder(Camera& cam) {
+        cam.decoder.terminate();
+        cam.decoder.wait();
+        cam.decoder_retry = now_seconds() + 1.0;
+        sched_.reset(cam.id);
+    }
+
+    // Starts (or restarts) the processes a camera needs.
+    void maintain(Camera& cam, double now) {
+        try {
+            if (!cam.ingest.running() && now >= cam.ingest_retry) start_ingest(cam, now);
+            if (!cam.decoder.running() && now >= cam.decoder_retry) start_decoder(cam);
+        } catch (const std::exception& e) {
+            log_error(name_, cam.cfg.name + ": " + e.what());
+            cam.ingest_retry = cam.decoder_retry = now + 5.0;
+        }
+    }
+
+    // Hands pictures to decoders while the scheduler has pool capacity.
+    void feed(double now) {
+        size_t id;
+        UnitPtr unit;
+        while (sched_.next(id, unit, now)) {
+            Camera& cam = *cams_[id];
+            if (!cam.decoder.running()) {
+                // The unit was counted in flight; release it and the rest
+                // of the queue, which the restarted decoder drops anyway.
+                sched_.reset(cam.id);
+                continue;
+            }
+            if (cam.decoder_fresh && !unit->has_parameter_sets) {
+                const auto& ps = cam.parser.parameter_sets();
+                cam.pending.insert(cam.pending.end(), ps.begin(), ps.end());
+            }
+            cam.decoder_fresh = false;
+            if (tracer_.enabled()) {
+                // Decoders emit one frame per picture, in order.
+                if (cam.fed_us.size() >= 64) cam.fed_us.pop_front();
+                cam.fed_us.push_back(trace_now_us() - static_cast<uint64_t>((now - unit->time) * 1e6));
+            }
+            const size_t skip = leading_delimiter_bytes(cam.cfg.codec, *unit);
+            cam.pending.insert(cam.pending.end(), unit->data.begin() + static_cast<std::ptrdiff_t>(skip), unit->data.end());
+            cam.pending.insert(cam.pending.end(), cam.delimiter.begin(), cam.delimiter.end());
+            flush(cam);
+        }
+    }
+
+    // Non-blocking write of queued bytes; the rest goes on EPOLLOUT.
+    void flush(Camera& cam) {
+        while (cam.pending_off < cam.pending.size()) {
+            ssize_t w = ::write(cam.decoder.stdin_fd(), cam.pending.data() + cam.pending_off, cam.pending.size() - cam.pending_off);
+            if (w < 0) {
+                if (errno == EINTR) continue;
+                if (errno == EAGAIN) return;
+                throw std::runtime_error(std::string("decoder pipe: ") + std::strerror(errno));
+            }
+            cam.pending_off += static_cast<size_t>(w);
+        }
+        cam.pending.clear();
+        cam.pending_off = 0;
+    }
+
+    void log_stats() {
+        for (auto& cam : cams_) {
+            const CameraStats& s = sched_.stats(cam->id);
+            char line[256];
+            std::snprintf(line, sizeof(line), "%s: node %d, received %llu, decoded %llu, published %llu, dropped %llu%s",
+                          cam->cfg.name.c_str(), cam->node, static_cast<unsigned long long>(s.received),
+                          static_cast<unsigned long long>(s.decoded), static_cast<unsigned long long>(s.published),
+                          static_cast<unsigned long long>(s.dropped), s.keyframes_only ? " (keyframes only)" : "");
+            log_info(name_, line);
+        }
+    }
+
+    HubConfig cfg_;
+    std::string name_;
+    DecodeScheduler sched_;
+    Tracer& tracer_ = Tracer::instance();
+    int epoll_ = -1;
+    std::vector<std::unique_ptr<Camera>> cams_;
+    std::string out_;
+    std::unique_ptr<CaptureWriter> capture_;
+    std::string capture_header_, capture_payload_;
+    bool stopping_ = false;
+};
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    signal(SIGPIPE, SIG_IGN);
+    signal(SIGTERM, [](int) { g_stop = 1; });
+    signal(SIGINT, [](int) { g_stop = 1; });
+    try {
+        ProcessorOptions opts = parse_options(argc, argv, "cpp_camera_hub");
+        CameraHub hub(HubConfig::from_json(opts.config), opts.name);
+        Tracer::instance().set_service(opts.name);
+        const int status = hub.run();
+        Tracer::instance().flush();
+        return status;
+    } catch (const std::exception& e) {
+        log_error("cpp_camera_hub", e.what());
+        return 1;
+    }
+}
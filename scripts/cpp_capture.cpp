@@ -0,0 +1,118 @@
+// Records every message that passes through into a capture file (see
+// cpp/capture.hpp), for replaying production traffic with cpp_replay.
+//
+// Placed first in a route, it captures exactly what the source delivered.
+// Messages pass through unchanged. A frame reference is only valid while
+// its shared-memory slot lives, so the frame pixels are copied into the
+// capture by default; binary envelope payloads are kept as well.
+//
+// Route usage:
+//   - type: "external"
+//     command: "./bin/cpp_capture"
+//     config:
+//       path: "captures/front_door.cap"
+//       max_bytes: 20000000000
+
+#include <csignal>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "cpp/capture.hpp"
+#include "cpp/frame.hpp"
+#include "cpp/json.hpp"
+#include "cpp/processor.hpp"
+
+using namespace camel;
+
+namespace {
+
+struct CaptureConfig {
+    std::string path;
+    bool pixels = true;      // "frames": "pixels" | "reference"
+    uint64_t max_bytes = 0;  // 0 = unlimited
+
+    static CaptureConfig from_json(const json::Value& c) {
+        CaptureConfig cfg;
+        cfg.path = c.string_or("path", "");
+        if (cfg.path.empty()) throw std::runtime_error("config.path is required");
+        const std::string frames = c.string_or("frames", "pixels");
+        if (frames != "pixels" && frames != "reference") throw std::runtime_error("frames must be 'pixels' or 'reference'");
+        cfg.pixels = frames == "pixels";
+        const double max_bytes = c.number_or("max_bytes", 0);
+        if (max_bytes < 0) throw std::runtime_error("max_bytes must be >= 0");
+        cfg.max_bytes = static_cast<uint64_t>(max_bytes);
+        return cfg;
+    }
+};
+
+class Capture {
+public:
+    Capture(CaptureConfig cfg, std::string name) : cfg_(std::move(cfg)), name_(std::move(name)), writer_(cfg_.path) {
+        log_info(name_, "capturing to " + cfg_.path);
+    }
+
+    ~Capture() {
+        try {
+            writer_.close();
+            log_info(name_, std::to_string(writer_.records()) + " messages, " + std::to_string(writer_.bytes()) +
+                                " bytes in " + cfg_.path);
+        } catch (const std::exception& e) {
+            log_error(name_, e.what());
+        }
+    }
+
+    bool handle(json::Value& message, std::string& payload) {
+        if (full_) return true;
+        header_.clear();
+        message.dump_to(header_);
+        size_t frame_size = 0;
+        const json::Value& ref = message.get("frame");
+        if (cfg_.pixels && ref.is_object()) {
+            // A frame that is already gone is recorded as a bare reference;
+            // the message itself must not go missing from the capture.
+            try {
+                FrameView f = frames_.resolve(ref);
+                frame_size = frame_bytes(f.format, f.width, f.height);
+                pixels_.resize(frame_size);
+                std::memcpy(pixels_.data(), f.planes[0], frame_size);
+                if (!frames_.still_valid(ref)) frame_size = 0;
+            } catch (const std::exception&) {
+                frame_size = 0;
+            }
+            if (frame_size == 0 && ++lost_frames_ % 100 == 1)
+                log_error(name_, "frame overwritten before capture (" + std::to_string(lost_frames_) + " so far)");
+        }
+        if (cfg_.max_bytes && writer_.bytes() + header_.size() + payload.size() + frame_size > cfg_.max_bytes) {
+            full_ = true;
+            writer_.close();
+            log_error(name_, "max_bytes reached, capture stopped");
+            return true;
+        }
+        writer_.write(RecordType::Message, header_, payload, pixels_.data(), frame_size);
+        return true;
+    }
+
+private:
+    CaptureConfig cfg_;
+    std::string name_;
+    CaptureWriter writer_;
+    FrameStore frames_;
+    std::string header_;
+    std::vector<uint8_t> pixels_;
+    uint64_t lost_frames_ = 0;
+    bool full_ = false;
+};
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    // The route stops processors by closing stdin; SIGTERM leaves a capture
+    // without index, which cpp_replay still reads.
+    signal(SIGPIPE, SIG_IGN);
+    return processor_main(argc, argv, "cpp_capture", [](const ProcessorOptions& opts) -> EnvelopeHandler {
+        auto capture = std::make_shared<Capture>(CaptureConfig::from_json(opts.config), opts.name);
+        return [capture](json::Value& message, std::string& payload) { return capture->handle(message, payload); };
+    });
+}
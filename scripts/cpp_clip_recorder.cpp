@@ -0,0 +1,550 @@
+// Pre-event clip recorder.
+//
+// Keeps the last `pre_seconds` of a camera's compressed H.264/H.265 stream
+// in memory as access units, trimmed to start on a keyframe. Every message
+// that reaches this stage is treated as an event: the packets from the
+// keyframe before (event - pre_seconds) to (event + post_seconds) are
+// remuxed into MP4 with `ffmpeg -c copy`, so a clip costs disk I/O and no
+// decoding or encoding. The message gains `clip_path` (and `clip_url` when
+// `base_url` is set) for the email/http sinks to attach or link.
+//
+// With `evidence_frames`, the same buffer also serves high-resolution
+// stills: the route decodes only the camera's low-res sub-stream for
+// detection, and on an event the GOP of the main stream leading up to it
+// is decoded once into an `evidence_frame` shared-memory ring that
+// cpp_snapshot reads. Decoding runs on its own thread; an event waits for
+// it at most `evidence_wait_seconds` and otherwise goes on without it.
+//
+// Route usage (after the filter that decides what is an alert):
+//   - type: "external"
+//     command: "./bin/cpp_clip_recorder"
+//     config:
+//       source: "rtsp://{{CAMERA_USER}}:{{CAMERA_PASS}}@{{CAMERA_IP}}/stream1"
+//       pre_seconds: 10
+//       post_seconds: 5
+//       output_dir: "clips"
+
+#include <signal.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <deque>
+#include <filesystem>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "cpp/annexb.hpp"
+#include "cpp/frame.hpp"
+#include "cpp/json.hpp"
+#include "cpp/probes.hpp"
+#include "cpp/processor.hpp"
+#include "cpp/shm.hpp"
+#include "cpp/subprocess.hpp"
+#include "cpp/y4m.hpp"
+
+using namespace camel;
+
+namespace {
+
+double now_seconds() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+struct RecorderConfig {
+    std::string source;
+    VideoCodec codec = VideoCodec::H264;
+    std::string ffmpeg = "ffmpeg";
+    std::string camera;
+    double pre_seconds = 10.0;
+    double post_seconds = 5.0;
+    double max_clip_seconds = 60.0;
+    double fps = 0.0;  // 0 = measured from packet arrival
+    std::string output_dir = "clips";
+    std::string base_url;
+    bool wait = false;
+    bool clips = true;
+    bool evidence_frames = false;
+    std::string evidence_shm;  // default /camel_evidence_<camera>
+    uint32_t evidence_slots = 4;
+    double evidence_wait_seconds = 2.0;
+
+    static RecorderConfig from_json(const json::Value& c, const std::string& name) {
+        RecorderConfig cfg;
+        cfg.source = c.string_or("source", "");
+        if (cfg.source.empty()) throw std::runtime_error("config.source is required");
+        cfg.codec = parse_video_codec(c.string_or("codec", "h264"));
+        cfg.ffmpeg = c.string_or("ffmpeg", cfg.ffmpeg);
+        cfg.camera = c.string_or("camera", name);
+        cfg.pre_seconds = c.number_or("pre_seconds", cfg.pre_seconds);
+        cfg.post_seconds = c.number_or("post_seconds", cfg.post_seconds);
+        cfg.max_clip_seconds = c.number_or("max_clip_seconds", cfg.max_clip_seconds);
+        cfg.fps = c.number_or("fps", cfg.fps);
+        cfg.output_dir = c.string_or("output_dir", cfg.output_dir);
+        cfg.base_url = c.string_or("base_url", cfg.base_url);
+        cfg.wait = c.bool_or("wait", cfg.wait);
+        cfg.clips = c.bool_or("clips", cfg.clips);
+        cfg.evidence_frames = c.bool_or("evidence_frames", cfg.evidence_frames);
+        cfg.evidence_shm = c.string_or("evidence_shm", "/camel_evidence_" + cfg.camera);
+        cfg.evidence_slots = static_cast<uint32_t>(c.number_or("evidence_slots", cfg.evidence_slots));
+        cfg.evidence_wait_seconds = c.number_or("evidence_wait_seconds", cfg.evidence_wait_seconds);
+        if (!cfg.clips && !cfg.evidence_frames) throw std::runtime_error("nothing to do: clips and evidence_frames are both off");
+        if (cfg.evidence_slots < 1) throw std::runtime_error("evidence_slots must be >= 1");
+        if (cfg.pre_seconds < 0 || cfg.post_seconds < 0) throw std::runtime_error("pre/post_seconds must be >= 0");
+        if (cfg.evidence_wait_seconds < 0) throw std::runtime_error("evidence_wait_seconds must be >= 0");
+        return cfg;
+    }
+};
+
+// Access units of the last `keep_seconds`, always starting on a keyframe.
+// Units are shared with clip writers, so trimming never copies or blocks on
+// a slow disk.
+class PacketRing {
+public:
+    explicit PacketRing(double keep_seconds) : keep_(keep_seconds) {}
+
+    void push(AccessUnit&& unit, const std::vector<uint8_t>& parameter_sets) {
+        std::lock_guard<std::mutex> lock(mu_);
+        unit.sequence = next_sequence_++;
+        const bool key = unit.keyframe;
+        units_.push_back(std::make_shared<const AccessUnit>(std::move(unit)));
+        if (key) headers_ = parameter_sets;
+        // Drop whole GOPs while the next keyframe is still old enough.
+        const double horizon = units_.back()->time - keep_;
+        for (;;) {
+            auto next_key = std::find_if(units_.begin() + 1, units_.end(), [](const UnitPtr& u) { return u->keyframe; });
+            if (next_key == units_.end() || (*next_key)->time > horizon) break;
+            units_.erase(units_.begin(), next_key);
+        }
+        if (!units_.front()->keyframe) units_.pop_front();  // leading partial GOP from stream start
+        cv_.notify_all();
+    }
+
+    void close() {
+        std::lock_guard<std::mutex> lock(mu_);
+        closed_ = true;
+        cv_.notify_all();
+    }
+
+    // Units from the last keyframe at or before `from` (or the oldest one).
+    std::vector<UnitPtr> snapshot(double from, std::vector<uint8_t>& parameter_sets) const {
+        std::lock_guard<std::mutex> lock(mu_);
+        parameter_sets = headers_;
+        size_t start = units_.size();
+        for (size_t i = 0; i < units_.size(); ++i) {
+            if (!units_[i]->keyframe) continue;
+            if (start == units_.size() || units_[i]->time <= from) start = i;
+            if (units_[i]->time > from) break;
+        }
+        return {units_.begin() + static_cast<std::ptrdiff_t>(std::min(start, units_.size())), units_.end()};
+    }
+
+    // The GOP leading up to `t`: units from the last keyframe at or before
+    // `t` through the last unit that arrived by then.
+    std::vector<UnitPtr> gop_until(double t, std::vector<uint8_t>& parameter_sets) const {
+        std::lock_guard<std::mutex> lock(mu_);
+        parameter_sets = headers_;
+        size_t start = 0, end = 0;
+        for (size_t i = 0; i < units_.size() && (i == 0 || units_[i]->time <= t); ++i) {
+            if (units_[i]->keyframe) start = i;
+            end = i + 1;
+        }
+        return {units_.begin() + static_cast<std::ptrdiff_t>(start), units_.begin() + static_cast<std::ptrdiff_t>(end)};
+    }
+
+    // Units newer than `after`, waiting until one arrives or `deadline`.
+    std::vector<UnitPtr> wait_newer(uint64_t after, double deadline) const {
+        std::unique_lock<std::mutex> lock(mu_);
+        auto ready = [&] { return closed_ || (!units_.empty() && units_.back()->sequence > after); };
+        double timeout = deadline - now_seconds();
+        if (timeout > 0) cv_.wait_for(lock, std::chrono::duration<double>(timeout), ready);
+        std::vector<UnitPtr> out;
+        for (const auto& u : units_)
+            if (u->sequence > after) out.push_back(u);
+        return out;
+    }
+
+    // Frame rate from arrival times; raw Annex-B carries no timestamps.
+    double measured_fps() const {
+        std::lock_guard<std::mutex> lock(mu_);
+        if (units_.size() < 2) return 0.0;
+        double span = units_.back()->time - units_.front()->time;
+        return span > 0 ? (units_.size() - 1) / span : 0.0;
+    }
+
+    bool closed() const {
+        std::lock_guard<std::mutex> lock(mu_);
+        return closed_;
+    }
+
+private:
+    double keep_;
+    mutable std::mutex mu_;
+    mutable std::condition_variable cv_;
+    std::deque<UnitPtr> units_;
+    std::vector<uint8_t> headers_;
+    uint64_t next_sequence_ = 1;
+    bool closed_ = false;
+};
+
+// One clip being written; its end moves out while further events arrive.
+struct Clip {
+    std::string path;
+    std::string url;
+    double start = 0.0;
+    std::atomic<double> end{0.0};
+    std::thread writer;
+    std::mutex mu;
+    std::condition_variable done_cv;
+    bool done = false;
+};
+
+// One evidence decode: the GOP up to an event, resolved to the
+// `evidence_frame` reference once it is in the ring.
+struct EvidenceJob {
+    std::vector<UnitPtr> units;
+    std::vector<uint8_t> headers;
+    std::promise<json::Value> promise;
+    std::shared_future<json::Value> frame = promise.get_future().share();
+};
+
+class ClipRecorder {
+public:
+    explicit ClipRecorder(const RecorderConfig& cfg, const std::string& name)
+        : cfg_(cfg), name_(name), ring_(cfg.pre_seconds + 1.0) {
+        if (cfg_.clips) std::filesystem::create_directories(cfg_.output_dir);
+        ingest_ = std::thread([this] { ingest(); });
+        if (cfg_.evidence_frames) evidence_thread_ = std::thread([this] { evidence_worker(); });
+    }
+
+    ~ClipRecorder() {
+        stopping_ = true;
+        {
+            std::lock_guard<std::mutex> lock(ingest_mu_);
+            ingest_proc_.terminate();
+        }
+        ingest_.join();
+        {
+            std::lock_guard<std::mutex> lock(evidence_mu_);
+            evidence_proc_.terminate();
+        }
+        evidence_cv_.notify_all();
+        if (evidence_thread_.joinable()) evidence_thread_.join();
+        ring_.close();
+        for (auto& c : clips_)
+            if (c->writer.joinable()) c->writer.join();
+    }
+
+    bool handle(json::Value& message) {
+        const double t = now_seconds();
+        std::shared_ptr<EvidenceJob> evidence;
+        if (cfg_.evidence_frames) evidence = request_evidence(t);
+        std::shared_ptr<Clip> clip;
+        if (cfg_.clips) {
+            clip = active_clip(t);
+            if (!clip) clip = start_clip(t);
+            message["clip_path"] = clip->path;
+            if (!clip->url.empty()) message["clip_url"] = clip->url;
+        }
+        if (evidence) attach_evidence(message, *evidence, t);
+        if (clip && cfg_.wait) {
+            std::unique_lock<std::mutex> lock(clip->mu);
+            clip->done_cv.wait(lock, [&] { return clip->done; });
+            if (!std::filesystem::exists(clip->path)) throw std::runtime_error("clip was not written");
+        }
+        return true;
+    }
+
+private:
+    // An event inside a clip's post window extends that clip, up to
+    // max_clip_seconds, instead of starting an overlapping one.
+    std::shared_ptr<Clip> active_clip(double t) {
+        reap();
+        if (clips_.empty()) return nullptr;
+        auto& c = clips_.back();
+        if (t > c->end.load()) return nullptr;
+        double end = std::min(t + cfg_.post_seconds, c->start + cfg_.max_clip_seconds);
+        if (end > c->end.load()) c->end = end;
+        return c;
+    }
+
+    std::shared_ptr<Clip> start_clip(double t) {
+        auto clip = std::make_shared<Clip>();
+        std::string file = cfg_.camera + "_" + timestamp() + ".mp4";
+        clip->path = (std::filesystem::path(cfg_.output_dir) / file).string();
+        if (!cfg_.base_url.empty())
+            clip->url = cfg_.base_url + (cfg_.base_url.back() == '/' ? "" : "/") + file;
+        clip->start = t - cfg_.pre_seconds;
+        clip->end = t + cfg_.post_seconds;
+        clip->writer = std::thread([this, clip] { write_clip(*clip); });
+        clips_.push_back(clip);
+        return clip;
+    }
+
+    void reap() {
+        while (!clips_.empty()) {
+            auto& c = clips_.front();
+            {
+                std::lock_guard<std::mutex> lock(c->mu);
+                if (!c->done) break;
+            }
+            c->writer.join();
+            clips_.pop_front();
+        }
+    }
+
+    void write_clip(Clip& clip) {
+        std::string part = clip.path + ".part";
+        bool ok = false;
+        try {
+            ok = mux(clip, part);
+        } catch (const std::exception& e) {
+            log_error(name_, std::string("clip ") + clip.path + ": " + e.what());
+        }
+        if (ok) {
+            std::filesystem::rename(part, clip.path);
+            if (CAMEL_PROBE_ENABLED(deliver)) {
+                std::error_code ec;
+                const uint64_t bytes = std::filesystem::file_size(clip.path, ec);
+                CAMEL_PROBE4(deliver, probes::route(), probes::stage(), clip.path.c_str(), ec ? 0 : bytes);
+            }
+            log_info(name_, "clip written to " + clip.path);
+        } else {
+            std::error_code ec;
+            std::filesystem::remove(part, ec);
+        }
+        std::lock_guard<std::mutex> lock(clip.mu);
+        clip.done = true;
+        clip.done_cv.notify_all();
+    }
+
+    bool mux(Clip& clip, const std::string& part) {
+        std::vector<uint8_t> headers;
+        std::vector<UnitPtr> units = ring_.snapshot(clip.start, headers);
+        if (units.empty()) throw std::runtime_error("no video received from " + cfg_.source);
+
+        double fps = cfg_.fps > 0 ? cfg_.fps : ring_.measured_fps();
+        if (fps <= 0) fps = 25.0;
+        char rate[32];
+        std::snprintf(rate, sizeof(rate), "%.3f", std::clamp(fps, 1.0, 240.0));
+        Subprocess mp4 = Subprocess::spawn({cfg_.ffmpeg, "-hide_banner", "-loglevel", "error", "-y", "-f",
+                                            annexb_format(cfg_.codec), "-framerate", rate, "-i", "pipe:0", "-c",
+                                            "copy", "-movflags", "+faststart", "-f", "mp4", part},
+                                           Subprocess::Stdin);
+
+        bool ok = true;
+        if (!units.front()->has_parameter_sets && !headers.empty()) ok = mp4.write(headers.data(), headers.size());
+        uint64_t last = 0;
+        auto write_units = [&](const std::vector<UnitPtr>& batch) {
+            for (const auto& u : batch) {
+                if (u->time > clip.end.load()) return false;
+                ok = ok && mp4.write(u->data.data(), u->data.size());
+                last = u->sequence;
+            }
+            return true;
+        };
+        // Pre-event packets are already in memory; post-event ones are
+        // written as they arrive until the (possibly extended) end.
+        bool more = write_units(units);
+        while (more && ok && now_seconds() < clip.end.load() && !ring_.closed())
+            more = write_units(ring_.wait_newer(last, clip.end.load()));
+        return mp4.wait() == 0 && ok;
+    }
+
+    // Queues the decode of the GOP leading up to `t`. Events that end on
+    // the same access unit share one decode; a queued decode that has not
+    // started yet is superseded by the newer one, since its picture would
+    // be older and the ring only keeps the last few anyway.
+    std::shared_ptr<EvidenceJob> request_evidence(double t) {
+        auto job = std::make_shared<EvidenceJob>();
+        job->units = ring_.gop_until(t, job->headers);
+        if (job->units.empty()) throw std::runtime_error("no video received from " + cfg_.source);
+        std::lock_guard<std::mutex> lock(evidence_mu_);
+        if (last_evidence_ && last_evidence_->units.back() == job->units.back()) return last_evidence_;
+        if (pending_evidence_)
+            pending_evidence_->promise.set_exception(
+                std::make_exception_ptr(std::runtime_error("evidence decode superseded by a newer event")));
+        pending_evidence_ = job;
+        last_evidence_ = job;
+        evidence_cv_.notify_one();
+        return job;
+    }
+
+    // Waits up to evidence_wait_seconds so a slow decode delays one event
+    // instead of the route; a late or failed picture is left out of the
+    // message and cpp_snapshot falls back to `frame`.
+    void attach_evidence(json::Value& message, EvidenceJob& job, double t) {
+        const auto wait = std::chrono::duration<double>(std::max(0.0, t + cfg_.evidence_wait_seconds - now_seconds()));
+        if (job.frame.wait_for(wait) != std::future_status::ready) {
+            log_error(name_, "evidence decode did not finish within " +
+                               std::to_string(std::lround(cfg_.evidence_wait_seconds * 1000.0)) + " ms");
+            return;
+        }
+        try {
+            message["evidence_frame"] = job.frame.get();
+        } catch (const std::exception& e) {
+            log_error(name_, std::string("evidence: ") + e.what());
+            return;
+        }
+        message["evidence_age_ms"] = std::round((t - job.units.back()->time) * 1000.0);
+    }
+
+    void evidence_worker() {
+        for (;;) {
+            std::shared_ptr<EvidenceJob> job;
+            {
+                std::unique_lock<std::mutex> lock(evidence_mu_);
+                evidence_cv_.wait(lock, [&] { return stopping_ || pending_evidence_; });
+                if (stopping_) break;
+                job = std::move(pending_evidence_);
+            }
+            try {
+                job->promise.set_value(decode_evidence(*job));
+            } catch (...) {
+                job->promise.set_exception(std::current_exception());
+            }
+        }
+        std::lock_guard<std::mutex> lock(evidence_mu_);
+        if (pending_evidence_)
+            pending_evidence_->promise.set_exception(std::make_exception_ptr(std::runtime_error("recorder stopping")));
+        pending_evidence_.reset();
+    }
+
+    // Decodes the main-stream picture at the end of `job` (the whole GOP up
+    // to it, the only decode this stream ever gets) into the evidence ring.
+    json::Value decode_evidence(const EvidenceJob& job) {
+        const std::vector<UnitPtr>& units = job.units;
+        const std::vector<uint8_t>& headers = job.headers;
+        {
+            std::lock_guard<std::mutex> lock(evidence_mu_);
+            if (stopping_) throw std::runtime_error("recorder stopping");
+            evidence_proc_ = Subprocess::spawn({cfg_.ffmpeg, "-hide_banner", "-loglevel", "error", "-f",
+                                                annexb_format(cfg_.codec), "-i", "pipe:0", "-an", "-pix_fmt",
+                                                "yuv420p", "-f", "yuv4mpegpipe", "pipe:1"},
+                                               Subprocess::Stdin | Subprocess::Stdout);
+        }
+        Subprocess& dec = evidence_proc_;
+        // Feed from a second thread: decoded frames fill the stdout pipe
+        // long before the compressed GOP is written.
+        std::thread feeder([&] {
+            bool ok = units.front()->has_parameter_sets || headers.empty() || dec.write(headers.data(), headers.size());
+            for (const auto& u : units)
+                if (ok) ok = dec.write(u->data.data(), u->data.size());
+            dec.close_stdin();
+        });
+        Y4mReader y4m([&](void* buf, size_t n) { return dec.read(buf, n); });
+        int frames = 0;
+        try {
+            if (y4m.read_header())
+                while (y4m.next_frame(evidence_)) ++frames;
+        } catch (...) {
+            {
+                std::lock_guard<std::mutex> lock(evidence_mu_);
+                dec.terminate();
+            }
+            feeder.join();
+            throw;
+        }
+        feeder.join();
+        int status;
+        {
+            std::lock_guard<std::mutex> lock(evidence_mu_);
+            status = dec.wait();
+        }
+        if (frames == 0) throw std::runtime_error("evidence decode produced no frame (ffmpeg exit " + std::to_string(status) + ")");
+
+        const size_t bytes = evidence_.size();
+        ensure_slot_ring(evidence_ring_, cfg_.evidence_shm, cfg_.evidence_slots, bytes);
+        SlotRing::WriteSlot slot = evidence_ring_->begin_write();
+        std::memcpy(slot.data, evidence_.data(), bytes);
+        evidence_ring_->end_write(slot, bytes);
+        return frame_reference(*evidence_ring_, slot, PixelFormat::I420, y4m.width(), y4m.height());
+    }
+
+    // Runs ffmpeg as a stream copier and feeds its Annex-B output into the
+    // ring; restarts with backoff when the camera drops.
+    void ingest() {
+        std::vector<uint8_t> buf(1 << 16);
+        double backoff = 1.0;
+        while (!stopping_) {
+            std::vector<std::string> argv = ffmpeg_copy_args(cfg_.ffmpeg, cfg_.source, cfg_.codec);
+            AccessUnitParser parser(cfg_.codec);
+            auto push = [&](AccessUnit&& u) {
+                u.time = now_seconds();
+                ring_.push(std::move(u), parser.parameter_sets());
+            };
+            try {
+                {
+                    std::lock_guard<std::mutex> lock(ingest_mu_);
+                    if (stopping_) break;
+                    ingest_proc_ = Subprocess::spawn(argv, Subprocess::Stdout);
+                }
+                double started = now_seconds();
+                // Reads need no lock: the destructor only signals the
+                // process, and the pipe stays ours until wait() below.
+                ssize_t n;
+                while ((n = ingest_proc_.read(buf.data(), buf.size())) > 0) parser.feed(buf.data(), static_cast<size_t>(n), push);
+                parser.flush(push);
+                std::lock_guard<std::mutex> lock(ingest_mu_);
+                ingest_proc_.wait();
+                if (now_seconds() - started > 30.0) backoff = 1.0;
+            } catch (const std::exception& e) {
+                log_error(name_, e.what());
+            }
+            if (stopping_) break;
+            log_error(name_, "stream " + cfg_.camera + " ended, reconnecting in " + std::to_string(static_cast<int>(backoff)) + "s");
+            for (double waited = 0; waited < backoff && !stopping_; waited += 0.1)
+                std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            backoff = std::min(backoff * 2.0, 30.0);
+        }
+    }
+
+    static std::string timestamp() {
+        auto now = std::chrono::system_clock::now();
+        std::time_t t = std::chrono::system_clock::to_time_t(now);
+        int ms = static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()).count() % 1000);
+        std::tm tm{};
+        localtime_r(&t, &tm);
+        char buf[40];
+        std::snprintf(buf, sizeof(buf), "%04d%02d%02d-%02d%02d%02d-%03d", tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday,
+                      tm.tm_hour, tm.tm_min, tm.tm_sec, ms);
+        return buf;
+    }
+
+    RecorderConfig cfg_;
+    std::string name_;
+    PacketRing ring_;
+    std::atomic<bool> stopping_{false};
+    std::mutex ingest_mu_;
+    Subprocess ingest_proc_;
+    std::thread ingest_;
+    std::deque<std::shared_ptr<Clip>> clips_;
+    // Evidence state below evidence_mu_ is owned by the evidence thread.
+    std::mutex evidence_mu_;
+    std::condition_variable evidence_cv_;
+    std::shared_ptr<EvidenceJob> pending_evidence_;
+    std::shared_ptr<EvidenceJob> last_evidence_;
+    Subprocess evidence_proc_;
+    std::thread evidence_thread_;
+    std::vector<uint8_t> evidence_;
+    std::unique_ptr<SlotRing> evidence_ring_;
+};
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    signal(SIGPIPE, SIG_IGN);  // a dying ffmpeg must not take the processor down
+    return processor_main(argc, argv, "cpp_clip_recorder", [](const ProcessorOptions& opts) -> MessageHandler {
+        auto rec = std::make_shared<ClipRecorder>(RecorderConfig::from_json(opts.config, opts.name), opts.name);
+        return [rec](json::Value& message) { return rec->handle(message); };
+    });
+}
@@ -0,0 +1,356 @@
+// Native object detection processor (ONNX Runtime, CPU execution provider).
+//
+// Drop-in replacement for `python -m ultralytics_processor` on the
+// per-frame path: the exported YOLOv8 model is loaded once, frames are
+// letterboxed in-process (or taken zero-copy from cpp_preprocessor's shared
+// tensor), and head decoding plus NMS run in the same process.
+//
+// Route usage:
+//   - type: "external"
+//     command: "./bin/cpp_detector"
+//     config:
+//       model: "yolov8n.onnx"
+//       confidence_threshold: 0.6
+//       target_objects: ["person", "car"]
+
+#include <onnxruntime_cxx_api.h>
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "cpp/frame.hpp"
+#include "cpp/json.hpp"
+#include "cpp/nms.hpp"
+#include "cpp/preprocess.hpp"
+#include "cpp/processor.hpp"
+#include "cpp/roi.hpp"
+#include "cpp/shm.hpp"
+#include "cpp/tiling.hpp"
+#include "cpp/yolo.hpp"
+#include "cpp/yolo_decode.hpp"
+
+using namespace camel;
+
+namespace {
+
+struct DetectorConfig {
+    std::string model;
+    float confidence_threshold = 0.5f;
+    NmsOptions nms;
+    int intra_op_threads = 0;  // 0 lets ONNX Runtime use one thread per physical core
+    int inter_op_threads = 1;
+    bool allow_spinning = false;
+    uint8_t pad_value = 114;
+    // Overrides of the model's input quantization; see OrtYolo::input_quant().
+    json::Value input_quant_scale;
+    json::Value input_quant_zero_point;
+
+    static DetectorConfig from_json(const json::Value& c) {
+        DetectorConfig cfg;
+        cfg.model = c.string_or("model", "");
+        if (cfg.model.empty()) throw std::runtime_error("config.model is required");
+        if (cfg.model.size() > 3 && cfg.model.compare(cfg.model.size() - 3, 3, ".pt") == 0)
+            throw std::runtime_error("config.model must be an ONNX export (yolo export model=" + cfg.model +
+                                     " format=onnx)");
+        cfg.confidence_threshold = static_cast<float>(c.number_or("confidence_threshold", cfg.confidence_threshold));
+        cfg.nms.iou_threshold = static_cast<float>(c.number_or("iou_threshold", cfg.nms.iou_threshold));
+        cfg.nms.max_detections = static_cast<size_t>(c.number_or("max_detections", 300));
+        cfg.intra_op_threads = static_cast<int>(c.number_or("intra_op_threads", cfg.intra_op_threads));
+        cfg.inter_op_threads = static_cast<int>(c.number_or("inter_op_threads", cfg.inter_op_threads));
+        cfg.allow_spinning = c.bool_or("allow_spinning", cfg.allow_spinning);
+        cfg.pad_value = static_cast<uint8_t>(c.number_or("pad_value", cfg.pad_value));
+        cfg.input_quant_scale = c.get("input_quant_scale");
+        cfg.input_quant_zero_point = c.get("input_quant_zero_point");
+        if (cfg.input_quant_scale.is_number() && cfg.input_quant_scale.as_number() <= 0)
+            throw std::runtime_error("input_quant_scale must be positive");
+        return cfg;
+    }
+};
+
+// One loaded model. Input geometry and element type come from the model; a
+// dynamic batch dimension allows whole batches per Run(), a fixed one is run
+// in chunks. Statically quantized (QDQ) models keep a float input; models
+// whose input was quantized as well take uint8/int8 tensors directly.
+// Their input quantization comes from the `input_quant_scale` and
+// `input_quant_zero_point` metadata of the model when present, else from
+// default_quant(); config values override either.
+class OrtYolo {
+public:
+    explicit OrtYolo(const DetectorConfig& cfg)
+        : env_(ORT_LOGGING_LEVEL_WARNING, "cpp_detector"),
+          session_(env_, cfg.model.c_str(), session_options(cfg)),
+          memory_(Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeDefault)) {
+        Ort::AllocatorWithDefaultOptions alloc;
+        input_name_ = session_.GetInputNameAllocated(0, alloc).get();
+        output_name_ = session_.GetOutputNameAllocated(0, alloc).get();
+
+        auto info = session_.GetInputTypeInfo(0).GetTensorTypeAndShapeInfo();
+        std::vector<int64_t> shape = info.GetShape();
+        if (shape.size() != 4 || shape[1] != 3) throw std::runtime_error("model input must be NCHW with 3 channels");
+        switch (info.GetElementType()) {
+            case ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT: input_type_ = TensorType::Float32; break;
+            case ONNX_TENSOR_ELEMENT_DATA_TYPE_UINT8: input_type_ = TensorType::UInt8; break;
+            case ONNX_TENSOR_ELEMENT_DATA_TYPE_INT8: input_type_ = TensorType::Int8; break;
+            default: throw std::runtime_error("model input must be float32, uint8 or int8");
+        }
+        if (session_.GetOutputTypeInfo(0).GetTensorTypeAndShapeInfo().GetElementType() !=
+            ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT)
+            throw std::runtime_error("model output must be float32 (export without half precision)");
+        fixed_batch_ = shape[0] > 0 ? static_cast<int>(shape[0]) : 0;
+        height_ = shape[2] > 0 ? static_cast<int>(shape[2]) : 640;
+        width_ = shape[3] > 0 ? static_cast<int>(shape[3]) : 640;
+
+        input_quant_ = default_quant(input_type_);
+        Ort::ModelMetadata meta = session_.GetModelMetadata();
+        if (auto v = meta.LookupCustomMetadataMapAllocated("input_quant_scale", alloc))
+            input_quant_.scale = std::stof(v.get());
+        if (auto v = meta.LookupCustomMetadataMapAllocated("input_quant_zero_point", alloc))
+            input_quant_.zero_point = std::stoi(v.get());
+        if (cfg.input_quant_scale.is_number()) input_quant_.scale = static_cast<float>(cfg.input_quant_scale.as_number());
+        if (cfg.input_quant_zero_point.is_number())
+            input_quant_.zero_point = static_cast<int>(cfg.input_quant_zero_point.as_number());
+        if (input_quant_.scale <= 0.0f) throw std::runtime_error("model input_quant_scale must be positive");
+    }
+
+    int width() const { return width_; }
+    int height() const { return height_; }
+    TensorType input_type() const { return input_type_; }
+    const TensorQuant& input_quant() const { return input_quant_; }
+    size_t item_bytes() const { return static_cast<size_t>(3) * height_ * width_ * tensor_element_size(input_type_); }
+
+    // Runs `batch` images laid out contiguously at `data` and calls
+    // on_head(index, head, layout) for each image while the output is alive.
+    template <typename OnHead>
+    void run(const void* input, int batch, OnHead&& on_head) {
+        const auto* data = static_cast<const uint8_t*>(input);
+        const size_t item = item_bytes();
+        int chunk = fixed_batch_ > 0 ? fixed_batch_ : batch;
+        for (int start = 0; start < batch; start += chunk) {
+            int n = std::min(chunk, batch - start);
+            if (fixed_batch_ > 0 && n != fixed_batch_) {
+                // Tail of a batch on a fixed-batch model: zero-pad the chunk.
+                padded_.assign(data + start * item, data + (start + n) * item);
+                padded_.resize(static_cast<size_t>(fixed_batch_) * item, 0);
+                run_chunk(padded_.data(), fixed_batch_, start, n, on_head);
+            } else {
+                run_chunk(data + start * item, n, start, n, on_head);
+            }
+        }
+    }
+
+private:
+    static Ort::SessionOptions session_options(const DetectorConfig& cfg) {
+        Ort::SessionOptions opts;
+        opts.SetGraphOptimizationLevel(GraphOptimizationLevel::ORT_ENABLE_ALL);
+        if (cfg.intra_op_threads > 0) opts.SetIntraOpNumThreads(cfg.intra_op_threads);
+        opts.SetInterOpNumThreads(std::max(1, cfg.inter_op_threads));
+        opts.SetExecutionMode(cfg.inter_op_threads > 1 ? ExecutionMode::ORT_PARALLEL : ExecutionMode::ORT_SEQUENTIAL);
+        // Spinning workers burn cores between frames; edge nodes share them
+        // with decoders and other routes.
+        opts.AddConfigEntry("session.intra_op.allow_spinning", cfg.allow_spinning ? "1" : "0");
+        opts.AddConfigEntry("session.inter_op.allow_spinning", cfg.allow_spinning ? "1" : "0");
+        return opts;
+    }
+
+    template <typename OnHead>
+    void run_chunk(const uint8_t* data, int batch, int first, int keep, OnHead& on_head) {
+        const int64_t shape[4] = {batch, 3, height_, width_};
+        const size_t count = static_cast<size_t>(batch) * 3 * height_ * width_;
+        // ONNX Runtime does not write to inputs; the const_cast lets shared
+        // memory tensors be used without a copy.
+        auto* p = const_cast<uint8_t*>(data);
+        Ort::Value input = input_type_ == TensorType::Float32
+                               ? Ort::Value::CreateTensor<float>(memory_, reinterpret_cast<float*>(p), count, shape, 4)
+                           : input_type_ == TensorType::UInt8
+                               ? Ort::Value::CreateTensor<uint8_t>(memory_, p, count, shape, 4)
+                               : Ort::Value::CreateTensor<int8_t>(memory_, reinterpret_cast<int8_t*>(p), count, shape, 4);
+        const char* in_names[] = {input_name_.c_str()};
+        const char* out_names[] = {output_name_.c_str()};
+        auto outputs = session_.Run(Ort::RunOptions{nullptr}, in_names, &input, 1, out_names, 1);
+
+        auto out_info = outputs[0].GetTensorTypeAndShapeInfo();
+        if (out_info.GetElementType() != ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT)
+            throw std::runtime_error("model output is not float32");
+        YoloLayout layout = yolo_layout_from_shape(out_info.GetShape());
+        const float* out = outputs[0].GetTensorData<float>();
+        const size_t per_image = static_cast<size_t>(layout.num_classes + 4) * layout.num_anchors;
+        if (out_info.GetElementCount() < per_image * static_cast<size_t>(batch))
+            throw std::runtime_error("model output is smaller than its shape implies");
+        for (int i = 0; i < keep; ++i) on_head(first + i, out + i * per_image, layout);
+    }
+
+    Ort::Env env_;
+    Ort::Session session_;
+    Ort::MemoryInfo memory_;
+    std::string input_name_, output_name_;
+    int fixed_batch_ = 0, width_ = 640, height_ = 640;
+    TensorType input_type_ = TensorType::Float32;
+    TensorQuant input_quant_;
+    std::vector<uint8_t> padded_;
+};
+
+class Detector {
+public:
+    Detector(const DetectorConfig& cfg, const json::Value& raw)
+        : cfg_(cfg), model_(cfg), names_(raw["class_names"]), targets_(raw["target_objects"]) {}
+
+    bool handle(json::Value& message) {
+        if (message.get("frames").is_array()) {
+            handle_batch(message);
+            return true;
+        }
+        Item item;
+        if (message.get("tensor").is_object())
+            item = from_tensor(message.get("tensor"), message.get("frame"));
+        else
+            item = from_frames({&message.get("frame")});
+        std::vector<std::vector<Detection>> dets = detect(item.data, item.batch, item.transforms, item.frame_sizes);
+        // Inference reads the shared tensor in place; a slot reused meanwhile
+        // yields boxes from two different frames.
+        if (!item.still_valid()) throw std::runtime_error("tensor was overwritten during inference");
+        RoiFilter roi = RoiFilter::from_json(message.get("tensor")["roi"]);
+        for (auto& d : dets) roi.filter(d);
+        if (message.get("tensor").contains("tiles"))
+            write_tiled_detections(message, dets, names_);  // merged across seams by cpp_postprocessor
+        else
+            write_detections(message, dets.front(), names_);
+        roi.tag(message["detections"]);
+        return true;
+    }
+
+private:
+    struct Item {
+        const void* data = nullptr;
+        int batch = 0;
+        std::vector<LetterboxTransform> transforms;
+        std::vector<std::pair<int, int>> frame_sizes;
+        // Shared-memory source when the data is read in place.
+        const SlotRing* ring = nullptr;
+        uint32_t slot = 0;
+        uint64_t sequence = 0;
+
+        bool still_valid() const { return !ring || ring->still_valid(slot, sequence); }
+    };
+
+    // {"frames": [frame_ref, ...]} -> {"results": [{detections...}, ...]}
+    void handle_batch(json::Value& message) {
+        std::vector<const json::Value*> refs;
+        for (const auto& f : message.get("frames").as_array()) refs.push_back(&f);
+        if (refs.empty()) throw std::runtime_error("empty frames batch");
+        Item item = from_frames(refs);
+        std::vector<std::vector<Detection>> dets = detect(item.data, item.batch, item.transforms, item.frame_sizes);
+        json::Value results = json::Value::array();
+        for (const auto& d : dets) {
+            json::Value r = json::Value::object();
+            write_detections(r, d, names_);
+            results.push_back(std::move(r));
+        }
+        message["results"] = std::move(results);
+    }
+
+    Item from_tensor(const json::Value& ref, const json::Value& frame) {
+        const char* dtype = tensor_type_name(model_.input_type());
+        if (ref.string_or("dtype", "float32") != dtype)
+            throw std::runtime_error(std::string("model expects a ") + dtype + " tensor");
+        const json::Value& shape = ref["shape"];
+        if (!shape.is_array() || shape.size() != 4 || static_cast<int>(shape[2].as_number()) != model_.height() ||
+            static_cast<int>(shape[3].as_number()) != model_.width())
+            throw std::runtime_error("tensor shape does not match the model input");
+        if (model_.input_type() != TensorType::Float32) {
+            TensorQuant q;
+            q.scale = static_cast<float>(ref.number_or("quant_scale", 0.0));
+            q.zero_point = static_cast<int>(ref.number_or("quant_zero_point", 0));
+            const TensorQuant& want = model_.input_quant();
+            if (q != want)
+                throw std::runtime_error("tensor quantization (scale " + std::to_string(q.scale) + ", zero point " +
+                                         std::to_string(q.zero_point) + ") does not match the model (scale " +
+                                         std::to_string(want.scale) + ", zero point " +
+                                         std::to_string(want.zero_point) + ")");
+        }
+        SlotRing& ring = ring_for(ref["shm"].as_string());
+        Item item;
+        item.ring = &ring;
+        item.slot = static_cast<uint32_t>(ref.number_or("slot", 0));
+        item.sequence = static_cast<uint64_t>(ref.number_or("sequence", 0));
+        item.batch = static_cast<int>(shape[0].as_number());
+        if (item.batch <= 0) throw std::runtime_error("tensor batch must be positive");
+        size_t payload = 0;
+        item.data = ring.read(item.slot, item.sequence, &payload);
+        if (payload < static_cast<size_t>(item.batch) * model_.item_bytes())
+            throw std::runtime_error("tensor payload holds " + std::to_string(payload) + " bytes, batch needs " +
+                                     std::to_string(static_cast<size_t>(item.batch) * model_.item_bytes()));
+        for (const auto& t : ref["transforms"].as_array()) item.transforms.push_back(LetterboxTransform::from_json(t));
+        if (static_cast<int>(item.transforms.size()) != item.batch)
+            throw std::runtime_error("tensor transforms do not match batch size");
+        int fw = static_cast<int>(frame.number_or("width", 1e9)), fh = static_cast<int>(frame.number_or("height", 1e9));
+        item.frame_sizes.assign(item.batch, {fw, fh});
+        return item;
+    }
+
+    Item from_frames(const std::vector<const json::Value*>& refs) {
+        const size_t item_bytes = model_.item_bytes();
+        input_.resize(item_bytes * refs.size());
+        LetterboxOptions opt;
+        opt.width = model_.width();
+        opt.height = model_.height();
+        opt.pad_value = cfg_.pad_value;
+        opt.type = model_.input_type();
+        opt.quant = model_.input_quant();
+        Item item;
+        item.data = input_.data();
+        item.batch = static_cast<int>(refs.size());
+        for (size_t i = 0; i < refs.size(); ++i) {
+            FrameView frame = frames_.resolve(*refs[i]);
+            item.transforms.push_back(letterbox_.run(frame, Rect{}, opt, input_.data() + i * item_bytes));
+            if (!frames_.still_valid(*refs[i])) throw std::runtime_error("frame was overwritten during preprocessing");
+            item.frame_sizes.emplace_back(frame.width, frame.height);
+        }
+        return item;
+    }
+
+    std::vector<std::vector<Detection>> detect(const void* data, int batch,
+                                               const std::vector<LetterboxTransform>& transforms,
+                                               const std::vector<std::pair<int, int>>& sizes) {
+        std::vector<std::vector<Detection>> out(batch);
+        model_.run(data, batch, [&](int i, const float* head, const YoloLayout& layout) {
+            if (mask_.size() != static_cast<size_t>(layout.num_classes))
+                mask_ = names_.target_mask(targets_, layout.num_classes);
+            candidates_.clear();
+            decode_yolov8_simd(head, layout, cfg_.confidence_threshold, mask_, candidates_);
+            candidates_to_frame(candidates_, transforms[i], sizes[i].first, sizes[i].second);
+            out[i] = nms_.run(candidates_, cfg_.nms);
+        });
+        return out;
+    }
+
+    SlotRing& ring_for(const std::string& name) {
+        auto it = rings_.find(name);
+        if (it == rings_.end()) it = rings_.emplace(name, SlotRing::open(name)).first;
+        else if (it->second.stale()) it->second = SlotRing::open(name);
+        return it->second;
+    }
+
+    DetectorConfig cfg_;
+    OrtYolo model_;
+    ClassNames names_;
+    json::Value targets_;
+    std::vector<uint8_t> mask_;
+    FrameStore frames_;
+    Letterboxer letterbox_;
+    std::map<std::string, SlotRing> rings_;
+    std::vector<uint8_t> input_;
+    CandidateList candidates_;
+    CandidateNms nms_;
+};
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    return processor_main(argc, argv, "cpp_detector", [](const ProcessorOptions& opts) -> MessageHandler {
+        auto det = std::make_shared<Detector>(DetectorConfig::from_json(opts.config), opts.config);
+        return [det](json::Value& message) { return det->handle(message); };
+    });
+}
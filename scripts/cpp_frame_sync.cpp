@@ -0,0 +1,233 @@
+// Multi-camera frame synchronization.
+//
+// Collects frame messages from the cameras of a group (for example the
+// output of cpp_camera_hub, or several routes merged into one pipe) and
+// aligns them by capture time into tuples (see cpp/frame_sync.hpp). Each
+// tuple goes out as one message in the `frames` batch shape cpp_detector
+// runs in a single call:
+//   {"group": "entrance", "cameras": ["front_door", "driveway"],
+//    "frames": [{...}, {...}], "frame_times_ms": [...], "frame_time_ms": ...,
+//    "skew_ms": 12, "complete": true}
+// cpp_postprocessor (`group_dedupe`) then merges detections of the same
+// object seen by several cameras. Messages from cameras outside every
+// group pass through unchanged.
+//
+// Usage:
+//   ./bin/cpp_camera_hub --config-file cameras.json |
+//     ./bin/cpp_frame_sync --config '{"groups": [{"name": "entrance",
+//                                     "cameras": ["front_door", "driveway"]}]}' |
+//     ./bin/cpp_detector --config '{"model": "yolov8n.onnx"}'
+
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "cpp/frame_sync.hpp"
+#include "cpp/json.hpp"
+#include "cpp/processor.hpp"
+#include "cpp/trace.hpp"
+
+using namespace camel;
+
+namespace {
+
+double steady_ms() {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+double unix_ms() {
+    return std::chrono::duration<double, std::milli>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+struct GroupConfig {
+    std::string name;
+    std::vector<std::string> cameras;
+    std::vector<double> offsets_ms;  // added to each camera's capture time
+};
+
+struct SyncConfig {
+    std::vector<GroupConfig> groups;
+    SyncOptions sync;
+    std::string camera_field = "camera";
+    std::string time_field = "frame_time_ms";
+
+    static SyncConfig from_json(const json::Value& c) {
+        SyncConfig cfg;
+        const json::Value& groups = c.get("groups");
+        if (!groups.is_array() || groups.size() == 0) throw std::runtime_error("config.groups must be a non-empty list");
+        for (const auto& g : groups.as_array()) {
+            GroupConfig group;
+            group.name = g.string_or("name", "group" + std::to_string(cfg.groups.size()));
+            for (const auto& cam : g["cameras"].as_array()) {
+                // "front_door" or {"name": "front_door", "offset_ms": -40}
+                group.cameras.push_back(cam.is_string() ? cam.as_string() : cam["name"].as_string());
+                group.offsets_ms.push_back(cam.is_object() ? cam.number_or("offset_ms", 0.0) : 0.0);
+            }
+            if (group.cameras.size() < 2) throw std::runtime_error("group " + group.name + " needs at least two cameras");
+            cfg.groups.push_back(std::move(group));
+        }
+        cfg.sync.tolerance_ms = c.number_or("tolerance_ms", cfg.sync.tolerance_ms);
+        cfg.sync.max_latency_ms = c.number_or("max_latency_ms", cfg.sync.max_latency_ms);
+        cfg.sync.min_cameras = static_cast<size_t>(c.number_or("min_cameras", static_cast<double>(cfg.sync.min_cameras)));
+        cfg.sync.max_pending = static_cast<size_t>(c.number_or("max_pending", static_cast<double>(cfg.sync.max_pending)));
+        cfg.camera_field = c.string_or("camera_field", cfg.camera_field);
+        cfg.time_field = c.string_or("time_field", cfg.time_field);
+        if (cfg.sync.tolerance_ms < 0 || cfg.sync.max_latency_ms < 0)
+            throw std::runtime_error("tolerance_ms and max_latency_ms must be >= 0");
+        return cfg;
+    }
+};
+
+class FrameSync {
+public:
+    FrameSync(SyncConfig cfg, std::string name) : cfg_(std::move(cfg)), name_(std::move(name)) {
+        for (size_t g = 0; g < cfg_.groups.size(); ++g) {
+            syncs_.emplace_back(cfg_.groups[g].cameras.size(), cfg_.sync);
+            tuples_.push_back(0);
+            for (size_t c = 0; c < cfg_.groups[g].cameras.size(); ++c)
+                if (!members_.emplace(cfg_.groups[g].cameras[c], Member{g, c}).second)
+                    throw std::runtime_error("camera " + cfg_.groups[g].cameras[c] + " is in more than one group");
+        }
+    }
+
+    int run(int fd) {
+        std::string buf;
+        char chunk[1 << 16];
+        for (bool eof = false; !eof;) {
+            const double now = steady_ms();
+            double deadline = -1.0;
+            for (const auto& s : syncs_) {
+                double d = s.next_deadline();
+                if (d >= 0 && (deadline < 0 || d < deadline)) deadline = d;
+            }
+            int timeout = deadline < 0 ? -1 : static_cast<int>(std::ceil(std::max(0.0, deadline - now)));
+            pollfd p{fd, POLLIN, 0};
+            int n = ::poll(&p, 1, timeout);
+            if (n < 0 && errno != EINTR) throw std::runtime_error("poll failed");
+            if (n > 0) {
+                ssize_t r = ::read(fd, chunk, sizeof(chunk));
+                if (r < 0 && errno != EINTR && errno != EAGAIN) throw std::runtime_error("read failed");
+                if (r == 0) eof = true;
+                if (r > 0) buf.append(chunk, static_cast<size_t>(r));
+                size_t start = 0;
+                for (size_t nl; (nl = buf.find('\n', start)) != std::string::npos; start = nl + 1)
+                    if (nl > start) handle_line(std::string_view(buf).substr(start, nl - start));
+                buf.erase(0, start);
+            }
+            for (size_t g = 0; g < syncs_.size(); ++g)
+                syncs_[g].poll(steady_ms(), [&](FrameTuple&& t) { write(tuple_message(g, std::move(t))); }, eof);
+        }
+        if (!buf.empty()) handle_line(buf);
+        for (size_t g = 0; g < syncs_.size(); ++g) {
+            syncs_[g].poll(steady_ms(), [&](FrameTuple&& t) { write(tuple_message(g, std::move(t))); }, true);
+            log_info(name_, cfg_.groups[g].name + ": " + std::to_string(tuples_[g]) + " tuples, " +
+                                std::to_string(syncs_[g].dropped()) + " frames dropped");
+        }
+        return 0;
+    }
+
+private:
+    struct Member {
+        size_t group;
+        size_t camera;
+    };
+
+    void handle_line(std::string_view line) {
+        json::Value message;
+        try {
+            message = json::Value::parse(line);
+        } catch (const json::ParseError& e) {
+            log_error(name_, e.what());
+            return;
+        }
+        auto it = members_.find(message.string_or(cfg_.camera_field, ""));
+        if (it == members_.end() || !message.get("frame").is_object()) {
+            write(message);
+            return;
+        }
+        SyncedFrame f;
+        f.camera = it->second.camera;
+        f.arrival_ms = steady_ms();
+        f.time_ms = message.get(cfg_.time_field).is_number() ? message.get(cfg_.time_field).as_number() : unix_ms();
+        f.time_ms += cfg_.groups[it->second.group].offsets_ms[f.camera];
+        f.message = std::move(message);
+        syncs_[it->second.group].push(std::move(f));
+    }
+
+    json::Value tuple_message(size_t group, FrameTuple&& t) {
+        const GroupConfig& g = cfg_.groups[group];
+        // The tuple continues the trace of its first frame; its span covers
+        // the time that frame waited for the others.
+        Tracer& tracer = Tracer::instance();
+        Span span;
+        if (tracer.enabled()) {
+            const double waited_ms = steady_ms() - t.members.front().arrival_ms;
+            span = tracer.begin(t.members.front().message, trace_now_us() - static_cast<uint64_t>(waited_ms * 1000.0));
+        }
+        json::Value msg = json::Value::object();
+        json::Value cameras = json::Value::array(), frames = json::Value::array(), times = json::Value::array();
+        double lo = t.members.front().time_ms, hi = lo;
+        for (auto& m : t.members) {
+            cameras.push_back(g.cameras[m.camera]);
+            frames.push_back(std::move(m.message["frame"]));
+            times.push_back(std::round(m.time_ms));
+            lo = std::min(lo, m.time_ms);
+            hi = std::max(hi, m.time_ms);
+        }
+        msg["group"] = g.name;
+        msg["cameras"] = std::move(cameras);
+        msg["frames"] = std::move(frames);
+        msg["frame_times_ms"] = std::move(times);
+        msg["frame_time_ms"] = std::round(lo);
+        msg["skew_ms"] = std::round(hi - lo);
+        msg["complete"] = t.complete;
+        ++tuples_[group];
+        tracer.end(span, msg);
+        return msg;
+    }
+
+    void write(const json::Value& message) {
+        out_.clear();
+        message.dump_to(out_);
+        out_ += '\n';
+        std::fwrite(out_.data(), 1, out_.size(), stdout);
+        std::fflush(stdout);
+    }
+
+    SyncConfig cfg_;
+    std::string name_;
+    std::vector<FrameSynchronizer> syncs_;
+    std::map<std::string, Member> members_;
+    std::string out_;
+    std::vector<size_t> tuples_;
+};
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    try {
+        ProcessorOptions opts = parse_options(argc, argv, "cpp_frame_sync");
+        if (opts.input_format != "json") throw std::runtime_error("cpp_frame_sync reads NDJSON messages");
+        int fd = STDIN_FILENO;
+        if (opts.input != "-" && (fd = ::open(opts.input.c_str(), O_RDONLY | O_CLOEXEC)) < 0)
+            throw std::runtime_error("cannot open input " + opts.input);
+        FrameSync sync(SyncConfig::from_json(opts.config), opts.name);
+        Tracer::instance().set_service(opts.name);
+        const int status = sync.run(fd);
+        Tracer::instance().flush();
+        return status;
+    } catch (const std::exception& e) {
+        log_error("cpp_frame_sync", e.what());
+        return 1;
+    }
+}
@@ -0,0 +1,103 @@
+// Starts a processor in its route stage's cgroup v2 pool (cpp/cgroup.hpp),
+// optionally with CPU and memory limits, so its cost shows up per stage in
+// cpp_monitor whatever language it is written in.
+//
+// The launcher joins `<cgroup>/<route>/<stage>` and then execs the command,
+// so the processor keeps the launcher's pid, stdin and stdout, and every
+// process it starts is charged to the same pool. Replicas of a stage share
+// the pool and its limits. Without a cgroup root (no --cgroup and no
+// CAMEL_CGROUP) the command runs unaccounted.
+//
+// Route usage:
+//   - type: "external"
+//     command: "./bin/cpp_launch --stage detector --cpus 2 --memory 1G -- python3 detect.py"
+//
+// Options:
+//   --route NAME      pool route, default CAMEL_ROUTE or "default"
+//   --stage NAME      pool stage, default the command's file name
+//   --cpus N          cpu.max in cores (fractions allowed)
+//   --memory SIZE     memory.max, e.g. 512M or 2G
+//   --cgroup DIR      delegated cgroup v2 directory, default CAMEL_CGROUP
+
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "cpp/cgroup.hpp"
+#include "cpp/processor.hpp"
+
+using namespace camel;
+
+namespace {
+
+struct LaunchOptions {
+    std::string route;
+    std::string stage;
+    std::string cgroup = default_cgroup_root();
+    CgroupLimits limits;
+    std::vector<char*> command;
+
+    static LaunchOptions parse(int argc, char** argv) {
+        LaunchOptions opts;
+        const char* route = std::getenv("CAMEL_ROUTE");
+        opts.route = route && *route ? route : "default";
+        int i = 1;
+        for (; i < argc; ++i) {
+            std::string arg = argv[i];
+            if (arg == "--") {
+                ++i;
+                break;
+            }
+            auto value = [&]() -> std::string {
+                if (i + 1 >= argc) throw std::runtime_error("missing value for " + arg);
+                return argv[++i];
+            };
+            if (arg == "--route") {
+                opts.route = value();
+            } else if (arg == "--stage") {
+                opts.stage = value();
+            } else if (arg == "--cpus") {
+                const std::string v = value();
+                char* end = nullptr;
+                opts.limits.cpus = std::strtod(v.c_str(), &end);
+                if (end == v.c_str() || *end || opts.limits.cpus <= 0) throw std::runtime_error("invalid --cpus '" + v + "'");
+            } else if (arg == "--memory") {
+                opts.limits.memory_bytes = parse_bytes(value());
+            } else if (arg == "--cgroup") {
+                opts.cgroup = value();
+            } else {
+                throw std::runtime_error("unknown argument " + arg + " (command goes after --)");
+            }
+        }
+        for (; i < argc; ++i) opts.command.push_back(argv[i]);
+        if (opts.command.empty()) throw std::runtime_error("no command after --");
+        opts.command.push_back(nullptr);
+        if (opts.stage.empty()) {
+            opts.stage = opts.command[0];
+            const size_t slash = opts.stage.rfind('/');
+            if (slash != std::string::npos) opts.stage.erase(0, slash + 1);
+        }
+        if (opts.cgroup.empty() && (opts.limits.cpus > 0 || opts.limits.memory_bytes > 0))
+            throw std::runtime_error("--cpus and --memory need a cgroup root (--cgroup or CAMEL_CGROUP)");
+        return opts;
+    }
+};
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    try {
+        LaunchOptions opts = LaunchOptions::parse(argc, argv);
+        if (!opts.cgroup.empty()) join_cgroup_pool(opts.cgroup, opts.route, opts.stage, opts.limits);
+        ::setenv("CAMEL_ROUTE", opts.route.c_str(), 1);
+        ::execvp(opts.command[0], opts.command.data());
+        throw std::runtime_error(std::string("cannot run ") + opts.command[0] + ": " + std::strerror(errno));
+    } catch (const std::exception& e) {
+        log_error("cpp_launch", e.what());
+        return 1;
+    }
+}
@@ -0,0 +1,732 @@
+// Synthetic load for capacity tests: drives a route's source at fixed
+// rates and measures how long messages take to come out at a sink.
+//
+// Sources, selected with `source`:
+//   pipe   runs `command` (a processor) and writes messages to its stdin;
+//          its stdout is the sink
+//   http   POSTs messages to `url` over `connections` keep-alive connections
+//   file   drops `<id>.json` files into `dir` (written, then renamed)
+//   rtsp   publishes `video` in a loop with ffmpeg to `url`_0 .. `url`_N-1,
+//          e.g. through mediamtx
+// For http, file and rtsp the route delivers to the loopback sink, an HTTP
+// listener on `sink` that accepts a JSON message (or array) per POST:
+//   to: "http://127.0.0.1:9100/"
+//
+// Timing is open loop: message n of a step is due at start + n / rate
+// whether or not earlier sends finished, and latency counts from the due
+// time. A stalled source or route shows up as latency of every message it
+// held back instead of as fewer, faster samples (coordinated omission).
+// Messages carry `"id": "lg<run>-<step>-<n>"`, and the sink matches that ID
+// (`id_field`, dotted for nested messages) back to the due time. RTSP frames
+// cannot carry the ID, so there latency is sink time minus the message's
+// `time_field` (cpp_camera_hub's `frame_time_ms`, i.e. from ingest).
+//
+// Each entry of `rates` (streams for rtsp) runs for `duration` seconds; the
+// first `warmup` seconds are left out of the latency figures. A step passes
+// when at most `max_loss` of its messages went missing and, with
+// `slo_p99_ms`, its p99 met that. Capacity is the highest passing step; the
+// sweep stops at the first failing one. The report is JSON on stdout (and
+// in `report`), progress goes to stderr.
+//
+// Usage:
+//   ./bin/cpp_loadgen --config '{"source": "pipe", "rates": [500, 1000, 2000],
+//       "command": ["./bin/cpp_postprocessor", "--config", "{\"algorithm\": \"fast_nms\"}"],
+//       "message": {"detections": [{"class": "person", "confidence": 0.9, "bbox": [10, 10, 50, 90]}]}}'
+//   ./bin/cpp_loadgen --config '{"source": "http", "url": "http://127.0.0.1:8080/ingest",
+//       "sink": "127.0.0.1:9100", "rates": [100, 200, 400], "slo_p99_ms": 250}'
+
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "cpp/http.hpp"
+#include "cpp/json.hpp"
+#include "cpp/processor.hpp"
+#include "cpp/subprocess.hpp"
+
+using namespace camel;
+
+namespace {
+
+volatile std::sig_atomic_t g_stop = 0;
+
+int64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+double unix_ms() {
+    return std::chrono::duration<double, std::milli>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+struct LoadgenConfig {
+    std::string source;
+    std::vector<std::string> command;  // pipe
+    std::string url;                   // http, rtsp
+    std::string dir;                   // file
+    std::string video = "test_video.mp4";
+    std::string sink = "127.0.0.1:9100";
+    int connections = 4;
+    std::vector<double> rates;         // messages/s, or streams for rtsp
+    double duration = 30.0;
+    double warmup = 5.0;
+    double drain = 5.0;                // wait for stragglers after a step
+    json::Value message = json::Value::object();
+    size_t payload_bytes = 0;
+    std::string id_field = "id";
+    std::string time_field = "frame_time_ms";
+    double slo_p99_ms = 0.0;
+    double max_loss = 0.001;
+    double expected_rate = 0.0;        // rtsp: sink messages/s per stream, 0 = no loss check
+    std::string report;
+
+    static LoadgenConfig from_json(const json::Value& c) {
+        LoadgenConfig cfg;
+        cfg.source = c.string_or("source", "");
+        if (cfg.source != "pipe" && cfg.source != "http" && cfg.source != "file" && cfg.source != "rtsp")
+            throw std::runtime_error("source must be pipe, http, file or rtsp");
+        if (c.contains("command"))
+            for (const auto& a : c["command"].as_array()) cfg.command.push_back(a.as_string());
+        cfg.url = c.string_or("url", "");
+        cfg.dir = c.string_or("dir", "");
+        cfg.video = c.string_or("video", cfg.video);
+        cfg.sink = c.string_or("sink", cfg.sink);
+        cfg.connections = static_cast<int>(c.number_or("connections", cfg.connections));
+        const json::Value& steps = c.get(cfg.source == "rtsp" ? "streams" : "rates");
+        if (steps.is_number()) cfg.rates.push_back(steps.as_number());
+        else if (steps.is_array())
+            for (const auto& r : steps.as_array()) cfg.rates.push_back(r.as_number());
+        cfg.duration = c.number_or("duration", cfg.duration);
+        cfg.warmup = c.number_or("warmup", cfg.warmup);
+        cfg.drain = c.number_or("drain", cfg.drain);
+        if (c.contains("message")) cfg.message = c["message"];
+        cfg.payload_bytes = static_cast<size_t>(c.number_or("payload_bytes", 0));
+        cfg.id_field = c.string_or("id_field", cfg.id_field);
+        cfg.time_field = c.string_or("time_field", cfg.time_field);
+        cfg.slo_p99_ms = c.number_or("slo_p99_ms", cfg.slo_p99_ms);
+        cfg.max_loss = c.number_or("max_loss", cfg.max_loss);
+        cfg.expected_rate = c.number_or("expected_rate", cfg.expected_rate);
+        cfg.report = c.string_or("report", "");
+
+        if (cfg.rates.empty()) throw std::runtime_error(cfg.source == "rtsp" ? "streams is required" : "rates is required");
+        for (double r : cfg.rates)
+            if (!(r > 0)) throw std::runtime_error("rates must be positive");
+        if (cfg.source == "rtsp")
+            for (double& r : cfg.rates) r = std::round(r);
+        if (cfg.duration <= 0 || cfg.warmup < 0 || cfg.warmup >= cfg.duration)
+            throw std::runtime_error("duration must be positive and longer than warmup");
+        if (!cfg.message.is_object()) throw std::runtime_error("message must be a JSON object");
+        if (cfg.connections < 1) throw std::runtime_error("connections must be at least 1");
+        if (cfg.source == "pipe" && cfg.command.empty()) throw std::runtime_error("pipe source needs a command");
+        if ((cfg.source == "http" || cfg.source == "rtsp") && cfg.url.empty())
+            throw std::runtime_error(cfg.source + " source needs a url");
+        if (cfg.source == "file" && cfg.dir.empty()) throw std::runtime_error("file source needs a dir");
+        // A pipe keeps message order, so one writer is all it can take.
+        if (cfg.source == "pipe" || cfg.source == "file") cfg.connections = 1;
+        return cfg;
+    }
+};
+
+// Log-linear histogram in microseconds: 64 linear sub-buckets per power of
+// two, so any recorded value is within 1.6% of its bucket.
+class LatencyHistogram {
+public:
+    LatencyHistogram() : counts_(kSub * (kMaxExp - kSubBits + 2), 0) {}
+
+    void record(int64_t ns) {
+        const uint64_t us = ns > 0 ? static_cast<uint64_t>(ns / 1000) : 0;
+        ++counts_[index(us)];
+        ++count_;
+        max_us_ = std::max(max_us_, us);
+    }
+
+    void merge(const LatencyHistogram& o) {
+        for (size_t i = 0; i < counts_.size(); ++i) counts_[i] += o.counts_[i];
+        count_ += o.count_;
+        max_us_ = std::max(max_us_, o.max_us_);
+    }
+
+    uint64_t count() const { return count_; }
+    double max_ms() const { return static_cast<double>(max_us_) / 1000.0; }
+
+    // Midpoint of the bucket holding the q-th value, in milliseconds.
+    double percentile_ms(double q) const {
+        if (!count_) return 0.0;
+        const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(q * static_cast<double>(count_))));
+        uint64_t seen = 0;
+        for (size_t i = 0; i < counts_.size(); ++i) {
+            seen += counts_[i];
+            if (seen >= rank) return std::min(midpoint_us(i), static_cast<double>(max_us_)) / 1000.0;
+        }
+        return max_ms();
+    }
+
+private:
+    static constexpr int kSubBits = 6, kSub = 1 << kSubBits, kMaxExp = 40;
+
+    static size_t index(uint64_t us) {
+        if (us < static_cast<uint64_t>(kSub)) return us;
+        const int exp = std::min(kMaxExp, 63 - __builtin_clzll(us));
+        const int shift = exp - kSubBits;
+        const uint64_t sub = std::min<uint64_t>(us >> shift, 2 * kSub - 1);
+        return static_cast<size_t>(kSub + shift * kSub + (sub - kSub));
+    }
+
+    static double midpoint_us(size_t i) {
+        if (i < static_cast<size_t>(kSub)) return static_cast<double>(i);
+        const size_t shift = (i - kSub) / kSub;
+        const double lo = static_cast<double>(((i - kSub) % kSub + kSub) << shift);
+        return lo + static_cast<double>(1ull << shift) / 2.0;
+    }
+
+    std::vector<uint64_t> counts_;
+    uint64_t count_ = 0;
+    uint64_t max_us_ = 0;
+};
+
+struct HostPort {
+    std::string host;
+    std::string port;
+    std::string path = "/";
+};
+
+// "http://host:port/path" or "host:port".
+HostPort parse_host_port(std::string url) {
+    HostPort hp;
+    if (url.compare(0, 7, "http://") == 0) url.erase(0, 7);
+    else if (url.find("://") != std::string::npos) throw std::runtime_error("only http:// is supported: " + url);
+    const size_t slash = url.find('/');
+    if (slash != std::string::npos) {
+        hp.path = url.substr(slash);
+        url.erase(slash);
+    }
+    const size_t colon = url.rfind(':');
+    hp.host = url.substr(0, colon);
+    hp.port = colon == std::string::npos ? "80" : url.substr(colon + 1);
+    if (hp.host.empty()) hp.host = "127.0.0.1";
+    return hp;
+}
+
+bool send_all(int fd, const std::string& data) {
+    size_t off = 0;
+    while (off < data.size()) {
+        const ssize_t w = ::send(fd, data.data() + off, data.size() - off, MSG_NOSIGNAL);
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        off += static_cast<size_t>(w);
+    }
+    return true;
+}
+
+// Content-Length of a request or response head, -1 if absent.
+long content_length(std::string_view head) {
+    std::string lower(head);
+    for (char& c : lower) c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    const size_t at = lower.find("\r\ncontent-length:");
+    return at == std::string::npos ? -1 : std::strtol(lower.c_str() + at + 17, nullptr, 10);
+}
+
+// One keep-alive connection; reconnects after errors.
+class HttpClient {
+public:
+    explicit HttpClient(HostPort target) : target_(std::move(target)) {}
+    ~HttpClient() { close(); }
+
+    // True on a 2xx response.
+    bool post(const std::string& body) {
+        for (int attempt = 0; attempt < 2; ++attempt) {
+            if (fd_ < 0 && !connect()) return false;
+            std::string req = "POST " + target_.path + " HTTP/1.1\r\nHost: " + target_.host + ":" + target_.port +
+                              "\r\nContent-Type: application/json\r\nContent-Length: " + std::to_string(body.size()) +
+                              "\r\n\r\n";
+            req += body;
+            int status = 0;
+            if (send_all(fd_, req) && read_response(status)) return status >= 200 && status < 300;
+            close();  // the server may have dropped an idle connection
+        }
+        return false;
+    }
+
+private:
+    bool connect() {
+        addrinfo hints{}, *res = nullptr;
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        if (getaddrinfo(target_.host.c_str(), target_.port.c_str(), &hints, &res) != 0) return false;
+        for (addrinfo* a = res; a && fd_ < 0; a = a->ai_next) {
+            fd_ = ::socket(a->ai_family, a->ai_socktype | SOCK_CLOEXEC, a->ai_protocol);
+            if (fd_ >= 0 && ::connect(fd_, a->ai_addr, a->ai_addrlen) != 0) close();
+        }
+        freeaddrinfo(res);
+        if (fd_ < 0) return false;
+        int one = 1;
+        setsockopt(fd_, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        return true;
+    }
+
+    bool read_response(int& status) {
+        size_t head_end;
+        while ((head_end = buf_.find("\r\n\r\n")) == std::string::npos)
+            if (!fill()) return false;
+        const std::string head = buf_.substr(0, head_end);
+        if (head.compare(0, 5, "HTTP/") != 0) return false;
+        const size_t sp = head.find(' ');
+        status = sp == std::string::npos ? 0 : std::atoi(head.c_str() + sp + 1);
+        const long length = std::max(0L, content_length(head));
+        while (buf_.size() < head_end + 4 + static_cast<size_t>(length))
+            if (!fill()) return false;
+        buf_.erase(0, head_end + 4 + static_cast<size_t>(length));
+        std::string lower = head;
+        for (char& c : lower) c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+        if (lower.find("connection: close") != std::string::npos) close();
+        return true;
+    }
+
+    bool fill() {
+        char chunk[4096];
+        for (;;) {
+            const ssize_t r = ::recv(fd_, chunk, sizeof(chunk), 0);
+            if (r > 0) {
+                buf_.append(chunk, static_cast<size_t>(r));
+                return true;
+            }
+            if (r < 0 && errno == EINTR) continue;
+            return false;
+        }
+    }
+
+    void close() {
+        if (fd_ >= 0) ::close(fd_);
+        fd_ = -1;
+        buf_.clear();
+    }
+
+    HostPort target_;
+    int fd_ = -1;
+    std::string buf_;
+};
+
+// Loopback sink: HTTP/1.1 POSTs of a JSON message, an array of them or
+// NDJSON, on keep-alive connections, one thread per connection.
+class HttpSink {
+public:
+    using Handler = std::function<void(const json::Value&)>;
+
+    HttpSink(const std::string& address, Handler handler) : handler_(std::move(handler)) {
+        const HostPort hp = parse_host_port(address);
+        listen_ = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        int one = 1;
+        setsockopt(listen_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(static_cast<uint16_t>(std::atoi(hp.port.c_str())));
+        if (inet_pton(AF_INET, hp.host.c_str(), &addr.sin_addr) != 1) throw std::runtime_error("invalid sink address " + address);
+        if (listen_ < 0 || ::bind(listen_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || ::listen(listen_, 64) != 0)
+            throw std::runtime_error("cannot listen on " + address + ": " + std::strerror(errno));
+        accept_thread_ = std::thread([this] { accept_loop(); });
+    }
+
+    ~HttpSink() {
+        stop_ = true;
+        accept_thread_.join();
+        for (auto& t : conns_) t.join();
+        ::close(listen_);
+    }
+
+private:
+    void accept_loop() {
+        while (!stop_) {
+            pollfd p{listen_, POLLIN, 0};
+            if (::poll(&p, 1, 200) <= 0) continue;
+            const int fd = ::accept4(listen_, nullptr, nullptr, SOCK_CLOEXEC);
+            if (fd >= 0) conns_.emplace_back([this, fd] { serve(fd); });
+        }
+    }
+
+    void serve(int fd) {
+        std::string buf;
+        char chunk[16384];
+        while (!stop_) {
+            pollfd p{fd, POLLIN, 0};
+            if (::poll(&p, 1, 200) <= 0) continue;
+            const ssize_t r = ::recv(fd, chunk, sizeof(chunk), 0);
+            if (r <= 0) break;
+            buf.append(chunk, static_cast<size_t>(r));
+            for (;;) {
+                http::Request req;
+                const long head = http::parse_request(buf, req);
+                if (head < 0) {
+                    send_all(fd, http::response(400, "text/plain", "bad request\n"));
+                    ::close(fd);
+                    return;
+                }
+                const long length = std::max(0L, content_length(std::string_view(buf).substr(0, static_cast<size_t>(head))));
+                if (head == 0 || buf.size() < static_cast<size_t>(head + length)) break;
+                deliver(std::string_view(buf).substr(static_cast<size_t>(head), static_cast<size_t>(length)));
+                buf.erase(0, static_cast<size_t>(head + length));
+                if (!send_all(fd, "HTTP/1.1 200 OK\r\nContent-Length: 0\r\n\r\n")) break;
+            }
+        }
+        ::close(fd);
+    }
+
+    void deliver(std::string_view body) {
+        try {
+            const json::Value v = json::Value::parse(body);
+            if (v.is_array())
+                for (const auto& m : v.as_array()) handler_(m);
+            else
+                handler_(v);
+            return;
+        } catch (const std::exception&) {
+        }
+        while (!body.empty()) {
+            const size_t nl = body.find('\n');
+            try {
+                handler_(json::Value::parse(body.substr(0, nl)));
+            } catch (const std::exception&) {
+            }
+            body = nl == std::string_view::npos ? std::string_view() : body.substr(nl + 1);
+        }
+    }
+
+    Handler handler_;
+    int listen_ = -1;
+    std::atomic<bool> stop_{false};
+    std::thread accept_thread_;
+    std::vector<std::thread> conns_;  // only touched by the accept thread until shutdown
+};
+
+struct Step {
+    double rate = 0;  // messages/s, streams for rtsp
+    int64_t start_ns = 0;
+    uint64_t planned = 0;
+    uint64_t warmup = 0;  // messages before this are left out of latency
+    std::atomic<uint64_t> sent{0}, errors{0};
+    std::atomic<int64_t> last_send_ns{0};
+    std::vector<uint8_t> seen;
+    uint64_t received = 0, duplicates = 0;
+    LatencyHistogram latency, lag;
+
+    int64_t due_ns(uint64_t n) const { return start_ns + std::llround(static_cast<double>(n) * 1e9 / rate); }
+};
+
+class LoadGenerator {
+public:
+    LoadGenerator(LoadgenConfig cfg, std::string name) : cfg_(std::move(cfg)), name_(std::move(name)) {
+        run_ = "lg" + std::to_string(::getpid() % 100000) + "-";
+        // The ID goes first and the template's own "id" is replaced.
+        json::Value tpl = json::Value::object();
+        for (const auto& [k, v] : cfg_.message.as_object())
+            if (k != "id") tpl[k] = v;
+        if (cfg_.payload_bytes) tpl["data"] = std::string(cfg_.payload_bytes, 'x');
+        const std::string body = tpl.dump();
+        template_tail_ = body == "{}" ? "}" : "," + body.substr(1);
+        if (!cfg_.id_field.empty()) {
+            for (size_t start = 0;;) {
+                const size_t dot = cfg_.id_field.find('.', start);
+                id_path_.push_back(cfg_.id_field.substr(start, dot - start));
+                if (dot == std::string::npos) break;
+                start = dot + 1;
+            }
+        }
+    }
+
+    int run() {
+        std::unique_ptr<HttpSink> sink;
+        if (cfg_.source == "pipe") {
+            child_ = Subprocess::spawn(cfg_.command, Subprocess::Stdin | Subprocess::Stdout);
+            reader_ = std::thread([this] { read_child(); });
+        } else {
+            sink = std::make_unique<HttpSink>(cfg_.sink, [this](const json::Value& m) { deliver(m); });
+            log_info(name_, "sink listening on " + cfg_.sink);
+        }
+
+        steps_.reserve(cfg_.rates.size());
+        for (double r : cfg_.rates) steps_.push_back(std::make_unique<Step>()), steps_.back()->rate = r;
+        for (size_t i = 0; i < steps_.size() && !g_stop; ++i) {
+            run_step(i);
+            const bool ok = step_ok(*steps_[i]);
+            log_info(name_, summary(*steps_[i]) + (ok ? "" : "  [failed]"));
+            if (ok) capacity_ = steps_[i]->rate;
+            else break;
+        }
+
+        if (child_.running()) {
+            child_.close_stdin();
+            reader_.join();
+            child_.wait();
+        }
+        sink.reset();
+        const std::string text = report().dump();
+        std::printf("%s\n", text.c_str());
+        std::fflush(stdout);
+        if (!cfg_.report.empty()) {
+            FILE* f = std::fopen(cfg_.report.c_str(), "w");
+            if (!f) throw std::runtime_error("cannot write " + cfg_.report);
+            std::fprintf(f, "%s\n", text.c_str());
+            std::fclose(f);
+        }
+        return 0;
+    }
+
+private:
+    void run_step(size_t index) {
+        Step& s = *steps_[index];
+        const bool rtsp = cfg_.source == "rtsp";
+        if (!rtsp) {
+            s.planned = static_cast<uint64_t>(std::llround(s.rate * cfg_.duration));
+            s.warmup = static_cast<uint64_t>(std::llround(s.rate * cfg_.warmup));
+            s.seen.assign(s.planned, 0);
+        }
+        s.start_ns = now_ns() + 100'000'000;  // let the senders get ready
+        current_.store(static_cast<int>(index));
+
+        std::vector<Subprocess> publishers;
+        std::vector<std::thread> senders;
+        std::vector<LatencyHistogram> lags(static_cast<size_t>(cfg_.connections));
+        if (rtsp) {
+            for (int i = 0; i < static_cast<int>(s.rate); ++i)
+                publishers.push_back(Subprocess::spawn({"ffmpeg", "-hide_banner", "-loglevel", "error", "-re", "-stream_loop",
+                                                        "-1", "-i", cfg_.video, "-c", "copy", "-f", "rtsp", "-rtsp_transport",
+                                                        "tcp", cfg_.url + "_" + std::to_string(i)},
+                                                       Subprocess::None));
+            const int64_t end = s.start_ns + static_cast<int64_t>(cfg_.duration * 1e9);
+            while (!g_stop && now_ns() < end) std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            for (auto& p : publishers) p.terminate();
+            bool missing = false;
+            for (auto& p : publishers) missing |= p.wait() == 127;
+            if (missing) throw std::runtime_error("cannot run ffmpeg");
+        } else {
+            for (int k = 0; k < cfg_.connections; ++k)
+                senders.emplace_back([this, &s, &lags, k] { send_loop(s, static_cast<uint64_t>(k), lags[static_cast<size_t>(k)]); });
+            for (auto& t : senders) t.join();
+            for (const auto& h : lags) s.lag.merge(h);
+            const int64_t deadline = now_ns() + static_cast<int64_t>(cfg_.drain * 1e9);
+            while (!g_stop && now_ns() < deadline) {
+                {
+                    std::lock_guard<std::mutex> lock(mu_);
+                    if (s.received >= s.sent.load() - s.errors.load()) break;
+                }
+                std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            }
+        }
+        current_.store(-1);
+    }
+
+    // Connection k sends messages k, k + connections, ... each at its due time.
+    void send_loop(Step& s, uint64_t k, LatencyHistogram& lag) {
+        const size_t step = static_cast<size_t>(current_.load());
+        std::unique_ptr<HttpClient> client;
+        if (cfg_.source == "http") client = std::make_unique<HttpClient>(parse_host_port(cfg_.url));
+        for (uint64_t n = k; n < s.planned && !g_stop; n += static_cast<uint64_t>(cfg_.connections)) {
+            const int64_t due = s.due_ns(n);
+            int64_t now = now_ns();
+            if (due > now) {
+                std::this_thread::sleep_for(std::chrono::nanoseconds(due - now));
+                now = now_ns();
+            }
+            lag.record(now - due);
+            const std::string id = run_ + std::to_string(step) + "-" + std::to_string(n);
+            std::string body = "{\"id\":\"" + id + "\"" + template_tail_;
+            bool ok = false;
+            if (cfg_.source == "pipe") {
+                body += '\n';
+                ok = child_.write(body.data(), body.size());
+            } else if (cfg_.source == "http") {
+                ok = client->post(body);
+            } else {
+                ok = drop_file(id, body);
+            }
+            s.sent.fetch_add(1);
+            if (!ok) s.errors.fetch_add(1);
+            s.last_send_ns.store(std::max(s.last_send_ns.load(), now_ns()));
+        }
+    }
+
+    bool drop_file(const std::string& id, const std::string& body) {
+        const std::string path = cfg_.dir + "/" + id + ".json", tmp = cfg_.dir + "/." + id + ".json.tmp";
+        FILE* f = std::fopen(tmp.c_str(), "w");
+        if (!f) return false;
+        const bool ok = std::fwrite(body.data(), 1, body.size(), f) == body.size();
+        return std::fclose(f) == 0 && ok && std::rename(tmp.c_str(), path.c_str()) == 0;
+    }
+
+    void read_child() {
+        std::string buf;
+        char chunk[65536];
+        for (;;) {
+            const ssize_t r = child_.read(chunk, sizeof(chunk));
+            if (r <= 0) break;
+            buf.append(chunk, static_cast<size_t>(r));
+            size_t start = 0, nl;
+            while ((nl = buf.find('\n', start)) != std::string::npos) {
+                try {
+                    deliver(json::Value::parse(std::string_view(buf).substr(start, nl - start)));
+                } catch (const std::exception&) {
+                }
+                start = nl + 1;
+            }
+            buf.erase(0, start);
+        }
+    }
+
+    // Sink side: matches a message back to its step and due time.
+    void deliver(const json::Value& msg) {
+        const int64_t now = now_ns();
+        const json::Value* id = &msg;
+        for (const auto& key : id_path_) {
+            if (!id->is_object()) return;
+            id = &id->get(key);
+        }
+        std::lock_guard<std::mutex> lock(mu_);
+        if (id->is_string() && id->as_string().compare(0, run_.size(), run_) == 0) {
+            const std::string& text = id->as_string();
+            char* end = nullptr;
+            const unsigned long step = std::strtoul(text.c_str() + run_.size(), &end, 10);
+            if (*end != '-' || step >= steps_.size()) return;
+            const uint64_t n = std::strtoull(end + 1, nullptr, 10);
+            Step& s = *steps_[step];
+            if (n >= s.planned) return;
+            if (s.seen[n]) {
+                ++s.duplicates;
+                return;
+            }
+            s.seen[n] = 1;
+            ++s.received;
+            if (n >= s.warmup) s.latency.record(now - s.due_ns(n));
+            return;
+        }
+        const int step = current_.load();
+        if (step < 0 || cfg_.source != "rtsp" || !msg.is_object()) return;
+        const json::Value& t = msg.get(cfg_.time_field);
+        if (!t.is_number()) return;
+        Step& s = *steps_[static_cast<size_t>(step)];
+        ++s.received;
+        if (now - s.start_ns >= static_cast<int64_t>(cfg_.warmup * 1e9))
+            s.latency.record(static_cast<int64_t>((unix_ms() - t.as_number()) * 1e6));
+    }
+
+    uint64_t lost(const Step& s) const { return s.planned > s.received ? s.planned - s.received : 0; }
+
+    bool step_ok(const Step& s) {
+        std::lock_guard<std::mutex> lock(mu_);
+        if (cfg_.slo_p99_ms > 0 && (!s.latency.count() || s.latency.percentile_ms(0.99) > cfg_.slo_p99_ms)) return false;
+        if (cfg_.source == "rtsp")
+            return cfg_.expected_rate <= 0 ||
+                   static_cast<double>(s.received) >= (1.0 - cfg_.max_loss) * s.rate * cfg_.expected_rate * cfg_.duration;
+        return s.planned && static_cast<double>(lost(s)) <= cfg_.max_loss * static_cast<double>(s.planned);
+    }
+
+    std::string summary(const Step& s) {
+        std::lock_guard<std::mutex> lock(mu_);
+        const bool rtsp = cfg_.source == "rtsp";
+        char line[256];
+        std::snprintf(line, sizeof(line), "%s %g: %llu received%s, p50 %.2f ms, p99 %.2f ms, max %.2f ms",
+                      rtsp ? "streams" : "rate", s.rate, static_cast<unsigned long long>(s.received),
+                      rtsp ? "" : (", " + std::to_string(lost(s)) + " lost").c_str(), s.latency.percentile_ms(0.5),
+                      s.latency.percentile_ms(0.99), s.latency.max_ms());
+        return line;
+    }
+
+    json::Value report() {
+        std::lock_guard<std::mutex> lock(mu_);
+        json::Value out = json::Value::object();
+        out["source"] = cfg_.source;
+        if (cfg_.source == "pipe") {
+            std::string cmd;
+            for (const auto& a : cfg_.command) cmd += (cmd.empty() ? "" : " ") + a;
+            out["target"] = cmd;
+        } else {
+            out["target"] = cfg_.source == "file" ? cfg_.dir : cfg_.url;
+        }
+        out["duration_s"] = cfg_.duration;
+        out["warmup_s"] = cfg_.warmup;
+        json::Value steps = json::Value::array();
+        for (const auto& sp : steps_) {
+            const Step& s = *sp;
+            if (!s.start_ns) break;
+            json::Value j = json::Value::object();
+            j[cfg_.source == "rtsp" ? "streams" : "rate"] = s.rate;
+            if (cfg_.source != "rtsp") {
+                j["sent"] = static_cast<double>(s.sent.load());
+                j["errors"] = static_cast<double>(s.errors.load());
+                j["lost"] = static_cast<double>(lost(s));
+                j["duplicates"] = static_cast<double>(s.duplicates);
+                const double span = static_cast<double>(s.last_send_ns.load() - s.start_ns) / 1e9;
+                j["send_rate"] = span > 0 ? static_cast<double>(s.sent.load()) / span : 0.0;
+                json::Value lag = json::Value::object();
+                lag["p99"] = s.lag.percentile_ms(0.99);
+                lag["max"] = s.lag.max_ms();
+                j["send_lag_ms"] = std::move(lag);
+            }
+            j["received"] = static_cast<double>(s.received);
+            j["throughput"] = static_cast<double>(s.received) / cfg_.duration;
+            json::Value lat = json::Value::object();
+            lat["samples"] = static_cast<double>(s.latency.count());
+            lat["p50"] = s.latency.percentile_ms(0.5);
+            lat["p90"] = s.latency.percentile_ms(0.9);
+            lat["p99"] = s.latency.percentile_ms(0.99);
+            lat["p999"] = s.latency.percentile_ms(0.999);
+            lat["max"] = s.latency.max_ms();
+            j["latency_ms"] = std::move(lat);
+            steps.push_back(std::move(j));
+        }
+        out["steps"] = std::move(steps);
+        out["capacity"] = capacity_ > 0 ? json::Value(capacity_) : json::Value();
+        if (cfg_.slo_p99_ms > 0) out["slo_p99_ms"] = cfg_.slo_p99_ms;
+        out["max_loss"] = cfg_.max_loss;
+        return out;
+    }
+
+    LoadgenConfig cfg_;
+    std::string name_;
+    std::string run_;            // ID prefix of this run
+    std::string template_tail_;  // message JSON after the ID
+    std::vector<std::string> id_path_;
+    Subprocess child_;
+    std::thread reader_;
+    std::vector<std::unique_ptr<Step>> steps_;
+    std::atomic<int> current_{-1};
+    std::mutex mu_;              // sink-side step fields
+    double capacity_ = 0.0;
+};
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    signal(SIGPIPE, SIG_IGN);
+    signal(SIGTERM, [](int) { g_stop = 1; });
+    signal(SIGINT, [](int) { g_stop = 1; });
+    try {
+        ProcessorOptions opts = parse_options(argc, argv, "cpp_loadgen");
+        LoadGenerator gen(LoadgenConfig::from_json(opts.config), opts.name);
+        return gen.run();
+    } catch (const std::exception& e) {
+        log_error("cpp_loadgen", e.what());
+        return 1;
+    }
+}
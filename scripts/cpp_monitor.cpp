@@ -0,0 +1,1383 @@
+// Node monitor: serves the dashboard in monitoring/ and pushes live metrics
+// to it over a WebSocket.
+//
+// A collector thread samples the stage counters every processor keeps in
+// shared memory (cpp/stage_metrics.hpp), derives route, node and health
+// figures, and publishes them through a double buffer together with the
+// delta against the previous sample. The server thread never computes
+// anything per client: each sample is encoded once and the same bytes go to
+// every open dashboard, so dozens of dashboards cost about as much as one,
+// and the processors only ever increment relaxed atomics.
+//
+// Endpoints:
+//   GET /ws                   WebSocket: {"type": "snapshot", "seq", "payload"}
+//                             once, then {"type": "delta", "seq", "payload":
+//                             {"set": {<JSON pointer>: value}, "remove": [...]}}
+//   GET /api/routes/status    GET /api/metrics    GET /api/alerts/recent
+//   GET /api/snapshot         GET /health         anything else: static files
+//   GET /api/alerts/recent    SLO burn alerts, newest first; also pushed
+//                             on /ws as {"type": "alert", "payload"}
+//   GET /metrics              Prometheus text: per-pool CPU, memory, faults
+//                             and I/O from the stages' cgroups (cgroup.hpp)
+//   GET /api/metrics/history?series=a,b&from=-3600&to=0&step=60
+//                             range query over the embedded store (tsdb.hpp)
+//   GET /api/flight?route=r   the flight recorder rings of a route's stages
+//   POST /api/flight/dump?route=r
+//                             writes them to `logs` (flight_recorder.hpp)
+//                             (flight and profile endpoints answer only
+//                             loopback peers unless `remote_debug` is set)
+//   GET /debug/profile?seconds=30&route=r&format=svg
+//                             CPU profile of the stages (profiler.hpp) as a
+//                             flame graph or folded stacks
+//
+// When a processor dies without cleaning up, its flight recorder ring is
+// dumped to `logs` with reason "exited"; a critical SLO burn dumps the
+// rings of the route's stages with reason "slo_burn".
+//
+// Usage:
+//   ./bin/cpp_monitor --config '{"port": 8000, "root": "monitoring"}'
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/statvfs.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "cpp/cgroup.hpp"
+#include "cpp/double_buffer.hpp"
+#include "cpp/flamegraph.hpp"
+#include "cpp/flight_recorder.hpp"
+#include "cpp/http.hpp"
+#include "cpp/json.hpp"
+#include "cpp/processor.hpp"
+#include "cpp/profiler.hpp"
+#include "cpp/slo.hpp"
+#include "cpp/stage_metrics.hpp"
+#include "cpp/subprocess.hpp"
+#include "cpp/tsdb.hpp"
+
+using namespace camel;
+
+namespace {
+
+volatile std::sig_atomic_t g_stop = 0;
+
+double now_seconds() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+std::string flight_block(int pid) { return "/camel_flight_" + std::to_string(pid); }
+
+// "90s", "30m", "24h", "7d" or plain seconds.
+double parse_period(const std::string& text) {
+    char* end = nullptr;
+    const double v = std::strtod(text.c_str(), &end);
+    const std::string unit = end ? end : "";
+    if (end == text.c_str() || v < 0) throw std::runtime_error("invalid period '" + text + "'");
+    if (unit.empty() || unit == "s") return v;
+    if (unit == "m") return v * 60;
+    if (unit == "h") return v * 3600;
+    if (unit == "d") return v * 86400;
+    throw std::runtime_error("invalid period '" + text + "'");
+}
+
+struct MonitorConfig {
+    std::string bind = "127.0.0.1";
+    bool remote_debug = false;      // serve flight/profile endpoints to non-loopback peers
+    int port = 8000;
+    std::string root = "monitoring";
+    double interval = 1.0;          // seconds between samples and pushes
+    double stale_after = 300.0;     // seconds a dead stage stays listed
+    std::string logs = "logs";      // flight recorder dumps
+    std::string cgroup = default_cgroup_root();  // pools started by cpp_launch
+    size_t max_client_buffer = 4u << 20;
+    TsdbConfig history;
+    std::vector<SloConfig> slos;
+    size_t max_alerts = 100;        // kept for /api/alerts/recent
+
+    static MonitorConfig from_json(const json::Value& c) {
+        MonitorConfig cfg;
+        cfg.bind = c.string_or("bind", cfg.bind);
+        cfg.remote_debug = c.bool_or("remote_debug", cfg.remote_debug);
+        cfg.port = static_cast<int>(c.number_or("port", cfg.port));
+        cfg.root = c.string_or("root", cfg.root);
+        cfg.interval = c.number_or("interval", cfg.interval);
+        cfg.stale_after = c.number_or("stale_after", cfg.stale_after);
+        cfg.logs = c.string_or("logs", cfg.logs);
+        cfg.cgroup = c.string_or("cgroup", cfg.cgroup);
+        cfg.max_client_buffer = static_cast<size_t>(c.number_or("max_client_buffer", static_cast<double>(cfg.max_client_buffer)));
+        // The minute tier covers the retention period; the 1 s tier at most
+        // an hour of it and the 10 min tier at least a week.
+        const json::Value& retention = c.get("retention_period");
+        const double keep = retention.is_number() ? retention.as_number() : parse_period(c.string_or("retention_period", "24h"));
+        if (keep < 60) throw std::runtime_error("retention_period must be at least 1m");
+        cfg.history.raw_points = static_cast<size_t>(std::min(keep, 3600.0));
+        cfg.history.minute_points = static_cast<size_t>(keep / 60);
+        cfg.history.ten_minute_points = static_cast<size_t>(std::max(keep / 600, 1008.0));
+        cfg.history.max_series = static_cast<size_t>(c.number_or("max_series", static_cast<double>(cfg.history.max_series)));
+        cfg.max_alerts = static_cast<size_t>(c.number_or("max_alerts", static_cast<double>(cfg.max_alerts)));
+        const json::Value& slos = c.get("slos");
+        if (slos.is_object())
+            for (const auto& [route, v] : slos.as_object()) cfg.slos.push_back(slo_from_json(route, v));
+        if (cfg.interval < 0.05) throw std::runtime_error("interval must be >= 0.05 s");
+        if (cfg.port <= 0 || cfg.port > 65535) throw std::runtime_error("invalid port");
+        return cfg;
+    }
+
+    // "door": {"target_ms": 250, "objective": 0.99, "window": "30d",
+    //          "notify": ["log://logs/slo.log", "email://..."]}
+    static SloConfig slo_from_json(const std::string& route, const json::Value& c) {
+        SloConfig slo;
+        slo.route = route;
+        slo.stage = c.string_or("stage", "");
+        slo.target_ms = c.contains("target_us") ? c.number_or("target_us", 0) / 1000.0 : c.number_or("target_ms", 0);
+        slo.objective = c.number_or("objective", slo.objective);
+        const json::Value& window = c.get("window");
+        slo.window_s = window.is_number() ? window.as_number() : parse_period(c.string_or("window", "30d"));
+        const json::Value& notify = c.get("notify");
+        if (notify.is_string()) slo.notify.push_back(notify.as_string());
+        else if (notify.is_array())
+            for (const auto& t : notify.as_array()) slo.notify.push_back(t.is_string() ? t.as_string() : "");
+        if (slo.target_ms <= 0) throw std::runtime_error("slos." + route + ": target_ms must be > 0");
+        if (!(slo.objective > 0 && slo.objective < 1)) throw std::runtime_error("slos." + route + ": objective must be in (0, 1)");
+        if (slo.window_s < 3600) throw std::runtime_error("slos." + route + ": window must be at least 1h");
+        for (const auto& t : slo.notify)
+            if (t.rfind("log://", 0) != 0 && t.rfind("email://", 0) != 0)
+                throw std::runtime_error("slos." + route + ": notify targets are log:// or email://, not '" + t + "'");
+        return slo;
+    }
+};
+
+struct History {
+    std::mutex mu;
+    Tsdb db;
+};
+
+// WebSocket messages raised by samples (alerts), numbered in order. They
+// are queued apart from the double-buffered sample, which the server may
+// skip, so every client sees every one.
+struct EventQueue {
+    static constexpr size_t kMax = 256;
+    std::mutex mu;
+    std::deque<std::pair<uint64_t, std::string>> events;  // oldest first
+    uint64_t seq = 0;
+};
+
+// One sample, pre-encoded for every consumer.
+struct Published {
+    uint64_t seq = 0;
+    std::string full;    // WebSocket snapshot message
+    std::string delta;   // WebSocket delta from seq - 1
+    std::string state;   // /api/snapshot
+    std::string routes;  // /api/routes/status
+    std::string metrics;
+    std::string health;
+    std::string prometheus;  // /metrics
+    std::string alerts;      // /api/alerts/recent
+};
+
+double round2(double v) { return std::round(v * 100.0) / 100.0; }
+
+std::string escape_pointer(const std::string& key) {
+    std::string out;
+    for (char c : key) {
+        if (c == '~') out += "~0";
+        else if (c == '/') out += "~1";
+        else out += c;
+    }
+    return out;
+}
+
+// JSON pointer -> encoded leaf value; arrays and empty objects count as leaves.
+void flatten(const json::Value& v, const std::string& prefix, std::map<std::string, std::string>& out) {
+    if (v.is_object() && v.size() > 0) {
+        for (const auto& [k, child] : v.as_object()) flatten(child, prefix + "/" + escape_pointer(k), out);
+        return;
+    }
+    v.dump_to(out[prefix]);
+}
+
+// Percentile from a log2 latency histogram, as the bucket's upper bound.
+double percentile_ms(const uint64_t* buckets, double q) {
+    uint64_t total = 0;
+    for (int i = 0; i < kLatencyBuckets; ++i) total += buckets[i];
+    if (total == 0) return 0.0;
+    const auto rank = static_cast<uint64_t>(std::ceil(q * static_cast<double>(total)));
+    uint64_t seen = 0;
+    for (int i = 0; i < kLatencyBuckets; ++i) {
+        seen += buckets[i];
+        if (seen >= rank) return latency_bucket_bound_us(i) / 1000.0;
+    }
+    return latency_bucket_bound_us(kLatencyBuckets - 1) / 1000.0;
+}
+
+struct PoolSample {
+    CgroupPool pool;
+    CgroupUsage usage;
+    double cores = 0.0;  // CPU used since the previous sample
+};
+
+std::string prometheus_label(const std::string& v) {
+    std::string out;
+    for (char c : v) {
+        if (c == '\\' || c == '"') out += '\\';
+        if (c == '\n') out += "\\n";
+        else out += c;
+    }
+    return out;
+}
+
+// Text exposition format, one family per resource, labelled by route and
+// stage. Limits are only exported for pools that have one.
+std::string render_prometheus(const std::vector<PoolSample>& pools) {
+    struct Family {
+        const char* name;
+        const char* type;
+        const char* help;
+        double (*value)(const PoolSample&);  // < 0: not exported for this pool
+    };
+    static const Family families[] = {
+        {"camel_pool_cpu_seconds_total", "counter", "CPU time used by the pool.",
+         [](const PoolSample& p) { return p.usage.cpu_usec / 1e6; }},
+        {"camel_pool_cpu_throttled_seconds_total", "counter", "Time the pool was throttled by its CPU limit.",
+         [](const PoolSample& p) { return p.usage.throttled_usec / 1e6; }},
+        {"camel_pool_memory_bytes", "gauge", "Memory charged to the pool, including page cache.",
+         [](const PoolSample& p) { return static_cast<double>(p.usage.memory_bytes); }},
+        {"camel_pool_rss_bytes", "gauge", "Anonymous memory of the pool.",
+         [](const PoolSample& p) { return static_cast<double>(p.usage.anon_bytes); }},
+        {"camel_pool_page_faults_total", "counter", "Page faults in the pool.",
+         [](const PoolSample& p) { return static_cast<double>(p.usage.page_faults); }},
+        {"camel_pool_major_page_faults_total", "counter", "Page faults that needed I/O.",
+         [](const PoolSample& p) { return static_cast<double>(p.usage.major_faults); }},
+        {"camel_pool_io_read_bytes_total", "counter", "Bytes read from block devices.",
+         [](const PoolSample& p) { return static_cast<double>(p.usage.io_read_bytes); }},
+        {"camel_pool_io_write_bytes_total", "counter", "Bytes written to block devices.",
+         [](const PoolSample& p) { return static_cast<double>(p.usage.io_write_bytes); }},
+        {"camel_pool_oom_kills_total", "counter", "Processes killed for exceeding the memory limit.",
+         [](const PoolSample& p) { return static_cast<double>(p.usage.oom_kills); }},
+        {"camel_pool_processes", "gauge", "Processes in the pool.",
+         [](const PoolSample& p) { return static_cast<double>(p.usage.processes); }},
+        {"camel_pool_cpu_limit_cores", "gauge", "CPU limit of the pool.",
+         [](const PoolSample& p) { return p.usage.limits.cpus > 0 ? p.usage.limits.cpus : -1.0; }},
+        {"camel_pool_memory_limit_bytes", "gauge", "Memory limit of the pool.",
+         [](const PoolSample& p) {
+             return p.usage.limits.memory_bytes > 0 ? static_cast<double>(p.usage.limits.memory_bytes) : -1.0;
+         }},
+    };
+    std::string out;
+    char num[32];
+    for (const Family& f : families) {
+        std::string series;
+        for (const PoolSample& p : pools) {
+            const double v = f.value(p);
+            if (v < 0) continue;
+            std::snprintf(num, sizeof(num), "%.12g", v);
+            series += std::string(f.name) + "{route=\"" + prometheus_label(p.pool.route) + "\",stage=\"" +
+                      prometheus_label(p.pool.stage) + "\"} " + num + "\n";
+        }
+        if (series.empty()) continue;
+        out += std::string("# HELP ") + f.name + " " + f.help + "\n# TYPE " + f.name + " " + f.type + "\n" + series;
+    }
+    return out;
+}
+
+// Delivers alerts to log:// and email:// targets on its own thread, so a
+// slow mail server never delays a sample.
+//   log://                 the monitor's stderr
+//   log://logs/slo.log     one JSON line per alert, appended
+//   email://host:port?user=u&password=p&to=a@x,b@y&from=f
+//                          sent with curl; TLS is required when a password
+//                          is given (port 465: implicit, otherwise STARTTLS)
+class AlertNotifier {
+public:
+    AlertNotifier() : thread_([this] { loop(); }) {}
+    AlertNotifier(const AlertNotifier&) = delete;
+    AlertNotifier& operator=(const AlertNotifier&) = delete;
+    ~AlertNotifier() {
+        {
+            std::lock_guard<std::mutex> lock(mu_);
+            stopping_ = true;
+        }
+        cv_.notify_all();
+        thread_.join();
+    }
+
+    void send(const std::vector<std::string>& targets, const json::Value& alert) {
+        if (targets.empty()) return;
+        {
+            std::lock_guard<std::mutex> lock(mu_);
+            if (queue_.size() >= 256) return;  // targets unreachable for a long time
+            queue_.push_back({targets, alert});
+        }
+        cv_.notify_one();
+    }
+
+private:
+    struct Job {
+        std::vector<std::string> targets;
+        json::Value alert;
+    };
+
+    void loop() {
+        for (;;) {
+            Job job;
+            {
+                std::unique_lock<std::mutex> lock(mu_);
+                cv_.wait(lock, [&] { return stopping_ || !queue_.empty(); });
+                if (queue_.empty()) return;
+                job = std::move(queue_.front());
+                queue_.pop_front();
+            }
+            for (const auto& target : job.targets) {
+                try {
+                    if (target.rfind("log://", 0) == 0) write_log(target.substr(6), job.alert);
+                    else send_email(target.substr(8), job.alert);
+                } catch (const std::exception& e) {
+                    log_error("cpp_monitor", "alert to " + target.substr(0, target.find('?')) + ": " + e.what());
+                }
+            }
+        }
+    }
+
+    static void write_log(const std::string& path, const json::Value& alert) {
+        if (path.empty()) {
+            log_info("cpp_monitor", "alert: " + alert.string_or("message", ""));
+            return;
+        }
+        const std::filesystem::path parent = std::filesystem::path(path).parent_path();
+        if (!parent.empty()) std::filesystem::create_directories(parent);
+        std::ofstream out(path, std::ios::app);
+        out << alert.dump() << '\n';
+        if (!out) throw std::runtime_error("cannot append to " + path);
+    }
+
+    static std::string curl_quote(const std::string& v) {
+        std::string out = "\"";
+        for (char c : v) {
+            if (c == '"' || c == '\\') out += '\\';
+            out += c;
+        }
+        return out + "\"";
+    }
+
+    // Credentials go to curl on stdin, never on its command line.
+    static void send_email(const std::string& spec, const json::Value& alert) {
+        const size_t q = spec.find('?');
+        const std::string host = spec.substr(0, q);
+        std::map<std::string, std::string> params;
+        if (q != std::string::npos) http::parse_query(std::string_view(spec).substr(q + 1), params);
+        const std::string user = params["user"], password = params["password"];
+        const std::string from = !params["from"].empty() ? params["from"] : user.find('@') != std::string::npos ? user : "camel@localhost";
+        std::vector<std::string> to;
+        std::stringstream list(params["to"]);
+        for (std::string a; std::getline(list, a, ',');)
+            if (!a.empty()) to.push_back(a);
+        if (host.empty() || to.empty()) throw std::runtime_error("email target needs a host and to=");
+
+        char path[] = "/tmp/camel_alert_XXXXXX";
+        const int fd = ::mkstemp(path);
+        if (fd < 0) throw std::runtime_error("cannot create mail file");
+        std::string mail = "From: " + from + "\r\nTo: ";
+        for (size_t i = 0; i < to.size(); ++i) mail += (i ? ", " : "") + to[i];
+        mail += "\r\nSubject: [camel] " + alert.string_or("route", "") + " latency SLO " + alert.string_or("status", "") +
+                "\r\nContent-Type: text/plain; charset=utf-8\r\n\r\n" + alert.string_or("message", "") + "\r\n\r\n" +
+                alert.dump() + "\r\n";
+        const bool written = ::write(fd, mail.data(), mail.size()) == static_cast<ssize_t>(mail.size());
+        ::close(fd);
+
+        const bool implicit_tls = host.size() > 4 && host.compare(host.size() - 4, 4, ":465") == 0;
+        char hostname[256] = "localhost";
+        ::gethostname(hostname, sizeof(hostname) - 1);
+        // The URL path is the EHLO name.
+        std::string config = "url = " + curl_quote((implicit_tls ? "smtps://" : "smtp://") + host + "/" + hostname) + "\n";
+        config += "mail-from = " + curl_quote(from) + "\n";
+        for (const auto& a : to) config += "mail-rcpt = " + curl_quote(a) + "\n";
+        config += "upload-file = " + curl_quote(path) + "\nmax-time = 30\nsilent\nshow-error\n";
+        if (!user.empty()) {
+            config += "user = " + curl_quote(user + ":" + password) + "\n";
+            if (!implicit_tls) config += "ssl-reqd\n";
+        }
+        int status = -1;
+        if (written) {
+            Subprocess curl = Subprocess::spawn({"curl", "--config", "-"}, Subprocess::Stdin);
+            curl.write(config.data(), config.size());
+            status = curl.wait();
+        }
+        ::unlink(path);
+        if (status != 0) throw std::runtime_error("curl exited with status " + std::to_string(status));
+    }
+
+    std::mutex mu_;
+    std::condition_variable cv_;
+    std::deque<Job> queue_;
+    bool stopping_ = false;
+    std::thread thread_;
+};
+
+class Collector {
+public:
+    Collector(const MonitorConfig& cfg, DoubleBuffer<Published>& out, EventQueue& events, int notify_fd,
+              std::atomic<int>& clients, History& history)
+        : cfg_(cfg), out_(out), events_(events), notify_fd_(notify_fd), clients_(clients), history_(history) {
+        for (const SloConfig& slo : cfg_.slos) slos_.emplace_back(slo);
+    }
+
+    void run() {
+        double next = now_seconds();
+        while (!g_stop) {
+            try {
+                sample();
+            } catch (const std::exception& e) {
+                log_error("cpp_monitor", e.what());
+            }
+            next += cfg_.interval;
+            const double wait = next - now_seconds();
+            if (wait > 0) std::this_thread::sleep_for(std::chrono::duration<double>(wait));
+            else next = now_seconds();
+        }
+    }
+
+private:
+    struct PoolState {
+        double time = 0.0;
+        uint64_t cpu_usec = 0;
+        double empty_since = 0.0;
+    };
+
+    struct Window {
+        std::deque<std::pair<double, uint64_t>> points;  // (time, processed) over the last minute
+        double dead_since = 0.0;
+    };
+
+    void sample() {
+        const double now = now_seconds();
+        const uint64_t now_ms = unix_ms_now();
+        std::vector<StageSample> stages = sample_stages();
+
+        json::Value routes = json::Value::object();
+        std::map<std::string, uint64_t> route_started;
+        uint64_t total_processed = 0, total_errors = 0, total_busy = 0, total_stage_msgs = 0;
+        double total_rate = 0.0, rss_mb = 0.0;
+        std::map<std::string, double> route_rate;
+        std::map<std::string, Window> seen;
+        for (const StageSample& s : stages) {
+            Window& w = windows_[s.shm];
+            if (!s.alive) {
+                if (w.dead_since == 0.0) {
+                    w.dead_since = now;
+                    dump_exited(s);
+                }
+                if (now - w.dead_since > cfg_.stale_after) {
+                    shm_unlink(s.shm.c_str());
+                    shm_unlink(flight_block(s.pid).c_str());
+                    shm_unlink(profile_result_name(s.pid).c_str());  // a result nobody collected
+                    continue;
+                }
+            }
+            for (SloTracker& t : slos_) t.observe(s);
+            const uint64_t processed = s.forwarded + s.dropped + s.errors;
+            w.points.emplace_back(now, processed);
+            while (w.points.size() > 2 && now - w.points.front().first > 60.0) w.points.pop_front();
+            const double span = now - w.points.front().first;
+            const double per_minute = span > 0 ? (processed - w.points.front().second) * 60.0 / span : 0.0;
+            seen[s.shm] = w;
+
+            json::Value st = json::Value::object();
+            st["stage"] = s.stage;
+            st["pid"] = s.pid;
+            st["status"] = s.alive ? "running" : "failed";
+            st["received"] = s.received;
+            st["forwarded"] = s.forwarded;
+            st["dropped"] = s.dropped;
+            st["errors"] = s.errors;
+            st["messages_per_minute"] = round2(per_minute);
+            st["avg_processing_ms"] = processed ? round2(static_cast<double>(s.busy_ns) / processed / 1e6) : 0.0;
+            st["p99_processing_ms"] = round2(percentile_ms(s.latency, 0.99));
+            st["last_message_ms"] = s.last_unix_ms;
+            const double rss = s.alive ? process_rss_mb(s.pid) : 0.0;
+            st["rss_mb"] = round2(rss);
+            rss_mb += rss;
+
+            json::Value& r = route_entry(routes, s.route);
+            if (!s.alive) r["status"] = "failed";
+            r["messages_processed"] = std::max(r.get("messages_processed").as_number(), static_cast<double>(processed));
+            r["errors"] = r.get("errors").as_number() + static_cast<double>(s.errors);
+            route_rate[s.route] = std::max(route_rate[s.route], per_minute);
+            auto it = route_started.find(s.route);
+            if (it == route_started.end() || s.started_unix_ms < it->second) route_started[s.route] = s.started_unix_ms;
+            r["stages"][s.stage + ":" + std::to_string(s.pid)] = std::move(st);
+
+            total_errors += s.errors;
+            total_busy += s.busy_ns;
+            total_stage_msgs += processed;
+        }
+        windows_.swap(seen);
+
+        // Pools may also hold processors without a stage block (other
+        // languages), so they can add routes of their own.
+        std::vector<PoolSample> pools = sample_pools(now);
+        for (const PoolSample& p : pools) {
+            json::Value& r = route_entry(routes, p.pool.route);
+            if (!r.contains("resources")) r["resources"] = json::Value::object();
+            r["resources"][p.pool.stage] = pool_json(p);
+        }
+
+        std::vector<std::string> events;
+        for (SloTracker& t : slos_) {
+            const SloStatus st = t.evaluate(now);
+            route_entry(routes, t.config().route)["slo"] = slo_json(t.config(), st);
+            SloLevel& level = slo_levels_[t.config().route];
+            if (st.level == level) continue;
+            events.push_back(raise_alert(t.config(), st, level, now_ms, stages));
+            level = st.level;
+        }
+
+        json::Value route_list = json::Value::array();
+        int running = 0, failed = 0;
+        for (auto& [name, r] : routes.as_object()) {
+            auto started = route_started.find(name);
+            r["uptime"] = started == route_started.end() ? 0.0 : static_cast<double>((now_ms - started->second) / 1000);
+            r["messages_per_minute"] = round2(route_rate[name]);
+            total_processed += static_cast<uint64_t>(r.get("messages_processed").as_number());
+            total_rate += route_rate[name];
+            (r.get("status").as_string() == "running" ? running : failed)++;
+            json::Value summary = r;
+            route_list.push_back(std::move(summary));
+        }
+
+        const double mem_total_mb = meminfo_mb("MemTotal:");
+        json::Value metrics = json::Value::object();
+        metrics["messages_processed"] = total_processed;
+        metrics["messages_per_minute"] = round2(total_rate);
+        metrics["avg_processing_time"] = total_stage_msgs ? round2(static_cast<double>(total_busy) / total_stage_msgs / 1e6) : 0.0;
+        metrics["error_rate"] = total_stage_msgs ? round2(100.0 * total_errors / total_stage_msgs) : 0.0;
+        metrics["memory_usage"] = round2(rss_mb);
+        metrics["memory_percentage"] = mem_total_mb > 0 ? round2(100.0 * rss_mb / mem_total_mb) : 0.0;
+
+        json::Value health = json::Value::object();
+        health["status"] = failed ? "degraded" : "healthy";
+        health["cpu_usage"] = round2(cpu_usage());
+        health["memory_usage"] = mem_total_mb > 0 ? round2(100.0 * (1.0 - meminfo_mb("MemAvailable:") / mem_total_mb)) : 0.0;
+        health["disk_usage"] = round2(disk_usage(cfg_.root));
+        health["connections"] = clients_.load(std::memory_order_relaxed);
+        record(static_cast<int64_t>(now_ms / 1000), routes, metrics, health);
+
+        json::Value state = json::Value::object();
+        state["routes"] = std::move(routes);
+        state["metrics"] = metrics;
+        state["health"] = health;
+
+        json::Value status = json::Value::object();
+        status["total"] = running + failed;
+        status["running"] = running;
+        status["failed"] = failed;
+        status["routes"] = std::move(route_list);
+
+        std::map<std::string, std::string> flat;
+        flatten(state, "", flat);
+        const uint64_t seq = ++seq_;
+        std::string delta = "{\"type\":\"delta\",\"seq\":" + std::to_string(seq) + ",\"payload\":{\"set\":{";
+        bool first = true;
+        for (const auto& [ptr, value] : flat) {
+            auto it = prev_.find(ptr);
+            if (it != prev_.end() && it->second == value) continue;
+            if (!first) delta += ',';
+            first = false;
+            json::detail::dump_string(delta, ptr);
+            delta += ':';
+            delta += value;
+        }
+        delta += "},\"remove\":[";
+        first = true;
+        for (const auto& [ptr, value] : prev_) {
+            if (flat.count(ptr)) continue;
+            if (!first) delta += ',';
+            first = false;
+            json::detail::dump_string(delta, ptr);
+        }
+        delta += "]}}";
+        prev_.swap(flat);
+
+        Published p;
+        p.seq = seq;
+        p.state = state.dump();
+        p.full = "{\"type\":\"snapshot\",\"seq\":" + std::to_string(seq) + ",\"payload\":" + p.state + "}";
+        p.delta = std::move(delta);
+        p.routes = status.dump();
+        p.metrics = metrics.dump();
+        p.health = health.dump();
+        p.prometheus = render_prometheus(pools);
+        json::Value recent = json::Value::object();
+        recent["alerts"] = json::Value::array();
+        for (const auto& a : alerts_) recent["alerts"].push_back(a);
+        p.alerts = recent.dump();
+        if (!events.empty()) {
+            std::lock_guard<std::mutex> lock(events_.mu);
+            for (auto& e : events) events_.events.emplace_back(++events_.seq, std::move(e));
+            while (events_.events.size() > EventQueue::kMax) events_.events.pop_front();
+        }
+        if (!out_.publish([&](Published& slot) { slot = std::move(p); })) {
+            // The server still reads the older slot; the next sample resends
+            // in full since this delta is lost.
+            prev_.clear();
+            if (events.empty()) return;
+        }
+        const uint64_t one = 1;
+        (void)!::write(notify_fd_, &one, sizeof(one));
+    }
+
+    static json::Value& route_entry(json::Value& routes, const std::string& name) {
+        json::Value& r = routes[name];
+        if (!r.contains("name")) {
+            r["name"] = name;
+            r["status"] = "running";
+            r["messages_processed"] = 0;
+            r["errors"] = 0;
+            r["stages"] = json::Value::object();
+        }
+        return r;
+    }
+
+    // Reads every pool under the cgroup root; CPU is turned into cores used
+    // since the previous sample. Pools left empty for stale_after are removed.
+    std::vector<PoolSample> sample_pools(double now) {
+        std::vector<PoolSample> out;
+        std::map<std::string, PoolState> seen;
+        for (CgroupPool& pool : list_cgroup_pools(cfg_.cgroup)) {
+            PoolSample p;
+            p.usage = read_cgroup_usage(pool.path);
+            PoolState& st = pools_[pool.path];
+            if (st.time > 0 && now > st.time && p.usage.cpu_usec >= st.cpu_usec)
+                p.cores = static_cast<double>(p.usage.cpu_usec - st.cpu_usec) / 1e6 / (now - st.time);
+            st.time = now;
+            st.cpu_usec = p.usage.cpu_usec;
+            if (p.usage.processes > 0) {
+                st.empty_since = 0.0;
+            } else if (st.empty_since == 0.0) {
+                st.empty_since = now;
+            } else if (now - st.empty_since > cfg_.stale_after && ::rmdir(pool.path.c_str()) == 0) {
+                ::rmdir((cfg_.cgroup + "/" + pool.route).c_str());  // fails while other stages remain
+                continue;
+            }
+            seen[pool.path] = st;
+            p.pool = std::move(pool);
+            out.push_back(std::move(p));
+        }
+        pools_.swap(seen);
+        return out;
+    }
+
+    static json::Value pool_json(const PoolSample& p) {
+        const CgroupUsage& u = p.usage;
+        json::Value v = json::Value::object();
+        v["processes"] = u.processes;
+        v["cpu_cores"] = round2(p.cores);
+        v["cpu_seconds"] = round2(u.cpu_usec / 1e6);
+        v["cpu_throttled_seconds"] = round2(u.throttled_usec / 1e6);
+        v["memory_mb"] = round2(u.memory_bytes / (1024.0 * 1024.0));
+        v["rss_mb"] = round2(u.anon_bytes / (1024.0 * 1024.0));
+        v["page_faults"] = u.page_faults;
+        v["major_page_faults"] = u.major_faults;
+        v["io_read_bytes"] = u.io_read_bytes;
+        v["io_write_bytes"] = u.io_write_bytes;
+        v["oom_kills"] = u.oom_kills;
+        if (u.limits.cpus > 0) v["cpu_limit"] = round2(u.limits.cpus);
+        if (u.limits.memory_bytes > 0) v["memory_limit_mb"] = round2(u.limits.memory_bytes / (1024.0 * 1024.0));
+        return v;
+    }
+
+    static json::Value slo_json(const SloConfig& cfg, const SloStatus& st) {
+        auto round4 = [](double v) { return std::round(v * 1e4) / 1e4; };
+        json::Value v = json::Value::object();
+        v["status"] = slo_level_name(st.level);
+        v["target_ms"] = cfg.target_ms;
+        v["objective"] = cfg.objective;
+        v["window_seconds"] = cfg.window_s;
+        v["compliance"] = round4(st.compliance);
+        v["budget_remaining"] = round4(st.budget_remaining);
+        json::Value burn = json::Value::object();
+        for (size_t i = 0; i < std::size(kSloWindows); ++i) burn[kSloWindows[i].name] = round2(st.burn[i]);
+        v["burn_rate"] = std::move(burn);
+        v["critical_burn_rate"] = round2(st.critical_threshold);
+        v["warning_burn_rate"] = round2(st.warning_threshold);
+        v["worst_stage"] = st.worst_stage;
+        v["covered_seconds"] = std::round(st.covered_s);
+        return v;
+    }
+
+    // Records, delivers and returns (as a WebSocket message) the alert for a
+    // change of SLO level. A critical burn also dumps the flight recorders
+    // of the route's stages, which hold the slow messages.
+    std::string raise_alert(const SloConfig& cfg, const SloStatus& st, SloLevel was, uint64_t now_ms,
+                            const std::vector<StageSample>& stages) {
+        char budget[48] = "error budget exhausted";
+        if (st.budget_remaining > 0)
+            std::snprintf(budget, sizeof(budget), "%.0f%% of the error budget left", 100.0 * st.budget_remaining);
+        char text[320];
+        if (st.level == SloLevel::Ok) {
+            std::snprintf(text, sizeof(text), "%s: latency SLO back within budget (was %s); %s", cfg.route.c_str(),
+                          slo_level_name(was), budget);
+        } else {
+            const bool critical = st.level == SloLevel::Critical;
+            std::snprintf(text, sizeof(text),
+                          "%s: latency SLO %s, error budget burning %.1fx over %s (worst stage %s; %.0f%% of messages "
+                          "within %g ms); %s",
+                          cfg.route.c_str(), slo_level_name(st.level), critical ? st.burn[2] : st.burn[3],
+                          critical ? "1h" : "6h", st.worst_stage.c_str(), 100.0 * cfg.objective, cfg.target_ms, budget);
+        }
+        json::Value a = json::Value::object();
+        a["id"] = ++alert_seq_;
+        a["timestamp"] = now_ms;
+        a["route"] = cfg.route;
+        a["source"] = "slo:" + cfg.route;
+        a["status"] = st.level == SloLevel::Ok ? "resolved" : "firing";
+        a["level"] = slo_level_name(st.level);
+        a["severity"] = st.level == SloLevel::Critical ? "high" : st.level == SloLevel::Warning ? "medium" : "low";
+        a["message"] = std::string(text);
+        a["burn_rate_1h"] = round2(st.burn[2]);
+        a["burn_rate_6h"] = round2(st.burn[3]);
+        a["budget_remaining"] = std::round(st.budget_remaining * 1e4) / 1e4;
+        a["worst_stage"] = st.worst_stage;
+        alerts_.push_front(a);
+        while (alerts_.size() > cfg_.max_alerts) alerts_.pop_back();
+        notifier_.send(cfg.notify, a);
+        if (st.level == SloLevel::Critical) {
+            for (const StageSample& s : stages) {
+                if (s.route != cfg.route || !s.alive) continue;
+                try {
+                    const FlightSnapshot snap = read_flight(flight_block(s.pid));
+                    if (!snap.records.empty()) write_flight_dump(snap, "slo_burn", cfg_.logs);
+                } catch (const std::exception&) {
+                    // flight recorder disabled in that process
+                }
+            }
+        }
+        return "{\"type\":\"alert\",\"payload\":" + a.dump() + "}";
+    }
+
+    void dump_exited(const StageSample& s) {
+        try {
+            const FlightSnapshot snap = read_flight(flight_block(s.pid));
+            if (snap.records.empty()) return;
+            const std::string path = write_flight_dump(snap, "exited", cfg_.logs);
+            log_error("cpp_monitor", s.route + "/" + s.stage + " (pid " + std::to_string(s.pid) + ") exited; last " +
+                                         std::to_string(snap.records.size()) + " messages in " +
+                                         (path.empty() ? "(dump failed)" : path));
+        } catch (const std::exception&) {
+            // flight recorder disabled in that process
+        }
+    }
+
+    // Series are named like the snapshot paths, with stages keyed by name
+    // rather than pid so a restarted stage continues its history.
+    void record(int64_t t, const json::Value& routes, const json::Value& metrics, const json::Value& health) {
+        std::lock_guard<std::mutex> lock(history_.mu);
+        Tsdb& db = history_.db;
+        for (const auto& [key, v] : metrics.as_object())
+            if (v.is_number()) db.add("metrics." + key, t, v.as_number());
+        for (const auto& [key, v] : health.as_object())
+            if (v.is_number()) db.add("health." + key, t, v.as_number());
+        for (const auto& [name, r] : routes.as_object()) {
+            const std::string prefix = "routes." + name + ".";
+            db.add(prefix + "messages_per_minute", t, r.number_or("messages_per_minute", 0));
+            db.add(prefix + "errors", t, r.number_or("errors", 0));
+            std::map<std::string, std::pair<double, double>> stages;  // name -> (avg, p99), worst instance
+            for (const auto& [key, st] : r.get("stages").as_object()) {
+                auto& [avg, p99] = stages[st.string_or("stage", key)];
+                avg = std::max(avg, st.number_or("avg_processing_ms", 0));
+                p99 = std::max(p99, st.number_or("p99_processing_ms", 0));
+            }
+            for (const auto& [stage, v] : stages) {
+                db.add(prefix + stage + ".avg_processing_ms", t, v.first);
+                db.add(prefix + stage + ".p99_processing_ms", t, v.second);
+            }
+            if (r.get("slo").is_object()) {
+                db.add(prefix + "slo_burn_rate_1h", t, r.get("slo").get("burn_rate").number_or("1h", 0));
+                db.add(prefix + "slo_budget_remaining", t, r.get("slo").number_or("budget_remaining", 1));
+            }
+            if (r.get("resources").is_object()) {
+                for (const auto& [stage, res] : r.get("resources").as_object()) {
+                    db.add(prefix + stage + ".cpu_cores", t, res.number_or("cpu_cores", 0));
+                    db.add(prefix + stage + ".memory_mb", t, res.number_or("memory_mb", 0));
+                }
+            }
+        }
+    }
+
+    static double process_rss_mb(int pid) {
+        std::ifstream in("/proc/" + std::to_string(pid) + "/statm");
+        uint64_t size = 0, resident = 0;
+        if (!(in >> size >> resident)) return 0.0;
+        return static_cast<double>(resident) * static_cast<double>(sysconf(_SC_PAGESIZE)) / (1024.0 * 1024.0);
+    }
+
+    static double meminfo_mb(const char* key) {
+        std::ifstream in("/proc/meminfo");
+        std::string name;
+        double kb = 0;
+        std::string unit;
+        while (in >> name >> kb >> unit)
+            if (name == key) return kb / 1024.0;
+        return 0.0;
+    }
+
+    double cpu_usage() {
+        std::ifstream in("/proc/stat");
+        std::string cpu;
+        uint64_t v[8] = {};
+        in >> cpu;
+        for (auto& x : v) in >> x;
+        const uint64_t idle = v[3] + v[4], total = v[0] + v[1] + v[2] + v[3] + v[4] + v[5] + v[6] + v[7];
+        const double usage = total > cpu_total_ ? 100.0 * (1.0 - static_cast<double>(idle - cpu_idle_) / (total - cpu_total_)) : 0.0;
+        cpu_idle_ = idle;
+        cpu_total_ = total;
+        return usage;
+    }
+
+    static double disk_usage(const std::string& path) {
+        struct statvfs st {};
+        if (statvfs(path.c_str(), &st) != 0 || st.f_blocks == 0) return 0.0;
+        return 100.0 * (1.0 - static_cast<double>(st.f_bavail) / static_cast<double>(st.f_blocks));
+    }
+
+    const MonitorConfig& cfg_;
+    DoubleBuffer<Published>& out_;
+    EventQueue& events_;
+    int notify_fd_;
+    std::atomic<int>& clients_;
+    History& history_;
+    std::map<std::string, Window> windows_;
+    std::map<std::string, PoolState> pools_;
+    std::vector<SloTracker> slos_;
+    std::map<std::string, SloLevel> slo_levels_;  // by route
+    std::deque<json::Value> alerts_;              // newest first
+    uint64_t alert_seq_ = 0;
+    AlertNotifier notifier_;
+    std::map<std::string, std::string> prev_;
+    uint64_t seq_ = 0;
+    uint64_t cpu_idle_ = 0, cpu_total_ = 0;
+};
+
+class Server {
+public:
+    explicit Server(MonitorConfig cfg) : cfg_(std::move(cfg)), history_{{}, Tsdb(cfg_.history)} {
+        epoll_ = epoll_create1(EPOLL_CLOEXEC);
+        notify_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        jobs_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        listen_ = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        int one = 1;
+        setsockopt(listen_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(static_cast<uint16_t>(cfg_.port));
+        if (inet_pton(AF_INET, cfg_.bind.c_str(), &addr.sin_addr) != 1) throw std::runtime_error("invalid bind address " + cfg_.bind);
+        if (epoll_ < 0 || notify_ < 0 || jobs_ < 0 || listen_ < 0 ||
+            ::bind(listen_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || ::listen(listen_, 64) != 0)
+            throw std::runtime_error("cannot listen on " + cfg_.bind + ":" + std::to_string(cfg_.port) + ": " + std::strerror(errno));
+        watch(listen_, EPOLLIN);
+        watch(notify_, EPOLLIN);
+        watch(jobs_, EPOLLIN);
+    }
+
+    ~Server() {
+        for (auto& [fd, c] : conns_) ::close(fd);
+        ::close(listen_);
+        ::close(notify_);
+        ::close(jobs_);
+        ::close(epoll_);
+    }
+
+    int run() {
+        Collector collector(cfg_, snapshots_, events_, notify_, ws_clients_, history_);
+        std::thread thread([&] { collector.run(); });
+        log_info("cpp_monitor", "dashboard on http://" + cfg_.bind + ":" + std::to_string(cfg_.port) + "/");
+        epoll_event events[64];
+        while (!g_stop) {
+            const int n = epoll_wait(epoll_, events, 64, 500);
+            if (n < 0 && errno != EINTR) break;
+            for (int i = 0; i < n; ++i) {
+                const int fd = events[i].data.fd;
+                if (fd == listen_) accept_all();
+                else if (fd == notify_) broadcast();
+                else if (fd == jobs_) finish_jobs();
+                else handle(fd, events[i].events);
+            }
+        }
+        g_stop = 1;
+        thread.join();
+        if (profile_thread_.joinable()) profile_thread_.join();
+        return 0;
+    }
+
+private:
+    struct Conn {
+        std::string in;
+        std::string out;
+        bool websocket = false;
+        bool loopback = false;  // peer is on this host
+        bool synced = false;   // websocket got a full snapshot and can take deltas
+        bool closing = false;  // close once `out` is flushed
+        bool writable_watch = false;
+        uint64_t job = 0;      // response produced by a background job
+    };
+
+    void watch(int fd, uint32_t events) {
+        epoll_event ev{};
+        ev.events = events;
+        ev.data.fd = fd;
+        epoll_ctl(epoll_, EPOLL_CTL_ADD, fd, &ev);
+    }
+
+    void accept_all() {
+        for (;;) {
+            sockaddr_in peer{};
+            socklen_t len = sizeof(peer);
+            const int fd = ::accept4(listen_, reinterpret_cast<sockaddr*>(&peer), &len, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0) return;
+            Conn c;
+            c.loopback = (ntohl(peer.sin_addr.s_addr) >> 24) == 127;
+            conns_[fd] = std::move(c);
+            watch(fd, EPOLLIN);
+        }
+    }
+
+    void close_conn(int fd) {
+        auto it = conns_.find(fd);
+        if (it == conns_.end()) return;
+        if (it->second.websocket) ws_clients_.fetch_sub(1, std::memory_order_relaxed);
+        if (it->second.job) waiting_.erase(it->second.job);
+        epoll_ctl(epoll_, EPOLL_CTL_DEL, fd, nullptr);
+        ::close(fd);
+        conns_.erase(it);
+    }
+
+    void handle(int fd, uint32_t events) {
+        auto it = conns_.find(fd);
+        if (it == conns_.end()) return;
+        Conn& c = it->second;
+        if (events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+            char buf[8192];
+            for (;;) {
+                const ssize_t r = ::read(fd, buf, sizeof(buf));
+                if (r > 0) {
+                    c.in.append(buf, static_cast<size_t>(r));
+                    continue;
+                }
+                if (r == 0 || (errno != EAGAIN && errno != EINTR)) {
+                    close_conn(fd);
+                    return;
+                }
+                break;
+            }
+            if (c.websocket) read_frames(c);
+            else serve(fd, c);
+        }
+        flush(fd);
+    }
+
+    void read_frames(Conn& c) {
+        http::Frame f;
+        for (long used; (used = http::parse_frame(c.in, f)) != 0;) {
+            if (used < 0) {
+                c.closing = true;
+                return;
+            }
+            c.in.erase(0, static_cast<size_t>(used));
+            if (f.op == http::Opcode::Ping) http::append_frame(c.out, http::Opcode::Pong, f.payload);
+            if (f.op == http::Opcode::Close) {
+                http::append_frame(c.out, http::Opcode::Close, "");
+                c.closing = true;
+            }
+        }
+    }
+
+    void serve(int fd, Conn& c) {
+        http::Request req;
+        const long used = http::parse_request(c.in, req);
+        if (used == 0) return;
+        c.closing = true;
+        if (used < 0) {
+            c.out = http::response(400, "text/plain", "bad request\n");
+            return;
+        }
+        c.in.erase(0, static_cast<size_t>(used));
+        // Flight records carry message contents, a dump writes files and a
+        // profile makes every stage take signals for minutes, so only local
+        // clients get them unless remote_debug is set.
+        if (req.path == "/api/flight" || req.path == "/api/flight/dump" || req.path == "/debug/profile") {
+            if (!c.loopback && !cfg_.remote_debug) {
+                c.out = http::response(403, "text/plain", "only served to localhost (set remote_debug)\n");
+                return;
+            }
+        }
+        if (req.path == "/api/flight/dump") {
+            c.out = req.method == "POST" ? flight(req, true) : http::response(405, "text/plain", "use POST\n");
+            return;
+        }
+        if (req.method != "GET") {
+            c.out = http::response(405, "text/plain", "only GET is supported\n");
+            return;
+        }
+        if (req.path == "/ws") {
+            if (!http::is_websocket_upgrade(req)) {
+                c.out = http::response(400, "text/plain", "WebSocket upgrade required\n");
+                return;
+            }
+            c.out = http::websocket_accept(req);
+            c.websocket = true;
+            c.closing = false;
+            ws_clients_.fetch_add(1, std::memory_order_relaxed);
+            // Before the first sample the client gets its snapshot from the
+            // next broadcast instead of a delta it has nothing to apply to.
+            auto snap = snapshots_.read();
+            if (snap->seq && snap->seq == sent_seq_) {
+                http::append_frame(c.out, http::Opcode::Text, snap->full);
+                c.synced = true;
+            }
+            return;
+        }
+        auto snap = snapshots_.read();
+        auto json_response = [&](const std::string& body) {
+            c.out = http::response(200, "application/json", body.empty() ? "{}" : body);
+        };
+        if (req.path == "/health") json_response(snap->health);
+        else if (req.path == "/api/routes/status") json_response(snap->routes);
+        else if (req.path == "/api/metrics") json_response(snap->metrics);
+        else if (req.path == "/api/snapshot") json_response(snap->state);
+        else if (req.path == "/metrics")
+            c.out = http::response(200, "text/plain; version=0.0.4", snap->prometheus);
+        else if (req.path == "/api/alerts/recent") json_response(snap->alerts);
+        else if (req.path == "/api/metrics/history") c.out = query_history(req);
+        else if (req.path == "/api/flight") c.out = flight(req, false);
+        else if (req.path == "/debug/profile") profile(fd, c, req);
+        else serve_file(c, req.path);
+    }
+
+    // Profiles every live stage of `route` (or one `stage`) over the same
+    // window on a background thread; one profile runs at a time. Stacks are
+    // prefixed with route, stage and pid so one flame graph shows where the
+    // whole node spends its CPU.
+    void profile(int fd, Conn& c, const http::Request& req) {
+        const double seconds = std::strtod(req.param("seconds", "30").c_str(), nullptr);
+        const int hz = std::atoi(req.param("hz", "99").c_str());
+        const std::string format = req.param("format", "svg");
+        if (!(seconds >= 1 && seconds <= 300) || hz < 1 || hz > 1000 || (format != "svg" && format != "folded")) {
+            c.out = http::response(400, "text/plain", "need 1 <= seconds <= 300, 1 <= hz <= 1000, format svg or folded\n");
+            return;
+        }
+        if (profiling_.exchange(true)) {
+            c.out = http::response(409, "text/plain", "a profile is already running\n");
+            return;
+        }
+        if (profile_thread_.joinable()) profile_thread_.join();
+        const std::string route = req.param("route"), stage = req.param("stage");
+        std::vector<StageSample> targets;
+        for (StageSample& s : sample_stages())
+            if (s.alive && (route.empty() || s.route == route) && (stage.empty() || s.stage == stage))
+                targets.push_back(std::move(s));
+        const uint64_t job = ++next_job_;
+        c.job = job;
+        c.closing = false;  // answered by finish_jobs()
+        waiting_[job] = fd;
+        profile_thread_ = std::thread([this, job, seconds, hz, format, targets = std::move(targets)] {
+            std::vector<std::string> folded(targets.size());
+            std::vector<std::thread> workers;
+            for (size_t i = 0; i < targets.size(); ++i) {
+                workers.emplace_back([&, i] {
+                    try {
+                        folded[i] = request_profile(targets[i].pid, seconds, hz);
+                    } catch (const std::exception& e) {
+                        log_error("cpp_monitor", "profile of pid " + std::to_string(targets[i].pid) + ": " + e.what());
+                    }
+                });
+            }
+            for (std::thread& w : workers) w.join();
+            std::string merged;
+            for (size_t i = 0; i < targets.size(); ++i) {
+                const std::string prefix = targets[i].route + ";" + targets[i].stage + ":" + std::to_string(targets[i].pid) + ";";
+                for (size_t pos = 0; pos < folded[i].size();) {
+                    const size_t nl = std::min(folded[i].find('\n', pos), folded[i].size());
+                    merged += prefix;
+                    merged.append(folded[i], pos, nl - pos);
+                    merged += '\n';
+                    pos = nl + 1;
+                }
+            }
+            std::string response =
+                format == "folded"
+                    ? http::response(200, "text/plain", merged)
+                    : http::response(200, "image/svg+xml",
+                                     render_flamegraph(merged, "CPU profile, " + std::to_string(static_cast<int>(seconds)) +
+                                                                   " s, " + std::to_string(targets.size()) + " stage(s)"));
+            {
+                std::lock_guard<std::mutex> lock(jobs_mu_);
+                done_jobs_.emplace_back(job, std::move(response));
+            }
+            profiling_.store(false);
+            const uint64_t one = 1;
+            (void)!::write(jobs_, &one, sizeof(one));
+        });
+    }
+
+    void finish_jobs() {
+        uint64_t count;
+        while (::read(jobs_, &count, sizeof(count)) > 0) {
+        }
+        std::vector<std::pair<uint64_t, std::string>> done;
+        {
+            std::lock_guard<std::mutex> lock(jobs_mu_);
+            done.swap(done_jobs_);
+        }
+        for (auto& [job, response] : done) {
+            auto it = waiting_.find(job);
+            if (it == waiting_.end()) continue;  // client went away
+            const int fd = it->second;
+            waiting_.erase(it);
+            Conn& c = conns_.at(fd);
+            c.job = 0;
+            c.out = std::move(response);
+            c.closing = true;
+            flush(fd);
+        }
+    }
+
+
+    // Flight recorder rings of the stages in `route` (all routes if empty),
+    // optionally one `stage`: returned as JSON, or written to `logs`.
+    std::string flight(const http::Request& req, bool dump) {
+        const std::string route = req.param("route"), stage = req.param("stage");
+        json::Value files = json::Value::array();
+        std::string body = "{\"stages\":[";
+        bool first = true;
+        for (const std::string& shm : list_flight_blocks()) {
+            FlightSnapshot snap;
+            try {
+                snap = read_flight(shm);
+            } catch (const std::exception&) {
+                continue;
+            }
+            if ((!route.empty() && snap.route != route) || (!stage.empty() && snap.stage != stage)) continue;
+            if (dump) {
+                const std::string path = write_flight_dump(snap, "request", cfg_.logs);
+                if (path.empty()) return http::response(500, "text/plain", "cannot write to " + cfg_.logs + "\n");
+                files.push_back(path);
+                continue;
+            }
+            if (!first) body += ',';
+            first = false;
+            body += "{\"route\":";
+            json::detail::dump_string(body, snap.route);
+            body += ",\"stage\":";
+            json::detail::dump_string(body, snap.stage);
+            body += ",\"pid\":" + std::to_string(snap.pid) + ",\"alive\":" + (snap.alive ? "true" : "false") +
+                    ",\"records\":[";
+            for (size_t i = 0; i < snap.records.size(); ++i) {
+                if (i) body += ',';
+                append_flight_record(body, snap.records[i]);
+            }
+            body += "]}";
+        }
+        if (dump) {
+            json::Value out = json::Value::object();
+            out["files"] = std::move(files);
+            return http::response(200, "application/json", out.dump());
+        }
+        body += "]}";
+        return http::response(200, "application/json", body);
+    }
+
+    // Without `series`, lists the stored series. `from` and `to` are unix
+    // seconds, or seconds relative to now when <= 0; `step` defaults to
+    // about 500 points over the range.
+    std::string query_history(const http::Request& req) {
+        const auto now = static_cast<int64_t>(unix_ms_now() / 1000);
+        auto when = [&](const char* key, int64_t def) {
+            const std::string v = req.param(key);
+            if (v.empty()) return def;
+            const auto t = static_cast<int64_t>(std::strtoll(v.c_str(), nullptr, 10));
+            return t <= 0 ? now + t : t;
+        };
+        const int64_t from = when("from", now - 3600), to = when("to", now);
+        if (to < from) return http::response(400, "text/plain", "from must not be after to\n");
+        const int64_t step = std::max<int64_t>(std::strtoll(req.param("step", "0").c_str(), nullptr, 10), (to - from) / 500);
+        json::Value out = json::Value::object();
+        std::lock_guard<std::mutex> lock(history_.mu);
+        const std::string wanted = req.param("series");
+        if (wanted.empty()) {
+            json::Value names = json::Value::array();
+            for (const std::string& n : history_.db.names()) names.push_back(n);
+            out["series"] = std::move(names);
+            out["bytes"] = history_.db.bytes();
+            out["rejected"] = history_.db.rejected();
+            return http::response(200, "application/json", out.dump());
+        }
+        out["from"] = from;
+        out["to"] = to;
+        out["step"] = step;
+        json::Value& series = out["series"];
+        series = json::Value::object();
+        for (size_t pos = 0; pos <= wanted.size();) {
+            const size_t comma = std::min(wanted.find(',', pos), wanted.size());
+            const std::string name = wanted.substr(pos, comma - pos);
+            pos = comma + 1;
+            const TimeSeries* ts = history_.db.find(name);
+            if (name.empty() || !ts) continue;
+            json::Value points = json::Value::array();
+            for (const TsPoint& p : ts->query(from, to, step)) {
+                json::Value pt = json::Value::array();
+                pt.push_back(p.t);
+                pt.push_back(p.v);
+                points.push_back(std::move(pt));
+            }
+            series[name] = std::move(points);
+        }
+        return http::response(200, "application/json", out.dump());
+    }
+
+    void serve_file(Conn& c, std::string path) {
+        if (path.find("..") != std::string::npos) {
+            c.out = http::response(404, "text/plain", "not found\n");
+            return;
+        }
+        if (path.empty() || path.back() == '/') path += "index.html";
+        std::ifstream in(cfg_.root + path, std::ios::binary);
+        if (!in) {
+            c.out = http::response(404, "text/plain", "not found\n");
+            return;
+        }
+        std::ostringstream ss;
+        ss << in.rdbuf();
+        c.out = http::response(200, http::content_type_for(path), ss.str());
+    }
+
+    // Sends the newest sample and any new events to every WebSocket client,
+    // encoded once: the delta to clients that have the previous sample, the
+    // full snapshot to the rest.
+    void broadcast() {
+        uint64_t count;
+        while (::read(notify_, &count, sizeof(count)) > 0) {
+        }
+        auto snap = snapshots_.read();
+        std::string events;
+        {
+            std::lock_guard<std::mutex> lock(events_.mu);
+            for (const auto& [seq, e] : events_.events)
+                if (seq > sent_event_seq_) http::append_frame(events, http::Opcode::Text, e);
+            sent_event_seq_ = events_.seq;
+        }
+        const bool fresh = snap->seq != sent_seq_;
+        if (!fresh && events.empty()) return;
+        // A client only understands a delta against the sample it has.
+        const bool incremental = snap->seq == sent_seq_ + 1;
+        frame_.clear();
+        full_frame_.clear();
+        if (fresh) {
+            if (incremental) http::append_frame(frame_, http::Opcode::Text, snap->delta);
+            http::append_frame(full_frame_, http::Opcode::Text, snap->full);
+            if (!incremental) frame_ = full_frame_;
+        }
+        frame_ += events;
+        full_frame_ += events;
+        sent_seq_ = snap->seq;
+        std::vector<int> fds;
+        for (auto& [fd, c] : conns_) {
+            if (!c.websocket || c.closing) continue;
+            if (c.out.size() > cfg_.max_client_buffer) {
+                c.closing = true;  // the client stopped reading
+                c.out.clear();
+            } else if (fresh && !c.synced) {
+                c.out += full_frame_;
+                c.synced = true;
+            } else {
+                c.out += frame_;
+            }
+            fds.push_back(fd);
+        }
+        for (int fd : fds) flush(fd);
+    }
+
+    void flush(int fd) {
+        auto it = conns_.find(fd);
+        if (it == conns_.end()) return;
+        Conn& c = it->second;
+        while (!c.out.empty()) {
+            const ssize_t w = ::send(fd, c.out.data(), c.out.size(), MSG_NOSIGNAL);
+            if (w > 0) {
+                c.out.erase(0, static_cast<size_t>(w));
+                continue;
+            }
+            if (w < 0 && (errno == EAGAIN || errno == EINTR)) break;
+            close_conn(fd);
+            return;
+        }
+        if (c.out.empty() && c.closing) {
+            close_conn(fd);
+            return;
+        }
+        const bool want = !c.out.empty();
+        if (want != c.writable_watch) {
+            epoll_event ev{};
+            ev.events = EPOLLIN | (want ? static_cast<uint32_t>(EPOLLOUT) : 0u);
+            ev.data.fd = fd;
+            epoll_ctl(epoll_, EPOLL_CTL_MOD, fd, &ev);
+            c.writable_watch = want;
+        }
+    }
+
+    MonitorConfig cfg_;
+    int epoll_ = -1, notify_ = -1, jobs_ = -1, listen_ = -1;
+    std::map<int, Conn> conns_;
+    DoubleBuffer<Published> snapshots_;
+    EventQueue events_;
+    std::atomic<int> ws_clients_{0};
+    History history_;
+    uint64_t sent_seq_ = 0;
+    uint64_t sent_event_seq_ = 0;
+    std::string frame_;
+    std::string full_frame_;
+    std::atomic<bool> profiling_{false};
+    std::thread profile_thread_;
+    uint64_t next_job_ = 0;
+    std::map<uint64_t, int> waiting_;  // job -> connection fd
+    std::mutex jobs_mu_;
+    std::vector<std::pair<uint64_t, std::string>> done_jobs_;
+};
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    signal(SIGPIPE, SIG_IGN);
+    signal(SIGTERM, [](int) { g_stop = 1; });
+    signal(SIGINT, [](int) { g_stop = 1; });
+    try {
+        ProcessorOptions opts = parse_options(argc, argv, "cpp_monitor");
+        Server server(MonitorConfig::from_json(opts.config));
+        return server.run();
+    } catch (const std::exception& e) {
+        log_error("cpp_monitor", e.what());
+        return 1;
+    }
+}
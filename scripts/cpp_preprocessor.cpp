@@ -0,0 +1,196 @@
+// Detector input preprocessing stage.
+//
+// Reads a decoded frame (BGR, I420 or NV12) referenced by the message,
+// letterboxes it into an NCHW tensor in a shared memory slot ring and adds a
+// "tensor" reference to the message for the detector to map. With
+// `tiling`, the frame is cut into overlapping tiles that go into the slot as
+// one batch (see cpp/tiling.hpp). With `roi` zones, only their bounding
+// crop is processed (see cpp/roi.hpp). With `quality`, exposure, blur and
+// motion are measured on the luma plane first, and unusable frames are
+// tagged or dropped before any conversion (see cpp/luma.hpp).
+//
+// Route usage:
+//   - type: "external"
+//     command: "./bin/cpp_preprocessor"
+//     config:
+//       input_size: 640
+//       tensor_type: "float32"      # float32 | int8 | uint8
+//       output_shm: "/camel_tensor_front_door"
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "cpp/frame.hpp"
+#include "cpp/json.hpp"
+#include "cpp/luma.hpp"
+#include "cpp/preprocess.hpp"
+#include "cpp/processor.hpp"
+#include "cpp/roi.hpp"
+#include "cpp/shm.hpp"
+#include "cpp/tiling.hpp"
+
+using namespace camel;
+
+namespace {
+
+struct PreprocessorConfig {
+    LetterboxOptions letterbox;
+    std::string output_shm = "/camel_tensor";
+    uint32_t slots = 4;
+    uint32_t max_batch = 1;
+    bool tiled = false;
+    TilingOptions tiling;
+    std::vector<Region> regions;
+    std::vector<Zone> zones;
+    RoiAnchor roi_anchor = RoiAnchor::BottomCenter;
+    float roi_margin = 0.05f;
+    bool quality = false;
+    QualityOptions quality_options;
+
+    static PreprocessorConfig from_json(const json::Value& c) {
+        PreprocessorConfig cfg;
+        const json::Value& size = c["input_size"];
+        if (size.is_array() && size.size() == 2) {
+            cfg.letterbox.width = static_cast<int>(size[0].as_number());
+            cfg.letterbox.height = static_cast<int>(size[1].as_number());
+        } else if (size.is_number()) {
+            cfg.letterbox.width = cfg.letterbox.height = static_cast<int>(size.as_number());
+        }
+        if (cfg.letterbox.width <= 0 || cfg.letterbox.height <= 0) throw std::runtime_error("invalid input_size");
+        cfg.letterbox.type = parse_tensor_type(c.string_or("tensor_type", "float32"));
+        cfg.letterbox.pad_value = static_cast<uint8_t>(c.number_or("pad_value", 114));
+        cfg.letterbox.quant = default_quant(cfg.letterbox.type);
+        cfg.letterbox.quant.scale = static_cast<float>(c.number_or("quant_scale", cfg.letterbox.quant.scale));
+        cfg.letterbox.quant.zero_point = static_cast<int>(c.number_or("quant_zero_point", cfg.letterbox.quant.zero_point));
+        if (cfg.letterbox.quant.scale <= 0.0f) throw std::runtime_error("quant_scale must be positive");
+        cfg.output_shm = c.string_or("output_shm", cfg.output_shm);
+        cfg.slots = static_cast<uint32_t>(c.number_or("slots", cfg.slots));
+        cfg.tiled = c["tiling"].is_object();
+        if (cfg.tiled) cfg.tiling = TilingOptions::from_json(c["tiling"], cfg.letterbox.width, cfg.letterbox.height);
+        cfg.regions = parse_regions(c["regions_of_interest"]);
+        cfg.zones = parse_zones(c["roi"]);
+        cfg.roi_anchor = parse_roi_anchor(c.string_or("roi_anchor", "bottom_center"));
+        cfg.roi_margin = static_cast<float>(c.number_or("roi_margin", cfg.roi_margin));
+        cfg.quality = c["quality"].is_object();
+        if (cfg.quality) cfg.quality_options = QualityOptions::from_json(c["quality"]);
+        cfg.max_batch = static_cast<uint32_t>(c.number_or("max_batch", cfg.tiled ? 16 : cfg.max_batch));
+        if (cfg.slots == 0 || cfg.max_batch == 0) throw std::runtime_error("slots and max_batch must be positive");
+        return cfg;
+    }
+
+    size_t item_bytes() const {
+        return static_cast<size_t>(letterbox.width) * letterbox.height * 3 * tensor_element_size(letterbox.type);
+    }
+};
+
+class Preprocessor {
+public:
+    explicit Preprocessor(const PreprocessorConfig& cfg)
+        : cfg_(cfg),
+          ring_(SlotRing::create(cfg.output_shm, cfg.slots, cfg.item_bytes() * cfg.max_batch)) {}
+
+    bool handle(json::Value& message) {
+        const json::Value& ref = message.get("frame");
+        FrameView frame = frames_.resolve(ref);
+        const Geometry& g = geometry(frame.width, frame.height);
+        if (cfg_.quality) {
+            LumaAnalyzer& quality = quality_for(message, ref);
+            FrameQuality q = quality.analyze(frame, g.area);
+            message["quality"] = q.to_json();
+            if (quality.should_drop(q)) return false;
+        }
+        std::vector<Rect> crops = {g.area};
+        if (cfg_.tiled) {
+            crops = plan_tiles(g.area, cfg_.tiling, g.rois);
+            if (crops.empty()) return false;
+            if (crops.size() > cfg_.max_batch)
+                throw std::runtime_error("frame needs " + std::to_string(crops.size()) + " tiles but max_batch is " +
+                                         std::to_string(cfg_.max_batch));
+        }
+
+        SlotRing::WriteSlot slot = ring_.begin_write();
+        json::Value transforms = json::Value::array();
+        for (size_t i = 0; i < crops.size(); ++i) {
+            LetterboxTransform t = letterbox_.run(frame, crops[i], cfg_.letterbox, slot.data + i * cfg_.item_bytes());
+            transforms.push_back(t.to_json());
+        }
+        if (!frames_.still_valid(ref)) throw std::runtime_error("source frame was overwritten during preprocessing");
+        ring_.end_write(slot, cfg_.item_bytes() * crops.size());
+
+        message["tensor"] = tensor_reference(slot, static_cast<int>(crops.size()), std::move(transforms));
+        if (cfg_.tiled) message["tensor"]["tiles"] = rects_to_json(crops);
+        if (!g.roi.empty()) message["tensor"]["roi"] = g.roi_json;
+        return true;
+    }
+
+private:
+    // Per-resolution crop and zone geometry, rebuilt when the stream changes.
+    struct Geometry {
+        int width = 0, height = 0;
+        Rect area;
+        std::vector<Rect> rois;
+        RoiFilter roi;
+        json::Value roi_json;
+    };
+
+    const Geometry& geometry(int width, int height) {
+        if (geometry_.width == width && geometry_.height == height) return geometry_;
+        Geometry g;
+        g.width = width;
+        g.height = height;
+        g.roi.zones = zones_to_pixels(cfg_.zones, width, height);
+        g.roi.anchor = cfg_.roi_anchor;
+        g.roi_json = g.roi.to_json();
+        g.area = zones_crop(g.roi.zones, width, height, cfg_.roi_margin);
+        for (const auto& r : cfg_.regions) g.rois.push_back(r.to_pixels(width, height));
+        for (const auto& z : g.roi.zones) g.rois.push_back(zones_crop({z}, width, height, cfg_.roi_margin));
+        geometry_ = std::move(g);
+        return geometry_;
+    }
+
+    // Motion compares against the previous frame of the same stream, so
+    // each camera (or, without a `camera` field, each frame ring) keeps its
+    // own analyzer.
+    LumaAnalyzer& quality_for(const json::Value& message, const json::Value& ref) {
+        std::string key = message.string_or("camera", "");
+        if (key.empty()) key = ref.string_or("shm", "");
+        auto it = quality_.find(key);
+        if (it == quality_.end()) it = quality_.emplace(key, LumaAnalyzer(cfg_.quality_options)).first;
+        return it->second;
+    }
+
+    json::Value tensor_reference(const SlotRing::WriteSlot& slot, int batch, json::Value transforms) const {
+        json::Value ref = json::Value::object();
+        ref["shm"] = ring_.name();
+        ref["slot"] = slot.index;
+        ref["sequence"] = slot.sequence;
+        ref["dtype"] = tensor_type_name(cfg_.letterbox.type);
+        json::Value shape = json::Value::array();
+        for (int d : {batch, 3, cfg_.letterbox.height, cfg_.letterbox.width}) shape.push_back(d);
+        ref["shape"] = std::move(shape);
+        if (cfg_.letterbox.type != TensorType::Float32) {
+            ref["quant_scale"] = cfg_.letterbox.quant.scale;
+            ref["quant_zero_point"] = cfg_.letterbox.quant.zero_point;
+        }
+        ref["transforms"] = std::move(transforms);
+        return ref;
+    }
+
+    PreprocessorConfig cfg_;
+    SlotRing ring_;
+    FrameStore frames_;
+    Letterboxer letterbox_;
+    std::map<std::string, LumaAnalyzer> quality_;
+    Geometry geometry_;
+};
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    return processor_main(argc, argv, "cpp_preprocessor", [](const ProcessorOptions& opts) -> MessageHandler {
+        auto pre = std::make_shared<Preprocessor>(PreprocessorConfig::from_json(opts.config));
+        return [pre](json::Value& message) { return pre->handle(message); };
+    });
+}
@@ -0,0 +1,123 @@
+// Privacy masking: blurs or pixelates every detection of the configured
+// classes in place in the shared-memory frame, before anything downstream
+// (snapshots, annotated streams, http/email sinks) can read it.
+//
+// Detections come from cpp_detector / cpp_postprocessor ("bbox" in frame
+// pixels, "class"). Masking is a separable running-sum box blur or block
+// mean on the Y/U/V planes (or B/G/R channels) and stays well under a millisecond for typical
+// 1080p frames, so it can run on every forwarded frame.
+//
+// Route usage (directly after detection, before any stage that reads pixels):
+//   - type: "external"
+//     command: "./bin/cpp_privacy_mask"
+//     config:
+//       classes: ["person", "face"]
+//       mode: "blur"
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "cpp/frame.hpp"
+#include "cpp/json.hpp"
+#include "cpp/mask.hpp"
+#include "cpp/processor.hpp"
+
+using namespace camel;
+
+namespace {
+
+struct PrivacyMaskConfig {
+    std::set<std::string> classes = {"person", "face"};  // empty or ["*"] = every detection
+    MaskOptions mask;
+    double padding = 0.1;  // fraction of the box size added on each side
+    double min_confidence = 0.0;
+
+    static PrivacyMaskConfig from_json(const json::Value& c) {
+        PrivacyMaskConfig cfg;
+        const json::Value& classes = c.get("classes");
+        if (classes.is_array()) {
+            cfg.classes.clear();
+            for (const auto& v : classes.as_array()) cfg.classes.insert(v.as_string());
+            if (cfg.classes.count("*")) cfg.classes.clear();
+        }
+        cfg.mask.mode = parse_mask_mode(c.string_or("mode", "blur"));
+        cfg.mask.radius = static_cast<int>(c.number_or("blur_radius", cfg.mask.radius));
+        cfg.mask.block = static_cast<int>(c.number_or("block_size", cfg.mask.block));
+        cfg.mask.strength = static_cast<float>(c.number_or("strength", cfg.mask.strength));
+        cfg.mask.passes = static_cast<int>(c.number_or("passes", cfg.mask.passes));
+        cfg.padding = c.number_or("padding", cfg.padding);
+        cfg.min_confidence = c.number_or("min_confidence", cfg.min_confidence);
+        if (cfg.mask.passes < 1 || cfg.mask.passes > 4) throw std::runtime_error("passes must be in 1..4");
+        if (cfg.mask.radius > MaskOptions::kMaxRadius) throw std::runtime_error("blur_radius must be <= 63");
+        if (cfg.mask.block > MaskOptions::kMaxBlock) throw std::runtime_error("block_size must be <= 128");
+        if (cfg.padding < 0.0) throw std::runtime_error("padding must be >= 0");
+        return cfg;
+    }
+};
+
+class PrivacyMask {
+public:
+    PrivacyMask(PrivacyMaskConfig cfg, std::string name) : cfg_(std::move(cfg)), name_(std::move(name)), frames_(true) {}
+
+    // Fails closed: a frame that could not be masked is dropped, never
+    // forwarded with an error for a sink to publish unmasked.
+    bool handle(json::Value& message) {
+        try {
+            return mask(message);
+        } catch (const std::exception& e) {
+            log_error(name_, std::string("dropping unmasked frame: ") + e.what());
+            return false;
+        }
+    }
+
+private:
+    bool mask(json::Value& message) {
+        int masked = 0;
+        if (message.get("detections").is_array() && message.get("detections").size() > 0) {
+            json::Value& list = message["detections"];
+            const json::Value& ref = message.get("frame");
+            FrameView frame = frames_.resolve(ref);
+            for (size_t i = 0; i < list.size(); ++i) {
+                json::Value& d = list[i];
+                if (!selected(d)) continue;
+                const json::Value& b = d.get("bbox");
+                if (!b.is_array() || b.size() != 4) continue;
+                double x1 = b[0].as_number(), y1 = b[1].as_number(), x2 = b[2].as_number(), y2 = b[3].as_number();
+                double px = (x2 - x1) * cfg_.padding, py = (y2 - y1) * cfg_.padding;
+                int rx = static_cast<int>(std::floor(x1 - px)), ry = static_cast<int>(std::floor(y1 - py));
+                Rect r{rx, ry, static_cast<int>(std::ceil(x2 + px)) - rx, static_cast<int>(std::ceil(y2 + py)) - ry};
+                if (r.w <= 0 || r.h <= 0) continue;
+                mask_region(frame, r, cfg_.mask);
+                d["masked"] = true;
+                ++masked;
+            }
+            // Masking raced with the ring wrapping around: the pixels that
+            // leave the node would be unmasked. handle() drops the message.
+            if (masked > 0 && !frames_.still_valid(ref)) throw std::runtime_error("frame slot was overwritten while masking");
+        }
+        message["privacy_masked"] = masked;
+        return true;
+    }
+
+    bool selected(const json::Value& d) const {
+        if (d.number_or("confidence", 1.0) < cfg_.min_confidence) return false;
+        return cfg_.classes.empty() || cfg_.classes.count(d.string_or("class", "")) > 0;
+    }
+
+    PrivacyMaskConfig cfg_;
+    std::string name_;
+    FrameStore frames_;
+};
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    return processor_main(argc, argv, "cpp_privacy_mask", [](const ProcessorOptions& opts) -> MessageHandler {
+        auto mask = std::make_shared<PrivacyMask>(PrivacyMaskConfig::from_json(opts.config), opts.name);
+        return [mask](json::Value& message) { return mask->handle(message); };
+    });
+}
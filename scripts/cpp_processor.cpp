@@ -0,0 +1,318 @@
+// Native detection postprocessor.
+//
+// Modes, selected with `algorithm`:
+//   fast_nms     suppress duplicate boxes in an existing `detections` list
+//   yolo_decode  decode a raw YOLOv8 output head ([batch, 4 + classes,
+//                anchors] float32) into detections, for routes where the
+//                model runs in another stage or on another box
+//   tile_merge   join detections of a tiled frame across tile seams
+//   group_dedupe merge detections of the same object seen by several
+//                cameras in a cpp_frame_sync tuple
+//
+// Route usage:
+//   - type: "external"
+//     command: "./bin/cpp_postprocessor"
+//     config:
+//       algorithm: "yolo_decode"
+//       confidence_threshold: 0.5
+//       target_objects: ["person"]
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "cpp/json.hpp"
+#include "cpp/multicam.hpp"
+#include "cpp/nms.hpp"
+#include "cpp/preprocess.hpp"
+#include "cpp/processor.hpp"
+#include "cpp/roi.hpp"
+#include "cpp/shm.hpp"
+#include "cpp/tiling.hpp"
+#include "cpp/yolo.hpp"
+#include "cpp/yolo_decode.hpp"
+
+using namespace camel;
+
+namespace {
+
+struct PostprocessorConfig {
+    std::string algorithm = "fast_nms";
+    float confidence_threshold = 0.5f;
+    NmsOptions nms;
+    TileMergeOptions merge;
+    GroundCalibration ground;
+    double match_distance = 0.5;
+
+    static PostprocessorConfig from_json(const json::Value& c) {
+        PostprocessorConfig cfg;
+        cfg.algorithm = c.string_or("algorithm", cfg.algorithm);
+        if (cfg.algorithm != "fast_nms" && cfg.algorithm != "yolo_decode" && cfg.algorithm != "tile_merge" &&
+            cfg.algorithm != "group_dedupe")
+            throw std::runtime_error("unknown algorithm '" + cfg.algorithm + "'");
+        // `threshold` is the older spelling used by fast_nms routes.
+        cfg.confidence_threshold = static_cast<float>(
+            c.number_or("confidence_threshold",
+                        c.number_or("threshold", cfg.algorithm == "fast_nms" ? 0.0 : cfg.confidence_threshold)));
+        cfg.nms.iou_threshold = static_cast<float>(c.number_or("iou_threshold", cfg.nms.iou_threshold));
+        cfg.nms.class_aware = !c.bool_or("class_agnostic", false);
+        cfg.nms.max_detections = static_cast<size_t>(c.number_or("max_detections", 300));
+        cfg.merge = TileMergeOptions::from_json(c);
+        cfg.ground = GroundCalibration::from_json(c["ground_points"]);
+        cfg.match_distance = c.number_or("match_distance", cfg.match_distance);
+        return cfg;
+    }
+};
+
+// Summary fields in the shape written by write_detections() (yolo.hpp), for
+// detection objects that are forwarded as-is.
+void write_summary(json::Value& message, const json::Value& list) {
+    message["detection_count"] = list.size();
+    if (list.size() == 0) return;
+    const json::Value& top = list[0];
+    message["object_type"] = top["class"];
+    message["confidence"] = top["confidence"];
+    const json::Value& b = top["bbox"];
+    if (b.is_array() && b.size() == 4) {
+        json::Value pos = json::Value::object();
+        pos["x"] = std::round(0.5 * (b[0].as_number() + b[2].as_number()));
+        pos["y"] = std::round(0.5 * (b[1].as_number() + b[3].as_number()));
+        message["position"] = std::move(pos);
+    }
+}
+
+class Postprocessor {
+public:
+    Postprocessor(const PostprocessorConfig& cfg, const json::Value& raw)
+        : cfg_(cfg), names_(raw["class_names"]), targets_(raw["target_objects"]) {}
+
+    bool handle(json::Value& message, std::string& payload) {
+        if (cfg_.algorithm == "fast_nms")
+            fast_nms(message);
+        else if (cfg_.algorithm == "tile_merge")
+            tile_merge(message);
+        else if (cfg_.algorithm == "group_dedupe")
+            group_dedupe(message);
+        else
+            yolo_decode(message, payload);
+        return true;
+    }
+
+private:
+    // Detections above the confidence threshold, with pointers back to
+    // their JSON objects so extra fields from earlier stages survive.
+    struct ParsedDetections {
+        std::vector<Detection> dets;
+        std::vector<const json::Value*> source;
+    };
+
+    ParsedDetections parse_detections(const json::Value& message) const {
+        const json::Value& list = message.get("detections");
+        if (!list.is_array()) throw std::runtime_error("message has no detections list");
+        ParsedDetections p;
+        std::map<std::string, int> class_ids;
+        for (const auto& d : list.as_array()) {
+            const json::Value& b = d["bbox"];
+            if (!b.is_array() || b.size() != 4) throw std::runtime_error("detection without a 4-element bbox");
+            float score = static_cast<float>(d.number_or("confidence", 0.0));
+            if (score < cfg_.confidence_threshold) continue;
+            Box box{static_cast<float>(b[0].as_number()), static_cast<float>(b[1].as_number()),
+                    static_cast<float>(b[2].as_number()), static_cast<float>(b[3].as_number())};
+            auto cls = class_ids.emplace(d.string_or("class", ""), static_cast<int>(class_ids.size())).first;
+            p.dets.push_back({box, score, cls->second});
+            p.source.push_back(&d);
+        }
+        return p;
+    }
+
+    void fast_nms(json::Value& message) {
+        ParsedDetections p = parse_detections(message);
+        json::Value kept = json::Value::array();
+        for (uint32_t i : nms_indices(p.dets, cfg_.nms)) kept.push_back(*p.source[i]);
+        write_summary(message, kept);
+        message["detections"] = std::move(kept);
+    }
+
+    // Detections tagged with "tile" (batch item) plus the tile rectangles in
+    // tensor.tiles, as written by cpp_preprocessor and cpp_detector.
+    void tile_merge(json::Value& message) {
+        const json::Value& tiles_json = message.get("tensor")["tiles"];
+        if (!tiles_json.is_array()) throw std::runtime_error("message has no tensor.tiles");
+        std::vector<Rect> tiles = rects_from_json(tiles_json);
+        int fw = 0, fh = 0;
+        for (const auto& t : tiles) {
+            fw = std::max(fw, t.x + t.w);
+            fh = std::max(fh, t.y + t.h);
+        }
+        const json::Value& frame = message.get("frame");
+        fw = static_cast<int>(frame.number_or("width", fw));
+        fh = static_cast<int>(frame.number_or("height", fh));
+
+        ParsedDetections p = parse_detections(message);
+        std::vector<int> tile_of;
+        for (const auto* d : p.source) tile_of.push_back(static_cast<int>(d->number_or("tile", -1)));
+        json::Value kept = json::Value::array();
+        for (const auto& m : merge_tiles(p.dets, tile_of, tiles, fw, fh, cfg_.merge)) {
+            json::Value d = *p.source[m.index];
+            json::Value bbox = json::Value::array();
+            for (float c : {m.box.x1, m.box.y1, m.box.x2, m.box.y2}) bbox.push_back(std::round(c * 10.0f) / 10.0f);
+            d["bbox"] = std::move(bbox);
+            d.erase("tile");
+            kept.push_back(std::move(d));
+        }
+        write_summary(message, kept);
+        message["detections"] = std::move(kept);
+    }
+
+    // Per-camera `results` of a synchronized tuple ({"cameras", "frames",
+    // "results"}) -> one `detections` list, each tagged with its `camera` and
+    // the cameras that saw the same object (`also_seen_by`).
+    void group_dedupe(json::Value& message) {
+        const json::Value& cameras = message.get("cameras");
+        const json::Value& frames = message.get("frames");
+        const json::Value& results = message.get("results");
+        if (!cameras.is_array() || !frames.is_array() || !results.is_array() || cameras.size() != results.size() ||
+            frames.size() != results.size())
+            throw std::runtime_error("message is not a detected frame tuple (cameras, frames, results)");
+
+        std::vector<ViewDetection> views;
+        std::vector<const json::Value*> source;
+        for (size_t c = 0; c < results.size(); ++c) {
+            const double fw = frames[c].number_or("width", 0.0), fh = frames[c].number_or("height", 0.0);
+            if (fw <= 0 || fh <= 0) throw std::runtime_error("tuple frame without width/height");
+            const ParsedDetections p = parse_detections(results[c]);
+            for (size_t i = 0; i < p.dets.size(); ++i) {
+                const Box& b = p.dets[i].box;
+                ViewDetection v;
+                v.camera = c;
+                v.label = p.source[i]->string_or("class", "");
+                v.score = p.dets[i].score;
+                v.foot = {b.center_x() / fw, b.y2 / fh};
+                v.frame_w = fw;
+                v.frame_h = fh;
+                v.height = b.height();
+                views.push_back(std::move(v));
+                source.push_back(p.source[i]);
+            }
+        }
+        std::vector<std::vector<const Homography*>> maps(cameras.size(), std::vector<const Homography*>(cameras.size()));
+        for (size_t a = 0; a < cameras.size(); ++a)
+            for (size_t b = 0; b < cameras.size(); ++b)
+                if (a != b) maps[a][b] = cfg_.ground.mapping(cameras[a].as_string(), cameras[b].as_string());
+
+        const std::vector<size_t> owner = associate_views(views, maps, cfg_.match_distance);
+        std::vector<size_t> kept_idx;
+        for (size_t i = 0; i < views.size(); ++i)
+            if (owner[i] == i) kept_idx.push_back(i);
+        std::stable_sort(kept_idx.begin(), kept_idx.end(), [&](size_t a, size_t b) { return views[a].score > views[b].score; });
+        json::Value kept = json::Value::array();
+        for (size_t i : kept_idx) {
+            json::Value d = *source[i];
+            d["camera"] = cameras[views[i].camera];
+            json::Value seen = json::Value::array();
+            for (size_t j = 0; j < views.size(); ++j)
+                if (j != i && owner[j] == i) seen.push_back(cameras[views[j].camera]);
+            if (seen.size() > 0) d["also_seen_by"] = std::move(seen);
+            kept.push_back(std::move(d));
+        }
+        message["duplicates_removed"] = views.size() - kept_idx.size();
+        write_summary(message, kept);
+        message["detections"] = std::move(kept);
+    }
+
+    // Head from shared memory ({"head": {"shm", "slot", "sequence", "shape"}})
+    // or, with binary input, from the envelope payload ({"head": {"shape"}}).
+    void yolo_decode(json::Value& message, std::string& payload) {
+        const json::Value& ref = message.get("head");
+        if (!ref.is_object()) throw std::runtime_error("message has no head reference");
+        if (ref.string_or("dtype", "float32") != "float32") throw std::runtime_error("head must be float32");
+        std::vector<int64_t> shape;
+        for (const auto& d : ref["shape"].as_array()) shape.push_back(static_cast<int64_t>(d.as_number()));
+        if (shape.size() == 2) shape.insert(shape.begin(), 1);
+        YoloLayout layout = yolo_layout_from_shape(shape);
+        const size_t per_image = static_cast<size_t>(layout.num_classes + 4) * layout.num_anchors;
+        const int batch = static_cast<int>(shape[0]);
+        const size_t bytes = per_image * batch * sizeof(float);
+
+        // Decoded in place; a shared memory head is re-validated afterwards.
+        const float* head = nullptr;
+        SlotRing* ring = nullptr;
+        const auto slot = static_cast<uint32_t>(ref.number_or("slot", 0));
+        const auto sequence = static_cast<uint64_t>(ref.number_or("sequence", 0));
+        if (ref.contains("shm")) {
+            size_t available = 0;
+            ring = &ring_for(ref["shm"].as_string());
+            head = reinterpret_cast<const float*>(ring->read(slot, sequence, &available));
+            if (available < bytes) throw std::runtime_error("head slot is smaller than its shape");
+        } else {
+            if (payload.size() != bytes) throw std::runtime_error("envelope payload does not match head shape");
+            head = reinterpret_cast<const float*>(payload.data());
+        }
+
+        // Transforms map tensor pixels back to the frame; without them boxes
+        // stay in model input coordinates.
+        const json::Value& transforms =
+            ref.contains("transforms") ? ref["transforms"] : message.get("tensor")["transforms"];
+        const json::Value& frame = message.get("frame");
+        int fw = static_cast<int>(frame.number_or("width", 1e9)), fh = static_cast<int>(frame.number_or("height", 1e9));
+        if (mask_.size() != static_cast<size_t>(layout.num_classes))
+            mask_ = names_.target_mask(targets_, layout.num_classes);
+
+        const bool tiled = message.get("tensor").contains("tiles");
+        const RoiFilter roi = RoiFilter::from_json(message.get("tensor")["roi"]);
+        std::vector<std::vector<Detection>> per_tile;
+        json::Value results = json::Value::array();
+        for (int i = 0; i < batch; ++i) {
+            candidates_.clear();
+            decode_yolov8_simd(head + i * per_image, layout, cfg_.confidence_threshold, mask_, candidates_);
+            if (transforms.is_array() && static_cast<int>(transforms.size()) > i)
+                candidates_to_frame(candidates_, LetterboxTransform::from_json(transforms[i]), fw, fh);
+            std::vector<Detection> dets = nms_.run(candidates_, cfg_.nms);
+            roi.filter(dets);
+            if (tiled) {
+                per_tile.push_back(std::move(dets));
+            } else if (batch == 1) {
+                write_detections(message, dets, names_);
+            } else {
+                json::Value r = json::Value::object();
+                write_detections(r, dets, names_);
+                roi.tag(r["detections"]);
+                results.push_back(std::move(r));
+            }
+        }
+        if (ring && !ring->still_valid(slot, sequence)) throw std::runtime_error("head was overwritten during decoding");
+        if (tiled)
+            write_tiled_detections(message, per_tile, names_);
+        else if (batch > 1)
+            message["results"] = std::move(results);
+        if (tiled || batch == 1) roi.tag(message["detections"]);
+        payload.clear();
+    }
+
+    SlotRing& ring_for(const std::string& name) {
+        auto it = rings_.find(name);
+        if (it == rings_.end()) it = rings_.emplace(name, SlotRing::open(name)).first;
+        else if (it->second.stale()) it->second = SlotRing::open(name);
+        return it->second;
+    }
+
+    PostprocessorConfig cfg_;
+    ClassNames names_;
+    json::Value targets_;
+    std::vector<uint8_t> mask_;
+    std::map<std::string, SlotRing> rings_;
+    CandidateList candidates_;
+    CandidateNms nms_;
+};
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    return processor_main(argc, argv, "cpp_postprocessor", [](const ProcessorOptions& opts) -> EnvelopeHandler {
+        auto post = std::make_shared<Postprocessor>(PostprocessorConfig::from_json(opts.config), opts.config);
+        return [post](json::Value& message, std::string& payload) { return post->handle(message, payload); };
+    });
+}
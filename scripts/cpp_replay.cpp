@@ -0,0 +1,230 @@
+// Replays a capture file (cpp_capture, or cpp_camera_hub's `capture`) as
+// the source of a route, in real time, accelerated or as fast as the next
+// stage reads.
+//
+// The source is given as a URI:
+//   replay://captures/front_door.cap?speed=10x&loop=true&start=30
+// `speed` is "1x" (default), any factor such as "10x" or "0.5x", or "max".
+// Records come out in capture order with the captured content, so two runs
+// over the same file feed a route identical input.
+//
+// Message records go to stdout as NDJSON (or binary envelopes with
+// --output-format binary). Captured frame pixels are written into
+// `/camel_replay_<camera>` slot rings and the message's frame reference is
+// rewritten to point there. With "output": "annexb" the compressed pictures
+// of one camera are written to stdout as an Annex-B stream instead; this is
+// how cpp_camera_hub replays a `replay://` camera through its decoders.
+//
+// Usage:
+//   ./bin/cpp_replay --config '{"uri": "replay://captures/door.cap?speed=max"}' |
+//     ./bin/cpp_preprocessor --config-file pre.json
+
+#include <unistd.h>
+
+#include <cerrno>
+#include <cmath>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <string>
+
+#include "cpp/capture.hpp"
+#include "cpp/envelope.hpp"
+#include "cpp/frame.hpp"
+#include "cpp/json.hpp"
+#include "cpp/processor.hpp"
+#include "cpp/shm.hpp"
+
+using namespace camel;
+
+namespace {
+
+volatile std::sig_atomic_t g_stop = 0;
+
+struct ReplayConfig {
+    std::string path;
+    double speed = 1.0;      // 0 = max
+    bool loop = false;
+    double start = 0.0;      // seconds into the capture
+    double end = 0.0;        // 0 = to the end
+    bool annexb = false;     // "output": "messages" | "annexb"
+    std::string camera;      // required for annexb when the capture holds several
+    std::string shm_prefix = "/camel_replay_";
+    uint32_t slots = 64;
+
+    static ReplayConfig from_json(const json::Value& c) {
+        ReplayConfig cfg;
+        std::map<std::string, std::string> params;
+        const std::string uri = c.string_or("uri", "");
+        if (!uri.empty()) {
+            if (uri.rfind("replay://", 0) != 0) throw std::runtime_error("config.uri must start with replay://");
+            std::string rest = uri.substr(9);
+            const size_t q = rest.find('?');
+            cfg.path = rest.substr(0, q);
+            for (size_t pos = q; pos != std::string::npos && pos < rest.size();) {
+                const size_t amp = rest.find('&', pos + 1);
+                const std::string kv = rest.substr(pos + 1, amp == std::string::npos ? std::string::npos : amp - pos - 1);
+                const size_t eq = kv.find('=');
+                if (!kv.empty()) params[kv.substr(0, eq)] = eq == std::string::npos ? "true" : kv.substr(eq + 1);
+                pos = amp;
+            }
+        }
+        auto param = [&](const char* key, const std::string& def) {
+            auto it = params.find(key);
+            return it != params.end() ? it->second : def;
+        };
+        auto flag = [](const std::string& v) { return v == "true" || v == "1" || v == "yes"; };
+        auto number = [](const std::string& v, const char* key) {
+            try {
+                return std::stod(v);
+            } catch (const std::exception&) {
+                throw std::runtime_error(std::string("invalid ") + key + " '" + v + "'");
+            }
+        };
+        cfg.path = c.string_or("path", cfg.path);
+        if (cfg.path.empty()) throw std::runtime_error("config needs a replay:// uri or a path");
+        const json::Value& speed = c.get("speed");
+        cfg.speed = parse_replay_speed(param("speed", speed.is_number() ? std::to_string(speed.as_number())
+                                                                        : c.string_or("speed", "1x")));
+        cfg.loop = flag(param("loop", c.bool_or("loop", false) ? "true" : "false"));
+        cfg.start = number(param("start", std::to_string(c.number_or("start", 0))), "start");
+        cfg.end = number(param("end", std::to_string(c.number_or("end", 0))), "end");
+        cfg.camera = param("camera", c.string_or("camera", ""));
+        const std::string output = c.string_or("output", "messages");
+        if (output != "messages" && output != "annexb") throw std::runtime_error("output must be 'messages' or 'annexb'");
+        cfg.annexb = output == "annexb";
+        cfg.shm_prefix = c.string_or("shm_prefix", cfg.shm_prefix);
+        cfg.slots = static_cast<uint32_t>(c.number_or("slots", cfg.slots));
+        if (cfg.start < 0 || cfg.end < 0 || (cfg.end > 0 && cfg.end <= cfg.start))
+            throw std::runtime_error("start and end must satisfy 0 <= start < end");
+        if (cfg.slots < 2) throw std::runtime_error("slots must be >= 2");
+        return cfg;
+    }
+};
+
+class Replay {
+public:
+    Replay(ReplayConfig cfg, const ProcessorOptions& opts)
+        : cfg_(std::move(cfg)), name_(opts.name), binary_(opts.output_format == "binary"), reader_(cfg_.path),
+          clock_(cfg_.speed) {
+        if (!reader_.indexed()) log_error(name_, cfg_.path + " has no index (recorder did not shut down); reading it through");
+    }
+
+    int run() {
+        const auto start_ns = static_cast<uint64_t>(cfg_.start * 1e9);
+        const auto end_ns = cfg_.end > 0 ? static_cast<uint64_t>(cfg_.end * 1e9) : UINT64_MAX;
+        uint64_t passes = 0, records = 0;
+        CaptureRecord rec;
+        while (!g_stop) {
+            reader_.seek(start_ns);
+            need_keyframe_ = true;
+            bool first = true, any = false;
+            while (!g_stop && reader_.next(rec) && rec.time_ns < end_ns) {
+                if (rec.time_ns < start_ns) continue;
+                if (first) clock_.reset(rec.time_ns);
+                first = false;
+                clock_.wait_until(rec.time_ns);
+                if (!emit(rec)) return 0;  // consumer went away
+                any = true;
+                ++records;
+            }
+            ++passes;
+            if (!cfg_.loop || !any) break;
+        }
+        if (reader_.truncated()) log_error(name_, cfg_.path + " ends in a partial record");
+        log_info(name_, std::to_string(records) + " records replayed in " + std::to_string(passes) + " pass(es)");
+        return 0;
+    }
+
+private:
+    bool emit(CaptureRecord& rec) {
+        if (cfg_.annexb) return rec.type == RecordType::AccessUnit ? emit_unit(rec) : true;
+        if (rec.type != RecordType::Message) return true;
+        json::Value& msg = rec.header;
+        msg.erase("trace");  // a replay is a new run with its own traces
+        std::string payload;
+        if (rec.frame_bytes > 0) {
+            publish_frame(msg, rec);
+            payload.assign(rec.payload, 0, rec.frame_offset());
+        } else {
+            payload.swap(rec.payload);
+        }
+        out_.clear();
+        msg.dump_to(out_);
+        if (binary_) {
+            write_envelope(stdout, out_, payload);
+        } else {
+            out_ += '\n';
+            std::fwrite(out_.data(), 1, out_.size(), stdout);
+        }
+        return std::fflush(stdout) == 0;
+    }
+
+    // Copies captured pixels into a replay ring and points the message at it.
+    void publish_frame(json::Value& msg, const CaptureRecord& rec) {
+        const json::Value& old = msg.get("frame");
+        const PixelFormat format = parse_pixel_format(old.string_or("format", "bgr"));
+        const int w = static_cast<int>(old.number_or("width", 0)), h = static_cast<int>(old.number_or("height", 0));
+        if (frame_bytes(format, w, h) != rec.frame_bytes) throw std::runtime_error("captured frame does not match its geometry");
+        std::string stream = msg.string_or("camera", "");
+        if (stream.empty()) {
+            stream = old.string_or("shm", "frames");
+            if (!stream.empty() && stream[0] == '/') stream.erase(0, 1);
+        }
+        std::unique_ptr<SlotRing>& ring = rings_[stream];
+        ensure_slot_ring(ring, cfg_.shm_prefix + stream, cfg_.slots, rec.frame_bytes);
+        SlotRing::WriteSlot slot = ring->begin_write();
+        std::memcpy(slot.data, rec.payload.data() + rec.frame_offset(), rec.frame_bytes);
+        ring->end_write(slot, rec.frame_bytes);
+        msg["frame"] = frame_reference(*ring, slot, format, w, h);
+    }
+
+    bool emit_unit(const CaptureRecord& rec) {
+        const std::string camera = rec.header.string_or("camera", "");
+        if (cfg_.camera.empty()) cfg_.camera = camera;  // single-camera capture
+        if (camera != cfg_.camera) return true;
+        // A decoder can only start on a keyframe; captured keyframes carry
+        // their parameter sets.
+        if (need_keyframe_ && !rec.header.bool_or("keyframe", false)) return true;
+        need_keyframe_ = false;
+        const char* p = rec.payload.data();
+        size_t n = rec.payload.size();
+        while (n > 0) {
+            ssize_t w = ::write(STDOUT_FILENO, p, n);
+            if (w < 0) {
+                if (errno == EINTR) continue;
+                return false;
+            }
+            p += w;
+            n -= static_cast<size_t>(w);
+        }
+        return true;
+    }
+
+    ReplayConfig cfg_;
+    std::string name_;
+    bool binary_;
+    CaptureReader reader_;
+    ReplayClock clock_;
+    std::map<std::string, std::unique_ptr<SlotRing>> rings_;
+    std::string out_;
+    bool need_keyframe_ = true;
+};
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    signal(SIGPIPE, SIG_IGN);
+    signal(SIGTERM, [](int) { g_stop = 1; });
+    signal(SIGINT, [](int) { g_stop = 1; });
+    try {
+        ProcessorOptions opts = parse_options(argc, argv, "cpp_replay");
+        Replay replay(ReplayConfig::from_json(opts.config), opts);
+        return replay.run();
+    } catch (const std::exception& e) {
+        log_error("cpp_replay", e.what());
+        return 1;
+    }
+}
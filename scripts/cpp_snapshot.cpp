@@ -0,0 +1,287 @@
+// Alert snapshots: JPEG stills of the frame (or of the detected objects)
+// with an optional thumbnail, for the email/http/mqtt sinks to attach.
+//
+// Frames are read from shared memory as I420/NV12 and encoded from YUV
+// directly (libjpeg-turbo raw data input): no RGB conversion, no OpenCV.
+// Crops, box overlays and thumbnails are done on the planes, and the
+// outputs of one message are encoded in parallel, each worker reusing its
+// own JPEG compressor. The message gains `snapshot_path` (and
+// `thumbnail_path`, `snapshot_url`/`thumbnail_url` when `base_url` is set).
+// With `source: evidence` the high-resolution `evidence_frame` decoded by
+// cpp_clip_recorder is used when present, with boxes scaled to it.
+//
+// Route usage (after the filter that decides what is an alert):
+//   - type: "external"
+//     command: "./bin/cpp_snapshot"
+//     config:
+//       output_dir: "snapshots"
+//       crop: "detections"
+//       thumbnail_width: 320
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <ctime>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "cpp/frame.hpp"
+#include "cpp/jpeg.hpp"
+#include "cpp/json.hpp"
+#include "cpp/probes.hpp"
+#include "cpp/processor.hpp"
+#include "cpp/worker_pool.hpp"
+#include "cpp/yuv.hpp"
+
+using namespace camel;
+
+namespace {
+
+enum class CropMode { Frame, Detections, Top, Each };
+
+CropMode parse_crop_mode(const std::string& s) {
+    if (s == "frame" || s == "none") return CropMode::Frame;
+    if (s == "detections") return CropMode::Detections;
+    if (s == "top") return CropMode::Top;
+    if (s == "each") return CropMode::Each;
+    throw std::runtime_error("unknown crop mode '" + s + "' (frame, detections, top, each)");
+}
+
+struct SnapshotConfig {
+    std::string output_dir = "snapshots";
+    std::string camera;
+    std::string base_url;
+    int quality = 85;
+    int thumbnail_quality = 75;
+    int thumbnail_width = 0;  // 0 = no thumbnail
+    CropMode crop = CropMode::Frame;
+    double crop_margin = 0.2;  // fraction of the box size added on each side
+    int min_crop = 64;         // pixels
+    int max_crops = 8;         // for crop: each
+    bool draw_boxes = true;
+    YuvColor box_color;
+    int box_thickness = 3;
+    bool expand_range = true;  // input is video range (as decoded by ffmpeg)
+    int threads = 2;
+    bool evidence = false;  // prefer the high-res `evidence_frame` of cpp_clip_recorder
+
+    static SnapshotConfig from_json(const json::Value& c, const std::string& name) {
+        SnapshotConfig cfg;
+        cfg.output_dir = c.string_or("output_dir", cfg.output_dir);
+        cfg.camera = c.string_or("camera", name);
+        cfg.base_url = c.string_or("base_url", cfg.base_url);
+        cfg.quality = static_cast<int>(c.number_or("quality", cfg.quality));
+        cfg.thumbnail_quality = static_cast<int>(c.number_or("thumbnail_quality", cfg.thumbnail_quality));
+        cfg.thumbnail_width = static_cast<int>(c.number_or("thumbnail_width", cfg.thumbnail_width));
+        cfg.crop = parse_crop_mode(c.string_or("crop", "frame"));
+        cfg.crop_margin = c.number_or("crop_margin", cfg.crop_margin);
+        cfg.min_crop = static_cast<int>(c.number_or("min_crop", cfg.min_crop));
+        cfg.max_crops = static_cast<int>(c.number_or("max_crops", cfg.max_crops));
+        cfg.draw_boxes = c.bool_or("draw_boxes", cfg.draw_boxes);
+        cfg.box_color = parse_color(c.string_or("box_color", "red"), true);
+        cfg.box_thickness = static_cast<int>(c.number_or("box_thickness", cfg.box_thickness));
+        std::string range = c.string_or("input_range", "limited");
+        if (range != "limited" && range != "full") throw std::runtime_error("input_range must be 'limited' or 'full'");
+        cfg.expand_range = range == "limited";
+        cfg.threads = static_cast<int>(c.number_or("threads", cfg.threads));
+        std::string source = c.string_or("source", "frame");
+        if (source != "frame" && source != "evidence") throw std::runtime_error("source must be 'frame' or 'evidence'");
+        cfg.evidence = source == "evidence";
+        if (cfg.quality < 1 || cfg.quality > 100 || cfg.thumbnail_quality < 1 || cfg.thumbnail_quality > 100)
+            throw std::runtime_error("quality must be in 1..100");
+        if (cfg.thumbnail_width < 0 || cfg.threads < 0 || cfg.max_crops < 1)
+            throw std::runtime_error("thumbnail_width/threads must be >= 0 and max_crops >= 1");
+        return cfg;
+    }
+};
+
+struct Box2D {
+    Rect rect;
+    float score = 0.0f;
+    size_t index = 0;  // in the message's detections list
+};
+
+class Snapshotter {
+public:
+    Snapshotter(SnapshotConfig cfg, std::string name)
+        : cfg_(std::move(cfg)), name_(std::move(name)), pool_(static_cast<size_t>(std::max(0, cfg_.threads - 1))) {
+        std::filesystem::create_directories(cfg_.output_dir);
+    }
+
+    bool handle(json::Value& message) {
+        // Detections are in `frame` pixels; an evidence frame of the same
+        // scene at another resolution gets them scaled.
+        const json::Value& detected = message.get("frame");
+        const bool evidence = cfg_.evidence && message.get("evidence_frame").is_object();
+        const json::Value& ref = evidence ? message.get("evidence_frame") : detected;
+        FrameView frame = frames_.resolve(ref);
+        double sx = 1.0, sy = 1.0;
+        if (evidence && detected.number_or("width", 0) > 0 && detected.number_or("height", 0) > 0) {
+            sx = frame.width / detected["width"].as_number();
+            sy = frame.height / detected["height"].as_number();
+        }
+        std::vector<Box2D> boxes = parse_boxes(message.get("detections"), frame, sx, sy);
+
+        std::string base = cfg_.output_dir + "/" + cfg_.camera + "_" + unique_timestamp();
+        std::vector<Output> outputs;
+        Rect main = plan_main(boxes, frame);
+        outputs.push_back({main, base + ".jpg", 0, cfg_.quality, "snapshot", nullptr});
+        if (cfg_.thumbnail_width > 0)
+            outputs.push_back({main, base + "_thumb.jpg", cfg_.thumbnail_width, cfg_.thumbnail_quality, "thumbnail", nullptr});
+        if (cfg_.crop == CropMode::Each) {
+            for (size_t i = 0; i < boxes.size() && static_cast<int>(i) < cfg_.max_crops; ++i)
+                outputs.push_back({with_margin(boxes[i].rect, frame), base + "_" + std::to_string(i) + ".jpg", 0,
+                                   cfg_.quality, "", &boxes[i]});
+        }
+
+        std::vector<std::function<void()>> jobs;
+        for (const auto& out : outputs) jobs.push_back([this, &out, &frame, &boxes] { render(out, frame, boxes); });
+        try {
+            pool_.run(jobs);
+            if (!frames_.still_valid(ref)) throw std::runtime_error("frame slot was overwritten while encoding");
+        } catch (...) {
+            for (const auto& out : outputs) {
+                std::error_code ec;
+                std::filesystem::remove(out.path, ec);
+            }
+            throw;
+        }
+
+        for (const auto& out : outputs) {
+            json::Value& target = out.detection ? message["detections"][out.detection->index] : message;
+            std::string prefix = out.detection ? "snapshot" : out.field;
+            target[prefix + "_path"] = out.path;
+            if (!cfg_.base_url.empty()) target[prefix + "_url"] = url_for(out.path);
+        }
+        return true;
+    }
+
+private:
+    struct Output {
+        Rect crop;
+        std::string path;
+        int width;  // scaled output width, 0 = crop size
+        int quality;
+        std::string field;       // message key prefix
+        const Box2D* detection;  // per-detection crop: keys go on that detection
+    };
+
+    // Detections as pixel rectangles, in list order; entries without a
+    // usable bbox are skipped.
+    std::vector<Box2D> parse_boxes(const json::Value& list, const FrameView& f, double sx, double sy) {
+        std::vector<Box2D> boxes;
+        if (!list.is_array()) return boxes;
+        for (size_t i = 0; i < list.size(); ++i) {
+            const json::Value& b = list[i]["bbox"];
+            if (!b.is_array() || b.size() != 4) continue;
+            int x1 = std::clamp(static_cast<int>(std::floor(b[0].as_number() * sx)), 0, f.width);
+            int y1 = std::clamp(static_cast<int>(std::floor(b[1].as_number() * sy)), 0, f.height);
+            int x2 = std::clamp(static_cast<int>(std::ceil(b[2].as_number() * sx)), 0, f.width);
+            int y2 = std::clamp(static_cast<int>(std::ceil(b[3].as_number() * sy)), 0, f.height);
+            if (x2 <= x1 || y2 <= y1) continue;
+            boxes.push_back({{x1, y1, x2 - x1, y2 - y1}, static_cast<float>(list[i].number_or("confidence", 0.0)), i});
+        }
+        return boxes;
+    }
+
+    Rect plan_main(const std::vector<Box2D>& boxes, const FrameView& f) const {
+        if (boxes.empty() || cfg_.crop == CropMode::Frame || cfg_.crop == CropMode::Each) return {0, 0, f.width, f.height};
+        if (cfg_.crop == CropMode::Top) {
+            auto top = std::max_element(boxes.begin(), boxes.end(), [](const Box2D& a, const Box2D& b) { return a.score < b.score; });
+            return with_margin(top->rect, f);
+        }
+        Rect u = boxes.front().rect;
+        for (const auto& b : boxes) {
+            int x2 = std::max(u.x + u.w, b.rect.x + b.rect.w), y2 = std::max(u.y + u.h, b.rect.y + b.rect.h);
+            u.x = std::min(u.x, b.rect.x);
+            u.y = std::min(u.y, b.rect.y);
+            u.w = x2 - u.x;
+            u.h = y2 - u.y;
+        }
+        return with_margin(u, f);
+    }
+
+    Rect with_margin(Rect r, const FrameView& f) const {
+        int mx = static_cast<int>(r.w * cfg_.crop_margin), my = static_cast<int>(r.h * cfg_.crop_margin);
+        mx = std::max(mx, (cfg_.min_crop - r.w + 1) / 2);
+        my = std::max(my, (cfg_.min_crop - r.h + 1) / 2);
+        return even_crop(f, {r.x - mx, r.y - my, r.w + 2 * mx, r.h + 2 * my});
+    }
+
+    // Runs on a pool worker: crop, overlay, scale, encode, write.
+    void render(const Output& out, const FrameView& frame, const std::vector<Box2D>& boxes) {
+        thread_local YuvImage image, scaled;
+        thread_local std::vector<uint8_t> jpeg;
+        copy_to_i420(frame, out.crop, image, cfg_.expand_range && frame.is_yuv());
+        Rect crop = even_crop(frame, out.crop);
+        if (cfg_.draw_boxes) {
+            for (const auto& b : boxes)
+                draw_rect(image.view, {b.rect.x - crop.x, b.rect.y - crop.y, b.rect.w, b.rect.h}, cfg_.box_thickness,
+                          cfg_.box_color);
+        }
+        YuvImage* src = &image;
+        if (out.width > 0 && out.width < image.width) {
+            int h = std::max(2, static_cast<int>(std::lround(static_cast<double>(image.height) * out.width / image.width)) & ~1);
+            downscale(image, out.width & ~1, h, scaled);
+            src = &scaled;
+        }
+        thread_jpeg_encoder().encode(*src, out.quality, jpeg);
+        write_file(out.path, jpeg);
+    }
+
+    static void write_file(const std::string& path, const std::vector<uint8_t>& data) {
+        std::string part = path + ".part";
+        FILE* f = std::fopen(part.c_str(), "wb");
+        if (!f) throw std::runtime_error("cannot write " + part);
+        bool ok = std::fwrite(data.data(), 1, data.size(), f) == data.size();
+        ok = std::fclose(f) == 0 && ok;
+        if (!ok) {
+            std::remove(part.c_str());
+            throw std::runtime_error("short write to " + part);
+        }
+        std::filesystem::rename(part, path);
+        CAMEL_PROBE4(deliver, probes::route(), probes::stage(), path.c_str(), static_cast<uint64_t>(data.size()));
+    }
+
+    std::string url_for(const std::string& path) const {
+        std::string file = std::filesystem::path(path).filename().string();
+        return cfg_.base_url.back() == '/' ? cfg_.base_url + file : cfg_.base_url + "/" + file;
+    }
+
+    // Local time to the millisecond, with a counter when two alerts share it.
+    std::string unique_timestamp() {
+        auto now = std::chrono::system_clock::now();
+        std::time_t t = std::chrono::system_clock::to_time_t(now);
+        int ms = static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()).count() % 1000);
+        std::tm tm{};
+        localtime_r(&t, &tm);
+        char buf[40];
+        std::snprintf(buf, sizeof(buf), "%04d%02d%02d-%02d%02d%02d-%03d", tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday,
+                      tm.tm_hour, tm.tm_min, tm.tm_sec, ms);
+        std::string stamp = buf;
+        repeat_ = stamp == last_stamp_ ? repeat_ + 1 : 0;
+        last_stamp_ = stamp;
+        return repeat_ ? stamp + "-" + std::to_string(repeat_) : stamp;
+    }
+
+    SnapshotConfig cfg_;
+    std::string name_;
+    FrameStore frames_;
+    WorkerPool pool_;
+    std::string last_stamp_;
+    int repeat_ = 0;
+};
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    return processor_main(argc, argv, "cpp_snapshot", [](const ProcessorOptions& opts) -> MessageHandler {
+        auto snap = std::make_shared<Snapshotter>(SnapshotConfig::from_json(opts.config, opts.name), opts.name);
+        return [snap](json::Value& message) { return snap->handle(message); };
+    });
+}